@@ -0,0 +1,130 @@
+// ============================================================================
+//  Filnavn : config_eeprom.h
+//  Projekt  : Modbus RTU Server / CLI
+//  Version  : v3.9.6 (2026-10-18)
+//  Forfatter: JanG at modbus_slave@laces.dk
+//  Formål   : Lav-niveau EEPROM-adgang for config-store.
+//             Differentiel skrivning: hver byte sammenlignes med den lagrede
+//             og programmeres kun hvis den er ændret (~3.4 ms pr. byte, og
+//             kun ændrede celler slides). Antal skrevne bytes og tid gemmes
+//             til rapportering efter save.
+//  Ændringer:
+//    - v3.9.1: A/B journal-slots med sekvensnummer og CRC16
+//    - v3.9.2: 2560..4095 bruges af retentive counter-ring
+//    - v3.9.3: Streaming slot-skrivning (begin/append/commit) og
+//              eeprom_slot_info() til streaming læsning (TLV-config)
+//    - v3.9.6: Generisk stream (eeprom_stream_*) til slots og profiler;
+//              retentive ring 2560..3327, profil-område 3328..4095
+//    - v3.9.6: Trinvis slot-skrivning (eeprom_slot_step_*) til udskudt
+//              save: højst én ændret byte pr. trin, så loop ikke venter
+//
+//  EEPROM-layout (4096 bytes):
+//    0    .. 1279 : config slot A  (header + image)
+//    1280 .. 2559 : config slot B
+//    2560 .. 3327 : retentive counter-ring (modbus_counters_retain.h)
+//    3328 .. 4095 : navngivne config-profiler (config_profile.h)
+//  Save skriver altid den inaktive slot: først image, så header. Headerens
+//  CRC16 (Modbus-polynomium) dækker sekvens, længde og image, så en reset
+//  midt i en save efterlader den gamle slot som nyeste gyldige. Load vælger
+//  den gyldige slot med højeste sekvens. Skiftende slots halverer sliddet.
+//  Et image fra før v3.9.1 ligger på offset 0 uden header; første save går
+//  derfor til slot B, så det gamle image bevares til den nye er skrevet.
+// ============================================================================
+
+#pragma once
+#include <Arduino.h>
+
+struct EepromWriteStats {
+  uint16_t compared;    // bytes sammenlignet
+  uint16_t written;     // bytes programmeret (ændrede)
+  uint32_t elapsedUs;   // samlet tid inkl. venten på EEPROM
+};
+
+// Seneste eeprom_write_diff() (eller sum over en save, se eeprom_stats_begin)
+extern EepromWriteStats eepromLastWrite;
+
+// Nulstil eepromLastWrite før en save der består af flere skrivninger
+void eeprom_stats_begin();
+
+// Skriv len bytes til addr; kun bytes der afviger fra EEPROM programmeres.
+// Returnerer antal programmerede bytes (lægges til eepromLastWrite).
+uint16_t eeprom_write_diff(uint16_t addr, const void* data, uint16_t len);
+
+// CLI: "EEPROM: n/m bytes written in x ms"
+void eeprom_print_last_write();
+
+// CRC16 (Modbus-polynomium) fortsat over len bytes direkte fra EEPROM
+uint16_t eeprom_crc16(uint16_t crc, uint16_t addr, uint16_t len);
+
+// ============================================================================
+// Streaming-skrivning til et vilkårligt område (journal-slot eller profil)
+// ============================================================================
+// append skriver næste stykke differentielt fra addr og opdaterer en CRC16
+// over de appendede data; false hvis maxLen overskrides. dryRun = kun
+// længde og CRC (bruges til at måle et image før der findes plads).
+// end returnerer længde og CRC; false ved overflow.
+void eeprom_stream_begin(uint16_t addr, uint16_t maxLen, bool dryRun = false);
+bool eeprom_stream_append(const void* data, uint16_t len);
+bool eeprom_stream_end(uint16_t& len, uint16_t& crc);
+
+// ============================================================================
+// Journal-slots (A/B)
+// ============================================================================
+#define EEPROM_SLOT_COUNT     2
+#define EEPROM_SLOT_BASE      0
+#define EEPROM_SLOT_SIZE      1280
+#define EEPROM_SLOT_MAGIC     0x5A1C
+
+struct EepromSlotHeader {
+  uint16_t magic;       // EEPROM_SLOT_MAGIC
+  uint16_t seq;         // tælles op pr. save (wrap-sikker sammenligning)
+  uint16_t len;         // image-længde i bytes
+  uint16_t crc;         // CRC16 over seq, len og image
+};
+
+#define EEPROM_SLOT_PAYLOAD   (EEPROM_SLOT_SIZE - sizeof(EepromSlotHeader))
+
+// Scan begge slots og vælg nyeste gyldige. Returnerer slot (0/1) eller -1.
+int8_t eeprom_slot_scan();
+
+// Læs image fra slot (op til maxLen bytes, resten nulstilles).
+// len = lagret længde. false hvis slot er ugyldig.
+bool eeprom_slot_read(uint8_t slot, void* dst, uint16_t maxLen, uint16_t& len);
+
+// Adresse og længde på image i en gyldig slot (til streaming læsning).
+// false hvis slot er ugyldig.
+bool eeprom_slot_info(uint8_t slot, uint16_t& addr, uint16_t& len);
+
+// Streaming skrivning til den inaktive slot uden RAM-kopi af hele image:
+//   eeprom_slot_begin() vælger slot og starter en stream,
+//   eeprom_slot_append() skriver næste stykke (differentielt) og
+//   eeprom_slot_commit() skriver header sidst og verificerer CRC.
+//   append returnerer false hvis image ikke kan være der. TLV-writeren
+//   bruger eeprom_stream_append() direkte (samme stream).
+int8_t eeprom_slot_begin();
+bool   eeprom_slot_append(const void* data, uint16_t len);
+int8_t eeprom_slot_commit();
+
+// Trinvis skrivning til den inaktive slot (udskudt save fra loop). Hvert
+// trin streamer hele image, men programmerer højst én ændret byte:
+//   if (eeprom_slot_step_begin()) { append hele image; r = eeprom_slot_step_end(); }
+//   begin returnerer false mens EEPROM er optaget (trinnet springes over).
+//   end returnerer EEPROM_STEP_MORE indtil image og derefter header stemmer,
+//   så slot (0/1), -1 ved verify-fejl eller -2 hvis image ikke kan være der.
+// Ændres data undervejs, skrives blot de nye bytes i de følgende trin; et
+// trin uden afvigelser er derfor altid et konsistent image.
+#define EEPROM_STEP_MORE  (-3)
+bool   eeprom_slot_step_begin();
+int8_t eeprom_slot_step_end();
+void   eeprom_slot_step_cancel();     // glem slot (ny save starter forfra)
+
+// Skriv image til den inaktive slot (begin + append + commit).
+// Returnerer den skrevne slot eller -1 ved fejl/for stort image.
+int8_t eeprom_slot_write(const void* data, uint16_t len);
+
+// Aktiv slot (-1 = ingen) og dens sekvensnummer
+int8_t   eeprom_slot_active();
+uint16_t eeprom_slot_seq();
+
+// CLI: 'show eeprom'
+void eeprom_print_status();
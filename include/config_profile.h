@@ -0,0 +1,113 @@
+// ============================================================================
+//  Filnavn : config_profile.h
+//  Projekt  : Modbus RTU Server / CLI
+//  Version  : v3.9.6 (2026-10-18)
+//  Forfatter: JanG at modbus_slave@laces.dk
+//  Formål   : Navngivne config-profiler (opskrifter) i EEPROM. Hver profil
+//             er et TLV-image (config_tlv.h) og kan hot-applies med én
+//             holding-reg skrivning (diff-apply, configApply v3.9.5).
+//
+//  EEPROM (efter retentive ring, se config_eeprom.h):
+//    PROFILE_AREA_BASE   : område-header {magic, side-størrelse, sider}.
+//                          Første byte 0xF1 er aldrig et gyldigt retain-
+//                          record id, så et område fra før v3.9.6 (retain
+//                          ring) genkendes som uformateret. Formateres ved
+//                          første boot (modbus_counters_retain.cpp).
+//    derefter PROFILE_PAGES sider à PROFILE_PAGE_SIZE bytes.
+//  En profil fylder et sammenhængende sidespænd (first fit):
+//    ProfileHeader {magic, nr, sider, seq, len, navn, crc16} + TLV-image.
+//  Antal profiler afhænger derfor af deres størrelse (op til PROFILE_MAX):
+//  23 sider = 736 bytes, så der er plads til 1-2 profiler på 300-500 bytes
+//  og kun små profiler når op på PROFILE_MAX.
+//  Save skriver image i frie sider, header sidst (crc over image + header)
+//  og ugyldiggør derefter den gamle version - et strømsvigt efterlader
+//  altid den gamle eller den nye. To gyldige med samme nr: højeste seq.
+//  Er der ikke plads til begge kopier, genbruges den gamles sider (den
+//  ugyldiggøres først), og profilerne pakkes mod side 0 hvis den frie
+//  plads er delt op. Strømsvigt i det tilfælde kan miste den profil der
+//  gemmes eller flyttes, men aldrig boot-config.
+//
+//  Register-blok (base = profile-reg, 0 = deaktiveret), PROFILE_REGS regs:
+//    base+0 : select - skriv n (1..PROFILE_MAX) = apply profil n;
+//             bit15 = gem også som boot-config. Nulstilles når udført.
+//    base+1 : aktiv profil (0 = basis-config fra journal-slot)
+//    base+2 : status for seneste select (PROFILE_ST_*)
+//  Select udføres fra loop efter frame-behandlingen (svaret er sendt), og
+//  slave-ID, baud, server-flag, hostname og profile-reg beholdes. Med bit15
+//  skrives boot-config trinvis (configSaveDeferred); status er
+//  PROFILE_ST_SAVING til den er færdig.
+// ============================================================================
+
+#pragma once
+#include <Arduino.h>
+#include "modbus_core.h"
+#include "modbus_counters_retain.h"
+
+#define PROFILE_AREA_BASE   (RETAIN_RING_BASE + RETAIN_RING_RECS * RETAIN_REC_SIZE)
+#define PROFILE_AREA_END    (E2END + 1)
+#define PROFILE_AREA_MAGIC  0x50F1
+#define PROFILE_AREA_HDR    4
+#define PROFILE_PAGE_SIZE   32
+#define PROFILE_PAGES       ((PROFILE_AREA_END - PROFILE_AREA_BASE - PROFILE_AREA_HDR) / PROFILE_PAGE_SIZE)
+#define PROFILE_MAGIC       0x9F3A
+#define PROFILE_MAX         8
+#define PROFILE_NAME_LEN    8
+
+#define PROFILE_REG_SELECT  0
+#define PROFILE_REG_ACTIVE  1
+#define PROFILE_REG_STATUS  2
+#define PROFILE_REGS        3
+#define PROFILE_SEL_SAVE    0x8000
+
+// Status (base+2 og returværdi fra profile_apply/profile_save)
+#define PROFILE_ST_NONE     0   // intet select siden boot
+#define PROFILE_ST_PENDING  1   // select modtaget, udføres efter svaret
+#define PROFILE_ST_OK       2
+#define PROFILE_ST_EMPTY    3   // ingen profil med det nr
+#define PROFILE_ST_INVALID  4   // CRC/record-fejl - kørende config urørt
+#define PROFILE_ST_RANGE    5   // nr udenfor 1..PROFILE_MAX
+#define PROFILE_ST_SAVEFAIL 6   // applied, men boot-config kunne ikke gemmes
+#define PROFILE_ST_FULL     7   // (kun save) ikke plads i profil-området
+#define PROFILE_ST_SAVING   8   // applied, boot-config skrives (udskudt save)
+
+struct ProfileHeader {
+  uint16_t magic;               // PROFILE_MAGIC (0 = slettet)
+  uint8_t  no;                  // 1..PROFILE_MAX
+  uint8_t  pages;               // sider inkl. header
+  uint16_t seq;
+  uint16_t len;                 // TLV-image bytes efter header
+  char     name[PROFILE_NAME_LEN];  // ikke nødvendigvis 0-termineret
+  uint16_t crc;                 // crc16 over image + header før crc
+};
+
+extern uint16_t profileReg;     // base holding-reg (0 = deaktiveret)
+extern uint8_t  profileActive;  // aktiv profil (0 = basis-config)
+
+// true hvis profil-området er formateret (ellers gammel retain-ring data)
+bool profile_area_formatted();
+
+// Formatér profil-området (område-header). Kaldes af retain-scan ved første
+// boot efter at gammel retain-data er migreret; no-op hvis formateret.
+void profile_area_format();
+
+// Sæt select/aktiv/status-blok. false ved ugyldig reg-blok.
+bool profile_config_set(uint16_t reg);
+
+// Gem cfg (fuldt udfyldt, se configCapture) som profil no med navn
+uint8_t profile_save(uint8_t no, const char* name, const PersistConfig& cfg);
+
+// Slet profil no. false hvis den ikke findes.
+bool profile_delete(uint8_t no);
+
+// Indlæs profil no i globalConfig og hot-apply den; save = gem også som
+// boot-config. Returnerer PROFILE_ST_*.
+uint8_t profile_apply(uint8_t no, bool save);
+
+// Kaldes fra FC06/FC16 efter en holding-reg skrivning (status = pending)
+void profile_on_reg_write(uint16_t addr);
+
+// Udfør ventende select + publicér aktiv/status (kaldes fra modbusLoop())
+void profile_loop();
+
+// CLI: 'show profiles'
+void profile_print();
@@ -0,0 +1,72 @@
+// ============================================================================
+//  Filnavn : config_tlv.h
+//  Projekt  : Modbus RTU Server / CLI
+//  Version  : v3.9.6 (2026-10-18)
+//  Forfatter: JanG at modbus_slave@laces.dk
+//  Formål   : Kompakt tag-length-value format for config i EEPROM-slots.
+//             Kun det der er konfigureret gemmes: system-record, enabled
+//             timers/counters, mappede GPIO-pins, brugte statiske
+//             registre/coils og udvidelses-blokke der ikke er slået fra.
+//             PersistConfig er stadig RAM-repræsentationen; den skrives og
+//             læses record for record direkte til/fra EEPROM (ingen kopi).
+//             Samme image bruges til navngivne profiler (config_profile.h).
+//
+//  Image: uint16 CONFIG_TLV_MAGIC, uint8 schema (skriverens CONFIG_SCHEMA),
+//         derefter records {uint8 tag, uint8 len, value[len]}.
+//         Indekserede records (timer/counter-blokke) har idx som value[0].
+//  Load:  cfg sættes til configDefaults(), og hver record lægges ovenpå.
+//         Ukendte tags springes over (nyere firmware -> ældre virker).
+//  Migrering pr. record: felter tilføjes sidst i record-structs. En kortere
+//         record fra ældre firmware læses som præfiks, resten beholder
+//         default. En længere record (nyere firmware) afkortes. Ændres et
+//         felts betydning, får record'en et nyt tag, og det gamle oversættes
+//         i config_tlv.cpp.
+//  Timer/counter-records rummer kun konfig-felterne (TlvTimer/TlvCounter);
+//         runtime-felter (fase, tællerværdi, frekvens, tidsstempler) gemmes
+//         ikke og nulstilles ved læsning.
+// ============================================================================
+
+#pragma once
+#include <Arduino.h>
+#include "modbus_core.h"
+
+#define CONFIG_TLV_MAGIC  0x7C1F    // rå struct-image starter med 0xC0DE
+
+enum ConfigTlvTag : uint8_t {
+  TLV_SYSTEM      = 0x01,   // id, server, baud, timer status/ctrl, sampler, snapshot, profil
+  TLV_HOSTNAME    = 0x02,   // tekst uden 0-terminering
+  TLV_STATIC_REG  = 0x03,   // addr, værdi
+  TLV_STATIC_COIL = 0x04,   // idx, værdi
+  TLV_GPIO        = 0x05,   // pin, coil, input (-1 = ingen)
+  TLV_TIMER_V1    = 0x10,   // idx, hel TimerConfig (før v3.9.6, kun læsning)
+  TLV_TIMER_REGS  = 0x11,   // idx, param-reg, seq-reg, trigger-pin
+  TLV_WAVE        = 0x12,   // TimerWaveConfig
+  TLV_TIMER       = 0x13,   // idx, TimerConfig konfig-felter (TlvTimer)
+  TLV_COUNTER_V1  = 0x20,   // idx, hel CounterConfig (før v3.9.6, kun læsning)
+  TLV_COUNTER_OPT = 0x21,   // idx, reset-on-read, auto-start, filter-us, rate-reg
+  TLV_COMPARE     = 0x22,   // idx, CounterCompareConfig
+  TLV_EDGELOG     = 0x23,   // idx, CounterEdgeLogConfig
+  TLV_PWM         = 0x24,   // idx, CounterPwmConfig
+  TLV_GATEWIN     = 0x25,   // idx, CounterGateWindowConfig
+  TLV_RETAIN      = 0x26,   // idx, CounterRetainConfig
+  TLV_COUNTER     = 0x27    // idx, CounterConfig konfig-felter (TlvCounter)
+};
+
+// Append cfg som TLV-image til den åbne EEPROM-stream (eeprom_stream_begin
+// eller eeprom_slot_begin). false hvis image ikke kan være i streamen.
+bool config_tlv_write(const PersistConfig& cfg);
+
+// Skriv cfg som TLV-image i den inaktive journal-slot.
+// Returnerer slot, -1 ved verify-fejl eller -2 hvis image ikke kan være i
+// slotten (kalder gemmer så rå PersistConfig, som altid passer).
+int8_t config_tlv_save(const PersistConfig& cfg);
+
+// true hvis gyldig slot indeholder et TLV-image
+bool config_tlv_is(uint8_t slot);
+
+// Læs TLV-image fra slot ind i cfg (defaults + records).
+// false hvis record-strukturen er ødelagt.
+bool config_tlv_load(uint8_t slot, PersistConfig& cfg);
+
+// Som config_tlv_load() for et image på EEPROM-adresse addr (len bytes)
+bool config_tlv_load_at(uint16_t addr, uint16_t len, PersistConfig& cfg);
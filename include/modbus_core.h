@@ -6,6 +6,7 @@
 //  Formål   : Centrale konstanter, Modbus FC-definitioner, RTU-buffer, 
 //             hardwarekonfiguration og PersistConfig (EEPROM).
 //  Ændringer:
+//    - v3.9.6: configCaptureBase() (basis-felter, fra CLI til config_store)
 //    - v3.1.2-patch1: Tilføjet CounterConfig i PersistConfig (EEPROM schema v4)
 //    - v3.1.0-patch1: CounterEngine integration (Opgave 5)
 //    - v3.0.x        : TimerEngine, CLI, RS485, buffer utils
@@ -59,6 +60,8 @@ void sendException(uint8_t rxSlave, uint8_t functionCode, uint8_t exceptionCode)
 void initModbus();
 void processModbusFrame(uint8_t *frame, uint8_t len);
 void modbusLoop();
+uint32_t modbus_next_deadline_ms();   // idle-scheduler (0 = RX i gang)
+void modbus_rx_flush();               // kassér halv frame (baud/ID ændret)
 
 // ===== Status/info =====
 void printStatistics();
@@ -101,6 +104,15 @@ void cli_loop();
 // ===== Include dependent modules =====
 #include "modbus_timers.h"
 #include "modbus_counters.h"   // CounterConfig v3
+#include "modbus_counters_compare.h"
+#include "modbus_counters_edgelog.h"
+#include "modbus_counters_pwm.h"
+#include "modbus_counters_window.h"
+#include "modbus_counters_rate.h"
+#include "modbus_counters_retain.h"
+#include "modbus_timers_wave.h"
+#include "modbus_timers_seq.h"
+#include "modbus_timers_trig.h"
 
 // ============================================================================
 //  EEPROM schema v8 – inkl. counter control arrays
@@ -153,10 +165,36 @@ struct PersistConfig {
   int16_t gpioToCoil[NUM_GPIO];        // GPIO pin -> coil index (-1 = unmapped)
   int16_t gpioToInput[NUM_GPIO];       // GPIO pin -> input index (-1 = unmapped)
 
+  // --------------------------------------------
+  // Udvidelser (schema 13+)
+  // PersistConfig er append-only fra schema 12: nye felter tilføjes lige før
+  // crc, så et ældre image er et præfiks af den nye struct. configLoad()
+  // verificerer checksum ved den gamle længde og default'er resten.
+  // --------------------------------------------
+  uint16_t samplerHz;      // v13: counter sampler-rate i Hz (0 = fra)
+  uint16_t counterFilterUs[4]; // v14: input-filter pr. counter i µs (0 = debounce-ms)
+  CounterCompareConfig counterCompare[4]; // v15: compare-setpoints pr. counter
+  uint16_t snapshotReg;    // v16: snapshot-blok base-reg (0 = fra)
+  uint8_t  snapshotPin;    // v16: INT-pin trigger for snapshot (0 = ingen)
+  CounterEdgeLogConfig counterEdgeLog[4]; // v17: edge-tidsstempel ring pr. counter
+  CounterPwmConfig counterPwm[4];         // v18: pulsbredde/duty-måling pr. counter
+  CounterGateWindowConfig counterGateWin[4]; // v19: gate-input + tidsvindue pr. counter
+  uint16_t counterRateReg[4];  // v20: rate/totalizer blok pr. counter (0 = fra)
+  TimerWaveConfig timerWave;   // v21: waveform reg-blok + Timer1 OC-pin (mode 5)
+  uint16_t timerParamReg[4];   // v22: live T1..T3/P1..P3 reg-blok pr. timer (0 = fra)
+  uint16_t timerSeqReg[4];     // v23: trin-program reg-blok pr. timer (mode 6, 0 = fra)
+  uint8_t  timerTrigPin[4];    // v24: INT/PCINT trigger-pin pr. timer (mode 4, 0 = polling)
+  CounterRetainConfig counterRetain[4]; // v25: checkpoint-regel pr. counter (0/0 = fra)
+  uint16_t profileReg;         // v26: profil-vælger reg-blok (0 = fra)
+  uint8_t  profileActive;      // v26: profil image stammer fra (0 = basis-config)
+
   // Integritet
   uint16_t crc;            // checksum (additiv) over alle felter undtagen crc
 };
 
+// Aktuelt EEPROM schema (se configLoad() for migrering af ældre schemas)
+#define CONFIG_SCHEMA  26
+
 // ============================================================================
 //  Prototyper for config-store
 // ============================================================================
@@ -166,4 +204,20 @@ extern PersistConfig globalConfig;
 bool configLoad(PersistConfig &cfg);
 void configDefaults(PersistConfig &cfg);
 bool configSave(const PersistConfig &cfg);
+void configCaptureBase(PersistConfig &cfg);  // kørende basis-felter -> cfg
+void configCapture(PersistConfig &cfg);      // kørende udvidelser -> cfg (+ crc)
 void configApply(const PersistConfig &cfg);
+void configDump(const PersistConfig &cfg);   // CLI: show config dump
+
+// Udskudt save (v3.9.6): kørende config fanges nu (configCapture ->
+// globalConfig) og skrives trinvis fra modbusLoop via configSaveStep(),
+// højst én ændret EEPROM-byte pr. trin, så bussen ikke blokeres.
+#define CONFIG_SAVE_IDLE     0
+#define CONFIG_SAVE_BUSY     1
+#define CONFIG_SAVE_OK       2
+#define CONFIG_SAVE_FAIL     3
+#define CONFIG_SAVE_STEP_MS  4     // én EEPROM-byte tager ~3,4 ms
+void     configSaveDeferred();
+void     configSaveStep();
+uint8_t  configSaveState();
+uint32_t config_save_next_deadline_ms();
@@ -7,6 +7,16 @@
 //             inkl. prescaler, bitwidth, overflow-flag, retning, scaling,
 //             soft-control via controlReg (start/stop/reset) og debounce.
 //  Ændringer:
+//    - v3.9.6: counters_regs_owner() til reg-blok overlap
+//    - v3.9.6: counters_set_running(), counters_uses_reg(); diff-apply
+//              nulstiller flyttede registre
+//    - v3.9.6: counters_uses_pin() til pin-ejerskab i udvidelses-blokke
+//    - v3.9.6: counterWrapSeq[] (omløbs-tæller til rate)
+//    - v3.9.6: counters_next_deadline_ms() med reelle vindue-deadlines
+//    - v3.9.5: counters_config_diff_set() - hot reconfig uden værdi-tab
+//    - v3.8.1: counters_next_deadline_ms() til idle sleep
+//    - v3.7.2: Input-filter med µs-opløsning (counterFilterUs[4] +
+//              counterFilter[4]) fælles for polling-, sampler- og ISR-vej.
 //    - v3.2.0: Tilføjet counterAutoStartEnable[4] array for individuel
 //              auto-start kontrol ved config load/reboot.
 //              CLI-kommando: "set counters start counter<n>:on|off"
@@ -22,6 +32,7 @@
 #pragma once
 #include <Arduino.h>
 #include "modbus_globals.h"
+#include "modbus_input_filter.h"
 
 // ============================================================================
 // CounterEngine - Global control arrays
@@ -30,6 +41,14 @@
 // 0 = disabled, 1 = enabled
 extern uint8_t counterResetOnReadEnable[4];  // index 0..3 = counter 1..4
 extern uint8_t counterAutoStartEnable[4];    // auto-start ved config load/reboot
+extern uint16_t counterFilterUs[4];          // input-filter vindue i µs (0 = brug debounce-ms)
+// +1 ved hvert overflow/underflow med auto-reset til startValue (mod 256).
+// Skelner et ægte omløb fra en værdi-skrivning/reset (rate_loop).
+extern volatile uint8_t counterWrapSeq[4];
+
+// Filter-state pr. counter (v3.7.2). Bruges af præcis én vej pr. counter:
+// loop-polling, sampler-ISR eller SW-ISR. Ændres kun med interrupts slået fra.
+extern InputFilter counterFilter[4];
 
 // Interne helpers brugt af CounterEngine og Modbus FC
 uint8_t sanitizeBitWidth(uint8_t bw);
@@ -125,6 +144,22 @@ struct CounterConfig {
 // Globalt array
 extern CounterConfig counters[4];
 
+// ============================================================================
+//  Port-plan for SW polling-tællere (v3.7.0)
+// ============================================================================
+// Én PINx-læsning pr. port; bit i i maskerne svarer til counter i+1.
+#define POLL_NO_PORT 0xFF
+
+struct CounterPollPlan {
+  volatile uint8_t* portReg[4];   // distinkte PINx registre (max 1 pr. counter)
+  uint8_t portCount;
+  uint8_t chanPort[4];            // port-slot pr. counter (POLL_NO_PORT = di_read)
+  uint8_t chanMask[4];            // bitmaske i porten pr. counter
+  uint8_t mask;                   // counters der er SW polling
+  uint8_t riseMask;               // tæl på stigende flanke
+  uint8_t fallMask;               // tæl på faldende flanke
+};
+
 // ============================================================================
 //  API – init / loop
 // ============================================================================
@@ -135,6 +170,34 @@ void counters_init();
 // Hoved-loop for CounterEngine (kald fra modbusLoop())
 void counters_loop();
 
+// Ms til CounterEngine skal have loop-tid igen (v3.8.1, idle sleep):
+// 0 = loop-pollede kanaler eller ventende ISR-resultat; ellers tidligste
+// frekvens-/tids-/rate-vindue, sampler-dræning, pulsbredde-timeout eller
+// retain-tjek. IDLE_NO_DEADLINE = intet planlagt.
+uint32_t counters_next_deadline_ms();
+
+// Genopbyg port-plan for SW polling-tællere (v3.7.0).
+// Kaldes når counter-config eller GPIO-mapping (gpioToInput) ændres.
+void counters_poll_plan_rebuild();
+
+// Effektivt filtervindue for counter idx (0..3) i Timer4 ticks:
+// counterFilterUs hvis sat, ellers debounce-ms når debounce er slået til.
+uint32_t counters_filter_window_ticks(uint8_t idx);
+
+// Sæt input-filter i µs for counter id (1..4) og genopbyg planen (v3.7.2).
+// 0 = intet µs-filter (debounce-ms bruges hvis slået til). CLI og
+// configApply skriver counterFilterUs[] herigennem.
+bool counters_filter_set(uint8_t id, uint16_t us);
+
+// Rå tællerværdi (32 bit) for counter idx (0..3) inkl. ventende sampler-
+// edges / Timer5. Kræver interrupts slået fra (ISR eller cli()-blok).
+uint32_t counters_raw_value_isr(uint8_t idx);
+
+// Sæt sampler-rate for port-mappede polling-tællere (v3.7.1).
+// 0 = fra (polling i loop), ellers SAMPLER_MIN_HZ..SAMPLER_MAX_HZ.
+// Returnerer false ved ugyldig rate.
+bool counters_sampler_set(uint16_t rateHz);
+
 // ============================================================================
 //  API – CLI / config helpers
 // ============================================================================
@@ -142,9 +205,37 @@ void counters_loop();
 // Sæt konfiguration for en tæller (id = 1..4). Returnerer false hvis id invalid.
 bool counters_config_set(uint8_t id, const CounterConfig& cfg);
 
+// Anvend konfiguration som diff mod den kørende tæller (load/profil, v3.9.5):
+//   CNT_CFG_SAME    - intet ændret, intet røres
+//   CNT_CFG_UPDATED - kun scale/register-adresser: værdien bevares
+//   CNT_CFG_RESET   - tælle-opsætning ændret: counters_config_set()
+//                     (retentiv counter beholder sin værdi via retain_restore)
+// Ved UPDATED/RESET nulstilles registre den gamle config publicerede og den
+// nye ikke bruger (flyttet eller slukket), undtagen statiske registre.
+#define CNT_CFG_SAME     0
+#define CNT_CFG_UPDATED  1
+#define CNT_CFG_RESET    2
+uint8_t counters_config_diff_set(uint8_t id, const CounterConfig& cfg);
+
+// Start (run=1) eller stop counter id (1..4) som controlReg bit1/bit2
+void counters_set_running(uint8_t id, uint8_t run);
+
+// true hvis holding-reg addr publiceres af en enabled counter
+// (værdi, rå, frekvens, control eller overflow)
+bool counters_uses_reg(uint16_t addr);
+
+// Counter-id (1..4) hvis en af dens registre ligger i [start, start+len),
+// ellers 0
+uint8_t counters_regs_owner(uint16_t start, uint16_t len);
+
 // Læs konfiguration for en tæller (id = 1..4). Returnerer false hvis id invalid.
 bool counters_get(uint8_t id, CounterConfig& out);
 
+// true hvis pin bruges som input af en aktiv counter: SW-ISR interrupt-pin,
+// GPIO-pin mappet til en SW polling-counters discrete input eller Timer5
+// T5-pin 47 (hw-mode).
+bool counters_uses_pin(uint8_t pin);
+
 // Reset én tæller til startValue og nulstil overflow-flag
 void counters_reset(uint8_t id);
 
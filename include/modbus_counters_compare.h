@@ -0,0 +1,83 @@
+// ============================================================================
+//  Filnavn : modbus_counters_compare.h
+//  Projekt  : Modbus RTU Server / CLI
+//  Version  : v3.8.2 (2026-10-18)
+//  Forfatter: JanG at modbus_slave@laces.dk
+//  Formål   : Compare-setpoints for CounterEngine.
+//             Hver counter kan have CMP_SETPOINTS setpoints i holding-regs.
+//             Når rå tællerværdi krydser et setpoint (i tælleretningen),
+//             udføres en handling direkte fra tællevejen (SW-ISR eller loop):
+//               - coil set/clear
+//               - GPIO high/low (direkte PORTx-skrivning, også fra ISR)
+//               - start timer via samme vej som timers_onCoilWrite()
+//             Hvilke setpoints der har fyret latches i et status-register.
+//
+//  Register-blok (base = compare-reg, 0 = deaktiveret):
+//    base+0 / base+1 : setpoint 1 (LSW / MSW, 32-bit rå værdi)
+//    base+2 / base+3 : setpoint 2 (LSW / MSW)
+//    base+4          : latch (bit0 = sp1, bit1 = sp2; master skriver 0 for at nulstille)
+//  Setpoints er 32 bit, så compare afvises for 64-bit counters (og er
+//  inaktiv hvis counteren senere sættes til 64 bit).
+//
+//  ISR-kontekst: GPIO og coil set/clear (gpio_coil_write, atomisk, inkl.
+//  GPIO-mappet pin) udføres straks i ISR'en. Timer-handlinger og latch-
+//  registret udføres fra counters_loop() (TimerEngine-start og holdingRegs
+//  er ikke ISR-sikre).
+//  Ændringer:
+//    - v3.9.6: GPIO-mål må ikke være en pin ejet af en anden funktion
+//    - v3.9.6: Kun for 8/16/32-bit counters
+//    - v3.8.2: Coil set/clear udføres i tællevejen med direkte GPIO-drive
+// ============================================================================
+
+#pragma once
+#include <Arduino.h>
+#include "modbus_globals.h"
+
+#define CMP_SETPOINTS   2
+#define CMP_BLOCK_REGS  (CMP_SETPOINTS * 2 + 1)
+
+enum CompareAction : uint8_t {
+  CMP_ACT_NONE       = 0,
+  CMP_ACT_COIL_SET   = 1,   // target = coil index
+  CMP_ACT_COIL_CLEAR = 2,   // target = coil index
+  CMP_ACT_GPIO_HIGH  = 3,   // target = GPIO pin
+  CMP_ACT_GPIO_LOW   = 4,   // target = GPIO pin
+  CMP_ACT_TIMER      = 5    // target = timer id (1..4)
+};
+
+// Persisteret konfiguration pr. counter (PersistConfig schema 15)
+struct CounterCompareConfig {
+  uint16_t reg;                       // base holding-reg (0 = deaktiveret)
+  uint8_t  action[CMP_SETPOINTS];     // CompareAction
+  uint16_t target[CMP_SETPOINTS];     // coil / pin / timer id
+};
+
+extern CounterCompareConfig counterCompare[4];
+
+// Valider og anvend compare-config for counter idx (0..3).
+// Returnerer false ved ugyldig reg-blok eller target.
+bool cmp_config_set(uint8_t idx, const CounterCompareConfig& cfg);
+
+// Genberegn GPIO port/bit-tabeller og setpoint-cache for alle counters
+void cmp_rebuild();
+
+// Tjek setpoint-krydsning efter tælling: prev -> now (rå værdier).
+// Retning tages fra counters[idx]. Omløb (overflow/underflow med auto-
+// reset til startValue) genkendes fra counterWrapSeq[idx]; en værdi
+// "baglæns" uden omløb (reset, preset, CLI-set) fyrer ikke.
+// ISR-sikker: kaldes fra SW-ISR eller fra loop.
+void cmp_on_count(uint8_t idx, uint64_t prev, uint64_t now);
+
+// Loop-del: opdater setpoint-cache fra holding-regs, udfør udskudte
+// timer-handlinger og opdater latch-registre (kaldes fra counters_loop()).
+void cmp_loop();
+
+// 0 hvis fyrede setpoints venter på cmp_loop() (timer-handling, latch),
+// ellers IDLE_NO_DEADLINE (idle-scheduler)
+uint32_t cmp_next_deadline_ms();
+
+// true hvis counter idx har mindst én aktiv setpoint-handling
+bool cmp_active(uint8_t idx);
+
+// true hvis pin er GPIO-mål for et compare-setpoint
+bool cmp_uses_pin(uint8_t pin);
@@ -0,0 +1,84 @@
+// ============================================================================
+//  Filnavn : modbus_counters_edgelog.h
+//  Projekt  : Modbus RTU Server / CLI
+//  Version  : v3.7.5 (2026-10-18)
+//  Forfatter: JanG at modbus_slave@laces.dk
+//  Formål   : Edge-tidsstempel ring pr. counter (jitter/burst-analyse).
+//             Hver talt edge får et 32-bit µs-tidsstempel (Timer4-tidsbase),
+//             skrevet i O(1) fra tællevejen (SW-ISR, sampler-ISR eller loop).
+//             Ringen ligger i privat RAM, som kun ISR/loop skriver, og
+//             kopieres til et holding-reg vindue når master læser det med
+//             FC03, så den kan drænes i store blokke. Vinduet er reserveret:
+//             FC06/FC16 der rammer det afvises med illegal data address.
+//
+//  Register-blok (base = edgelog-reg, 0 = deaktiveret), 1 + 2*depth regs:
+//    base+0              : head = antal loggede edges (mod 65536)
+//    base+1+2*k / +2+2*k : slot k tidsstempel i µs (LSW / MSW), k = 0..depth-1
+//  Edge nr. n (1-baseret, mod 65536) ligger i slot (n-1) % depth.
+//
+//  Drænings-protokol for master:
+//    1) læs head H, 2) læs slots, 3) gyldige edges er (H-depth, H].
+//    FC03 kopierer de læste slots fra RAM ét ad gangen med interrupts slået
+//    fra (edgelog_publish), så et 32-bit tidsstempel aldrig rives over.
+//    Slots skrevet under kopien kopieres igen til head står stille, og head
+//    publiceres til sidst, så head og slots passer sammen. head publiceres
+//    desuden fra counters_loop(). Kommer der flere end depth edges mellem
+//    to læsninger, er de ældste overskrevet (head-spring > depth).
+//
+//  Tidsstempel-præcision:
+//    - sw-isr    : ISR-tid (µs), plus evt. filtervindue (fast offset)
+//    - sampler   : sample-periode (fx 50 µs ved 20 kHz)
+//    - polling   : loop-periode
+//    - HW-mode   : ikke understøttet (Timer5 tæller uden CPU pr. edge)
+//  Hukommelse: ringene deler en pulje på EDGELOG_POOL tidsstempler (256
+//  bytes), fordelt efter depth på counters med edge-log. Summen af depth
+//  for alle ringe er højst EDGELOG_POOL (samme pulje-regel som rate).
+//  Ændringer:
+//    - v3.9.6: Pulje på EDGELOG_POOL tidsstempler; slot-vis kopi ved FC03
+//    - v3.9.6: Ring i privat RAM, kopieres ved FC03; blokken er skrivebeskyttet
+// ============================================================================
+
+#pragma once
+#include <Arduino.h>
+#include "modbus_globals.h"
+
+#define EDGELOG_MAX_DEPTH  64
+#define EDGELOG_POOL       EDGELOG_MAX_DEPTH   // tidsstempler i alt (256 bytes)
+#define EDGELOG_BLOCK_REGS(depth)  (1 + 2 * (uint16_t)(depth))
+
+// Persisteret konfiguration pr. counter (PersistConfig schema 17)
+struct CounterEdgeLogConfig {
+  uint16_t reg;     // base holding-reg (0 = deaktiveret)
+  uint8_t  depth;   // antal tidsstempler i ringen (1..EDGELOG_MAX_DEPTH)
+};
+
+extern CounterEdgeLogConfig counterEdgeLog[4];
+
+// Valider og anvend edge-log for counter idx (0..3). Ringen og head nulstilles.
+// Returnerer false ved ugyldig reg-blok/depth, overlap med en anden reg-blok
+// (se modbus_regmap.h) eller når puljen ikke har depth ledige tidsstempler.
+bool edgelog_config_set(uint8_t idx, const CounterEdgeLogConfig& cfg);
+
+// Log én edge for counter idx (0..3) med tidsstempel 'us' - O(1).
+// Kræver interrupts slået fra (ISR eller cli()-blok).
+void edgelog_stamp_isr(uint8_t idx, uint32_t us);
+
+// Loop-variant: tager selv tidsstempel og slår interrupts fra
+void edgelog_stamp(uint8_t idx);
+
+// true hvis counter idx har edge-log slået til (billigt tjek fra ISR)
+bool edgelog_enabled(uint8_t idx);
+
+// Publicér head-registre (kaldes fra counters_loop())
+void edgelog_loop();
+
+// true hvis holding-reg området start..start+count-1 rammer en edge-log
+// blok (head eller slots). FC06/FC16 afviser sådanne skrivninger.
+bool edgelog_overlaps(uint16_t start, uint16_t count);
+
+// Kopiér head og de slots der ligger i start..start+count-1 fra RAM til
+// holdingRegs (kaldes af FC03 før svaret bygges)
+void edgelog_publish(uint16_t start, uint16_t count);
+
+// Antal loggede edges for counter idx (mod 65536)
+uint16_t edgelog_head(uint8_t idx);
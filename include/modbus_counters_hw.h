@@ -58,6 +58,10 @@ void hw_counter_stop(uint8_t counter_id);
 // Called from counters_loop() approximately once per second
 void hw_counter_update_frequency(uint16_t freq_reg, uint8_t counter_id);
 
+// Ms til næste frekvensvindue afsluttes (0 = nu/ikke initialiseret).
+// Bruges af counters_next_deadline_ms() (idle-scheduler, v3.9.6)
+uint32_t hw_counter_freq_next_ms();
+
 // Reset frequency measurement tracking (called after counter reset)
 void hw_counter_reset_frequency(uint8_t counter_id);
 
@@ -0,0 +1,63 @@
+// ============================================================================
+//  Filnavn : modbus_counters_pwm.h
+//  Projekt  : Modbus RTU Server / CLI
+//  Version  : v3.7.6 (2026-10-18)
+//  Forfatter: JanG at modbus_slave@laces.dk
+//  Formål   : Pulsbredde/duty-cycle måling for SW-ISR counters.
+//             Interrupt-ISR'en (CHANGE) tidsstempler stigende og faldende
+//             flanker med Timer4-tidsbasen (0,5 µs). Høj-tid og periode
+//             summeres over N hele cyklusser; counters_loop() publicerer
+//             gennemsnittet i fast-punkt holding-regs. Tællingen fortsætter
+//             uændret (index-reg/raw-reg), og freq-reg får frekvensen
+//             beregnet fra den målte periode i stedet for 1 s vinduet.
+//
+//  Register-blok (base = pwm-reg, 0 = deaktiveret), PWM_BLOCK_REGS regs:
+//    base+0 / base+1 : høj-tid i µs (LSW / MSW)
+//    base+2 / base+3 : lav-tid i µs (LSW / MSW)
+//    base+4 / base+5 : periode i µs (LSW / MSW)
+//    base+6          : duty i 0,01 % (0..10000)
+//    base+7          : status (PWM_ST_*)
+//
+//  Stale: kommer der ingen flanke i timeout-ms, sættes PWM_ST_STALE,
+//  tider og freq-reg nulstilles og duty viser det faste niveau (0 / 10000).
+// ============================================================================
+
+#pragma once
+#include <Arduino.h>
+#include "modbus_globals.h"
+
+#define PWM_BLOCK_REGS     8
+#define PWM_MAX_AVG        64
+#define PWM_DEFAULT_TIMEOUT_MS  1000
+#define PWM_PUBLISH_MS     100      // max. alder for publiceret måling (idle)
+
+// Status-bits i base+7
+#define PWM_ST_VALID   0x0001   // mindst én måling publiceret
+#define PWM_ST_STALE   0x0002   // ingen flanke i timeout-ms
+#define PWM_ST_LEVEL   0x0004   // input-niveau ved stale (1 = høj)
+
+// Persisteret konfiguration pr. counter (PersistConfig schema 18)
+struct CounterPwmConfig {
+  uint16_t reg;         // base holding-reg (0 = deaktiveret)
+  uint8_t  avgCycles;   // antal cyklusser pr. måling (1..PWM_MAX_AVG)
+  uint16_t timeoutMs;   // stale-timeout i ms
+};
+
+extern CounterPwmConfig counterPwm[4];
+
+// Valider og anvend PWM-måling for counter idx (0..3). Kræver at counteren
+// er SW-ISR (interrupt-pin) når reg != 0. Nulstiller måling og registre.
+bool pwm_config_set(uint8_t idx, const CounterPwmConfig& cfg);
+
+// true hvis PWM-måling er aktiv for counter idx
+bool pwm_enabled(uint8_t idx);
+
+// Niveauskift (efter input-filter) fra SW-ISR. Kræver interrupts slået fra.
+void pwm_on_level_isr(uint8_t idx, uint8_t level, uint32_t ticks);
+
+// Publicér målinger og stale-status (kaldes fra counters_loop())
+void pwm_loop();
+
+// Ms til pwm_loop() skal køre: ny måling (højst PWM_PUBLISH_MS gammel)
+// eller stale-timeout (idle-scheduler)
+uint32_t pwm_next_deadline_ms();
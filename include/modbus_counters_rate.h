@@ -0,0 +1,71 @@
+// ============================================================================
+//  Filnavn : modbus_counters_rate.h
+//  Projekt  : Modbus RTU Server / CLI
+//  Version  : v3.7.8 (2026-10-18)
+//  Forfatter: JanG at modbus_slave@laces.dk
+//  Formål   : Rate- og totalizer-registre pr. counter.
+//             counters_loop() fører en kompakt bucket-ring pr. counter:
+//               - 60 sekund-buckets (uint16)  -> pulser sidste 60 s
+//               - 12 fem-minutters blokke      -> pulser sidste 3600 s
+//             Time-raten er glidende hvert sekund: de 11 nyeste blokke +
+//             igangværende blok + den ældste blok vægtet med den del af den
+//             der stadig ligger inden for vinduet (lineær interpolation).
+//             Totalizer er 64-bit og tæller alle edges; den nulstilles IKKE af
+//             controlReg reset, reset counter eller ny counter-config.
+//
+//  Hukommelse: state allokeres fra en pulje på RATE_SLOTS slots (205 bytes
+//  pr. slot, 410 bytes i alt) og kun for counters hvor rate-reg er sat.
+//  Samme regel som edge-log: state over ~100 bytes pr. counter ligger i en
+//  fast pulje, ikke i et [4]-array, og en fuld pulje afvises med en
+//  tydelig fejl. Puljen dækker 2 af de 4 counters; en tredje afvises
+//  (rate_slot_available() == false).
+//
+//  Register-blok (base = rate-reg, 0 = deaktiveret), RATE_BLOCK_REGS regs:
+//    base+0 / base+1 : pulser sidste 60 s   (= pulser/min, LSW / MSW)
+//    base+2 / base+3 : pulser sidste 3600 s (= pulser/time, LSW / MSW)
+//    base+4..base+7  : lifetime totalizer (64-bit, LSW først)
+//  Ændringer:
+//    - v3.9.6: RAM-tal for puljen; fælles pulje-regel med edge-log
+//    - v3.9.6: rate_slot_available() så en fuld pulje kan meldes for sig
+// ============================================================================
+
+#pragma once
+#include <Arduino.h>
+#include "modbus_globals.h"
+
+#define RATE_SLOTS        2
+#define RATE_BLOCK_REGS   8
+#define RATE_SEC_BUCKETS  60
+#define RATE_BLK_BUCKETS  12
+#define RATE_BLK_SECONDS  300
+
+// Persisteret pr. counter (PersistConfig schema 20): base holding-reg, 0 = fra
+extern uint16_t counterRateReg[4];
+
+// Sæt rate-blok for counter idx (0..3). Allokerer/frigiver slot.
+// Totalizer bevares ved ændring af reg og når rate slås fra og til igen
+// (edges mens rate er slået fra tælles ikke med).
+// Returnerer false ved ugyldig reg-blok eller ingen ledig slot.
+bool rate_config_set(uint8_t idx, uint16_t reg);
+
+// true hvis counter idx har en slot eller der er en ledig i puljen
+bool rate_slot_available(uint8_t idx);
+
+// Ny baseline efter ny counter-config (ingen delta tælles)
+void rate_rebase(uint8_t idx);
+
+// Kaldes efter reset af counter idx med værdien lige før reset: edges frem
+// til reset medregnes i totalizer/rate, og ny baseline sættes.
+void rate_on_reset(uint8_t idx, uint64_t before);
+
+// Nulstil totalizer for counter idx
+void rate_total_reset(uint8_t idx);
+
+// Lifetime totalizer for counter idx (seneste værdi hvis rate er slået fra)
+uint64_t rate_total(uint8_t idx);
+
+// Opdatér buckets og publicér registre (kaldes fra counters_loop())
+void rate_loop();
+
+// Ms til næste sekundgrænse (IDLE_NO_DEADLINE uden rate-slots)
+uint32_t rate_next_deadline_ms();
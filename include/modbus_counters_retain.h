@@ -0,0 +1,94 @@
+// ============================================================================
+//  Filnavn : modbus_counters_retain.h
+//  Projekt  : Modbus RTU Server / CLI
+//  Version  : v3.9.6 (2026-10-18)
+//  Forfatter: JanG at modbus_slave@laces.dk
+//  Formål   : Retentive counters. Tællerværdien checkpointes til en ring i
+//             EEPROM (efter config-slots), så produktionstal overlever
+//             strømsvigt. Ved boot gendannes hver retentiv counter fra sin
+//             nyeste gyldige record.
+//
+//  Checkpoint pr. counter når værdien er ændret og enten
+//    - interval-s sekunder er gået siden seneste checkpoint, eller
+//    - værdien har flyttet sig mindst delta skridt.
+//  Højst én record pr. RETAIN_MIN_GAP_MS for alle counters tilsammen
+//  (round-robin); records skrives én byte pr. loop-pass, så EEPROM-tiden
+//  (~3.4 ms/byte) aldrig blokerer Modbus-svar.
+//
+//  Ring: RETAIN_RING_RECS records à 8 bytes {id, seq, value, crc8}; crc8
+//  skrives sidst, så en afbrudt record er ugyldig og den forrige gælder.
+//  Nyeste record for en retentiv counter overskrives aldrig (ringen springer
+//  den over); er den gammel i sekvens, skrives den frisk igen.
+//
+//  Slid (10 år, 100.000 cyklusser pr. celle): en celle skrives én gang pr.
+//  ringomløb. Værst tilfælde er 4 retentive counters, hvis nyeste records
+//  er fastholdt, så kun 92 records deler skrivningerne. Med én record pr.
+//  36 s giver 10 år 315.360.000 s / 36 s / 92 = ca. 95.200 cyklusser -
+//  uafhængigt af pulsraten (ingen fastholdte: 96 records, ca. 91.300).
+//  Uændrede bytes (id, høje værdibytes) skrives ikke.
+//  interval-s under RETAIN_MIN_GAP_S afvises i CLI og hæves ved load.
+//  Værst tabte tal ved strømsvigt: det der er talt siden seneste
+//  checkpoint (interval-s, dog mindst 36 s x antal retentive counters,
+//  dvs. 144 s med 4 counters).
+//  Værdien gemmes som 32 bit (64-bit counters gendannes med lav del).
+//
+//  v3.9.6: Ringen er halveret (192 -> 96 records, gap 17 -> 36 s, så
+//  værste slid med fastholdte records holdes under 100.000 cyklusser);
+//  øverste halvdel er config-profiler (config_profile.h). Første boot
+//  efter opgradering læser også den gamle øverste halvdel, flytter nyeste
+//  værdi derfra ind i ringen og formaterer profil-området; derefter læses
+//  kun ringen.
+// ============================================================================
+
+#pragma once
+#include <Arduino.h>
+#include "modbus_globals.h"
+#include "config_eeprom.h"
+
+#define RETAIN_RING_BASE    (EEPROM_SLOT_BASE + EEPROM_SLOT_COUNT * EEPROM_SLOT_SIZE)
+#define RETAIN_REC_SIZE     8
+#define RETAIN_RING_RECS    96        // 768 bytes: 2560..3327
+#define RETAIN_LEGACY_RECS  192       // ring før v3.9.6 (kun læst ved boot)
+#define RETAIN_MIN_GAP_S    36        // 10-års slidbudget (se ovenfor)
+#define RETAIN_MIN_GAP_MS   (RETAIN_MIN_GAP_S * 1000UL)
+#define RETAIN_CHECK_MS     1000      // idle: interval/delta tjekkes hvert sekund
+#define RETAIN_STEP_MS      4         // idle: én EEPROM-byte (3,3 ms) pr. skridt
+#define RETAIN_SEQ_REFRESH  16384     // skriv fastholdt record igen efter så mange
+
+// Persisteret pr. counter (PersistConfig schema 25); 0/0 = ikke retentiv
+struct CounterRetainConfig {
+  uint16_t intervalS;   // checkpoint-interval i sekunder (0 = kun delta,
+                        // ellers mindst RETAIN_MIN_GAP_S)
+  uint32_t delta;       // checkpoint når værdien har flyttet sig (0 = kun interval)
+};
+
+extern CounterRetainConfig counterRetain[4];
+
+// true hvis counter idx (0..3) er retentiv
+bool retain_enabled(uint8_t idx);
+
+// Sæt checkpoint-regel for counter idx (0..3). Uden record i ringen
+// checkpointes første gang hurtigst muligt. Returnerer false ved idx >= 4.
+bool retain_config_set(uint8_t idx, const CounterRetainConfig& cfg);
+
+// Kaldes fra counters_init(): første gang (boot) scannes ringen for nyeste
+// record pr. counter; senere (load/apply) huskes de kørende værdier, så
+// retentive counters ikke falder tilbage til seneste checkpoint.
+void retain_init();
+
+// Husk kørende værdi for counter idx før den re-initialiseres af en
+// diff-apply (counters_config_diff_set); gendannes af retain_restore()
+void retain_hold(uint8_t idx);
+
+// Gendan retentive counters efter counters_config_set() i configApply
+void retain_restore();
+
+// Checkpoint-logik + ikke-blokerende skrivning (kaldes fra counters_loop())
+void retain_loop();
+
+// Ms til retain_loop() skal køre: næste EEPROM-byte, udløb af min. gap
+// eller næste interval/delta-tjek (idle-scheduler)
+uint32_t retain_next_deadline_ms();
+
+// CLI: tabel til 'show counters'
+void retain_print_status();
@@ -0,0 +1,59 @@
+// ============================================================================
+//  Filnavn : modbus_counters_sampler.h
+//  Projekt  : Modbus RTU Server / CLI
+//  Version  : v3.7.4 (2026-10-18)
+//  Forfatter: JanG at modbus_slave@laces.dk
+//  Formål   : Fast-rate sampler for SW polling-tællere (Timer2 CTC ISR).
+//             ISR'en læser de port-mappede inputs fra CounterPollPlan ved en
+//             fast rate, laver edge-detektering og input-filter, og akkumulerer
+//             tællinger i volatile accumulators som counters_loop() dræner.
+//             Tælling bliver dermed uafhængig af loop-last (CLI, TX, EEPROM).
+//  Garanti (missed edges):
+//    - Et niveau skal holde mindst 1 sample-periode for at blive set,
+//      dvs. max input-frekvens = rate / 2 (50% duty), fx 10 kHz ved 20 kHz.
+//    - Med input-filter (filter-us / debounce-ms) skal et niveau desuden
+//      være stabilt i filtervinduet, målt med Timer4-tidsbasen (0,5 µs).
+//    - Accumulator er 16-bit pr. kanal; edges ud over 65535 mellem to
+//      counters_loop() dræninger tælles i sampler_lost_edges().
+//  Ændringer:
+//    - v3.9.6: sampler_drain_period_ms() til idle-scheduleren
+//    - v3.7.4: sampler_peek_isr() til snapshot-latch
+// ============================================================================
+
+#pragma once
+#include <Arduino.h>
+#include "modbus_counters.h"
+
+#define SAMPLER_MIN_HZ   1000
+#define SAMPLER_MAX_HZ   20000
+
+// Start Timer2 i CTC mode ved den ønskede rate (SAMPLER_MIN_HZ..SAMPLER_MAX_HZ).
+// Den faktiske rate (afrundet til timerens opløsning) returneres af sampler_rate_hz().
+void sampler_start(uint16_t rateHz);
+
+// Stop Timer2 og nulstil alle accumulators
+void sampler_stop();
+
+// Aktuel sample-rate i Hz (0 = stoppet)
+uint16_t sampler_rate_hz();
+
+// Indlæs port-plan (atomisk). chanMask = kanaler ISR'en skal sample,
+// filtMask = kanaler der føres gennem counterFilter[i] (skal være nulstillet).
+void sampler_load_plan(const CounterPollPlan& plan, uint8_t chanMask, uint8_t filtMask);
+
+// Hent og nulstil accumulator for counter idx (0..3) atomisk
+uint16_t sampler_drain(uint8_t idx);
+
+// Læs accumulator for counter idx uden at nulstille (kræver interrupts slået
+// fra, fx fra en ISR eller cli()-blok). Bruges af snapshot-latch.
+uint16_t sampler_peek_isr(uint8_t idx);
+
+// Antal edges tabt fordi en accumulator var fuld (siden start)
+uint16_t sampler_lost_edges();
+
+// Garanteret max input-frekvens i Hz (rate / 2)
+uint16_t sampler_max_input_hz();
+
+// Max ms mellem to dræninger før en accumulator kan løbe fuld ved max
+// input-frekvens (halv margin). IDLE_NO_DEADLINE når sampler er stoppet.
+uint32_t sampler_drain_period_ms();
@@ -0,0 +1,66 @@
+// ============================================================================
+//  Filnavn : modbus_counters_snapshot.h
+//  Projekt  : Modbus RTU Server / CLI
+//  Version  : v3.7.4 (2026-10-18)
+//  Forfatter: JanG at modbus_slave@laces.dk
+//  Formål   : Synkron snapshot-latch af alle 4 counters.
+//             Tællerværdier, frekvenser og et fælles µs-tidsstempel kopieres
+//             atomisk (interrupts slået fra) og publiceres i én sammenhængende
+//             holding-reg blok, som master kan læse i én FC03 når det passer.
+//
+//  Trigger:
+//    - Control-bit: skriv bit0 = 1 i base+0 (FC06/FC16). Latch sker straks i
+//      frame-behandlingen; bit0 nulstilles når snapshot er publiceret.
+//    - Broadcast: samme skrivning sendt til slave-ID 0 latcher alle slaves
+//      på samme tid (broadcast besvares ikke, jf. Modbus RTU).
+//    - Edge på INT-pin (2/3/20/21): stigende flanke latcher i ISR. 18/19 er
+//      Serial1 = MODBUS_SERIAL og afvises.
+//
+//  Register-blok (base = snapshot-reg, 0 = deaktiveret), SNAP_BLOCK_REGS regs:
+//    base+0          : control (bit0 = latch-request)
+//                      status bit 8+i = counter i+1 er 64-bit og værdien
+//                      var >= 2^32: kun de lave 32 bit er publiceret
+//    base+1          : sekvensnummer (tælles op pr. snapshot)
+//    base+2 / base+3 : tidsstempel i µs (LSW / MSW, Timer4-tidsbase)
+//    base+4+3*i      : counter i+1 rå værdi LSW
+//    base+5+3*i      : counter i+1 rå værdi MSW
+//    base+6+3*i      : counter i+1 frekvens i Hz
+//  Ændringer:
+//    - v3.9.6: Pins 18/19 og pins ejet af counter/gate/compare afvises
+//    - v3.9.6: Status-bit for 64-bit værdier der er afkortet til 32 bit
+// ============================================================================
+
+#pragma once
+#include <Arduino.h>
+#include "modbus_globals.h"
+
+#define SNAP_HDR_REGS    4
+#define SNAP_CH_REGS     3
+#define SNAP_BLOCK_REGS  (SNAP_HDR_REGS + 4 * SNAP_CH_REGS)
+
+#define SNAP_CTRL_LATCH  0x0001
+#define SNAP_ST_TRUNC(i) ((uint16_t)(0x0100u << (i)))   // i = 0..3
+#define SNAP_ST_TRUNC_ALL 0x0F00
+
+extern uint16_t snapshotReg;   // base holding-reg (0 = deaktiveret)
+extern uint8_t  snapshotPin;   // INT-pin for edge-trigger (0 = ingen)
+
+// Sæt snapshot-blok og evt. trigger-pin. Returnerer false ved ugyldig
+// reg-blok eller pin (ikke INT-pin, seriel-pin, eller i brug af counter,
+// gate, timer-trigger eller compare-mål).
+bool snapshot_config_set(uint16_t reg, uint8_t pin);
+
+// Tag snapshot nu (atomisk). Publiceres i registrene af snapshot_loop().
+void snapshot_capture();
+
+// Kaldes fra FC06/FC16 efter en holding-reg skrivning (control-bit trigger)
+void snapshot_on_reg_write(uint16_t addr);
+
+// Publicér ventende snapshot + tjek control-bit (kaldes fra counters_loop())
+void snapshot_loop();
+
+// 0 hvis et snapshot venter på snapshot_loop(), ellers IDLE_NO_DEADLINE
+uint32_t snapshot_next_deadline_ms();
+
+// Antal snapshots siden boot
+uint16_t snapshot_seq();
@@ -58,3 +58,14 @@ void sw_counter_detach_interrupt(uint8_t counter_id);
 // Processes edge detection and counter increment
 // counter_id: 1..4
 void sw_counter_interrupt_handler(uint8_t counter_id);
+
+// Bekræft ventende filter-niveau når input har været stabilt i filtervinduet
+// uden nye edges (kaldes fra counters_loop). counter_id: 1..4
+void sw_counter_filter_poll(uint8_t counter_id);
+
+// true hvis et filter-niveau venter på bekræftelse (sw_counter_filter_poll)
+bool sw_counter_filter_pending(uint8_t counter_id);
+
+// Nulstil input-filter og edge-state til pin'ens aktuelle niveau med nyt
+// filtervindue i Timer4 ticks (0 = intet filter). counter_id: 1..4
+void sw_counter_filter_reset(uint8_t counter_id, uint32_t windowTicks);
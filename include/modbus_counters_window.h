@@ -0,0 +1,75 @@
+// ============================================================================
+//  Filnavn : modbus_counters_window.h
+//  Projekt  : Modbus RTU Server / CLI
+//  Version  : v3.7.7 (2026-10-18)
+//  Forfatter: JanG at modbus_slave@laces.dk
+//  Formål   : Gate-input og tidsvindue-tælling for CounterEngine.
+//
+//  Gate:
+//    Edges tælles kun mens gate-pin har det aktive niveau (high/low).
+//    Tjekkes direkte i tællevejen: SW-ISR, sampler-ISR og loop-polling
+//    (præberegnet PINx + bitmaske, ingen digitalRead i ISR).
+//    HW-mode (Timer5) tæller uden CPU og kan ikke gates.
+//
+//  Tidsvindue:
+//    Counteren tæller uafbrudt; hver window-ms latches antal edges i vinduet
+//    (forskel i rå værdi) og næste vindue starter straks. Vinduesgrænsen
+//    styres af Timer4 compare-kanal B (OCR4B), så vinduet er præcist til
+//    få µs uafhængigt af loop-last og Modbus-trafik. Vinduer akkumuleres
+//    i ticks (ingen drift). Præcision af indholdet:
+//      - sw-isr / hw-t5 / sampler : edges frem til vinduesgrænsen
+//      - polling                  : edges behandlet i loop før grænsen
+//
+//  Register-blok (base = window-reg, 0 = deaktiveret), WIN_BLOCK_REGS regs:
+//    base+0 / base+1 : antal edges i seneste afsluttede vindue (LSW / MSW)
+//    base+2          : vindue-sekvensnummer (+1 pr. afsluttet vindue)
+//  Resultat og sekvens publiceres samlet fra loop; master læser alle 3 regs
+//  i én FC03 og bruger sekvensnummeret til at læse hvert vindue præcis én gang.
+// ============================================================================
+
+#pragma once
+#include <Arduino.h>
+#include "modbus_globals.h"
+
+#define WIN_BLOCK_REGS     3
+#define WIN_MAX_MS         60000
+
+// Persisteret konfiguration pr. counter (PersistConfig schema 19)
+struct CounterGateWindowConfig {
+  uint8_t  gatePin;     // GPIO pin for gate (0 = ingen gate)
+  uint8_t  gateLevel;   // aktivt gate-niveau (1 = high, 0 = low)
+  uint16_t windowMs;    // vindueslængde i ms (0 = intet vindue)
+  uint16_t windowReg;   // base holding-reg for resultat (0 = intet vindue)
+};
+
+extern CounterGateWindowConfig counterGateWin[4];
+
+// Valider og anvend gate/vindue for counter idx (0..3).
+// Returnerer false ved ugyldig pin, reg-blok eller vindueslængde, ved
+// gate-pin ejet af en anden funktion og ved gate på en hw-mode counter.
+bool gatewin_config_set(uint8_t idx, const CounterGateWindowConfig& cfg);
+
+// true hvis pin er gate-input for en counter
+bool gatewin_uses_pin(uint8_t pin);
+
+// Gate-tjek fra tællevejen. Kræver ikke cli (én PINx-læsning).
+// Returnerer true hvis counter idx må tælle nu (altid true uden gate).
+bool gate_open(uint8_t idx);
+
+// Bitmaske over counters der er gated og hvis gate er lukket lige nu
+// (bit i = counter i+1). Bruges af sampler-ISR.
+uint8_t gate_closed_mask();
+
+// Genstart aktuelt vindues startværdi efter reset/ny config af counter idx
+// (vinduesgrænserne flyttes ikke)
+void window_rebase(uint8_t idx);
+
+// Publicér afsluttede vinduer (kaldes fra counters_loop())
+void window_loop();
+
+// Ms til næste vinduesgrænse (0 = resultat venter på window_loop()).
+// Grænsen lukkes af OCR4B-ISR'en, som selv vækker CPU'en.
+uint32_t window_next_deadline_ms();
+
+// Antal afsluttede vinduer for counter idx
+uint16_t window_seq(uint8_t idx);
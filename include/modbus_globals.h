@@ -1,10 +1,17 @@
 // ============================================================================
 //  Filnavn : modbus_globals.h
 //  Projekt  : Modbus RTU Server / CLI
-//  Version  : v3.1.3-patch1 (2025-11-03)
+//  Version  : v3.8.3 (2026-10-18)
 //  Forfatter: JanG at modbus_slave@laces.dk
 //  Formål   : Deklaration af alle globale Modbus-data og hjælpefunktioner.
 //             Kompatibel med CLEAN build uden demo-data.
+//  Ændringer:
+//    - v3.9.4: Diag input-reg 99/111 (boot-tid til klar / første frame)
+//    - v3.9.0: Diag input-reg 110 (bytes skrevet ved seneste config-save)
+//    - v3.8.8: Input-reg 112..159 = lateness-statistik pr. timer
+//    - v3.8.7: Diag input-reg 108/109 (timer trigger-latency)
+//    - v3.8.3: Per-port GPIO mirror-plan (gpio_plan_rebuild/gpio_mirror)
+//    - v3.8.2: Direkte GPIO-drive for coil-mappede pins (gpio_coil_write)
 // ============================================================================
 
 #pragma once
@@ -24,6 +31,28 @@
 #define SLAVE_ID         1
 #define BAUDRATE         9600
 
+// ---------------------------------------------------------------------------
+//  Diagnostik i input-registre (FC04, read-only)
+//  inputRegs[0..2] bruges af demo-værdier i main.cpp
+// ---------------------------------------------------------------------------
+#define IREG_DIAG_SAMPLER_HZ     96   // counter sampler rate i Hz (0 = fra)
+#define IREG_DIAG_SAMPLER_MAXHZ  97   // garanteret max input-frekvens i Hz
+#define IREG_DIAG_SAMPLER_LOST   98   // edges tabt pga. fuld accumulator
+#define IREG_DIAG_BOOT_READY_MS  99   // boot: sketch-start -> setup() færdig (ms)
+#define IREG_DIAG_TIMER_LATE_LAST 100 // TimerEngine: seneste fase-lateness (µs)
+#define IREG_DIAG_TIMER_LATE_MAX  101 // TimerEngine: max fase-lateness (µs)
+#define IREG_DIAG_TIMER_ISR_MAX   102 // TimerEngine: max tid i scheduler-ISR (µs)
+#define IREG_DIAG_TIMER_EVENTS    103 // TimerEngine: håndterede deadlines (LSW)
+#define IREG_DIAG_IDLE_PERMILLE   104 // idle sleep: andel af seneste sekund (‰)
+#define IREG_DIAG_LOOP_PASSES     105 // main loop pass i seneste sekund
+#define IREG_DIAG_OUT_LAT_LAST    106 // timer-output: deadline -> pin (µs), seneste
+#define IREG_DIAG_OUT_LAT_MAX     107 // timer-output: deadline -> pin (µs), max
+#define IREG_DIAG_TRIG_LAT_LAST   108 // timer-trigger: edge-ISR -> første fase (µs)
+#define IREG_DIAG_TRIG_LAT_MAX    109 // timer-trigger: edge-ISR -> første fase (µs), max
+#define IREG_DIAG_EEPROM_WRITTEN  110 // config-save: bytes programmeret (differentiel)
+#define IREG_DIAG_BOOT_FIRST_MS   111 // boot: sketch-start -> første accepterede frame (ms)
+#define IREG_TIMER_STATS_BASE     112 // 4 x 12 regs lateness pr. timer (modbus_timers.h)
+
 // ---------------------------------------------------------------------------
 //  Globale buffere
 // ---------------------------------------------------------------------------
@@ -77,3 +106,29 @@ unsigned long rtuGapUs(void);
 // GPIO-konflikt-håndtering: fjerner STATIC mapping hvis en DYNAMIC tager over
 // Skriver WARNING hvis der var en konflikt
 void gpio_handle_dynamic_conflict(uint8_t pin);
+
+// Pins ejet af seriel kommunikation: Serial (0/1, CLI), MODBUS_SERIAL
+// (18/19) og RS485 retningspin. Må ikke bruges af timer/counter-funktioner.
+bool gpio_pin_reserved(uint8_t pin);
+
+// Find GPIO pin der er mappet til discrete input idx (gpioToInput).
+// Returnerer -1 hvis input ikke er mappet til en pin.
+int8_t gpio_find_input_pin(uint16_t inputIndex);
+
+// GPIO mirror-plan (v3.8.3): gpioToCoil/gpioToInput kompileres til en plan
+// pr. port (PORTx/PINx + masker). Skal genopbygges efter enhver ændring af
+// mapping (CLI gpio, configApply, konflikt-håndtering). Coil-mappede pins
+// sættes som OUTPUT og får coil'ens aktuelle niveau.
+void gpio_plan_rebuild();
+
+// Ét mirror-pass: coils -> PORTx og PINx -> discreteInputs (kaldes fra loop)
+void gpio_mirror();
+
+// Ms til næste mirror-pass (idle-scheduler, v3.9.6): 1 ms-sampling af
+// mappede inputs; coils skrives af Modbus/CLI (aktivitet) eller direkte
+// via gpio_coil_write(), så uden inputs er der ingen deadline.
+uint32_t gpio_next_deadline_ms();
+
+// Direkte GPIO-drive (v3.8.2): skriv coil-bit og alle pins mappet til
+// coil'en atomisk (loop og ISR). Returnerer true hvis mindst én pin blev skrevet.
+bool gpio_coil_write(uint16_t coilIdx, bool value);
@@ -0,0 +1,82 @@
+// ============================================================================
+//  Filnavn : modbus_idle.h
+//  Projekt  : Modbus RTU Server / CLI
+//  Version  : v3.8.1 (2026-10-18)
+//  Forfatter: JanG at modbus_slave@laces.dk
+//  Formål   : Next-deadline scheduling og AVR idle sleep for main loop.
+//             Hver motor rapporterer hvor mange ms der går før den skal
+//             have loop-tid igen (0 = nu / kræver polling). modbusLoop()
+//             kører kun de motorer der er forfaldne, og CPU'en sover i
+//             SLEEP_MODE_IDLE til den tidligste deadline.
+//  Ændringer:
+//    - v3.9.6: Cachet deadline i søvn; scan kun ved motor-ISR-arbejde
+//              (idle_isr_post) eller når deadline er nået
+//    - v3.9.6: Deadlines bruges igen: motorer der ikke er forfaldne
+//              springes over (idle_engines_due), og søvnen strækkes over
+//              flere Timer0-ticks til tidligste deadline. Et vækkende
+//              interrupt giver kun et billigt deadline-tjek, ikke et pass.
+//  Deadlines:
+//    - Modbus RX / CLI     : 0 når bytes venter eller en frame er i gang
+//    - TimerEngine         : fase-slut (OCR4A), alarm-timeout, trin-program,
+//                            ventende ISR-hændelser; 0 ved input-polling
+//    - CounterEngine       : frekvensvinduer, tidsvinduer (OCR4B), rate-
+//                            sekund, sampler-dræning, pulsbredde-timeout,
+//                            retain-checkpoint; 0 ved loop-polling
+//    - GPIO mirror         : 1 ms når inputs er mappet (PINx -> discrete)
+//    - Udskudt save        : 4 ms pr. EEPROM-trin mens den er i gang
+//  Aktivitet (bytes i CLI/Modbus RX) gør alle motorer forfaldne, så
+//  registre læst/skrevet af master eller CLI er friske i samme pass.
+//  Vækning:
+//    - Alle interrupts vækker fra idle: USART RX (CLI + Modbus), Timer0
+//      (millis, hver 1,024 ms), Timer4 (TimerEngine/tidsvinduer), Timer2
+//      (sampler), INT/PCINT (SW-ISR tællere).
+//    - Deadline fra seneste scan caches. Timer0 og Timer2 (2-20 kHz)
+//      ændrer ingen deadline, så efter deres vækninger sammenlignes kun
+//      millis() med den cachede deadline. Et nyt scan sker kun når den er
+//      nået, eller når en motor-ISR har efterladt arbejde til loop
+//      (idle_isr_post). RX bryder søvnen direkte. Er intet forfaldent
+//      efter et scan, sover CPU'en igen uden at køre et loop-pass.
+// ============================================================================
+
+#pragma once
+#include <Arduino.h>
+
+#define IDLE_NO_DEADLINE  0xFFFFFFFFUL   // motoren har intet planlagt
+
+// Motorer i modbusLoop() der kan springes over (bitmaske)
+#define IDLE_ENG_GPIO      0x01
+#define IDLE_ENG_TIMERS    0x02
+#define IDLE_ENG_COUNTERS  0x04
+#define IDLE_ENG_ALL       0x07
+
+// Idle sleep til/fra (runtime, default til)
+extern bool idleSleepEnabled;
+
+// Sættes af motor-ISR'er der efterlader arbejde til loop (pending-flag
+// som tmrEvt, cmpPending, winPending ...), så idle_loop() genberegner
+// deadlines. Kaldes ikke fra Timer0/Timer2.
+extern volatile uint8_t idleIsrWork;
+static inline void idle_isr_post() { idleIsrWork = 1; }
+
+// Ms tilbage til lastMs + periodMs (0 = forfalden)
+static inline uint32_t idle_due_in(unsigned long lastMs, uint32_t periodMs,
+                                   unsigned long nowMs) {
+  unsigned long age = nowMs - lastMs;
+  return (age >= periodMs) ? 0 : (uint32_t)(periodMs - age);
+}
+
+// Tidligste deadline (ms) på tværs af Modbus RX, CLI, TimerEngine,
+// CounterEngine og GPIO mirror. mainDueMs = main loop's egne periodiske
+// opgaver.
+uint32_t idle_next_deadline_ms(uint32_t mainDueMs);
+
+// Motorer (IDLE_ENG_*) der skal køre i dette pass. Beregnes sidst i
+// idle_loop() (også med sleep slået fra); alle er forfaldne efter boot.
+uint8_t idle_engines_due();
+
+// Sov (SLEEP_MODE_IDLE) til tidligste deadline eller aktivitet.
+// Kaldes sidst i loop(); opdaterer søvnstatistik og diagnostik-registre.
+void idle_loop(uint32_t mainDueMs);
+
+// CLI: søvnstatus og statistik for seneste sekund
+void idle_print_status();
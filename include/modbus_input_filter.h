@@ -0,0 +1,65 @@
+// ============================================================================
+//  Filnavn : modbus_input_filter.h
+//  Projekt  : Modbus RTU Server / CLI
+//  Version  : v3.7.2 (2026-10-18)
+//  Forfatter: JanG at modbus_slave@laces.dk
+//  Formål   : Digitalt input-filter med µs-opløsning ("stable for window").
+//             Et nyt niveau accepteres først når det har været stabilt i
+//             mindst windowTicks (Timer4 ticks, se modbus_timebase.h).
+//             Kortere pulser (støj/prel) afvises helt.
+//  Brug:
+//    - Periodisk sampling (loop-polling, sampler-ISR): kald infilt_level()
+//      med rå niveau ved hver sample.
+//    - Edge-interrupt (SW-ISR): kald infilt_level() ved hver edge; når
+//      der ikke kommer flere edges, bekræftes sidste niveau ved at kalde
+//      infilt_level(f, f.cand, nu) fra loop med interrupts slået fra.
+//    - windowTicks = 0 -> filteret er transparent (rå niveau).
+//    - stableSince = tidspunkt hvor det accepterede niveau først blev set
+//      rå (selve input-skiftet, ikke bekræftelsen) - til pulsbredde-måling.
+//  Ændringer:
+//    - v3.9.6: stableSince føres gennem filteret
+// ============================================================================
+
+#pragma once
+#include <Arduino.h>
+
+struct InputFilter {
+  uint32_t windowTicks;   // krævet stabil tid (0 = intet filter)
+  uint32_t since;         // tidspunkt hvor cand blev set første gang
+  uint32_t stableSince;   // rå skift-tidspunkt for stable (v3.9.6)
+  uint8_t  stable;        // filtreret (accepteret) niveau 0/1
+  uint8_t  cand;          // seneste rå niveau (kandidat) 0/1
+};
+
+// Nulstil filter til et kendt niveau (ingen ventende kandidat)
+static inline void infilt_reset(InputFilter& f, uint8_t level, uint32_t windowTicks) {
+  f.windowTicks = windowTicks;
+  f.since  = 0;
+  f.stableSince = 0;
+  f.stable = level;
+  f.cand   = level;
+}
+
+// Fød filteret med rå niveau ved tid nowTicks og returnér filtreret niveau.
+// Kan kaldes fra ISR (ingen millis()/micros(), kun 32-bit sammenligninger).
+static inline uint8_t infilt_level(InputFilter& f, uint8_t raw, uint32_t nowTicks) {
+  if (f.windowTicks == 0) {
+    if (raw != f.stable) f.stableSince = nowTicks;
+    f.stable = raw;
+    f.cand = raw;
+    return raw;
+  }
+  if (raw != f.cand) {
+    // Kandidaten stoppede nu: blev den holdt længe nok, accepteres den
+    if (f.cand != f.stable && (uint32_t)(nowTicks - f.since) >= f.windowTicks) {
+      f.stable = f.cand;
+      f.stableSince = f.since;
+    }
+    f.cand  = raw;
+    f.since = nowTicks;
+  } else if (f.cand != f.stable && (uint32_t)(nowTicks - f.since) >= f.windowTicks) {
+    f.stable = f.cand;
+    f.stableSince = f.since;
+  }
+  return f.stable;
+}
@@ -0,0 +1,45 @@
+// ============================================================================
+//  Filnavn : modbus_regmap.h
+//  Projekt  : Modbus RTU Server / CLI
+//  Version  : v3.9.6 (2026-10-18)
+//  Forfatter: JanG at modbus_slave@laces.dk
+//  Formål   : Fælles overblik over hvilke holding-reg blokke der er i brug.
+//             Hver *_config_set / *_reg_set der binder en reg-blok spørger
+//             regmap_owner() før blokken tages, så to features aldrig
+//             publicerer i de samme registre.
+//
+//  Ejere (art, idx = counter/timer 0..3):
+//    - counter   : værdi-, rå-, frekvens-, control- og overflow-reg
+//    - compare, edge-log, pulsbredde, tidsvindue, rate   (pr. counter)
+//    - live-parametre, trin-program                      (pr. timer)
+//    - snapshot, waveform, profil-vælger, timer status/control-reg (globale)
+//  Statiske registre (set reg static) er værdier, ikke ejere, og tjekkes
+//  ikke her.
+// ============================================================================
+
+#pragma once
+#include <Arduino.h>
+#include "modbus_globals.h"
+
+#define REGMAP_NONE      0
+#define REGMAP_COUNTER   1
+#define REGMAP_COMPARE   2
+#define REGMAP_EDGELOG   3
+#define REGMAP_PWM       4
+#define REGMAP_WINDOW    5
+#define REGMAP_RATE      6
+#define REGMAP_TPARAM    7
+#define REGMAP_SEQ       8
+#define REGMAP_SNAPSHOT  9
+#define REGMAP_WAVE      10
+#define REGMAP_PROFILE   11
+#define REGMAP_TSTATUS   12    // idx 0 = status-reg, 1 = control-reg
+
+// Ejer-id: art i bit 4..7, idx i bit 0..3 (0 = REGMAP_NONE)
+#define REGMAP_ID(kind, idx)  ((uint8_t)(((kind) << 4) | (idx)))
+#define REGMAP_KIND(id)       ((uint8_t)((id) >> 4))
+#define REGMAP_IDX(id)        ((uint8_t)((id) & 0x0F))
+
+// Første ejer der overlapper [start, start+len), bortset fra 'self' (den
+// blok der er ved at blive sat). REGMAP_NONE hvis registrene er frie.
+uint8_t regmap_owner(uint16_t start, uint16_t len, uint8_t self);
@@ -0,0 +1,52 @@
+// ============================================================================
+//  Filnavn : modbus_timebase.h
+//  Projekt  : Modbus RTU Server / CLI
+//  Version  : v3.8.0 (2026-10-18)
+//  Forfatter: JanG at modbus_slave@laces.dk
+//  Formål   : Fælles højopløselig tidsbase (Timer4, free-running).
+//             Timer4 kører i normal mode med prescaler 8 -> 0,5 µs pr. tick,
+//             udvidet via overflow-ISR. Ticks wrapper efter ca. 35 min,
+//             µs-tid (timebase_us) er fuld 32 bit og wrapper efter ca. 71 min.
+//             Kan læses fra både loop og ISR (ingen millis()/micros() i ISR).
+//  Bemærk:
+//    - Timer4 ejes af tidsbasen; analogWrite() på pin 6/7/8 virker ikke.
+//    - Brug altid forskelle (nu - før) på ticks, så wrap håndteres korrekt.
+//  Ændringer:
+//    - v3.8.0: Compare-kanal A (OCR4A) til TimerEngine-scheduler
+//    - v3.7.7: Compare-kanal B (OCR4B) til tidsvindue-tælling
+//    - v3.7.4: 32-bit overflow-tæller; timebase_us()/timebase_us_isr() til
+//              fulde µs-tidsstempler (snapshot-latch)
+// ============================================================================
+
+#pragma once
+#include <Arduino.h>
+
+#define TIMEBASE_TICKS_PER_US  2     // 16 MHz / prescaler 8
+
+// Omregning µs <-> ticks (uint32)
+#define TIMEBASE_US_TO_TICKS(us)   ((uint32_t)(us) * TIMEBASE_TICKS_PER_US)
+#define TIMEBASE_TICKS_TO_US(t)    ((uint32_t)(t) / TIMEBASE_TICKS_PER_US)
+
+// Start Timer4 som free-running tidsbase (kaldes én gang fra initModbus())
+void timebase_init();
+
+// Aktuel tid i ticks. Sikker at kalde fra loop (gemmer/genskaber SREG).
+uint32_t timebase_ticks();
+
+// Aktuel tid i ticks fra ISR-kontekst (interrupts er allerede slået fra)
+uint32_t timebase_ticks_isr();
+
+// Aktuel tid i µs (fuld 32-bit wrap). Loop- og ISR-variant som ovenfor.
+uint32_t timebase_us();
+uint32_t timebase_us_isr();
+
+// Compare-kanal B (OCR4B, v3.7.7). Armér interrupt ved (lave 16 bit af)
+// atTicks; kræver interrupts slået fra. Ejes af tidsvindue-tælling
+// (modbus_counters_window), som definerer TIMER4_COMPB_vect.
+void timebase_compb_arm_isr(uint32_t atTicks);
+void timebase_compb_disable();
+
+// Compare-kanal A (OCR4A, v3.8.0). Samme semantik som kanal B; ejes af
+// TimerEngine (modbus_timers), som definerer TIMER4_COMPA_vect.
+void timebase_compa_arm_isr(uint32_t atTicks);
+void timebase_compa_disable();
@@ -1,10 +1,20 @@
 // ============================================================================
 //  Filnavn : modbus_timers.h
 //  Projekt  : Modbus RTU Server / CLI
-//  Version  : v3.0.7-patch4 (2025-11-03)
+//  Version  : v3.8.0 (2026-10-18)
 //  Forfatter: JanG at modbus_slave@laces.dk
 //  Formål   : Header for timer-engine med coil-styring og alarm/timeout
 //  Ændringer:
+//    - v3.9.6: timers_next_deadline_ms() styrer om timers_loop() køres
+//    - v3.9.5: timers_config_same() til diff-apply i configApply
+//    - v3.8.8: Lateness-statistik pr. timer (TimerPhaseStats, input-reg 112+)
+//    - v3.8.7: timers_trigger_isr() + trigger-latency i TimerLatenessStats
+//    - v3.8.6: Mode 6 (trin-program i holding-regs, se modbus_timers_seq.h)
+//    - v3.8.5: Live-parametre i holding-regs (timerParamReg)
+//    - v3.8.4: Mode 5 (hardware waveform på Timer1, se modbus_timers_wave.h)
+//    - v3.8.2: Output-latency (deadline -> GPIO-pin) i TimerLatenessStats
+//    - v3.8.1: timers_next_deadline_ms() til idle sleep
+//    - v3.8.0: Faser drives af Timer4 compare-match ISR; lateness-diagnostik
 //    - v3.0.7-patch4: Tilføjet alarm/timeout-felter og CLI helpers
 //    - v3.0.7-patch2: Tilføjet timers_hasCoil() til exclusive coil control
 //    - v3.0.7       : Grundlæggende timer-definitioner
@@ -27,13 +37,17 @@ extern uint16_t timerStatusCtrlRegIndex;  // global control register (bit0..3)
 //   2 = Monostable : P2(T1) -> P1, retrigger restarter
 //   3 = Astable    : skifter mellem P1(T1) / P2(T2)
 //   4 = Trigger    : udløses af diskret input, kører subMode(1..3)
+//   5 = Waveform   : PWM/pulstog på Timer1 OC-pin, styres via holding-regs
+//   6 = Sequence   : trin-program (op til 8 coils pr. trin) i holding-regs
 // ============================================================================
 
 enum TimerMode : uint8_t {
   TM_ONE_SHOT = 1,
   TM_MONO     = 2,
   TM_ASTABLE  = 3,
-  TM_TRIGGER  = 4
+  TM_TRIGGER  = 4,
+  TM_WAVE     = 5,
+  TM_SEQUENCE = 6
 };
 
 enum TriggerEdge : uint8_t {
@@ -45,7 +59,7 @@ enum TriggerEdge : uint8_t {
 struct TimerConfig {
   uint8_t  id;            // 1..4
   uint8_t  enabled;       // 0/1
-  uint8_t  mode;          // 1..4
+  uint8_t  mode;          // 1..6
   uint8_t  subMode;       // kun brugt i mode 4
   // Output levels per period
   uint8_t  p1High;        // 0/1
@@ -64,12 +78,13 @@ struct TimerConfig {
   // Runtime
   uint8_t  active;        // kørende sekvens
   uint8_t  phase;         // 0..n (afhængig af mode)
-  unsigned long phaseStartMs;
+  unsigned long phaseStartMs;   // millis() ved seneste faseskift (loop)
   uint8_t  lastTrigLevel; // til edge-detect
 
   // Diagnostik / alarm
   uint8_t  alarm;         // 0/1
-  uint8_t  alarmCode;     // 0=ok, 1=timeout, 2=phase stuck (reserveret)
+  uint8_t  alarmCode;     // 0=ok, 1=timeout, 2=phase stuck (reserveret),
+                          // 3=ugyldigt trin (mode 6)
   unsigned long lastDurationMs; // seneste fulde lapse (ms)
 
     // Reset-on-read status sticky flag
@@ -85,13 +100,76 @@ void timers_onCoilWrite(uint16_t coilIdx, uint8_t value);
 void timers_disable_all();
 bool timers_config_set(uint8_t id, const TimerConfig& src);
 bool timers_get(uint8_t id, TimerConfig& out);
+// Diff-apply (v3.9.5): src svarer til kørende timer (runtime-felter og
+// statusRoEnable ignoreres; T/P også når liveParams = reg-blok beholdes)
+bool timers_config_same(uint8_t id, const TimerConfig& src, bool liveParams);
 
-// Opgave 1b: tjek om coil styres af en aktiv timer
+// Live-parametre (v3.8.5): T1..T3 og P1..P3 bundet til en holding-reg blok.
+// Master kan ændre dem med FC06/FC16; timers_loop() overtager nye værdier,
+// og de gælder fra næste faseskift (igangværende fase afsluttes uændret).
+//   base+0/1 : T1 ms (LSW/MSW)   base+2/3 : T2 ms   base+4/5 : T3 ms
+//   base+6   : niveauer bit0=P1 bit1=P2 bit2=P3
+// Persisteres i PersistConfig (schema 22). 32-bit perioder > 65535 ms bør
+// skrives med FC16, så LSW/MSW ikke læses halvt opdateret.
+#define TIMER_PARAM_REGS  7
+extern uint16_t timerParamReg[4];
+
+// Bind timer idx (0..3) til reg-blok (0 = fra). Aktuelle værdier publiceres.
+bool timers_param_reg_set(uint8_t idx, uint16_t reg);
+
+// Start mode 4 timer idx fra edge-ISR (interrupts slået fra). 'at' er
+// tidsstemplet (timebase_ticks_isr) taget først i ISR'en.
+void timers_trigger_isr(uint8_t idx, uint32_t at);
+
+// Opgave 1b: tjek om coil styres af en aktiv timer (mode 5 ejer ingen coil)
 bool timers_hasCoil(uint16_t idx);
 
 // Opgave 2+3: CLI helpers til status og alarm
 void timers_print_status();
 void timers_clear_alarms();
 
+// Scheduler-diagnostik (v3.8.0). Lateness = tid fra deadline til ISR'en
+// skifter fase; isrMax = længste ophold i scheduler-ISR'en.
+struct TimerLatenessStats {
+  uint16_t lateLastUs;
+  uint16_t lateMaxUs;
+  uint16_t isrMaxUs;
+  uint32_t events;      // antal håndterede deadlines
+  uint16_t outLastUs;   // deadline -> GPIO-pin skrevet (kun mappede coils)
+  uint16_t outMaxUs;
+  uint16_t trigLastUs;  // edge-ISR -> første fase skrevet (trigger-pin, v3.8.7)
+  uint16_t trigMaxUs;
+};
+void timers_lateness_get(TimerLatenessStats& out);
+
+// Lateness pr. timer (v3.8.8): tid fra planlagt til faktisk faseskift ved
+// deadline (starter og bid-grænser i lange faser tælles ikke). Publiceres
+// read-only i input-reg IREG_TIMER_STATS_BASE + 12*i:
+//   +0 faseskift (LSW)  +1 min µs  +2 max µs  +3 mean µs
+//   +4..+11 log2-histogram: <2, <4, <8, <16, <32, <64, <128, >=128 µs
+#define TIMER_STATS_REGS        12
+#define TIMER_STATS_BINS        8
+#define TIMER_STATS_PUBLISH_MS  250
+struct TimerPhaseStats {
+  uint32_t count;
+  uint16_t minUs;
+  uint16_t maxUs;
+  uint16_t meanUs;
+  uint16_t hist[TIMER_STATS_BINS];
+};
+bool timers_stats_get(uint8_t idx, TimerPhaseStats& out);
+
+// Nulstil statistik pr. timer og globale last/max (input-reg 100..109)
+void timers_stats_reset();
+
+// CLI: 'show timers stats'
+void timers_print_stats();
+
+// Ms til timers_loop() skal køre igen: fase-slut, alarm-timeout eller
+// ventende ISR-hændelse (0). 0 også ved trigger-polling i loop (mode 4
+// uden pin, trin der venter på input). IDLE_NO_DEADLINE = intet planlagt.
+// Bruges af idle-scheduleren (v3.8.1).
+uint32_t timers_next_deadline_ms();
+
 // Globalt array deklareres i .cpp
 extern TimerConfig timers[4];
@@ -0,0 +1,72 @@
+// ============================================================================
+//  Filnavn : modbus_timers_seq.h
+//  Projekt  : Modbus RTU Server / CLI
+//  Version  : v3.8.6 (2026-10-18)
+//  Forfatter: JanG at modbus_slave@laces.dk
+//  Formål   : Timer mode 6 - trin-program (sekvens) i en holding-reg blok.
+//             Programmet uploades med FC16 og afvikles af TimerEngine:
+//             tidstrin planlægges i Timer4 compare-ISR'en som øvrige faser,
+//             input-trin polles i timers_loop().
+//
+//  Register-blok (base = reg, 0 = deaktiveret):
+//    base+0 : kontrol  1 = start fra trin 0, 0 = stop. Sættes til 1 ved
+//             start via coil-write og til 0 når programmet slutter.
+//    base+1 : aktuelt trin (read-only), 0xFFFF = stoppet
+//    base+2 : antal trin N (1..SEQ_MAX_STEPS)
+//    base+3 + 3*k : trin k (3 regs)
+//      w0 : bit0..7  = coil-maske (coil base+0..7)
+//           bit8..15 = niveauer for de maskerede coils
+//      w1 : ventetid i ms (SEQ_WAIT_TIME) eller diskret input-index
+//      w2 : bit0..7  = næste trin (0xFF = efterfølgende trin)
+//           bit8..11 = venteform (SEQ_WAIT_*)
+//  Et program slutter ved et SEQ_WAIT_END trin eller et hop ud over N-1.
+//  Coil-base er timerens coil; programmet ejer coil..coil+SEQ_COILS-1.
+//  Blokken fylder altid SEQ_BLOCK_REGS regs uanset N. Mens programmet
+//  kører, afvises FC06/FC16 til base+1.. (kun base+0 kan skrives); stop
+//  programmet (base+0 = 0) før upload af et nyt.
+//  Ændringer:
+//    - v3.9.6: Hele blokken skal ligge i NUM_REGS; skrivelås mens den kører
+// ============================================================================
+
+#pragma once
+#include <Arduino.h>
+#include "modbus_globals.h"
+
+#define SEQ_HDR_REGS    3
+#define SEQ_STEP_REGS   3
+#define SEQ_MAX_STEPS   32
+#define SEQ_BLOCK_REGS  (SEQ_HDR_REGS + SEQ_MAX_STEPS * SEQ_STEP_REGS)
+#define SEQ_COILS       8
+#define SEQ_NEXT_SEQ    0xFF     // næste = efterfølgende trin
+
+#define SEQ_WAIT_TIME   0        // vent w1 ms
+#define SEQ_WAIT_HIGH   1        // vent til input w1 er høj
+#define SEQ_WAIT_LOW    2        // vent til input w1 er lav
+#define SEQ_WAIT_END    3        // skriv outputs og afslut programmet
+
+#define SEQ_STEP_IDLE   0xFFFF   // aktuelt-trin reg når programmet er stoppet
+
+struct SeqStep {
+  uint8_t  mask;
+  uint8_t  levels;
+  uint8_t  next;       // allerede opløst (SEQ_NEXT_SEQ -> trin + 1)
+  uint8_t  wait;
+  uint16_t arg;
+};
+
+// Persisteret pr. timer (PersistConfig schema 23): base holding-reg, 0 = fra
+extern uint16_t timerSeqReg[4];
+
+// Sæt programblok for timer idx (0..3). false ved ugyldig blok.
+bool seq_reg_set(uint8_t idx, uint16_t reg);
+
+// Læs trin 'step' for timer idx fra reg-blokken (ISR-sikker).
+// false hvis blokken er slået fra, eller trin >= N / uden for registrene.
+bool seq_step_get(uint8_t idx, uint8_t step, SeqStep& out);
+
+// true hvis [start, start+count) rammer N/trin i et kørende program
+// (FC06/FC16 afviser skrivningen med illegal data address)
+bool seq_write_locked(uint16_t start, uint16_t count);
+
+// Kontrol- og aktuelt-trin register (nullptr hvis blokken er slået fra)
+uint16_t* seq_regs(uint8_t idx);
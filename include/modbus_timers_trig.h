@@ -0,0 +1,52 @@
+// ============================================================================
+//  Filnavn : modbus_timers_trig.h
+//  Projekt  : Modbus RTU Server / CLI
+//  Version  : v3.8.7 (2026-10-18)
+//  Forfatter: JanG at modbus_slave@laces.dk
+//  Formål   : Interrupt-trigger for timer mode 4. I stedet for at polle
+//             discrete input trigIndex i timers_loop() bindes triggeren til
+//             en pin med INT eller PCINT; sekvensen startes i edge-ISR'en
+//             med fasestart = tidsstempel ved ISR-indgang.
+//
+//  Pins (Mega 2560):
+//    - INT  : 2, 3, 20, 21 - flanke vælges i hardware (RISING/FALLING/
+//             CHANGE), så også meget korte pulser fanges.
+//    - PCINT: 10..13, 50..53 (PCINT0, port B) og A8..A15 = 62..69 (PCINT2,
+//             port K). Kun pin-skift; flanken afgøres ved at læse porten i
+//             ISR'en, så pulsen skal være længere end ISR-latency (~5 µs).
+//             18/19 (INT3/INT2) er Serial1 = MODBUS_SERIAL og afvises.
+//  Pin'en må ikke samtidig bruges af counter, gate-vindue, snapshot,
+//  compare-mål eller waveform, eller være GPIO-mappet til coil/input.
+//  Input-niveauet spejles stadig til discrete input trigIndex (i
+//  timers_loop) til visning.
+//  Ændringer:
+//    - v3.9.6: 18/19 afvist; ejerskabstjek som wave_config_set
+// ============================================================================
+
+#pragma once
+#include <Arduino.h>
+#include "modbus_globals.h"
+
+// Persisteret pr. timer (PersistConfig schema 24): trigger-pin, 0 = polling
+extern uint8_t timerTrigPin[4];
+
+// true hvis pin kan bruges som trigger-pin (INT eller PCINT0/PCINT2)
+bool trig_pin_valid(uint8_t pin);
+
+// Sæt trigger-pin for timer idx (0..3), 0 = polling. false ved ugyldig pin
+// eller konflikt med anden brug af pin'en.
+bool trig_pin_set(uint8_t idx, uint8_t pin);
+
+// (Gen)bind ISR for timer idx efter config-ændring (mode/edge/enabled).
+// trig_unbind() kaldes før config kopieres, så ISR'en aldrig ser en halv.
+void trig_rebind(uint8_t idx);
+void trig_unbind(uint8_t idx);
+
+// true hvis timer idx startes fra ISR (ingen polling nødvendig)
+bool trig_bound(uint8_t idx);
+
+// Aktuelt niveau på trigger-pin for timer idx (kun når trig_bound())
+bool trig_level(uint8_t idx);
+
+// true hvis pin bruges som trigger-pin af en timer
+bool trig_uses_pin(uint8_t pin);
@@ -0,0 +1,85 @@
+// ============================================================================
+//  Filnavn : modbus_timers_wave.h
+//  Projekt  : Modbus RTU Server / CLI
+//  Version  : v3.8.4 (2026-10-18)
+//  Forfatter: JanG at modbus_slave@laces.dk
+//  Formål   : Timer mode 5 - hardware waveform på Timer1 output-compare pin.
+//             PWM, enkelt-puls med µs-bredde og "N pulser ved F Hz" genereres
+//             af Timer1 selv; CPU'en rører kun pin'en ved start/stop.
+//  Timer-valg:
+//    - Timer1 er ledig (Timer0 = millis, Timer2 = sampler, Timer4 = tidsbase,
+//      Timer5 = HW counter). Én timer ad gangen kan køre mode 5.
+//    - Fast PWM mode 15 (TOP = OCR1A): både periode og duty er double-
+//      buffered og skifter samtidigt ved BOTTOM -> glitch-fri ændringer.
+//      Derfor bruges OC1B (pin 12) eller OC1C (pin 13), ikke OC1A (pin 11).
+//    - Pin 13 deler LED med heartbeat; heartbeat stoppes mens pin 13 bruges.
+//
+//  Register-blok (base = reg, 0 = deaktiveret), WAVE_BLOCK_REGS regs:
+//    base+0 : kommando  0=stop, 1=PWM, 2=enkelt-puls, 3=pulstog (N pulser)
+//             Enkelt-puls/pulstog sætter reg til 0 når de er færdige;
+//             skriv 2/3 igen for ny start.
+//    base+1 : frekvens i Hz (1..65535)          - PWM/pulstog
+//    base+2 : duty i promille (0..1000)         - PWM/pulstog
+//    base+3 : antal pulser N (1..65535)         - pulstog (max WAVE_MAX_TRAIN_HZ)
+//    base+4 / base+5 : pulsbredde µs LSW/MSW    - enkelt-puls (1..4194303)
+//    base+6 : resterende pulser (read-only)
+//    base+7 : status (read-only) bit0=kører, bit1=færdig, bit2=parameterfejl
+//  Frekvens, duty og N må ændres mens output kører. Færdig signaleres også
+//  i timer-status registret (bit for timerens id).
+// ============================================================================
+
+#pragma once
+#include <Arduino.h>
+#include "modbus_globals.h"
+
+#define WAVE_BLOCK_REGS   8
+
+#define WAVE_CMD_STOP     0
+#define WAVE_CMD_PWM      1
+#define WAVE_CMD_PULSE    2
+#define WAVE_CMD_TRAIN    3
+
+#define WAVE_ST_RUNNING   0x0001
+#define WAVE_ST_DONE      0x0002
+#define WAVE_ST_PARAM_ERR 0x0004
+
+#define WAVE_MAX_PULSE_US 4194303UL   // 65535 ticks ved prescaler 1024
+#define WAVE_MAX_TRAIN_HZ 10000       // pulstog: OVF-ISR skal nå at køre pr. periode
+
+// Persisteret (PersistConfig schema 21)
+struct TimerWaveConfig {
+  uint16_t reg;       // base holding-reg (0 = fra)
+  uint8_t  pin;       // 12 (OC1B) eller 13 (OC1C), 0 = ingen
+  uint8_t  reserved;
+};
+
+extern TimerWaveConfig timerWave;
+
+// Sæt reg-blok og output-pin. Stopper igangværende output.
+// Returnerer false ved ugyldig reg-blok eller pin (GPIO-mappet, eller i brug
+// som trigger, compare-mål, counter-input, gate eller snapshot-pin).
+bool wave_config_set(const TimerWaveConfig& cfg);
+
+// Bind/frigiv generatoren til timer idx (0..3). Kaldes af timers_config_set.
+void wave_bind(uint8_t idx);
+void wave_unbind();
+
+// Timer (0..3) der ejer generatoren, -1 = ingen
+int8_t wave_timer();
+
+// true hvis pin bruges som waveform-output
+bool wave_uses_pin(uint8_t pin);
+
+// true mens output kører
+bool wave_running();
+
+// Læs kommando/parametre og publicér status (kaldes fra timers_loop()).
+// Returnerer true når en enkelt-puls eller et pulstog lige er færdigt.
+bool wave_loop();
+
+// true når en enkelt-puls/pulstog er færdig og wave_loop() skal køre
+// (idle-scheduler)
+bool wave_pending();
+
+// CLI: statuslinje til 'show timers'
+void wave_print_status();
@@ -27,13 +27,13 @@
 // ============================================================================
 
 #define VERSION_MAJOR    3
-#define VERSION_MINOR    6
-#define VERSION_PATCH    5
+#define VERSION_MINOR    9
+#define VERSION_PATCH    6
 #ifndef VERSION_STRING_NY
-#define VERSION_STRING_NY  "v3.6.5"
+#define VERSION_STRING_NY  "v3.9.6"
 #endif
 #ifndef VERSION_BUILD
-#define VERSION_BUILD   "20251115"
+#define VERSION_BUILD   "20261018"
 #endif
 #ifndef CLI_VERSION
 #define CLI_VERSION     "v3.6.1"
@@ -43,6 +43,219 @@
 //  CHANGELOG (uddrag)
 // ============================================================================
 //
+//  v3.9.6 (2026-10-18) - Config-profiler (opskrifter) valgt via holding-register
+//   • Op til 8 navngivne config-profiler i EEPROM 3328..4095 (23 sider à 32 bytes)
+//       - hver profil er et TLV-image; antal afhænger af profilernes størrelse
+//       - save: image i frie sider, header sidst, gammel version ugyldiggøres bagefter
+//   • Holding-reg blok (set profile reg:<n>): select / aktiv / status
+//       - select n hot-applies profil n som diff; bit15 = gem også som boot-config
+//       - udføres efter frame-svaret; ID, baud, server, hostname beholdes
+//   • CLI: profile save|load|delete, show profiles, set profile reg:<n>
+//   • Retentive ring halveret til 96 records (2560..3327), min. gap 36 s
+//       - værst ~95.200 cyklusser/celle på 10 år (4 fastholdte records)
+//       - gammel øverste halvdel migreres ind i ringen ved første boot
+//   • Schema 26: profileReg/profileActive; generisk EEPROM-stream (eeprom_stream_*)
+//   • Rå struct-images migreres kun fra baseline schema 10..12; rå images
+//     med schema 13..25 (v3.7.1..v3.9.2) giver defaults (gem via v3.9.3+)
+//
+//  v3.9.5 (2026-10-18) - Hot reconfig som diff (load/defaults)
+//   • configApply() efter boot anvendes som diff mod kørende tilstand:
+//       - UART genstartes kun ved ny baud; nyt slave-ID kasserer halv frame
+//       - ingen memset af holdingRegs/coils; statiske regs/coils kun ved ændring
+//       - GPIO-plan kun ved ændret mapping
+//       - kun ændrede timere/counters re-initialiseres
+//       - udvidelses-blokke kun ved ændring eller re-init counter
+//   • counters_config_diff_set(): scale/registre ændret -> værdi bevares
+//   • timers_config_same(): live T/P (reg-blok) bevares ved load
+//   • retain_hold(): retentiv counter beholder værdi ved re-init
+//
+//  v3.9.4 (2026-10-18) - Hurtig, stille boot + boot-tid i input-regs
+//   • Modbus svarer hurtigt efter reset/watchdog:
+//       - delay(500) i setup() fjernet
+//       - configLoad()/configSave() skriver ikke længere hele config
+//       - configApply() genstarter kun UART ved ny baudrate (ingen delay(50))
+//       - kort banner efter Modbus er klar
+//   • 'show config dump' viser det fulde config-image på forespørgsel
+//   • Boot-tid fra sketch-start (ms) i input-regs:
+//       - 99: setup() færdig, Modbus lytter
+//       - 111: første accepterede frame
+//       - vises også i 'show stats'
+//
+//  v3.9.3 (2026-10-18) - TLV config-format
+//   • Config gemmes som tag-length-value records (config_tlv.h)
+//       - kun enabled timers/counters, mappede GPIO, brugte statiske maps
+//       - ukendte tags springes over; kortere records får defaults for resten
+//       - records streames direkte mellem PersistConfig og EEPROM-slot
+//   • Schema 10/11 migrering uden kopier af timers/counters på stakken
+//
+//  v3.9.2 (2026-10-18) - Retentive counters
+//   • Counter-værdier checkpointes til wear-levelled EEPROM-ring (2560..4095)
+//       - set counter <id> retain [interval-s:<n>] [delta:<n>]
+//       - gendannes ved boot fra nyeste record (counters_init/configApply)
+//       - max én record pr. 17 s -> ~96.600 cyklusser/celle på 10 år
+//   • EEPROM schema 25: counterRetain[4]
+//
+//  v3.9.1 (2026-10-18) - A/B journal-slots for config
+//   • Config gemmes i to skiftende EEPROM-slots med sekvens og CRC16
+//       - save skriver den inaktive slot, header sidst, og verificerer CRC
+//       - load vælger nyeste gyldige slot; legacy-image på 0 læses stadig
+//       - 'show eeprom' viser slot-status; 1 KB verify-kopi i RAM fjernet
+//
+//  v3.9.0 (2026-10-18) - Differentiel EEPROM-save
+//   • configSave() skriver kun bytes der afviger fra det lagrede image
+//       - Nyt modul config_eeprom: eeprom_write_diff() + statistik
+//       - Rapport efter save: "EEPROM: n/m bytes written in x ms"
+//       - Input-reg 110: bytes programmeret ved seneste save
+//
+//  v3.8.8 (2026-10-18) - Lateness-statistik pr. timer
+//   • Lateness pr. timer ved faseskift: min/max/mean + log2-histogram (8 bins)
+//       - Registreres i Timer4 scheduler-ISR'en (kun faseskift, ikke bid-grænser)
+//       - Input-reg 112..159 (12 pr. timer), publiceres 4 gange i sekundet
+//   • CLI: show timers stats / reset timers stats
+//
+//  v3.8.7 (2026-10-18) - Interrupt-trigger for timer mode 4
+//   • Mode 4 trigger kan bindes til INT- eller PCINT-pin (set timer <id> trigger pin:<p>)
+//       - INT 2/3/18-21 (flanke i hardware), PCINT0 10-13/50-53, PCINT2 A8-A15
+//       - Sekvensen startes i edge-ISR; faser regnes fra ISR-tidsstemplet
+//       - Ingen loop-polling af triggeren -> idle sleep er tilladt
+//   • Input-reg 108/109: edge-ISR -> første fase skrevet (µs, seneste/max)
+//   • EEPROM schema 24: timerTrigPin[4]
+//
+//  v3.8.6 (2026-10-18) - Trin-programmer (timer mode 6)
+//   • Timer mode 6: trin-program i holding-reg blok (FC16 upload)
+//       - Op til 32 trin; hvert trin sætter maskerede coils (base..base+7)
+//       - Venteform pr. trin: tid (ms), input høj/lav, slut; næste trin pr. hop
+//       - Tidstrin planlægges i Timer4 ISR; input-trin polles i timers_loop
+//       - Kontrol-reg (1 start / 0 stop) og aktuelt-trin reg (0xFFFF = stoppet)
+//   • CLI: set timer <id> mode 6 parameter coil <base> reg <n>
+//   • EEPROM schema 23: timerSeqReg[4]
+//
+//  v3.8.5 (2026-10-18) - Live timer-parametre i holding-regs
+//   • T1..T3 og P1..P3 kan bindes til en reg-blok pr. timer (7 regs)
+//       - Ændringer overtages i timers_loop() og gælder fra næste faseskift
+//       - Ingen genstart af sekvens, ingen EEPROM-skrivning
+//   • EEPROM schema 22: timerParamReg[4]
+//   • CLI: set timer <id> params reg:<n>
+//
+//  v3.8.4 (2026-10-18) - Hardware waveform (timer mode 5)
+//   • Ny timer-mode 5: PWM, enkelt-puls (µs) og N-pulstog på Timer1 OC1B/OC1C
+//       - Fast PWM mode 15 (TOP = OCR1A): periode + duty double-buffered
+//       - Pulstog tælles i TIMER1_OVF_vect; stop armeres i OCR-bufferen
+//       - Frekvens/duty/N i holding-regs, ændres mens output kører
+//       - Færdig -> timer-status bit (timers_flag_active) + status-reg
+//   • EEPROM schema 21: timerWave (reg-blok + pin)
+//   • CLI: set timer <id> mode 5 parameter pin <12|13> reg <n>
+//
+//  v3.8.3 (2026-10-18) - Precompiled per-port GPIO mirror plan
+//   • GPIO-spejling i modbusLoop() via forudberegnet plan pr. port
+//       - én PORTx-skrivning og én PINx-læsning pr. port med masker
+//       - byte-flytning ved 1:1 byte-aligned mapping
+//       - genopbygges ved gpio map/unmap, configApply og konflikt-håndtering
+//
+//  v3.8.2 (2026-10-18) - Direct GPIO drive for timer and counter outputs
+//   • Coil-mappede GPIO-pins drives direkte (forudberegnet PORTx/bitmaske)
+//       - TimerEngine-ISR og compare coil set/clear skriver coil + pin atomisk
+//       - pins sættes som OUTPUT; tabel genopbygges ved gpio map/unmap og load
+//       - output-latency deadline -> pin måles; input-reg 106/107
+//
+//  v3.8.1 (2026-10-18) - Next-deadline scheduling and idle sleep
+//   • Motorerne rapporterer næste deadline (Modbus RX, CLI, timere, tællere)
+//       - loop() går i AVR idle sleep når intet er forfaldent
+//       - ingen søvn ved RX i gang, loop-polling eller mode 4 trigger
+//       - "set sleep on|off"; idle-andel og loop-pass/s i input-reg 104/105
+//
+//  v3.8.0 (2026-10-18) - Compare-match scheduler for TimerEngine
+//   • TimerEngine-faser drives af Timer4 OCR4A compare-ISR
+//       - næste deadline på tværs af timere i OCR4A, faseskift + coil i ISR
+//       - deadlines regnes fra forrige deadline (ingen drift)
+//       - lateness/ISR-tid måles og publiceres i input-reg 100..103
+//       - UDESTÅR: måling af lateness under fuld Modbus-last på hardware
+//         er en separat, åben leverance (TODO.md, Open Deliverables;
+//         testprocedure i MANUAL.md, Scheduling and Lateness)
+//   • bitWriteArray() er atomisk (coils skrives fra ISR)
+//
+//  v3.7.8 (2026-10-18) - Rate- og totalizer-registre
+//   • Rate pr. counter: pulser sidste 60 s og sidste 3600 s
+//       - Kompakt bucket-ring (60 x 1 s + 12 x 5 min) i counters_loop()
+//       - Time-raten glider hvert sekund (ældste blok vægtes)
+//   • 64-bit lifetime totalizer, overlever controlReg reset og reconfig
+//   • CLI: set counter <id> rate reg:<n>, reset counter <id> total
+//   • EEPROM schema 20: counterRateReg[4]
+//
+//  v3.7.7 (2026-10-18) - Gate- og tidsvindue-tælling
+//   • Gate-input pr. counter: tæl kun mens gate-pin er aktiv
+//       - Tjekkes i SW-ISR, sampler-ISR og polling (PINx, ingen digitalRead)
+//   • Tidsvindue pr. counter: latch antal edges pr. window-ms
+//       - Vinduesgrænse fra Timer4 compare-kanal B (OCR4B), ingen drift
+//       - Resultat + sekvensnummer publiceres samlet (læs hvert vindue én gang)
+//   • counters_raw_value_isr() deles af snapshot-latch og tidsvindue
+//   • EEPROM schema 19: counterGateWin[4]
+//
+//  v3.7.6 (2026-10-18) - Pulsbredde/duty-måling
+//   • SW-ISR counters kan måle høj-tid, lav-tid, periode og duty
+//       - Flanke-tidsstempler fra Timer4-tidsbase (0,5 µs) i INT-ISR
+//       - Gennemsnit over pwm-avg cyklusser, stale efter pwm-timeout-ms
+//       - freq-reg beregnes fra målt periode når pwm-reg er sat
+//   • CLI: pwm-reg/pwm-avg/pwm-timeout-ms i "set counter"
+//   • EEPROM schema 18: counterPwm[4]
+//
+//  v3.7.5 (2026-10-18) - Edge-tidsstempel ring pr. counter
+//   • Valgfri ring af µs-tidsstempler for de sidste N edges pr. counter
+//       - Skrives i O(1) fra SW-ISR, sampler-ISR eller polling-loop
+//       - Ligger direkte i holding-reg vindue (head + 2 regs pr. slot)
+//       - Kun counters med edgelog bruger hukommelse
+//   • CLI: set counter <id> edgelog reg:<n> depth:<1..64>
+//   • EEPROM schema 17: counterEdgeLog[4]
+//
+//  v3.7.4 (2026-10-18) - Snapshot-latch af counters
+//   • Synkron snapshot af alle 4 counters (værdi, frekvens, µs-tidsstempel)
+//       - Trigger: control-bit, broadcast-skrivning eller INT-pin edge
+//       - Publiceres samlet i én holding-reg blok (læses med én FC03)
+//   • Broadcast (slave-ID 0) skrivninger behandles nu uden svar
+//   • Timer4 tidsbase: fuld 32-bit µs-tid (timebase_us)
+//   • EEPROM schema 16: snapshotReg/snapshotPin
+//
+//  v3.7.3 (2026-10-18) - Compare-setpoints for counters
+//   • Compare-setpoints pr. counter (modbus_counters_compare): 2 setpoints i
+//     holding-regs; ved krydsning udføres coil set/clear, GPIO high/low eller
+//     timer-start direkte fra tællevejen. Latch-register viser hvad der fyrede.
+//       - GPIO-handling udføres i SW-ISR (µs-reaktion), coil/timer i loop
+//       - CLI: set counter <id> compare reg:<n> sp1:<action>:<target> ...
+//       - EEPROM schema 15: counterCompare[4]
+//
+//  v3.7.2 (2026-10-18) - µs input-filter for counters
+//   • Fælles digitalt input-filter (InputFilter, "stable for window") med
+//     µs-opløsning for SW polling-, sampler- og SW-ISR-tællere.
+//       - Ny tidsbase: Timer4 free-running, 0,5 µs ticks, 32-bit (modbus_timebase)
+//       - set counter <id> ... filter-us:<0..65535>; debounce-ms bruges som
+//         vindue når filter-us = 0
+//       - Ingen millis() i SW-ISR; pin læses via PINx-register
+//       - EEPROM schema 14: counterFilterUs[4] (migreres fra 12/13)
+//
+//  v3.7.1 (2026-10-18) - Fast-rate timer-ISR sampler for SW polling
+//   • Ny modul modbus_counters_sampler: Timer2 CTC ISR ved 1..20 kHz
+//       - ISR læser port-planen fra v3.7.0, laver edge-detektering og
+//         debounce (i samples) og tæller i volatile 16-bit accumulators
+//       - counters_loop() dræner accumulators atomisk (count_steps)
+//       - Tælling er uafhængig af cli_loop()/sendResponse()/configSave()
+//   • Garanti: max input-frekvens = rate/2; tabte edges (fuld accumulator)
+//     tælles og publiceres i input-reg 96..98 (FC04) + 'show counters'
+//   • CLI: 'set counters sampler-hz:<0|1000..20000>'
+//   • EEPROM schema 13: PersistConfig er nu append-only (nye felter før crc)
+//       - Schema 12 migreres automatisk (checksum ved gammel længde)
+//   • Frekvensberegning udskilt i counter_update_frequency()
+//
+//  v3.7.0 (2026-10-18) - SW polling: port-vis batch-sampling
+//   • SW polling-tællere læser nu input direkte fra PINx-registret
+//       - Før: di_read(inputIndex) fra discreteInputs, fyldt af digitalRead()-spejlingen
+//       - Nu: hver port læses én gang pr. counters_loop() pass (max 4 porte)
+//       - Edges for alle kanaler beregnes samlet: changed = nu ^ sidst,
+//         rising = changed & nu & riseMask, falling = changed & ~nu & fallMask
+//       - Fallback til discreteInputs hvis inputIndex ikke er GPIO-mappet
+//   • counters_poll_plan_rebuild() genopbygger planen ved counter-config,
+//     'gpio map/unmap' og timer-trigger GPIO-konflikter
+//   • count_step() udskilt som fælles tællerskridt (op/ned + overflow)
+//
 //  v3.6.5 (2025-11-15) - CRITICAL BUGFIX: Slave ID persistence issue
 //   • CRITICAL BUGFIX: 'set id' og 'set baud' opdaterer ikke globalConfig
 //       - Problem: 'set id = 5' ændrede kun RAM variable currentSlaveID, ikke globalConfig.slaveId
@@ -6,6 +6,8 @@
 //  Formål   : Interaktiv CLI til Modbus RTU-serveren, inkl. timers, GPIO,
 //             EEPROM-persistens og CounterEngine med HW/SW input-tællere.
 //  Ændringer:
+//    - v3.9.6: capture_running_config() flyttet til config_store
+//              (configCaptureBase), så FC-auto-save deler den
 //    - v3.1.9:
 //        - Counter reset-on-read er nu individuel pr. counter (synkroniseres med controlReg bit 3)
 //        - CLI-kommando: "set counter <id> reset-on-read ENABLE|DISABLE"
@@ -54,7 +56,12 @@
 //      set timer <id> mode <1|2|3|4> parameter P1:<high|low> P2:<high|low> [P3:<high|low>]
 //                      T1 <ms> [T2 <ms>] [T3 <ms>] coil <idx>
 //                      [trigger <di_idx> edge rising|falling|both sub <1|2|3>]
+//      set timer <id> mode 5 parameter pin <12|13> reg <n>   (waveform, v3.8.4)
+//      set timer <id> mode 6 parameter coil <base> reg <n>   (trin-program, v3.8.6)
+//      set timer <id> params reg:<n>   (T1..T3/P1..P3 i holding-regs, v3.8.5)
+//      set timer <id> trigger pin:<p>  (mode 4 startes fra INT/PCINT ISR, v3.8.7)
 //      set timers status-reg:<n> control-reg:<n>
+//      show timers stats / reset timers stats   (lateness pr. timer, v3.8.8)
 //  - Counter syntaks:
 //      set counter <id> mode 1 parameter
 //           count-on:<rising|falling|both>
@@ -68,14 +75,30 @@
 //           direction:<up|down>
 //           scale:<float>
 //           debounce:<on|off> [debounce-ms:<n>]
+//           filter-us:<0..65535> (µs input-filter, v3.7.2)
 //           hw-mode:<sw|sw-isr|hw-t5>
 //           interrupt-pin:<2|3|18|19|20|21> (for sw-isr mode)
+//           pwm-reg:<n> pwm-avg:<1..64> pwm-timeout-ms:<n> (pulsbredde, v3.7.6)
+//      set counter <id> compare reg:<n> sp1:<action>:<target> [sp2:...] (v3.7.3)
+//      set counter <id> edgelog reg:<n> depth:<1..64> (v3.7.5)
+//      set counter <id> gate pin:<p> [level:<high|low>] (v3.7.7)
+//      set counter <id> window ms:<n> reg:<n> (v3.7.7)
+//      set counter <id> rate reg:<n> (v3.7.8)
+//      set counter <id> retain [interval-s:<n>] [delta:<n>] (v3.9.2)
 //    Implicit enable på "set counter"
 //  - Andre counter kommandoer:
 //      show counters
-//      reset counter <id>
+//      reset counter <id> [total]
 //      clear counters
 //      no set counter <id>   (disable/slet counter-konfiguration)
+//  - System:
+//      set sleep on|off   (idle sleep i main loop, v3.8.1)
+//      show eeprom        (journal-slots A/B + seneste save, v3.9.1)
+//      show config dump   (fuldt config-image; ikke længere ved boot, v3.9.4)
+//  - Config-profiler (v3.9.6):
+//      profile save <n> [name:<text>] / profile load <n> / profile delete <n>
+//      set profile reg:<n>   (select/aktiv/status holding-regs, 0 = fra)
+//      show profiles
 //  - Static maps:
 //      set reg static <addr> value <val>
 //      set coil static <idx> <ON|OFF|0|1>
@@ -86,9 +109,25 @@
 #include "modbus_counters.h"
 #include "modbus_counters_hw.h"
 #include "modbus_counters_sw_int.h"
+#include "modbus_counters_compare.h"
+#include "modbus_counters_snapshot.h"
+#include "modbus_counters_edgelog.h"
+#include "modbus_counters_pwm.h"
+#include "modbus_counters_window.h"
+#include "modbus_counters_rate.h"
+#include "modbus_counters_retain.h"
+#include "modbus_counters_sampler.h"
+#include "config_profile.h"
+#include "modbus_timebase.h"
+#include "modbus_idle.h"
 #include "modbus_core.h"
 #include "modbus_globals.h"
 #include "modbus_timers.h"
+#include "modbus_timers_wave.h"
+#include "modbus_timers_seq.h"
+#include "modbus_timers_trig.h"
+#include "modbus_regmap.h"
+#include "config_eeprom.h"
 #include "version.h"
 #include <avr/wdt.h>
 
@@ -324,9 +363,14 @@ static void print_static_config() {
   for (uint8_t i = 0; i < 4; ++i) {
     const TimerConfig& t = timers[i];
     if (!t.enabled) continue;                // KUN hvis timer er enabled
+    if (t.mode == TM_WAVE) continue;         // mode 5 ejer ingen coil
     if (t.coil >= NUM_COILS) continue;
     Serial.print(F("  coil DYNAMIC "));
     Serial.print(t.coil);
+    if (t.mode == TM_SEQUENCE) {             // mode 6 ejer coil..coil+7
+      Serial.print(F(".."));
+      Serial.print(t.coil + SEQ_COILS - 1);
+    }
     Serial.print(F(" value timer"));
     Serial.println(t.id);
   }
@@ -383,6 +427,17 @@ static void print_timers_config_block(bool onlyEnabled) {
     Serial.print(F("  timer ")); Serial.print(t.id);
     Serial.print(t.enabled ? F(" ENABLED") : F(" DISABLED"));
     Serial.print(F(" mode=")); Serial.print((int)t.mode);
+    if (t.mode == TM_WAVE) {
+      Serial.print(F(" pin=")); Serial.print(timerWave.pin);
+      Serial.print(F(" reg=")); Serial.println(timerWave.reg);
+      continue;
+    }
+    if (t.mode == TM_SEQUENCE) {
+      Serial.print(F(" coil=")); Serial.print(t.coil);
+      Serial.print(F(".."));     Serial.print(t.coil + SEQ_COILS - 1);
+      Serial.print(F(" reg="));  Serial.println(timerSeqReg[i]);
+      continue;
+    }
     if (t.mode == 4) {
       Serial.print(F(" sub=")); Serial.print((int)t.subMode);
     }
@@ -397,6 +452,12 @@ static void print_timers_config_block(bool onlyEnabled) {
       Serial.print(F(" trig=")); Serial.print(t.trigIndex);
       Serial.print(F(" edge=")); Serial.print(edgeToStr(t.trigEdge));
     }
+    if (timerTrigPin[i]) {
+      Serial.print(F(" trigger-pin=")); Serial.print(timerTrigPin[i]);
+    }
+    if (timerParamReg[i]) {
+      Serial.print(F(" params-reg=")); Serial.print(timerParamReg[i]);
+    }
     Serial.println();
   }
   if (!any) Serial.println(F("timers (none enabled)"));
@@ -421,6 +482,29 @@ static void print_timers_config_block(bool onlyEnabled) {
 }
 
 // Counter konfig-blok til show config (tekstlig)
+
+// Print uint64 decimalt (Serial.print understøtter ikke 64-bit)
+static void print_u64(uint64_t v) {
+  char buf[21];
+  uint8_t i = sizeof(buf) - 1;
+  buf[i] = '\0';
+  do {
+    buf[--i] = (char)('0' + (uint8_t)(v % 10));
+    v /= 10;
+  } while (v && i);
+  Serial.print(&buf[i]);
+}
+
+static void print_compare_action(uint8_t act) {
+  switch (act) {
+    case CMP_ACT_COIL_SET:   Serial.print(F("coil-set"));   break;
+    case CMP_ACT_COIL_CLEAR: Serial.print(F("coil-clear")); break;
+    case CMP_ACT_GPIO_HIGH:  Serial.print(F("gpio-high"));  break;
+    case CMP_ACT_GPIO_LOW:   Serial.print(F("gpio-low"));   break;
+    case CMP_ACT_TIMER:      Serial.print(F("timer"));      break;
+    default:                 Serial.print(F("none"));       break;
+  }
+}
 static void print_counters_config_block(bool onlyEnabled) {
   bool any = false;
   for (uint8_t i = 0; i < 4; ++i) {
@@ -469,6 +553,10 @@ static void print_counters_config_block(bool onlyEnabled) {
     } else {
       Serial.print(F("off"));
     }
+    if (counterFilterUs[c.id - 1] > 0) {
+      Serial.print(F(" filter-us="));
+      Serial.print(counterFilterUs[c.id - 1]);
+    }
 
     Serial.print(F(" hw-mode="));
     if (c.hwMode == 0) {
@@ -496,12 +584,91 @@ static void print_counters_config_block(bool onlyEnabled) {
       Serial.print(c.interruptPin);
     }
 
+    // Pulsbredde-måling (v3.7.6)
+    const CounterPwmConfig& pc = counterPwm[c.id - 1];
+    if (pc.reg != 0) {
+      Serial.print(F(" pwm-reg=")); Serial.print(pc.reg);
+      Serial.print(F(" pwm-avg=")); Serial.print(pc.avgCycles);
+      Serial.print(F(" pwm-timeout-ms=")); Serial.print(pc.timeoutMs);
+    }
+
     Serial.println();
   }
   if (!any) {
     Serial.println(F("counters (none enabled)"));
   }
 
+  if (sampler_rate_hz()) {
+    Serial.print(F("counters sampler-hz:"));
+    Serial.println(sampler_rate_hz());
+  }
+
+  if (snapshotReg) {
+    Serial.print(F("counters snapshot-reg:"));
+    Serial.print(snapshotReg);
+    Serial.print(F(" snapshot-pin:"));
+    Serial.println(snapshotPin);
+  }
+
+  // Compare-setpoints (v3.7.3)
+  for (uint8_t i = 0; i < 4; ++i) {
+    const CounterCompareConfig& cc = counterCompare[i];
+    if (cc.reg == 0) continue;
+    if (onlyEnabled && !counters[i].enabled) continue;
+    Serial.print(F("counter ")); Serial.print(i + 1);
+    Serial.print(F(" compare reg:")); Serial.print(cc.reg);
+    for (uint8_t sp = 0; sp < CMP_SETPOINTS; ++sp) {
+      if (cc.action[sp] == CMP_ACT_NONE) continue;
+      Serial.print(F(" sp")); Serial.print(sp + 1); Serial.print(':');
+      print_compare_action(cc.action[sp]);
+      Serial.print(':'); Serial.print(cc.target[sp]);
+    }
+    Serial.println();
+  }
+
+  // Gate / tidsvindue (v3.7.7)
+  for (uint8_t i = 0; i < 4; ++i) {
+    const CounterGateWindowConfig& gw = counterGateWin[i];
+    if (onlyEnabled && !counters[i].enabled) continue;
+    if (gw.gatePin != 0) {
+      Serial.print(F("counter ")); Serial.print(i + 1);
+      Serial.print(F(" gate pin:")); Serial.print(gw.gatePin);
+      Serial.println(gw.gateLevel ? F(" level:high") : F(" level:low"));
+    }
+    if (gw.windowReg != 0) {
+      Serial.print(F("counter ")); Serial.print(i + 1);
+      Serial.print(F(" window ms:")); Serial.print(gw.windowMs);
+      Serial.print(F(" reg:")); Serial.println(gw.windowReg);
+    }
+  }
+
+  // Rate/totalizer (v3.7.8)
+  for (uint8_t i = 0; i < 4; ++i) {
+    if (counterRateReg[i] == 0) continue;
+    if (onlyEnabled && !counters[i].enabled) continue;
+    Serial.print(F("counter ")); Serial.print(i + 1);
+    Serial.print(F(" rate reg:")); Serial.println(counterRateReg[i]);
+  }
+
+  // Retentive counters (v3.9.2)
+  for (uint8_t i = 0; i < 4; ++i) {
+    if (!retain_enabled(i)) continue;
+    if (onlyEnabled && !counters[i].enabled) continue;
+    Serial.print(F("counter ")); Serial.print(i + 1);
+    Serial.print(F(" retain interval-s:")); Serial.print(counterRetain[i].intervalS);
+    Serial.print(F(" delta:")); Serial.println(counterRetain[i].delta);
+  }
+
+  // Edge-tidsstempel ringe (v3.7.5)
+  for (uint8_t i = 0; i < 4; ++i) {
+    const CounterEdgeLogConfig& ec = counterEdgeLog[i];
+    if (ec.reg == 0) continue;
+    if (onlyEnabled && !counters[i].enabled) continue;
+    Serial.print(F("counter ")); Serial.print(i + 1);
+    Serial.print(F(" edgelog reg:")); Serial.print(ec.reg);
+    Serial.print(F(" depth:")); Serial.println(ec.depth);
+  }
+
   // Vis counter reset-on-read control (individuelt pr. counter)
   bool showResetOnRead = false;
   for (uint8_t i = 0; i < 4; ++i) {
@@ -615,6 +782,16 @@ static void print_timer_links() {
     Serial.print(F("  timer ")); Serial.print(t.id);
     Serial.print(F(" ENABLED"));
     Serial.print(F(" mode=")); Serial.print((int)t.mode);
+    if (t.mode == TM_WAVE) {
+      Serial.print(F(" waveform pin ")); Serial.print(timerWave.pin);
+      Serial.print(F(" reg ")); Serial.println(timerWave.reg);
+      continue;
+    }
+    if (t.mode == TM_SEQUENCE) {
+      Serial.print(F(" program coil ")); Serial.print(t.coil);
+      Serial.print(F(" reg ")); Serial.println(timerSeqReg[i]);
+      continue;
+    }
     Serial.print(F(" P1:")); Serial.print(t.p1High ? "high" : "low");
     Serial.print(F(" P2:")); Serial.print(t.p2High ? "high" : "low");
     Serial.print(F(" P3:")); Serial.print(t.p3High ? "high" : "low");
@@ -637,7 +814,7 @@ static void print_timer_links() {
   Serial.println(F("coil"));
   for (uint8_t i = 0; i < 4; ++i) {
     const TimerConfig& t = timers[i];
-    if (!t.enabled) continue;
+    if (!t.enabled || t.mode == TM_WAVE) continue;
     anyCoil = true;
     Serial.print(F("  coil dynamic ")); Serial.print(t.coil);
     Serial.print(F(" at timer ")); Serial.println(t.id);
@@ -714,11 +891,13 @@ static bool coil_static_upsert(uint16_t idx, uint8_t val) {
 // ---------- SHOW ----------
 static void cmd_show(uint8_t ntok, char* tok[]) {
   if (ntok == 1) {
-    Serial.println(F("Usage: show {config|stats|regs|coils|inputs|timers|counters|version|gpio}"));
+    Serial.println(F("Usage: show {config|stats|regs|coils|inputs|timers|counters|version|gpio|eeprom|profiles}"));
     return;
   }
 
   if (!strcmp(tok[1],"CONFIG")) {
+    // Fuldt image (tidligere skrevet ved hver boot/save, v3.9.4)
+    if (ntok >= 3 && !strcmp(tok[2],"DUMP")) { configDump(globalConfig); return; }
     Serial.println(F("=== CONFIGURATION ==="));
     Serial.print(F("Version: ")); Serial.println(VERSION_STRING_NY);
     Serial.print(F("Build: "));   Serial.println(VERSION_BUILD);
@@ -734,6 +913,11 @@ static void cmd_show(uint8_t ntok, char* tok[]) {
 
     Serial.print(F("Hostname: "));
     Serial.println(cliHostname);
+    if (profileReg || profileActive) {
+      Serial.print(F("Profile: "));
+      if (profileActive) Serial.print(profileActive); else Serial.print(F("base"));
+      Serial.print(F(" (set profile reg:")); Serial.print(profileReg); Serial.println(F(")"));
+    }
     Serial.println(F("====================="));
     print_static_config();
     print_timers_config_block(true);     // only enabled timers
@@ -743,11 +927,15 @@ static void cmd_show(uint8_t ntok, char* tok[]) {
     return;
   }
 
-  if (!strcmp(tok[1],"STATS"))        { printStatistics(); return; }
+  if (!strcmp(tok[1],"STATS"))        { printStatistics(); idle_print_status(); return; }
   if (!strcmp(tok[1],"REGS"))         { cli_dump_regs();   return; }
   if (!strcmp(tok[1],"COILS"))        { cli_dump_coils();  print_timer_links(); return; }
   if (!strcmp(tok[1],"INPUTS"))       { cli_dump_inputs(); print_timer_links(); return; }
-  if (!strcmp(tok[1],"TIMERS"))       { timers_print_status(); return; }
+  if (!strcmp(tok[1],"TIMERS")) {
+    if (ntok >= 3 && !strcmp(tok[2],"STATS")) timers_print_stats();
+    else timers_print_status();
+    return;
+  }
   if (!strcmp(tok[1], "COUNTERS"))    { 
     counters_print_status(); 
     Serial.println();
@@ -778,6 +966,151 @@ static void cmd_show(uint8_t ntok, char* tok[]) {
       Serial.println(F("=============================="));
     }
 
+    // Sampler-status (missed-edge bound)
+    Serial.println(F("=== COUNTER SAMPLER ==="));
+    if (sampler_rate_hz()) {
+      Serial.print(F("Rate: ")); Serial.print(sampler_rate_hz());
+      Serial.print(F(" Hz | min pulse: ")); Serial.print(1000000UL / sampler_rate_hz());
+      Serial.print(F(" us | max input: ")); Serial.print(sampler_max_input_hz());
+      Serial.print(F(" Hz | lost: ")); Serial.println(sampler_lost_edges());
+    } else {
+      Serial.println(F("OFF (polling counters sampled in loop)"));
+    }
+
+    // Snapshot-latch status
+    Serial.println(F("=== COUNTER SNAPSHOT ==="));
+    if (snapshotReg) {
+      Serial.print(F("Regs: ")); Serial.print(snapshotReg);
+      Serial.print(F("..")); Serial.print(snapshotReg + SNAP_BLOCK_REGS - 1);
+      Serial.print(F(" | trigger-pin: "));
+      if (snapshotPin) Serial.print(snapshotPin); else Serial.print(F("none"));
+      Serial.print(F(" | seq: ")); Serial.println(snapshot_seq());
+    } else {
+      Serial.println(F("OFF"));
+    }
+
+    // Compare-setpoints: aktuelle setpoints + latch
+    Serial.println(F("=== COUNTER COMPARE ==="));
+    bool anyCmp = false;
+    for (uint8_t i = 0; i < 4; ++i) {
+      const CounterCompareConfig& cc = counterCompare[i];
+      if (cc.reg == 0) continue;
+      anyCmp = true;
+      Serial.print(F("Counter ")); Serial.print(i + 1);
+      for (uint8_t sp = 0; sp < CMP_SETPOINTS; ++sp) {
+        uint32_t v = (uint32_t)holdingRegs[cc.reg + 2 * sp] |
+                     ((uint32_t)holdingRegs[cc.reg + 2 * sp + 1] << 16);
+        Serial.print(F(" | sp")); Serial.print(sp + 1); Serial.print('=');
+        Serial.print(v); Serial.print(' ');
+        print_compare_action(cc.action[sp]);
+      }
+      Serial.print(F(" | latch=0x"));
+      Serial.println(holdingRegs[cc.reg + CMP_SETPOINTS * 2], HEX);
+    }
+    if (!anyCmp) Serial.println(F("(none)"));
+
+    // Gate / tidsvindue: gate-niveau + seneste vindue
+    Serial.println(F("=== COUNTER GATE / WINDOW ==="));
+    bool anyGw = false;
+    for (uint8_t i = 0; i < 4; ++i) {
+      const CounterGateWindowConfig& gw = counterGateWin[i];
+      if (gw.gatePin == 0 && gw.windowReg == 0) continue;
+      anyGw = true;
+      Serial.print(F("Counter ")); Serial.print(i + 1);
+      if (gw.gatePin != 0) {
+        Serial.print(F(" | gate pin ")); Serial.print(gw.gatePin);
+        Serial.print(gate_open(i) ? F(" OPEN") : F(" CLOSED"));
+      }
+      if (gw.windowReg != 0) {
+        Serial.print(F(" | window ")); Serial.print(gw.windowMs);
+        Serial.print(F(" ms | last "));
+        Serial.print((uint32_t)holdingRegs[gw.windowReg] |
+                     ((uint32_t)holdingRegs[gw.windowReg + 1] << 16));
+        Serial.print(F(" | seq ")); Serial.print(window_seq(i));
+      }
+      Serial.println();
+    }
+    if (!anyGw) Serial.println(F("(none)"));
+
+    // Rate (60 s / 3600 s) + lifetime totalizer
+    Serial.println(F("=== COUNTER RATE / TOTAL ==="));
+    bool anyRate = false;
+    for (uint8_t i = 0; i < 4; ++i) {
+      uint16_t reg = counterRateReg[i];
+      if (reg == 0) continue;
+      anyRate = true;
+      Serial.print(F("Counter ")); Serial.print(i + 1);
+      Serial.print(F(" | /min ")); Serial.print((uint32_t)holdingRegs[reg] | ((uint32_t)holdingRegs[reg + 1] << 16));
+      Serial.print(F(" | /hour ")); Serial.print((uint32_t)holdingRegs[reg + 2] | ((uint32_t)holdingRegs[reg + 3] << 16));
+      Serial.print(F(" | total ")); print_u64(rate_total(i));
+      Serial.println();
+    }
+    if (!anyRate) Serial.println(F("(none)"));
+
+    // Retentive counters: seneste checkpoint i EEPROM-ringen
+    retain_print_status();
+
+    // Pulsbredde/duty: seneste publicerede måling
+    Serial.println(F("=== COUNTER PWM ==="));
+    bool anyPwm = false;
+    for (uint8_t i = 0; i < 4; ++i) {
+      const CounterPwmConfig& pc = counterPwm[i];
+      if (pc.reg == 0) continue;
+      anyPwm = true;
+      const uint16_t* r = &holdingRegs[pc.reg];
+      uint16_t st = r[7];
+      Serial.print(F("Counter ")); Serial.print(i + 1);
+      Serial.print(F(" | high ")); Serial.print((uint32_t)r[0] | ((uint32_t)r[1] << 16));
+      Serial.print(F(" us | low ")); Serial.print((uint32_t)r[2] | ((uint32_t)r[3] << 16));
+      Serial.print(F(" us | period ")); Serial.print((uint32_t)r[4] | ((uint32_t)r[5] << 16));
+      Serial.print(F(" us | duty ")); Serial.print(r[6] / 100); Serial.print('.');
+      if (r[6] % 100 < 10) Serial.print('0');
+      Serial.print(r[6] % 100);
+      Serial.print(F(" % | "));
+      if (st & PWM_ST_STALE) Serial.println(F("STALE"));
+      else if (st & PWM_ST_VALID) Serial.println(F("ok"));
+      else Serial.println(F("waiting"));
+    }
+    if (!anyPwm) Serial.println(F("(none)"));
+
+    // Edge-tidsstempel ringe: head + seneste tidsstempel
+    Serial.println(F("=== COUNTER EDGE LOG ==="));
+    bool anyLog = false;
+    for (uint8_t i = 0; i < 4; ++i) {
+      const CounterEdgeLogConfig& ec = counterEdgeLog[i];
+      if (ec.reg == 0) continue;
+      anyLog = true;
+      uint16_t head = edgelog_head(i);
+      Serial.print(F("Counter ")); Serial.print(i + 1);
+      Serial.print(F(" | regs ")); Serial.print(ec.reg);
+      Serial.print(F("..")); Serial.print(ec.reg + EDGELOG_BLOCK_REGS(ec.depth) - 1);
+      Serial.print(F(" | depth ")); Serial.print(ec.depth);
+      Serial.print(F(" | head ")); Serial.print(head);
+      if (head) {
+        uint16_t slot = (uint16_t)((head - 1) % ec.depth);
+        uint32_t us = (uint32_t)holdingRegs[ec.reg + 1 + 2 * slot] |
+                      ((uint32_t)holdingRegs[ec.reg + 2 + 2 * slot] << 16);
+        Serial.print(F(" | last ")); Serial.print(us); Serial.print(F(" us"));
+      }
+      Serial.println();
+    }
+    if (!anyLog) Serial.println(F("(none)"));
+
+    // Input-filter pr. counter (effektivt vindue, Timer4-tidsbase)
+    Serial.println(F("=== COUNTER INPUT FILTER ==="));
+    for (uint8_t i = 0; i < 4; ++i) {
+      if (!counters[i].enabled || counters[i].hwMode != 0) continue;
+      uint32_t win = counters_filter_window_ticks(i);
+      Serial.print(F("Counter ")); Serial.print(i + 1); Serial.print(F(": "));
+      if (win == 0) {
+        Serial.println(F("off"));
+        continue;
+      }
+      Serial.print(TIMEBASE_TICKS_TO_US(win));
+      Serial.print(F(" us stable"));
+      Serial.println(counterFilterUs[i] > 0 ? F(" (filter-us)") : F(" (debounce-ms)"));
+    }
+
     // DEBUG: Show HW counter (Timer5 only) state
     Serial.println(F("=== DEBUG HW COUNTER STATE (Timer5 only) ==="));
     Serial.print(F("hwCounter5Extend: ")); Serial.println(hwCounter5Extend);
@@ -788,6 +1121,8 @@ static void cmd_show(uint8_t ntok, char* tok[]) {
     return; 
   }
   if (!strcmp(tok[1],"GPIO"))         { cli_show_gpio();   return; }
+  if (!strcmp(tok[1],"EEPROM"))       { eeprom_print_status(); return; }
+  if (!strcmp(tok[1],"PROFILES"))     { profile_print(); return; }
   if (!strcmp(tok[1],"VERSION")) {
     Serial.print(F("Version: ")); Serial.println(VERSION_STRING_NY);
     Serial.print(F("Build: "));   Serial.println(VERSION_BUILD);
@@ -995,10 +1330,11 @@ static bool regsOverlap(uint16_t start1, uint8_t len1, uint16_t start2, uint8_t
 }
 
 // Validate counter register configuration for overlaps
-static bool validateCounterRegisters(const CounterConfig& newCfg, uint8_t excludeCounterId = 0) {
+static bool validateCounterRegisters(const CounterConfig& newCfg, uint8_t excludeCounterId = 0,
+                                     uint16_t pwmReg = 0) {
   // Collect all registers used by this counter
-  uint16_t regsToCheck[5];  // index, raw, freq, ctrl, overflow
-  uint8_t regCounts[5];     // how many regs each uses
+  uint16_t regsToCheck[6];  // index, raw, freq, ctrl, overflow, pwm-blok
+  uint8_t regCounts[6];     // how many regs each uses
   uint8_t numRegs = 0;
 
   // Get bitwidth-dependent register count for index and raw registers
@@ -1034,6 +1370,13 @@ static bool validateCounterRegisters(const CounterConfig& newCfg, uint8_t exclud
     numRegs++;
   }
 
+  // Pulsbredde-blok (v3.7.6)
+  if (pwmReg > 0 && pwmReg < NUM_REGS) {
+    regsToCheck[numRegs] = pwmReg;
+    regCounts[numRegs] = PWM_BLOCK_REGS;
+    numRegs++;
+  }
+
   // Check internal overlaps within this counter (e.g., index-reg and raw-reg can't overlap)
   for (uint8_t i = 0; i < numRegs; i++) {
     for (uint8_t j = i + 1; j < numRegs; j++) {
@@ -1090,6 +1433,16 @@ static bool validateCounterRegisters(const CounterConfig& newCfg, uint8_t exclud
         Serial.println(F(")"));
         return false;
       }
+      // Check pwm-reg blok
+      uint16_t otherPwm = counterPwm[otherId - 1].reg;
+      if (otherPwm > 0 &&
+          regsOverlap(regsToCheck[i], regCounts[i], otherPwm, PWM_BLOCK_REGS)) {
+        Serial.print(F("% ERROR: Counter ")); Serial.print(newCfg.id);
+        Serial.print(F(" overlaps with Counter ")); Serial.print(otherId);
+        Serial.print(F(" pwm-reg block ")); Serial.print(otherPwm);
+        Serial.println(F(")"));
+        return false;
+      }
     }
   }
 
@@ -1119,6 +1472,37 @@ static bool validateCounterRegisters(const CounterConfig& newCfg, uint8_t exclud
   return true;
 }
 
+// Reg-blok [start, start+len) overlapper en anden blok (modbus_regmap):
+// skriv "% ERROR: <what> block overlaps <ejer>" og returnér true
+static bool regBlockTaken(const __FlashStringHelper* what, uint16_t start, uint16_t len, uint8_t self) {
+  uint8_t own = regmap_owner(start, len, self);
+  if (own == REGMAP_NONE) return false;
+  uint8_t kind = REGMAP_KIND(own);
+  Serial.print(F("% ERROR: ")); Serial.print(what); Serial.print(F(" block overlaps "));
+  if (kind <= REGMAP_RATE) {
+    Serial.print(F("Counter ")); Serial.print(REGMAP_IDX(own) + 1);
+  } else if (kind <= REGMAP_SEQ) {
+    Serial.print(F("Timer ")); Serial.print(REGMAP_IDX(own) + 1);
+  }
+  switch (kind) {
+    case REGMAP_COMPARE:  Serial.println(F(" compare")); break;
+    case REGMAP_EDGELOG:  Serial.println(F(" edgelog")); break;
+    case REGMAP_PWM:      Serial.println(F(" pwm")); break;
+    case REGMAP_WINDOW:   Serial.println(F(" window")); break;
+    case REGMAP_RATE:     Serial.println(F(" rate")); break;
+    case REGMAP_TPARAM:   Serial.println(F(" params")); break;
+    case REGMAP_SEQ:      Serial.println(F(" program")); break;
+    case REGMAP_SNAPSHOT: Serial.println(F("snapshot")); break;
+    case REGMAP_WAVE:     Serial.println(F("waveform")); break;
+    case REGMAP_PROFILE:  Serial.println(F("profile regs")); break;
+    case REGMAP_TSTATUS:
+      Serial.println(REGMAP_IDX(own) == 0 ? F("timers status-reg") : F("timers control-reg"));
+      break;
+    default:              Serial.println(); break;   // counterens egne regs
+  }
+  return true;
+}
+
 static void cmd_set_counter(uint8_t ntok, char* tok[]) {
   //  - Counter syntaks:
   //      set counter <id> mode 1 parameter
@@ -1183,6 +1567,14 @@ if (cfg.direction != CNT_DIR_UP && cfg.direction != CNT_DIR_DOWN) {
   cfg.direction = CNT_DIR_UP;
 }
 
+// Input-filter i µs (v3.7.2) - gemmes i counterFilterUs, ikke i CounterConfig
+int32_t filterUs = -1;
+
+// Pulsbredde-måling (v3.7.6) - gemmes i counterPwm, ikke i CounterConfig
+CounterPwmConfig pwm = counterPwm[id - 1];
+if (pwm.avgCycles == 0) pwm.avgCycles = 1;
+if (pwm.timeoutMs == 0) pwm.timeoutMs = PWM_DEFAULT_TIMEOUT_MS;
+
 // Find "parameter" token
 uint8_t start = 5;
   for (uint8_t i = 5; i < ntok; ++i) {
@@ -1366,6 +1758,46 @@ uint8_t start = 5;
       continue;
     }
 
+    // filter-us:<n> (v3.7.2) - input-filter: niveau skal være stabilt i n µs
+    if (!strncasecmp(p, "filter-us:", 10)) {
+      uint32_t us = strtoul(p + 10, nullptr, 10);
+      if (us > 65535UL) {
+        Serial.println(F("% Invalid filter-us (0..65535)"));
+        return;
+      }
+      filterUs = (int32_t)us;
+      continue;
+    }
+
+    // pwm-reg:<reg> pwm-avg:<1..64> pwm-timeout-ms:<n> (v3.7.6)
+    if (!strncasecmp(p, "pwm-reg:", 8)) {
+      uint16_t r = (uint16_t)strtoul(p + 8, nullptr, 10);
+      if (r != 0 && (uint32_t)r + PWM_BLOCK_REGS > NUM_REGS) {
+        Serial.println(F("% pwm-reg out of range"));
+        return;
+      }
+      pwm.reg = r;
+      continue;
+    }
+    if (!strncasecmp(p, "pwm-avg:", 8)) {
+      uint16_t n = (uint16_t)strtoul(p + 8, nullptr, 10);
+      if (n < 1 || n > PWM_MAX_AVG) {
+        Serial.println(F("% Invalid pwm-avg (1..64)"));
+        return;
+      }
+      pwm.avgCycles = (uint8_t)n;
+      continue;
+    }
+    if (!strncasecmp(p, "pwm-timeout-ms:", 15)) {
+      uint32_t ms = strtoul(p + 15, nullptr, 10);
+      if (ms < 1 || ms > 60000UL) {
+        Serial.println(F("% Invalid pwm-timeout-ms (1..60000)"));
+        return;
+      }
+      pwm.timeoutMs = (uint16_t)ms;
+      continue;
+    }
+
     // hw-mode:<sw|sw-isr|hw-t5> (v3.4.0 refactored)
     // sw = software polling mode (interruptPin=0)
     // sw-isr = software interrupt mode (requires separate interrupt-pin parameter)
@@ -1413,23 +1845,375 @@ uint8_t start = 5;
     return;
   }
 
+  // Pulsbredde-måling kræver flanke-tidsstempler fra interrupt-ISR
+  if (pwm.reg != 0 && (cfg.hwMode != 0 || cfg.interruptPin == 0)) {
+    Serial.println(F("% pwm-reg requires hw-mode:sw-isr with interrupt-pin"));
+    return;
+  }
+
   // Validate register configuration before setting
-  if (!validateCounterRegisters(cfg)) {
+  if (!validateCounterRegisters(cfg, 0, pwm.reg)) {
     Serial.println(F("% Counter configuration rejected due to register conflicts"));
     return;
   }
 
+  // Filtervindue sættes før config, så counters_config_set() genopbygger med det
+  if (filterUs >= 0) {
+    counters_filter_set(id, (uint16_t)filterUs);
+  }
+
   if (!counters_config_set(id, cfg)) {
     Serial.println(F("% Could not set counter config"));
     return;
   }
 
+  bool pwmFree = pwm.reg == 0 ||
+      !regBlockTaken(F("pwm-reg"), pwm.reg, PWM_BLOCK_REGS, REGMAP_ID(REGMAP_PWM, id - 1));
+  if (pwmFree && !pwm_config_set(id - 1, pwm)) {
+    Serial.println(F("% Could not set pwm measurement"));
+  }
+
   Serial.print(F("Counter ")); Serial.print(id); Serial.println(F(" configured and enabled"));
 }
 
+// ----------------------------------------------------------------------------
+// set counter <id> compare reg:<n> sp1:<action>:<target> [sp2:<action>:<target>]
+//   action: coil-set | coil-clear | gpio-high | gpio-low | timer | none
+// ----------------------------------------------------------------------------
+static void cmd_set_counter_compare(uint8_t ntok, char* tok[]) {
+  uint8_t id = (uint8_t)strtoul(tok[2], nullptr, 10);
+  if (id < 1 || id > 4) {
+    Serial.println(F("% Invalid counter id (1..4)"));
+    return;
+  }
+
+  CounterCompareConfig cc = counterCompare[id - 1];
+  for (uint8_t i = 4; i < ntok; ++i) {
+    char* p = tok[i];
+
+    if (!strncasecmp(p, "reg:", 4)) {
+      cc.reg = (uint16_t)strtoul(p + 4, nullptr, 10);
+      continue;
+    }
+
+    if ((!strncasecmp(p, "sp1:", 4) || !strncasecmp(p, "sp2:", 4))) {
+      uint8_t s = (uint8_t)(p[2] - '1');
+      const char* v = p + 4;
+      const char* colon = strchr(v, ':');
+      size_t alen = colon ? (size_t)(colon - v) : strlen(v);
+      uint16_t target = colon ? (uint16_t)strtoul(colon + 1, nullptr, 10) : 0;
+
+      uint8_t act;
+      if      (alen == 8  && !strncasecmp(v, "coil-set", 8))   act = CMP_ACT_COIL_SET;
+      else if (alen == 10 && !strncasecmp(v, "coil-clear", 10)) act = CMP_ACT_COIL_CLEAR;
+      else if (alen == 9  && !strncasecmp(v, "gpio-high", 9))   act = CMP_ACT_GPIO_HIGH;
+      else if (alen == 8  && !strncasecmp(v, "gpio-low", 8))    act = CMP_ACT_GPIO_LOW;
+      else if (alen == 5  && !strncasecmp(v, "timer", 5))       act = CMP_ACT_TIMER;
+      else if (alen == 4  && !strncasecmp(v, "none", 4))        act = CMP_ACT_NONE;
+      else {
+        Serial.println(F("% Invalid action (coil-set|coil-clear|gpio-high|gpio-low|timer|none)"));
+        return;
+      }
+      if (act != CMP_ACT_NONE && !colon) {
+        Serial.println(F("% Missing target (sp<n>:<action>:<coil|pin|timer-id>)"));
+        return;
+      }
+      cc.action[s] = act;
+      cc.target[s] = target;
+      continue;
+    }
+
+    Serial.print(F("% Unknown parameter: ")); Serial.println(p);
+    return;
+  }
+
+  // Register-blok må ikke overlappe counter-registre eller andre blokke
+  if (cc.reg != 0 &&
+      regBlockTaken(F("compare-reg"), cc.reg, CMP_BLOCK_REGS, REGMAP_ID(REGMAP_COMPARE, id - 1))) {
+    return;
+  }
+
+  if (!cmp_config_set(id - 1, cc)) {
+    Serial.print(F("% Invalid compare config (reg 1.."));
+    Serial.print(NUM_REGS - CMP_BLOCK_REGS);
+    Serial.println(F(", coil/pin/timer target out of range or pin in use, not for 64-bit counters)"));
+    return;
+  }
+
+  Serial.print(F("Counter ")); Serial.print(id);
+  Serial.print(F(" compare set (regs ")); Serial.print(cc.reg);
+  Serial.print(F("..")); Serial.print(cc.reg + CMP_BLOCK_REGS - 1);
+  Serial.println(F(")"));
+}
+
+// ----------------------------------------------------------------------------
+// set counter <id> edgelog reg:<n> depth:<1..64>
+//   Ring af µs-tidsstempler for de sidste <depth> edges (1 + 2*depth regs)
+// ----------------------------------------------------------------------------
+static void cmd_set_counter_edgelog(uint8_t ntok, char* tok[]) {
+  uint8_t id = (uint8_t)strtoul(tok[2], nullptr, 10);
+  if (id < 1 || id > 4) {
+    Serial.println(F("% Invalid counter id (1..4)"));
+    return;
+  }
+
+  CounterEdgeLogConfig ec = counterEdgeLog[id - 1];
+  if (ec.depth == 0) ec.depth = 16;
+  for (uint8_t i = 4; i < ntok; ++i) {
+    char* p = tok[i];
+    if (!strncasecmp(p, "reg:", 4)) {
+      ec.reg = (uint16_t)strtoul(p + 4, nullptr, 10);
+      continue;
+    }
+    if (!strncasecmp(p, "depth:", 6)) {
+      ec.depth = (uint8_t)strtoul(p + 6, nullptr, 10);
+      continue;
+    }
+    Serial.print(F("% Unknown parameter: ")); Serial.println(p);
+    return;
+  }
+
+  uint16_t len = EDGELOG_BLOCK_REGS(ec.depth);
+  if (ec.reg != 0 &&
+      regBlockTaken(F("edgelog"), ec.reg, len, REGMAP_ID(REGMAP_EDGELOG, id - 1))) {
+    return;
+  }
+
+  if (!edgelog_config_set(id - 1, ec)) {
+    Serial.print(F("% Invalid edgelog config (depth 1.."));
+    Serial.print(EDGELOG_MAX_DEPTH);
+    Serial.println(F(", reg + 1 + 2*depth must fit in holding regs,"));
+    Serial.print(F("  depth of all edgelogs together max ")); Serial.print(EDGELOG_POOL);
+    Serial.println(F(")"));
+    return;
+  }
+
+  Serial.print(F("Counter ")); Serial.print(id);
+  Serial.print(F(" edgelog set (regs ")); Serial.print(ec.reg);
+  Serial.print(F("..")); Serial.print(ec.reg + len - 1);
+  Serial.print(F(", depth ")); Serial.print(ec.depth);
+  Serial.println(F(")"));
+  if (counters[id - 1].enabled && counters[id - 1].hwMode != 0) {
+    Serial.println(F("% Note: hw-mode counts in Timer5 - no edge timestamps"));
+  }
+}
+
+// ----------------------------------------------------------------------------
+// set counter <id> gate pin:<p> [level:<high|low>]
+// set counter <id> window ms:<1..60000> reg:<n>
+//   Gate: tæl kun mens gate-pin har aktivt niveau. Vindue: latch antal edges
+//   pr. window-ms (Timer4 OCR4B) med sekvensnummer i reg+2.
+// ----------------------------------------------------------------------------
+static void cmd_set_counter_gatewin(uint8_t ntok, char* tok[], bool window) {
+  uint8_t id = (uint8_t)strtoul(tok[2], nullptr, 10);
+  if (id < 1 || id > 4) {
+    Serial.println(F("% Invalid counter id (1..4)"));
+    return;
+  }
+
+  CounterGateWindowConfig gw = counterGateWin[id - 1];
+  if (!window) gw.gateLevel = 1;
+  for (uint8_t i = 4; i < ntok; ++i) {
+    char* p = tok[i];
+    if (!window && !strncasecmp(p, "pin:", 4)) {
+      gw.gatePin = (uint8_t)strtoul(p + 4, nullptr, 10);
+      continue;
+    }
+    if (!window && !strncasecmp(p, "level:", 6)) {
+      if      (!strcasecmp(p + 6, "high")) gw.gateLevel = 1;
+      else if (!strcasecmp(p + 6, "low"))  gw.gateLevel = 0;
+      else {
+        Serial.println(F("% Invalid level (use high|low)"));
+        return;
+      }
+      continue;
+    }
+    if (window && !strncasecmp(p, "ms:", 3)) {
+      uint32_t ms = strtoul(p + 3, nullptr, 10);
+      gw.windowMs = (ms > WIN_MAX_MS) ? 0 : (uint16_t)ms;
+      continue;
+    }
+    if (window && !strncasecmp(p, "reg:", 4)) {
+      gw.windowReg = (uint16_t)strtoul(p + 4, nullptr, 10);
+      continue;
+    }
+    Serial.print(F("% Unknown parameter: ")); Serial.println(p);
+    return;
+  }
+
+  if (window && gw.windowReg != 0 &&
+      regBlockTaken(F("window-reg"), gw.windowReg, WIN_BLOCK_REGS, REGMAP_ID(REGMAP_WINDOW, id - 1))) {
+    return;
+  }
+
+  if (!gatewin_config_set(id - 1, gw)) {
+    if (window) {
+      Serial.print(F("% Invalid window config (ms 1..60000, reg 1.."));
+      Serial.print(NUM_REGS - WIN_BLOCK_REGS);
+      Serial.println(F(")"));
+    } else if (gw.gatePin != 0 && counters[id - 1].hwMode != 0) {
+      Serial.println(F("% Gate not supported in hw-mode (Timer5 counts without CPU)"));
+    } else {
+      Serial.println(F("% Invalid gate pin (serial, or used by counter/trigger/compare/"));
+      Serial.println(F("  snapshot/waveform)"));
+    }
+    return;
+  }
+
+  Serial.print(F("Counter ")); Serial.print(id);
+  if (window) {
+    Serial.print(F(" window ")); Serial.print(gw.windowMs);
+    Serial.print(F(" ms (regs ")); Serial.print(gw.windowReg);
+    Serial.print(F("..")); Serial.print(gw.windowReg + WIN_BLOCK_REGS - 1);
+    Serial.println(F(")"));
+  } else {
+    Serial.print(F(" gate pin ")); Serial.print(gw.gatePin);
+    Serial.println(gw.gateLevel ? F(" active high") : F(" active low"));
+  }
+}
+
+// ----------------------------------------------------------------------------
+// set counter <id> rate reg:<n>
+//   n+0/1 pulser sidste 60 s, n+2/3 pulser sidste 3600 s, n+4..7 totalizer
+// ----------------------------------------------------------------------------
+static void cmd_set_counter_rate(uint8_t ntok, char* tok[]) {
+  uint8_t id = (uint8_t)strtoul(tok[2], nullptr, 10);
+  if (id < 1 || id > 4) {
+    Serial.println(F("% Invalid counter id (1..4)"));
+    return;
+  }
+  if (ntok < 5 || strncasecmp(tok[4], "reg:", 4)) {
+    Serial.println(F("Usage: set counter <id> rate reg:<n>"));
+    return;
+  }
+  uint16_t reg = (uint16_t)strtoul(tok[4] + 4, nullptr, 10);
+  if (reg != 0 &&
+      regBlockTaken(F("rate-reg"), reg, RATE_BLOCK_REGS, REGMAP_ID(REGMAP_RATE, id - 1))) {
+    return;
+  }
+  if (reg != 0 && !rate_slot_available(id - 1)) {
+    Serial.print(F("% ERROR: no free rate slot (max ")); Serial.print(RATE_SLOTS);
+    Serial.println(F(" counters with rate)"));
+    return;
+  }
+  if (!rate_config_set(id - 1, reg)) {
+    Serial.print(F("% Invalid rate reg (1.."));
+    Serial.print(NUM_REGS - RATE_BLOCK_REGS);
+    Serial.println(F(")"));
+    return;
+  }
+  Serial.print(F("Counter ")); Serial.print(id);
+  Serial.print(F(" rate set (regs ")); Serial.print(reg);
+  Serial.print(F("..")); Serial.print(reg + RATE_BLOCK_REGS - 1);
+  Serial.println(F(")"));
+}
+
+// ----------------------------------------------------------------------------
+// set counter <id> retain [interval-s:<n>] [delta:<n>]
+//   checkpoint til EEPROM-ring; uden parametre: interval-s:60
+// ----------------------------------------------------------------------------
+static void cmd_set_counter_retain(uint8_t ntok, char* tok[]) {
+  uint8_t id = (uint8_t)strtoul(tok[2], nullptr, 10);
+  if (id < 1 || id > 4) {
+    Serial.println(F("% Invalid counter id (1..4)"));
+    return;
+  }
+  CounterRetainConfig rc;
+  rc.intervalS = 0;
+  rc.delta = 0;
+  for (uint8_t t = 4; t < ntok; ++t) {
+    if (!strncasecmp(tok[t], "interval-s:", 11)) {
+      unsigned long v = strtoul(tok[t] + 11, nullptr, 10);
+      rc.intervalS = (uint16_t)((v > 65535UL) ? 65535UL : v);
+    } else if (!strncasecmp(tok[t], "delta:", 6)) {
+      rc.delta = strtoul(tok[t] + 6, nullptr, 10);
+    } else {
+      Serial.println(F("Usage: set counter <id> retain [interval-s:<n>] [delta:<n>]"));
+      return;
+    }
+  }
+  if (ntok == 4) rc.intervalS = 60;
+  if (rc.intervalS == 0 && rc.delta == 0) {
+    Serial.println(F("% interval-s or delta must be > 0 (use 'no set counter <id> retain')"));
+    return;
+  }
+  if (rc.intervalS != 0 && rc.intervalS < RETAIN_MIN_GAP_S) {
+    Serial.print(F("% interval-s must be 0 or >= ")); Serial.println(RETAIN_MIN_GAP_S);
+    return;
+  }
+  retain_config_set(id - 1, rc);
+  Serial.print(F("Counter ")); Serial.print(id);
+  Serial.print(F(" retentive (interval-s:")); Serial.print(rc.intervalS);
+  Serial.print(F(" delta:")); Serial.print(rc.delta);
+  Serial.print(F(", min ")); Serial.print(RETAIN_MIN_GAP_S);
+  Serial.println(F(" s between EEPROM records)"));
+}
+
+// ----------------------------------------------------------------------------
+// set timer <id> params reg:<n>  (0 = fra)
+// ----------------------------------------------------------------------------
+static void cmd_set_timer_params(uint8_t ntok, char* tok[]) {
+  uint8_t id = (uint8_t)strtoul(tok[2], nullptr, 10);
+  if (id < 1 || id > 4) {
+    Serial.println(F("% Invalid timer id (1..4)"));
+    return;
+  }
+  if (ntok < 5 || strncasecmp(tok[4], "reg:", 4)) {
+    Serial.println(F("Usage: set timer <id> params reg:<n>"));
+    return;
+  }
+  uint16_t reg = (uint16_t)strtoul(tok[4] + 4, nullptr, 10);
+  if (reg != 0 &&
+      regBlockTaken(F("params reg"), reg, TIMER_PARAM_REGS, REGMAP_ID(REGMAP_TPARAM, id - 1))) {
+    return;
+  }
+  if (!timers_param_reg_set(id - 1, reg)) {
+    Serial.print(F("% Invalid params reg (1.."));
+    Serial.print(NUM_REGS - TIMER_PARAM_REGS);
+    Serial.println(F(")"));
+    return;
+  }
+  Serial.print(F("Timer ")); Serial.print(id);
+  if (reg == 0) {
+    Serial.println(F(" params unbound"));
+    return;
+  }
+  Serial.print(F(" params bound (regs ")); Serial.print(reg);
+  Serial.print(F("..")); Serial.print(reg + TIMER_PARAM_REGS - 1);
+  Serial.println(F(")"));
+}
+
+// ----------------------------------------------------------------------------
+// set timer <id> trigger pin:<p>  (0 = polling af discrete input)
+// ----------------------------------------------------------------------------
+static void cmd_set_timer_trigger(uint8_t ntok, char* tok[]) {
+  uint8_t id = (uint8_t)strtoul(tok[2], nullptr, 10);
+  if (id < 1 || id > 4) {
+    Serial.println(F("% Invalid timer id (1..4)"));
+    return;
+  }
+  if (ntok < 5 || strncasecmp(tok[4], "pin:", 4)) {
+    Serial.println(F("Usage: set timer <id> trigger pin:<p>"));
+    return;
+  }
+  uint8_t pin = (uint8_t)strtoul(tok[4] + 4, nullptr, 10);
+  if (!trig_pin_set(id - 1, pin)) {
+    Serial.println(F("% Invalid trigger pin (INT 2,3,20,21 or PCINT 10-13,50-53,62-69;"));
+    Serial.println(F("  not used by counter/gate/snapshot/compare/waveform or gpio-mapped)"));
+    return;
+  }
+  Serial.print(F("Timer ")); Serial.print(id);
+  if (pin == 0) {
+    Serial.println(F(" trigger polled from discrete input"));
+    return;
+  }
+  Serial.print(F(" trigger on pin ")); Serial.print(pin);
+  Serial.println(trig_bound(id - 1) ? F(" (edge isr)") : F(" (used once timer is mode 4)"));
+}
+
 static void cmd_set(uint8_t ntok, char* tok[]) {
   if (ntok < 2) {
-    Serial.println(F("Usage: set {id|baud|server|mode|timer|counter|reg|coil|timers} ..."));
+    Serial.println(F("Usage: set {id|baud|server|mode|timer|counter|reg|coil|timers|profile} ..."));
     return;
   }
 
@@ -1456,13 +2240,23 @@ static void cmd_set(uint8_t ntok, char* tok[]) {
       char* p = tok[i];
 
       if (!strncasecmp(p, "status-reg:", 11)) {
-        timerStatusRegIndex = (uint16_t)strtoul(p + 11, nullptr, 10);
+        uint16_t r = (uint16_t)strtoul(p + 11, nullptr, 10);
+        if (r != 0 && r < NUM_REGS &&
+            regBlockTaken(F("status-reg"), r, 1, REGMAP_ID(REGMAP_TSTATUS, 0))) {
+          continue;
+        }
+        timerStatusRegIndex = r;
         Serial.print(F("Timer status-reg = "));
         Serial.println(timerStatusRegIndex);
         continue;
       }
       if (!strncasecmp(p, "control-reg:", 12)) {
-        timerStatusCtrlRegIndex = (uint16_t)strtoul(p + 12, nullptr, 10);
+        uint16_t r = (uint16_t)strtoul(p + 12, nullptr, 10);
+        if (r != 0 && r < NUM_REGS &&
+            regBlockTaken(F("control-reg"), r, 1, REGMAP_ID(REGMAP_TSTATUS, 1))) {
+          continue;
+        }
+        timerStatusCtrlRegIndex = r;
         Serial.print(F("Timer control-reg = "));
         Serial.println(timerStatusCtrlRegIndex);
         continue;
@@ -1474,6 +2268,106 @@ static void cmd_set(uint8_t ntok, char* tok[]) {
     return;
   }
 
+  // --- Profil-vælger (v3.9.6) ---
+  // Syntax: set profile reg:<n>   (0 = fra)
+  if (!strcmp(tok[1], "PROFILE")) {
+    if (ntok != 3 || strncasecmp(tok[2], "reg:", 4)) {
+      Serial.println(F("Usage: set profile reg:<n>"));
+      return;
+    }
+    uint16_t reg = (uint16_t)strtoul(tok[2] + 4, nullptr, 10);
+    if (reg != 0 && regBlockTaken(F("profile reg"), reg, PROFILE_REGS, REGMAP_ID(REGMAP_PROFILE, 0))) {
+      return;
+    }
+    if (!profile_config_set(reg)) {
+      Serial.print(F("% Invalid profile reg (0|1.."));
+      Serial.print(NUM_REGS - PROFILE_REGS); Serial.println(F(")"));
+      return;
+    }
+    Serial.print(F("Profile regs "));
+    if (profileReg == 0) {
+      Serial.println(F("disabled"));
+      return;
+    }
+    Serial.print(profileReg); Serial.print(F(".."));
+    Serial.print(profileReg + PROFILE_REGS - 1);
+    Serial.println(F(" (select, active, status)"));
+    return;
+  }
+
+  // --- Globale counter-indstillinger ---
+  // Syntax: set counters sampler-hz:<0|1000..20000>
+  if (!strcmp(tok[1], "COUNTERS")) {
+    if (ntok < 3) {
+      Serial.println(F("Usage: set counters sampler-hz:<0|1000..20000>"));
+      return;
+    }
+    for (uint8_t i = 2; i < ntok; i++) {
+      char* p = tok[i];
+
+      if (!strncasecmp(p, "sampler-hz:", 11)) {
+        uint16_t hz = (uint16_t)strtoul(p + 11, nullptr, 10);
+        if (!counters_sampler_set(hz)) {
+          Serial.print(F("% Invalid sampler rate (0 or "));
+          Serial.print(SAMPLER_MIN_HZ); Serial.print(F(".."));
+          Serial.print(SAMPLER_MAX_HZ); Serial.println(F(" Hz)"));
+          continue;
+        }
+        Serial.print(F("Counter sampler = "));
+        Serial.print(sampler_rate_hz());
+        Serial.print(F(" Hz (max input "));
+        Serial.print(sampler_max_input_hz());
+        Serial.println(F(" Hz)"));
+        continue;
+      }
+
+      // snapshot-reg:<n> / snapshot-pin:<0|2|3|20|21> (v3.7.4)
+      if (!strncasecmp(p, "snapshot-reg:", 13) || !strncasecmp(p, "snapshot-pin:", 13)) {
+        uint16_t v = (uint16_t)strtoul(p + 13, nullptr, 10);
+        bool isReg = !strncasecmp(p, "snapshot-reg:", 13);
+        uint16_t reg = isReg ? v : snapshotReg;
+        uint8_t  pin = isReg ? snapshotPin : (uint8_t)v;
+        if (reg != 0 &&
+            regBlockTaken(F("snapshot-reg"), reg, SNAP_BLOCK_REGS, REGMAP_ID(REGMAP_SNAPSHOT, 0))) {
+          continue;
+        }
+        if (!snapshot_config_set(reg, pin)) {
+          Serial.print(F("% Invalid snapshot config (reg 0|1.."));
+          Serial.print(NUM_REGS - SNAP_BLOCK_REGS);
+          Serial.println(F(", pin 0|2|3|20|21 not used by counter/gate/trigger/compare)"));
+          continue;
+        }
+        Serial.print(F("Counter snapshot regs "));
+        if (snapshotReg == 0) {
+          Serial.println(F("OFF"));
+        } else {
+          Serial.print(snapshotReg); Serial.print(F(".."));
+          Serial.print(snapshotReg + SNAP_BLOCK_REGS - 1);
+          Serial.print(F(" trigger-pin "));
+          if (snapshotPin) Serial.println(snapshotPin); else Serial.println(F("none"));
+        }
+        continue;
+      }
+
+      // snapshot:latch - tag snapshot nu fra CLI
+      if (!strcasecmp(p, "snapshot:latch")) {
+        if (snapshotReg == 0) {
+          Serial.println(F("% Snapshot not configured (set counters snapshot-reg:<n>)"));
+          continue;
+        }
+        snapshot_capture();
+        snapshot_loop();
+        Serial.print(F("Snapshot #")); Serial.print(snapshot_seq());
+        Serial.println(F(" latched"));
+        continue;
+      }
+
+      Serial.print(F("% Unknown parameter: "));
+      Serial.println(p);
+    }
+    return;
+  }
+
 // --- Fjern en counter: "no set counter <id>" ---
 if (!strcmp(tok[0], "NO") && !strcmp(tok[1], "SET") && !strcmp(tok[2], "COUNTER")) {
   if (ntok < 4) {
@@ -1485,6 +2379,47 @@ if (!strcmp(tok[0], "NO") && !strcmp(tok[1], "SET") && !strcmp(tok[2], "COUNTER"
     Serial.println(F("% Invalid counter id (1..4)"));
     return;
   }
+  // "no set counter <id> compare" - fjern kun compare-setpoints (v3.7.3)
+  if (ntok >= 5 && !strcasecmp(tok[4], "compare")) {
+    CounterCompareConfig off;
+    memset(&off, 0, sizeof(off));
+    cmp_config_set(id - 1, off);
+    Serial.print(F("Counter ")); Serial.print(id); Serial.println(F(" compare disabled"));
+    return;
+  }
+  // "no set counter <id> gate|window" - fjern gate eller tidsvindue (v3.7.7)
+  if (ntok >= 5 && (!strcasecmp(tok[4], "gate") || !strcasecmp(tok[4], "window"))) {
+    CounterGateWindowConfig gw = counterGateWin[id - 1];
+    bool window = !strcasecmp(tok[4], "window");
+    if (window) { gw.windowMs = 0; gw.windowReg = 0; }
+    else        { gw.gatePin = 0; }
+    gatewin_config_set(id - 1, gw);
+    Serial.print(F("Counter ")); Serial.print(id);
+    Serial.println(window ? F(" window disabled") : F(" gate disabled"));
+    return;
+  }
+  // "no set counter <id> retain" - ikke længere retentiv (v3.9.2)
+  if (ntok >= 5 && !strcasecmp(tok[4], "retain")) {
+    CounterRetainConfig off;
+    memset(&off, 0, sizeof(off));
+    retain_config_set(id - 1, off);
+    Serial.print(F("Counter ")); Serial.print(id); Serial.println(F(" retain disabled"));
+    return;
+  }
+  // "no set counter <id> rate" - fjern rate/totalizer (v3.7.8)
+  if (ntok >= 5 && !strcasecmp(tok[4], "rate")) {
+    rate_config_set(id - 1, 0);
+    Serial.print(F("Counter ")); Serial.print(id); Serial.println(F(" rate disabled"));
+    return;
+  }
+  // "no set counter <id> edgelog" - fjern edge-tidsstempel ring (v3.7.5)
+  if (ntok >= 5 && !strcasecmp(tok[4], "edgelog")) {
+    CounterEdgeLogConfig off;
+    memset(&off, 0, sizeof(off));
+    edgelog_config_set(id - 1, off);
+    Serial.print(F("Counter ")); Serial.print(id); Serial.println(F(" edgelog disabled"));
+    return;
+  }
   CounterConfig c;
   if (!counters_get(id, c)) {
     Serial.println(F("% Counter read error"));
@@ -1653,6 +2588,18 @@ if (!strcmp(tok[0], "NO") && !strcmp(tok[1], "SET") && !strcmp(tok[2], "COIL") &
       return;
     }
 
+    // "set timer <id> params reg:<n>" (v3.8.5)
+    if (ntok >= 4 && !strcasecmp(tok[3], "params")) {
+      cmd_set_timer_params(ntok, tok);
+      return;
+    }
+
+    // "set timer <id> trigger pin:<p>" (v3.8.7)
+    if (ntok >= 4 && !strcasecmp(tok[3], "trigger")) {
+      cmd_set_timer_trigger(ntok, tok);
+      return;
+    }
+
     // Normal "set timer <id> ..."
     if (ntok < 5) {
       Serial.println(F("Usage: set timer <id> mode <n> parameter ..."));
@@ -1671,7 +2618,9 @@ if (!strcmp(tok[0], "NO") && !strcmp(tok[1], "SET") && !strcmp(tok[2], "COIL") &
     }
 
     cfg.enabled = 1;  // implicit enable
-    if (cfg.mode < 1 || cfg.mode > 4) cfg.mode = 1;
+    if (cfg.mode < 1 || cfg.mode > 6) cfg.mode = 1;
+    TimerWaveConfig wave = timerWave;   // mode 5: pin/reg
+    uint16_t seqReg = timerSeqReg[id - 1];   // mode 6: program-blok
     if (cfg.subMode < 1 || cfg.subMode > 3) cfg.subMode = 1;
 
     // parse mode + parameter block
@@ -1725,11 +2674,62 @@ if (!strcmp(tok[0], "NO") && !strcmp(tok[1], "SET") && !strcmp(tok[2], "COIL") &
             cfg.subMode = (uint8_t)strtoul(tok[++j], nullptr, 10);
             if (cfg.subMode < 1 || cfg.subMode > 3) cfg.subMode = 1;
           }
+          // waveform output-pin (mode 5), reg-blok (mode 5/6)
+          else if (!strcmp(p,"PIN") && (j+1) < ntok) {
+            wave.pin = (uint8_t)strtoul(tok[++j], nullptr, 10);
+          }
+          else if (!strcmp(p,"REG") && (j+1) < ntok) {
+            uint16_t reg = (uint16_t)strtoul(tok[++j], nullptr, 10);
+            if (cfg.mode == TM_SEQUENCE) seqReg = reg;
+            else wave.reg = reg;
+          }
         }
         break;
       }
     }
 
+    if (cfg.mode == TM_WAVE) {
+      if (wave_timer() >= 0 && wave_timer() != (int8_t)(id - 1)) {
+        Serial.print(F("% Timer1 waveform already used by timer "));
+        Serial.println(wave_timer() + 1);
+        return;
+      }
+      if ((wave.pin != 12 && wave.pin != 13) || wave.reg == 0) {
+        Serial.println(F("% Mode 5 requires pin 12|13 and reg <n>"));
+        return;
+      }
+      if (regBlockTaken(F("waveform reg"), wave.reg, WAVE_BLOCK_REGS, REGMAP_ID(REGMAP_WAVE, 0))) {
+        return;
+      }
+      if (!wave_config_set(wave)) {
+        Serial.print(F("% Invalid waveform config (reg 1.."));
+        Serial.print(NUM_REGS - WAVE_BLOCK_REGS);
+        Serial.println(F(", pin gpio-mapped or in use)"));
+        return;
+      }
+    }
+
+    if (cfg.mode == TM_SEQUENCE) {
+      if (seqReg == 0) {
+        Serial.println(F("% Mode 6 requires coil <base> and reg <n>"));
+        return;
+      }
+      if (cfg.coil + SEQ_COILS > NUM_COILS) {
+        Serial.print(F("% Coil base must be 0.."));
+        Serial.println(NUM_COILS - SEQ_COILS);
+        return;
+      }
+      if (regBlockTaken(F("program reg"), seqReg, SEQ_BLOCK_REGS, REGMAP_ID(REGMAP_SEQ, id - 1))) {
+        return;
+      }
+      if (!seq_reg_set(id - 1, seqReg)) {
+        Serial.print(F("% Invalid program reg (1.."));
+        Serial.print(NUM_REGS - SEQ_BLOCK_REGS);
+        Serial.println(F(")"));
+        return;
+      }
+    }
+
     if (!timers_config_set(id, cfg)) {
       Serial.println(F("% Could not set timer config"));
       return;
@@ -1740,6 +2740,40 @@ if (!strcmp(tok[0], "NO") && !strcmp(tok[1], "SET") && !strcmp(tok[2], "COIL") &
 
   // ---------------- COUNTER ----------------
   if (!strcmp(tok[1], "COUNTER")) {
+    // "set counter <id> compare reg:<n> sp1:<action>:<target> [sp2:<action>:<target>]" (v3.7.3)
+    if (ntok >= 4 && !strcasecmp(tok[3], "compare")) {
+      cmd_set_counter_compare(ntok, tok);
+      return;
+    }
+
+    // "set counter <id> gate pin:<p> [level:<high|low>]" / "window ms:<n> reg:<n>" (v3.7.7)
+    if (ntok >= 4 && !strcasecmp(tok[3], "gate")) {
+      cmd_set_counter_gatewin(ntok, tok, false);
+      return;
+    }
+    if (ntok >= 4 && !strcasecmp(tok[3], "window")) {
+      cmd_set_counter_gatewin(ntok, tok, true);
+      return;
+    }
+
+    // "set counter <id> rate reg:<n>" (v3.7.8)
+    if (ntok >= 4 && !strcasecmp(tok[3], "rate")) {
+      cmd_set_counter_rate(ntok, tok);
+      return;
+    }
+
+    // "set counter <id> retain [interval-s:<n>] [delta:<n>]" (v3.9.2)
+    if (ntok >= 4 && !strcasecmp(tok[3], "retain")) {
+      cmd_set_counter_retain(ntok, tok);
+      return;
+    }
+
+    // "set counter <id> edgelog reg:<n> depth:<1..64>" (v3.7.5)
+    if (ntok >= 4 && !strcasecmp(tok[3], "edgelog")) {
+      cmd_set_counter_edgelog(ntok, tok);
+      return;
+    }
+
     // "set counter <id> reset-on-read ENABLE/DISABLE"
     if (ntok >= 4 && !strcasecmp(tok[3], "reset-on-read")) {
       if (ntok < 5) {
@@ -1914,6 +2948,25 @@ if (!strcmp(tok[0], "NO") && !strcmp(tok[1], "SET") && !strcmp(tok[2], "COIL") &
     return;
   }
 
+  if (!strcmp(tok[1],"SLEEP")) {
+    if (ntok != 3) {
+      Serial.println(F("Usage: set sleep on|off"));
+      return;
+    }
+    if (!strcmp(tok[2],"ON")) {
+      idleSleepEnabled = true;
+      Serial.println(F("OK: idle sleep ON"));
+    }
+    else if (!strcmp(tok[2],"OFF")) {
+      idleSleepEnabled = false;
+      Serial.println(F("OK: idle sleep OFF"));
+    }
+    else {
+      Serial.println(F("% Invalid value (use on|off)"));
+    }
+    return;
+  }
+
   if (!strcmp(tok[1],"MODE")) {
     if (ntok != 3) {
       Serial.println(F("Usage: set mode server|monitor"));
@@ -1940,75 +2993,7 @@ if (!strcmp(tok[0], "NO") && !strcmp(tok[1], "SET") && !strcmp(tok[2], "COIL") &
 // ---------- Persistence ----------
 static void cmd_persist(const char* verb) {
   if (!strcmp(verb,"SAVE")) {
-    // Use global config to avoid stack overflow
-    memset(&globalConfig, 0, sizeof(globalConfig));
-    globalConfig.magic      = 0xC0DE;
-    globalConfig.schema     = 11;  // v11: GPIO mappings removed from persistence
-    globalConfig.reserved   = 0;
-    globalConfig.slaveId    = currentSlaveID;
-    globalConfig.serverFlag = serverRunning ? 1 : 0;
-    globalConfig.baud       = currentBaudrate;
-    globalConfig.timerStatusReg     = timerStatusRegIndex;
-    globalConfig.timerStatusCtrlReg = timerStatusCtrlRegIndex;
-
-    // Hostname
-    strncpy(globalConfig.hostname, cliHostname, sizeof(globalConfig.hostname));
-    globalConfig.hostname[sizeof(globalConfig.hostname)-1] = '\0';
-
-    // Counter control flags (will be saved by configSave())
-    for (uint8_t i = 0; i < 4; i++) {
-      globalConfig.counterResetOnReadEnable[i] = counterResetOnReadEnable[i];
-      globalConfig.counterAutoStartEnable[i] = counterAutoStartEnable[i];
-    }
-
-    // statiske maps
-    globalConfig.regStaticCount  = regStaticCount;
-    for (uint8_t i = 0; i < globalConfig.regStaticCount && i < MAX_STATIC_REGS; i++) {
-      globalConfig.regStaticAddr[i] = regStaticAddr[i];
-      globalConfig.regStaticVal [i] = regStaticVal [i];
-    }
-    globalConfig.coilStaticCount = coilStaticCount;
-    for (uint8_t i = 0; i < globalConfig.coilStaticCount && i < MAX_STATIC_COILS; i++) {
-      globalConfig.coilStaticIdx[i] = coilStaticIdx[i];
-      globalConfig.coilStaticVal[i] = coilStaticVal[i] ? 1 : 0;
-    }
-
-    // timere: gem og tæl kun enabled
-    globalConfig.timerCount = 0;
-    for (uint8_t i = 0; i < 4; i++) {
-      globalConfig.timer[i] = timers[i];
-      if (timers[i].enabled) globalConfig.timerCount++;
-
-      // Nulstil runtime-felter som IKKE skal gemmes
-      globalConfig.timer[i].active = 0;
-      globalConfig.timer[i].phase = 0;
-      globalConfig.timer[i].phaseStartMs = 0;
-      globalConfig.timer[i].lastTrigLevel = 0;
-      globalConfig.timer[i].alarm = 0;
-      globalConfig.timer[i].alarmCode = 0;
-      globalConfig.timer[i].lastDurationMs = 0;
-    }
-
-    // Counters: gem og tæl kun enabled
-    globalConfig.counterCount = 0;
-    for (uint8_t i = 0; i < 4; i++) {
-      globalConfig.counter[i] = counters[i];
-      if (counters[i].enabled) globalConfig.counterCount++;
-
-      // Nulstil runtime-felter som IKKE skal gemmes
-      globalConfig.counter[i].counterValue = globalConfig.counter[i].startValue;
-      globalConfig.counter[i].edgeCount = 0;
-      globalConfig.counter[i].overflowFlag = 0;
-      globalConfig.counter[i].lastLevel = 0;
-      globalConfig.counter[i].lastEdgeMs = 0;
-      globalConfig.counter[i].lastCountForFreq = 0;
-      globalConfig.counter[i].lastFreqCalcMs = 0;
-      globalConfig.counter[i].currentFreqHz = 0;
-    }
-
-    // NOTE: GPIO mappings no longer saved (v3.3.1)
-    // HW counters auto-map their pins, static mappings are runtime-only
-
+    configCaptureBase(globalConfig);
     if (configSave(globalConfig)) Serial.println(F("OK: config saved to EEPROM"));
     else                          Serial.println(F("% Save failed"));
     return;
@@ -2038,6 +3023,53 @@ static void cmd_persist(const char* verb) {
   }
 }
 
+// ---------- Config-profiler (v3.9.6) ----------
+static void print_profile_result(uint8_t st, uint8_t no) {
+  switch (st) {
+    case PROFILE_ST_OK:       Serial.print(F("OK: profile ")); Serial.println(no); break;
+    case PROFILE_ST_EMPTY:    Serial.println(F("% No such profile (see 'show profiles')")); break;
+    case PROFILE_ST_INVALID:  Serial.println(F("% Profile image invalid - running config unchanged")); break;
+    case PROFILE_ST_RANGE:
+      Serial.print(F("% Profile number must be 1..")); Serial.println(PROFILE_MAX);
+      break;
+    case PROFILE_ST_FULL:     Serial.println(F("% Not enough profile space (delete a profile first)")); break;
+    default:                  Serial.println(F("% Profile EEPROM write/verify failed")); break;
+  }
+}
+
+// profile save <n> [name:<text>] | profile load <n> | profile delete <n>
+static void cmd_profile(uint8_t ntok, char* tok[]) {
+  if (ntok < 3) {
+    Serial.println(F("Usage: profile save <n> [name:<text>] | profile load <n> | profile delete <n>"));
+    return;
+  }
+  uint8_t no = (uint8_t)strtoul(tok[2], nullptr, 10);
+
+  if (!strcmp(tok[1], "SAVE")) {
+    const char* name = nullptr;
+    if (ntok >= 4 && !strncasecmp(tok[3], "name:", 5)) name = tok[3] + 5;
+    configCaptureBase(globalConfig);
+    configCapture(globalConfig);
+    uint8_t st = profile_save(no, name, globalConfig);
+    if (st == PROFILE_ST_OK) eeprom_print_last_write();
+    print_profile_result(st, no);
+    return;
+  }
+  if (!strcmp(tok[1], "LOAD")) {
+    print_profile_result(profile_apply(no, false), no);
+    return;
+  }
+  if (!strcmp(tok[1], "DELETE")) {
+    if (!profile_delete(no)) {
+      print_profile_result(PROFILE_ST_EMPTY, no);
+      return;
+    }
+    Serial.print(F("Profile ")); Serial.print(no); Serial.println(F(" deleted"));
+    return;
+  }
+  Serial.println(F("% Unknown 'profile' command (save|load|delete)"));
+}
+
 // ---------- Help ----------
 // ---------- Contextual help functions ----------
 static void help_counters() {
@@ -2049,9 +3081,40 @@ static void help_counters() {
   Serial.println(F("   start-value:<n> res|resolution:<8|16|32|64> prescaler:<1|4|8|16|64|256|1024>"));
   Serial.println(F("   index-reg:<reg> raw-reg:<reg> freq-reg:<reg> ctrl-reg:<reg> overload-reg:<reg>"));
   Serial.println(F("   input-dis:<di_idx> direction:<up|down> scale:<float>"));
-  Serial.println(F("   debounce:<on|off> [debounce-ms:<ms>]"));
+  Serial.println(F("   debounce:<on|off> [debounce-ms:<ms>] filter-us:<0..65535>"));
+  Serial.println(F("   - Input level must be stable for filter-us (or debounce-ms) before it counts"));
   Serial.println(F("   hw-mode:<sw|sw-isr|hw-t5> [polling|interrupt|hardware mode]"));
   Serial.println(F("   interrupt-pin:<2|3|18|19|20|21> [required for sw-isr mode]"));
+  Serial.println(F("   pwm-reg:<reg> [pwm-avg:<1..64>] [pwm-timeout-ms:<n>] [sw-isr only, 0 = off]"));
+  Serial.println(F("   - PWM block: +0/1 high us, +2/3 low us, +4/5 period us, +6 duty 0.01%,"));
+  Serial.println(F("     +7 status (bit0 valid, bit1 stale, bit2 level). freq-reg from period"));
+  Serial.println(F(" set counter <id> compare reg:<n> sp1:<action>:<target> [sp2:<action>:<target>]"));
+  Serial.println(F("   - action: coil-set|coil-clear|gpio-high|gpio-low|timer|none"));
+  Serial.println(F("   - regs: n+0/1 = sp1 (LSW/MSW), n+2/3 = sp2, n+4 = latch (write 0 to clear)"));
+  Serial.println(F(" no set counter <id> compare"));
+  Serial.println(F(" set counter <id> gate pin:<p> [level:<high|low>]"));
+  Serial.println(F("   - Count only while gate pin is at active level (not hw-mode)"));
+  Serial.println(F(" set counter <id> window ms:<1..60000> reg:<n>"));
+  Serial.println(F("   - Latch edges per window (Timer4 bounded): n+0/1 = count LSW/MSW, n+2 = seq"));
+  Serial.println(F(" no set counter <id> gate|window"));
+  Serial.println(F(" set counter <id> rate reg:<n>  (max 2 counters)"));
+  Serial.println(F("   - n+0/1 = pulses last 60 s, n+2/3 = pulses last 3600 s, n+4..7 = lifetime total"));
+  Serial.println(F(" no set counter <id> rate"));
+  Serial.println(F(" set counter <id> retain [interval-s:<n>] [delta:<n>]"));
+  Serial.println(F("   - Keep value over power loss: checkpoint to EEPROM ring when changed and"));
+  Serial.println(F("     interval-s elapsed or value moved delta (default interval-s:60)"));
+  Serial.println(F(" no set counter <id> retain"));
+  Serial.println(F(" set counter <id> edgelog reg:<n> depth:<1..64>"));
+  Serial.println(F("   - Ring of us timestamps: n+0 = head (edges logged), n+1+2*k = slot k LSW/MSW"));
+  Serial.println(F("   - Edge #h is in slot (h-1) % depth; valid edges are (head-depth, head]"));
+  Serial.println(F(" no set counter <id> edgelog"));
+  Serial.println(F(" set counters snapshot-reg:<n> [snapshot-pin:<0|2|3|20|21>]"));
+  Serial.println(F("   - Atomic latch of all counters: n+0 ctrl (bit0=latch), n+1 seq, n+2/3 us,"));
+  Serial.println(F("     n+4+3*i = counter i+1 value LSW/MSW + freq. Broadcast write latches all slaves"));
+  Serial.println(F(" set counters snapshot:latch      - latch snapshot now"));
+  Serial.println(F(" set counters sampler-hz:<0|1000..20000>"));
+  Serial.println(F("   - Sample GPIO-mapped polling counters in a timer ISR (0 = loop polling)"));
+  Serial.println(F("   - Guaranteed max input frequency = rate/2 (FC04 input-reg 96..98)"));
   Serial.println();
   Serial.println(F(" Control:"));
   Serial.println(F(" set counter <id> reset-on-read ENABLE|DISABLE"));
@@ -2059,7 +3122,8 @@ static void help_counters() {
   Serial.println(F(" set counter <id> start ENABLE|DISABLE"));
   Serial.println(F("   - Enable/disable counter auto-start on boot"));
   Serial.println(F(" no set counter <id>         - remove counter from configuration"));
-  Serial.println(F(" reset counter <id>          - reset selected counter"));
+  Serial.println(F(" reset counter <id>          - reset selected counter (totalizer keeps counting)"));
+  Serial.println(F(" reset counter <id> total    - reset lifetime totalizer only"));
   Serial.println(F(" clear counters              - reset all counters and overflow flags"));
   Serial.println();
   Serial.println(F(" -- Bitmask controlReg (counter): --"));
@@ -2095,9 +3159,18 @@ static void help_counters() {
 static void help_timers() {
   Serial.println(F("=== TIMERS ==="));
   Serial.println(F(" show timers                         - show active timer mappings/status"));
+  Serial.println(F(" show timers stats                   - lateness per timer: min/mean/max + log2 histogram"));
+  Serial.println(F(" reset timers stats                  - clear lateness statistics and diag max values"));
   Serial.println();
   Serial.println(F(" set timer <id> mode <1|2|3|4> parameter P1:<high|low> P2:<high|low> [P3:<high|low>]"));
   Serial.println(F("   T1 <ms> [T2 <ms>] [T3 <ms>] coil <idx> [trigger <di_idx> edge rising|falling|both sub <1|2|3>]"));
+  Serial.println(F(" set timer <id> params reg:<n>        - bind T1..T3/P1..P3 to regs n..n+6 (0 = off)"));
+  Serial.println(F(" set timer <id> trigger pin:<p>       - mode 4 start from INT/PCINT edge isr (0 = poll input)"));
+  Serial.println(F(" set timer <id> mode 5 parameter pin <12|13> reg <n>"));
+  Serial.println(F("   - Timer1 waveform: regs n..n+7 = cmd, Hz, duty permille, N, width us LSW/MSW, remain, status"));
+  Serial.println(F(" set timer <id> mode 6 parameter coil <base> reg <n>"));
+  Serial.println(F("   - Step program on coils base..base+7: n=control (1 start/0 stop), n+1=step, n+2=N"));
+  Serial.println(F("     step k at n+3+3k: mask|levels<<8, ms or input, next|wait<<8 (0 ms,1 high,2 low,3 end)"));
   Serial.println();
   Serial.println(F(" set timers status-reg:<n>"));
   Serial.println(F("   - Configure global status register (shows timer states)"));
@@ -2112,11 +3185,15 @@ static void help_timers() {
   Serial.println(F("  2 = Monostable (retriggerable pulse)"));
   Serial.println(F("  3 = Astable (blink/toggle)"));
   Serial.println(F("  4 = Input-triggered (responds to discrete inputs)"));
+  Serial.println(F("  5 = Hardware waveform (PWM, us pulse, N pulses at F Hz on pin 12/13)"));
+  Serial.println(F("  6 = Step program (up to 32 steps, time or input waits, uploaded via FC16)"));
   Serial.println();
   Serial.println(F(" Examples:"));
   Serial.println(F("  set timer 1 mode 1 parameter P1:low P2:high P3:low T1 1000 T2 500 T3 1000 coil 5"));
   Serial.println(F("  set timer 3 mode 3 parameter P1:low P2:high T1 300 T2 700 coil 10"));
   Serial.println(F("  set timer 4 mode 4 parameter P1:low P2:high T1 200 T2 300 coil 15 trigger 12 edge rising sub 1"));
+  Serial.println(F("  set timer 2 mode 5 parameter pin 12 reg 120"));
+  Serial.println(F("  set timer 3 mode 6 parameter coil 20 reg 40"));
 }
 
 static void help_regs_coils_inputs() {
@@ -2166,11 +3243,20 @@ static void help_system() {
   Serial.println(F(" save                    - save configuration to EEPROM"));
   Serial.println(F(" load                    - load configuration from EEPROM"));
   Serial.println(F(" defaults                - reset to default configuration"));
+  Serial.println(F(" show eeprom             - config slots A/B (seq, CRC) and last save"));
+  Serial.println(F(" show config dump        - full config image (last loaded/saved)"));
+  Serial.println();
+  Serial.println(F(" profile save <n> [name:<text>] - store running config as profile n"));
+  Serial.println(F(" profile load <n>        - hot-apply profile n (boot config unchanged)"));
+  Serial.println(F(" profile delete <n>      - remove profile n"));
+  Serial.println(F(" show profiles           - stored profiles, free space, active profile"));
+  Serial.println(F(" set profile reg:<n>     - select/active/status holding regs (0=off)"));
   Serial.println();
   Serial.println(F(" set id <n>              - set Modbus slave ID (0=all, 1..247)"));
   Serial.println(F(" set baud <n>            - set Modbus baudrate (e.g. 9600, 19200)"));
   Serial.println(F(" set server on|off       - enable/disable Modbus server"));
   Serial.println(F(" set mode server|monitor - toggle server/monitor mode"));
+  Serial.println(F(" set sleep on|off        - idle sleep when nothing is due"));
   Serial.println();
   Serial.println(F(" reboot                  - restart system (software reset)"));
   Serial.println();
@@ -2223,8 +3309,8 @@ static void cmd_help(uint8_t ntok, char* tok[]) {
 
 // ---------- Counter helper commands ----------
 static void cmd_reset_counter(uint8_t ntok, char* tok[]) {
-  if (ntok != 3) {
-    Serial.println(F("Usage: reset counter <id>"));
+  if (ntok != 3 && !(ntok == 4 && !strcmp(tok[3], "TOTAL"))) {
+    Serial.println(F("Usage: reset counter <id> [total]"));
     return;
   }
   uint8_t id = (uint8_t)strtoul(tok[2], nullptr, 10);
@@ -2232,10 +3318,29 @@ static void cmd_reset_counter(uint8_t ntok, char* tok[]) {
     Serial.println(F("% Invalid counter id (1..4)"));
     return;
   }
+  // "reset counter <id> total" - nulstil kun lifetime totalizer (v3.7.8)
+  if (ntok == 4) {
+    if (counterRateReg[id - 1] == 0) {
+      Serial.println(F("% Counter has no rate/totalizer (set counter <id> rate reg:<n>)"));
+      return;
+    }
+    rate_total_reset(id - 1);
+    Serial.print(F("Counter ")); Serial.print(id); Serial.println(F(" totalizer reset"));
+    return;
+  }
   counters_reset(id);
   Serial.print(F("Counter ")); Serial.print(id); Serial.println(F(" reset"));
 }
 
+static void cmd_reset_timers(uint8_t ntok, char* tok[]) {
+  if (ntok != 3 || strcmp(tok[2], "STATS")) {
+    Serial.println(F("Usage: reset timers stats"));
+    return;
+  }
+  timers_stats_reset();
+  Serial.println(F("Timer lateness statistics reset"));
+}
+
 static void cmd_clear_counters(uint8_t ntok, char* tok[]) {
   if (ntok != 2 || strcmp("COUNTERS", tok[1])) {
     Serial.println(F("Usage: clear counters"));
@@ -2286,7 +3391,15 @@ static void cmd_gpio(uint8_t ntok, char* tok[]) {
       Serial.println(F("% GPIO pin out of range (0..53)"));
       return;
     }
+    if (wave_uses_pin(pin)) {
+      Serial.println(F("% Pin is used as timer waveform output"));
+      return;
+    }
     if (!strcmp(tok[3],"COIL")) {
+      if (trig_uses_pin(pin)) {
+        Serial.println(F("% Pin is used as timer trigger input"));
+        return;
+      }
       uint16_t idx = (uint16_t)strtoul(tok[4], nullptr, 10);
       if (idx >= NUM_COILS) {
         Serial.println(F("% Coil index out of range"));
@@ -2294,7 +3407,8 @@ static void cmd_gpio(uint8_t ntok, char* tok[]) {
       }
       gpioToCoil[pin]  = (int16_t)idx;
       gpioToInput[pin] = -1;
-      pinMode(pin, INPUT);
+      counters_poll_plan_rebuild();
+      gpio_plan_rebuild();           // pin -> OUTPUT + mirror-plan
       Serial.print(F("OK: pin ")); Serial.print(pin); Serial.print(F(" mapped to COIL "));
       Serial.println(idx);
       return;
@@ -2308,6 +3422,8 @@ static void cmd_gpio(uint8_t ntok, char* tok[]) {
       gpioToInput[pin] = (int16_t)idx;
       gpioToCoil[pin]  = -1;
       pinMode(pin, INPUT);
+      counters_poll_plan_rebuild();
+      gpio_plan_rebuild();
       Serial.print(F("OK: pin ")); Serial.print(pin); Serial.print(F(" mapped to INPUT "));
       Serial.println(idx);
       return;
@@ -2326,8 +3442,11 @@ static void cmd_gpio(uint8_t ntok, char* tok[]) {
       Serial.println(F("% GPIO pin out of range (0..53)"));
       return;
     }
+    if (gpioToCoil[pin] >= 0) pinMode(pin, INPUT);   // stop med at drive pin'en
     gpioToCoil[pin]  = -1;
     gpioToInput[pin] = -1;
+    counters_poll_plan_rebuild();
+    gpio_plan_rebuild();
     Serial.print(F("OK: pin ")); Serial.print(pin); Serial.println(F(" unmapped"));
     return;
   }
@@ -2509,12 +3628,16 @@ void cli_loop() {
         cmd_persist(tok[0]);
       }
       else if (!strcmp(tok[0],"GPIO"))             cmd_gpio(ntok, tok);
+      else if (!strcmp(tok[0],"PROFILE"))          cmd_profile(ntok, tok);
       else if (!strcmp(tok[0],"RESET") && ntok >= 2 && !strcmp(tok[1],"COUNTER")) {
         cmd_reset_counter(ntok, tok);
       }
       else if (!strcmp(tok[0],"CLEAR") && ntok >= 2 && !strcmp(tok[1],"COUNTERS")) {
         cmd_clear_counters(ntok, tok);
       }
+      else if (!strcmp(tok[0],"RESET") && ntok >= 2 && !strcmp(tok[1],"TIMERS")) {
+        cmd_reset_timers(ntok, tok);
+      }
       else if (!strcmp(tok[0],"REBOOT")) {
         Serial.println(F("System rebooting..."));
         delay(100);
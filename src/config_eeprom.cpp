@@ -0,0 +1,341 @@
+// ============================================================================
+//  Filnavn : config_eeprom.cpp
+//  Projekt  : Modbus RTU Server / CLI
+//  Version  : v3.9.6 (2026-10-18)
+//  Forfatter: JanG at modbus_slave@laces.dk
+//  Formål   : Differentiel EEPROM-skrivning og A/B journal-slots
+//             (se config_eeprom.h)
+// ============================================================================
+
+#include "config_eeprom.h"
+#include <avr/eeprom.h>
+#include <util/crc16.h>
+
+static int8_t   slotActive = -1;    // nyeste gyldige slot efter scan/write
+static uint16_t slotSeq    = 0;
+static bool     slotScanned = false;
+
+// Igangværende streaming-skrivning
+static int8_t   wrSlot = -1;        // journal-slot (-1 = andet mål, fx profil)
+static bool     wrOpen = false;
+static bool     wrDry  = false;     // kun længde + CRC, intet skrives
+static uint16_t wrAddr = 0;         // image-start i EEPROM
+static uint16_t wrMax  = 0;
+static uint16_t wrLen  = 0;
+static uint16_t wrCrc  = 0;         // CRC over appendede data (fra RAM)
+static bool     wrOverflow = false;
+static bool     wrStep = false;     // trinvis: højst én ændret byte pr. stream
+static bool     wrHalt = false;     // trinvis: byte programmeret, resten kun talt
+
+// Trinvis journal-skrivning (udskudt save): slot beholdes mellem trin
+static int8_t   stSlot = -1;
+
+EepromWriteStats eepromLastWrite = {0, 0, 0};
+
+void eeprom_stats_begin() {
+  eepromLastWrite.compared  = 0;
+  eepromLastWrite.written   = 0;
+  eepromLastWrite.elapsedUs = 0;
+}
+
+uint16_t eeprom_write_diff(uint16_t addr, const void* data, uint16_t len) {
+  const uint8_t* src = static_cast<const uint8_t*>(data);
+  uint8_t* dst = reinterpret_cast<uint8_t*>(addr);
+  unsigned long t0 = micros();
+  uint16_t written = 0;
+
+  for (uint16_t i = 0; i < len; ++i) {
+    // eeprom_read_byte venter selv på en igangværende skrivning
+    if (eeprom_read_byte(dst + i) != src[i]) {
+      eeprom_write_byte(dst + i, src[i]);
+      written++;
+    }
+  }
+  eeprom_busy_wait();             // sidste byte færdig før tiden tages
+
+  eepromLastWrite.compared  += len;
+  eepromLastWrite.written   += written;
+  eepromLastWrite.elapsedUs += micros() - t0;
+  return written;
+}
+
+// Programmér første byte der afviger (højst én); true hvis en blev skrevet.
+// Kræver eeprom_is_ready() - kaldes kun i et trin der startede klar.
+static bool eeprom_write_first_diff(uint16_t addr, const void* data, uint16_t len) {
+  const uint8_t* src = static_cast<const uint8_t*>(data);
+  uint8_t* dst = reinterpret_cast<uint8_t*>(addr);
+  for (uint16_t i = 0; i < len; ++i) {
+    if (eeprom_read_byte(dst + i) != src[i]) {
+      eeprom_write_byte(dst + i, src[i]);
+      eepromLastWrite.written++;
+      return true;
+    }
+  }
+  return false;
+}
+
+void eeprom_print_last_write() {
+  Serial.print(F("EEPROM: "));
+  Serial.print(eepromLastWrite.written);
+  Serial.print(F("/"));
+  Serial.print(eepromLastWrite.compared);
+  Serial.print(F(" bytes written in "));
+  Serial.print(eepromLastWrite.elapsedUs / 1000UL);
+  Serial.print(F("."));
+  uint16_t frac = (uint16_t)((eepromLastWrite.elapsedUs % 1000UL) / 100UL);
+  Serial.print(frac);
+  Serial.println(F(" ms"));
+}
+
+uint16_t eeprom_crc16(uint16_t crc, uint16_t addr, uint16_t len) {
+  const uint8_t* p = reinterpret_cast<const uint8_t*>(addr);
+  for (uint16_t i = 0; i < len; ++i) {
+    crc = _crc16_update(crc, eeprom_read_byte(p + i));
+  }
+  return crc;
+}
+
+// ============================================================================
+// Streaming
+// ============================================================================
+void eeprom_stream_begin(uint16_t addr, uint16_t maxLen, bool dryRun) {
+  wrOpen = true;
+  wrDry  = dryRun;
+  wrAddr = addr;
+  wrMax  = maxLen;
+  wrLen  = 0;
+  wrCrc  = 0xFFFF;
+  wrOverflow = false;
+  wrStep = false;
+  wrHalt = false;
+}
+
+bool eeprom_stream_append(const void* data, uint16_t len) {
+  if (!wrOpen || wrOverflow) return false;
+  if ((uint32_t)wrLen + len > wrMax) {
+    wrOverflow = true;
+    return false;
+  }
+  if (wrStep) {
+    if (!wrHalt) wrHalt = eeprom_write_first_diff(wrAddr + wrLen, data, len);
+  } else if (!wrDry) {
+    eeprom_write_diff(wrAddr + wrLen, data, len);
+  }
+  const uint8_t* src = static_cast<const uint8_t*>(data);
+  for (uint16_t i = 0; i < len; ++i) wrCrc = _crc16_update(wrCrc, src[i]);
+  wrLen += len;
+  return true;
+}
+
+bool eeprom_stream_end(uint16_t& len, uint16_t& crc) {
+  wrOpen = false;
+  len = wrLen;
+  crc = wrCrc;
+  return !wrOverflow;
+}
+
+// ============================================================================
+// Journal-slots
+// ============================================================================
+static uint16_t slot_addr(uint8_t slot) {
+  return (uint16_t)(EEPROM_SLOT_BASE + (uint16_t)slot * EEPROM_SLOT_SIZE);
+}
+
+static void slot_header(uint8_t slot, EepromSlotHeader& h) {
+  eeprom_read_block(&h, reinterpret_cast<const void*>(slot_addr(slot)), sizeof(h));
+}
+
+static uint16_t crc_word(uint16_t crc, uint16_t w) {
+  crc = _crc16_update(crc, (uint8_t)(w & 0xFF));
+  return _crc16_update(crc, (uint8_t)(w >> 8));
+}
+
+// CRC16 direkte over EEPROM-bytes (ingen RAM-buffer til image)
+static uint16_t image_crc(uint16_t crc, uint8_t slot, uint16_t len) {
+  return eeprom_crc16(crc, slot_addr(slot) + sizeof(EepromSlotHeader), len);
+}
+
+static uint16_t slot_crc(uint8_t slot, uint16_t seq, uint16_t len) {
+  uint16_t crc = 0xFFFF;
+  crc = crc_word(crc, seq);
+  crc = crc_word(crc, len);
+  return image_crc(crc, slot, len);
+}
+
+static bool slot_valid(uint8_t slot, EepromSlotHeader& h) {
+  slot_header(slot, h);
+  if (h.magic != EEPROM_SLOT_MAGIC) return false;
+  if (h.len == 0 || h.len > EEPROM_SLOT_PAYLOAD) return false;
+  return slot_crc(slot, h.seq, h.len) == h.crc;
+}
+
+int8_t eeprom_slot_scan() {
+  slotActive = -1;
+  slotSeq = 0;
+  for (uint8_t s = 0; s < EEPROM_SLOT_COUNT; ++s) {
+    EepromSlotHeader h;
+    if (!slot_valid(s, h)) continue;
+    // Wrap-sikker: nyere hvis forskellen er positiv som int16
+    if (slotActive < 0 || (int16_t)(h.seq - slotSeq) > 0) {
+      slotActive = (int8_t)s;
+      slotSeq = h.seq;
+    }
+  }
+  slotScanned = true;
+  return slotActive;
+}
+
+bool eeprom_slot_read(uint8_t slot, void* dst, uint16_t maxLen, uint16_t& len) {
+  len = 0;
+  if (slot >= EEPROM_SLOT_COUNT) return false;
+  EepromSlotHeader h;
+  if (!slot_valid(slot, h)) return false;
+  uint16_t n = (h.len < maxLen) ? h.len : maxLen;
+  eeprom_read_block(dst, reinterpret_cast<const void*>(slot_addr(slot) + sizeof(EepromSlotHeader)), n);
+  if (n < maxLen) memset(static_cast<uint8_t*>(dst) + n, 0, maxLen - n);
+  len = h.len;
+  return true;
+}
+
+bool eeprom_slot_info(uint8_t slot, uint16_t& addr, uint16_t& len) {
+  addr = 0;
+  len = 0;
+  if (slot >= EEPROM_SLOT_COUNT) return false;
+  EepromSlotHeader h;
+  if (!slot_valid(slot, h)) return false;
+  addr = slot_addr(slot) + sizeof(EepromSlotHeader);
+  len = h.len;
+  return true;
+}
+
+int8_t eeprom_slot_begin() {
+  if (!slotScanned) eeprom_slot_scan();
+  // Inaktiv slot; uden gyldig slot bruges B, så et legacy-image på
+  // offset 0 overlever indtil den nye slot er komplet.
+  wrSlot = (slotActive == 1) ? 0 : 1;
+  eeprom_stream_begin(slot_addr((uint8_t)wrSlot) + sizeof(EepromSlotHeader), EEPROM_SLOT_PAYLOAD);
+  return wrSlot;
+}
+
+bool eeprom_slot_append(const void* data, uint16_t len) {
+  return wrSlot >= 0 && eeprom_stream_append(data, len);
+}
+
+int8_t eeprom_slot_commit() {
+  int8_t slot = wrSlot;
+  wrSlot = -1;
+  uint16_t len, crc;
+  bool ok = eeprom_stream_end(len, crc);
+  if (slot < 0 || !ok || len == 0) return -1;
+
+  EepromSlotHeader h;
+  h.magic = EEPROM_SLOT_MAGIC;
+  h.seq   = (uint16_t)(slotSeq + 1);
+  h.len   = len;
+
+  // Image er skrevet - headeren gør slotten gyldig og skrives til sidst
+  h.crc = slot_crc((uint8_t)slot, h.seq, len);
+  eeprom_write_diff(slot_addr((uint8_t)slot), &h, sizeof(h));
+
+  // Verificér ud fra det faktisk lagrede image
+  EepromSlotHeader v;
+  if (!slot_valid((uint8_t)slot, v) || v.seq != h.seq) return -1;
+
+  // Lagret image skal give samme CRC som de data der blev appendet
+  if (image_crc(0xFFFF, (uint8_t)slot, len) != crc) return -1;
+
+  slotActive = slot;
+  slotSeq = h.seq;
+  return slot;
+}
+
+// ============================================================================
+// Trinvis journal-skrivning (udskudt save)
+// ============================================================================
+bool eeprom_slot_step_begin() {
+  if (!eeprom_is_ready()) return false;
+  if (!slotScanned) eeprom_slot_scan();
+  if (stSlot < 0) stSlot = (slotActive == 1) ? 0 : 1;
+  wrSlot = stSlot;
+  eeprom_stream_begin(slot_addr((uint8_t)stSlot) + sizeof(EepromSlotHeader), EEPROM_SLOT_PAYLOAD);
+  wrStep = true;
+  return true;
+}
+
+int8_t eeprom_slot_step_end() {
+  int8_t slot = stSlot;
+  bool halted = wrHalt;
+  wrSlot = -1;
+  uint16_t len, crc;
+  bool ok = eeprom_stream_end(len, crc);
+  if (slot < 0) return -1;
+  if (!ok || len == 0) {
+    stSlot = -1;
+    return ok ? -1 : -2;
+  }
+  if (halted) return EEPROM_STEP_MORE;
+
+  // Hele image stemmer med data i dette trin (crc er derfor også
+  // image-CRC'en); headeren programmeres nu byte for byte
+  EepromSlotHeader h;
+  h.magic = EEPROM_SLOT_MAGIC;
+  h.seq   = (uint16_t)(slotSeq + 1);
+  h.len   = len;
+  h.crc   = slot_crc((uint8_t)slot, h.seq, len);
+  if (eeprom_write_first_diff(slot_addr((uint8_t)slot), &h, sizeof(h))) return EEPROM_STEP_MORE;
+
+  stSlot = -1;
+  EepromSlotHeader v;
+  if (!slot_valid((uint8_t)slot, v) || v.seq != h.seq) return -1;
+  if (image_crc(0xFFFF, (uint8_t)slot, len) != crc) return -1;
+  slotActive = slot;
+  slotSeq = h.seq;
+  return slot;
+}
+
+void eeprom_slot_step_cancel() {
+  stSlot = -1;
+}
+
+int8_t eeprom_slot_write(const void* data, uint16_t len) {
+  if (len == 0 || len > EEPROM_SLOT_PAYLOAD) return -1;
+  eeprom_slot_begin();
+  eeprom_slot_append(data, len);
+  return eeprom_slot_commit();
+}
+
+int8_t eeprom_slot_active() {
+  if (!slotScanned) eeprom_slot_scan();
+  return slotActive;
+}
+
+uint16_t eeprom_slot_seq() {
+  if (!slotScanned) eeprom_slot_scan();
+  return slotSeq;
+}
+
+void eeprom_print_status() {
+  Serial.println(F("=== EEPROM ==="));
+  for (uint8_t s = 0; s < EEPROM_SLOT_COUNT; ++s) {
+    EepromSlotHeader h;
+    bool ok = slot_valid(s, h);
+    Serial.print(F("Slot "));
+    Serial.print((char)('A' + s));
+    Serial.print(F(" @"));
+    Serial.print(slot_addr(s));
+    Serial.print(F(": "));
+    if (!ok) {
+      Serial.println(h.magic == EEPROM_SLOT_MAGIC ? F("CRC error") : F("empty"));
+      continue;
+    }
+    Serial.print(F("seq="));
+    Serial.print(h.seq);
+    Serial.print(F(" len="));
+    Serial.print(h.len);
+    Serial.print(F(" crc=0x"));
+    Serial.print(h.crc, HEX);
+    if (s == (uint8_t)eeprom_slot_active()) Serial.print(F(" (active)"));
+    Serial.println();
+  }
+  if (eepromLastWrite.compared > 0) eeprom_print_last_write();
+}
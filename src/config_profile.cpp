@@ -0,0 +1,377 @@
+// ============================================================================
+//  Filnavn : config_profile.cpp
+//  Projekt  : Modbus RTU Server / CLI
+//  Version  : v3.9.6 (2026-10-18)
+//  Forfatter: JanG at modbus_slave@laces.dk
+//  Formål   : Navngivne config-profiler i EEPROM (se config_profile.h).
+//             Profil-tabellen bygges ved første brug ved at scanne siderne.
+//  Ændringer:
+//    - v3.9.6: Reg-blok må ikke overlappe andre features (regmap_owner)
+//    - v3.9.6: Save genbruger den gamle kopis sider og pakker profilerne
+//              når der ikke er plads til to kopier; select med bit15 gemmer
+//              boot-config udskudt (configSaveDeferred) i stedet for
+//              synkront fra modbusLoop
+// ============================================================================
+
+#include "config_profile.h"
+#include "config_eeprom.h"
+#include "config_tlv.h"
+#include "modbus_regmap.h"
+#include <avr/eeprom.h>
+#include <util/crc16.h>
+#include <stddef.h>
+#include <string.h>
+
+uint16_t profileReg    = 0;
+uint8_t  profileActive = 0;
+
+struct ProfileAreaHeader {
+  uint16_t magic;               // PROFILE_AREA_MAGIC
+  uint8_t  pageSize;
+  uint8_t  pages;
+};
+
+static_assert(PROFILE_PAGES >= 1 && PROFILE_PAGES <= 32, "profil-område: 1..32 sider");
+static_assert(sizeof(ProfileHeader) < PROFILE_PAGE_SIZE, "ProfileHeader > side");
+
+// Nyeste gyldige version pr. profil-nr (page 0xFF = ingen)
+struct ProfileSlot {
+  uint8_t  page;
+  uint8_t  pages;
+  uint16_t seq;
+};
+
+static ProfileSlot tab[PROFILE_MAX];
+static bool     tabScanned = false;
+static uint16_t nextSeq = 0;
+static uint8_t  profileStatus = PROFILE_ST_NONE;
+
+// ============================================================================
+// Hjælpere
+// ============================================================================
+static uint16_t page_addr(uint8_t page) {
+  return PROFILE_AREA_BASE + PROFILE_AREA_HDR + (uint16_t)page * PROFILE_PAGE_SIZE;
+}
+
+// Wrap-sikker: a er nyere end b
+static inline bool seq_newer(uint16_t a, uint16_t b) {
+  return (int16_t)(a - b) > 0;
+}
+
+// crc16 over image (imgCrc, fortsat) og header-felter før crc
+static uint16_t hdr_crc(const ProfileHeader& h, uint16_t imgCrc) {
+  const uint8_t* p = reinterpret_cast<const uint8_t*>(&h);
+  for (uint8_t i = 0; i < offsetof(ProfileHeader, crc); ++i) imgCrc = _crc16_update(imgCrc, p[i]);
+  return imgCrc;
+}
+
+static bool hdr_read(uint8_t page, ProfileHeader& h) {
+  eeprom_read_block(&h, reinterpret_cast<const void*>(page_addr(page)), sizeof(h));
+  if (h.magic != PROFILE_MAGIC || h.no < 1 || h.no > PROFILE_MAX) return false;
+  if (h.pages == 0 || (uint16_t)page + h.pages > PROFILE_PAGES) return false;
+  if (sizeof(h) + (uint32_t)h.len > (uint16_t)h.pages * PROFILE_PAGE_SIZE) return false;
+  uint16_t crc = eeprom_crc16(0xFFFF, page_addr(page) + sizeof(h), h.len);
+  return hdr_crc(h, crc) == h.crc;
+}
+
+// Header ugyldiggøres ved at nulstille magic (én skrivning)
+static void hdr_kill(uint8_t page) {
+  uint16_t zero = 0;
+  eeprom_write_diff(page_addr(page), &zero, sizeof(zero));
+}
+
+static void profile_scan() {
+  for (uint8_t i = 0; i < PROFILE_MAX; ++i) tab[i].page = 0xFF;
+  tabScanned = true;
+  if (!profile_area_formatted()) return;
+
+  bool any = false;
+  uint8_t p = 0;
+  while (p < PROFILE_PAGES) {
+    ProfileHeader h;
+    if (!hdr_read(p, h)) {
+      p++;
+      continue;
+    }
+    ProfileSlot& s = tab[h.no - 1];
+    if (s.page == 0xFF || seq_newer(h.seq, s.seq)) {
+      s.page  = p;
+      s.pages = h.pages;
+      s.seq   = h.seq;
+    }
+    if (!any || seq_newer(h.seq, nextSeq)) nextSeq = h.seq;
+    any = true;
+    p += h.pages;
+  }
+  if (any) nextSeq++;
+}
+
+static void scan_once() {
+  if (!tabScanned) profile_scan();
+}
+
+// Bitmaske over sider i brug af gyldige profiler
+static uint32_t used_pages() {
+  uint32_t used = 0;
+  for (uint8_t i = 0; i < PROFILE_MAX; ++i) {
+    if (tab[i].page == 0xFF) continue;
+    for (uint8_t k = 0; k < tab[i].pages; ++k) used |= 1UL << (tab[i].page + k);
+  }
+  return used;
+}
+
+// Første frie sidespænd på need sider (-1 = ingen plads)
+static int8_t find_free(uint8_t need) {
+  uint32_t used = used_pages();
+  uint8_t run = 0;
+  for (uint8_t p = 0; p < PROFILE_PAGES; ++p) {
+    run = (used & (1UL << p)) ? 0 : (uint8_t)(run + 1);
+    if (run == need) return (int8_t)(p + 1 - need);
+  }
+  return -1;
+}
+
+// Flyt n sider fra src ned til dst (dst < src), laveste side først, så et
+// overlappende spænd kun overskriver sider der allerede er kopieret.
+// Headerens CRC afhænger ikke af adressen. Ligger den gamle header uden
+// for det nye spænd, ugyldiggøres den bagefter.
+static void move_pages(uint8_t src, uint8_t dst, uint8_t n) {
+  uint8_t buf[PROFILE_PAGE_SIZE];
+  for (uint8_t k = 0; k < n; ++k) {
+    eeprom_read_block(buf, reinterpret_cast<const void*>(page_addr(src + k)), sizeof(buf));
+    eeprom_write_diff(page_addr(dst + k), buf, sizeof(buf));
+  }
+  if (src >= dst + n) hdr_kill(src);
+}
+
+// Pak profilerne mod side 0 (i sideorden), så al fri plads er ét spænd
+static void profile_compact() {
+  uint8_t dst = 0;
+  for (;;) {
+    int8_t k = -1;
+    for (uint8_t i = 0; i < PROFILE_MAX; ++i) {
+      if (tab[i].page == 0xFF || tab[i].page < dst) continue;
+      if (k < 0 || tab[i].page < tab[k].page) k = (int8_t)i;
+    }
+    if (k < 0) return;
+    if (tab[k].page != dst) {
+      move_pages(tab[k].page, dst, tab[k].pages);
+      tab[k].page = dst;
+    }
+    dst += tab[k].pages;
+  }
+}
+
+static uint8_t free_pages() {
+  uint32_t used = used_pages();
+  uint8_t n = 0;
+  for (uint8_t p = 0; p < PROFILE_PAGES; ++p) {
+    if (!(used & (1UL << p))) n++;
+  }
+  return n;
+}
+
+// Skriv område-header første gang. Sider med en rest af profil-magic
+// (tilfældigt i gamle retain-data) ugyldiggøres først.
+void profile_area_format() {
+  if (profile_area_formatted()) return;
+  for (uint8_t p = 0; p < PROFILE_PAGES; ++p) {
+    uint16_t magic;
+    eeprom_read_block(&magic, reinterpret_cast<const void*>(page_addr(p)), sizeof(magic));
+    if (magic == PROFILE_MAGIC) hdr_kill(p);
+  }
+  ProfileAreaHeader a = {PROFILE_AREA_MAGIC, PROFILE_PAGE_SIZE, PROFILE_PAGES};
+  eeprom_write_diff(PROFILE_AREA_BASE, &a, sizeof(a));
+}
+
+static void publish() {
+  if (profileReg == 0) return;
+  holdingRegs[profileReg + PROFILE_REG_ACTIVE] = profileActive;
+  holdingRegs[profileReg + PROFILE_REG_STATUS] = profileStatus;
+}
+
+// ============================================================================
+// API
+// ============================================================================
+bool profile_area_formatted() {
+  ProfileAreaHeader a;
+  eeprom_read_block(&a, reinterpret_cast<const void*>(PROFILE_AREA_BASE), sizeof(a));
+  return a.magic == PROFILE_AREA_MAGIC && a.pageSize == PROFILE_PAGE_SIZE &&
+         a.pages == PROFILE_PAGES;
+}
+
+bool profile_config_set(uint16_t reg) {
+  if (reg != 0 && (uint32_t)reg + PROFILE_REGS > NUM_REGS) return false;
+  if (reg != 0 && regmap_owner(reg, PROFILE_REGS, REGMAP_ID(REGMAP_PROFILE, 0))) return false;
+  profileReg = reg;
+  if (profileReg != 0) {
+    holdingRegs[profileReg + PROFILE_REG_SELECT] = 0;
+    publish();
+  }
+  return true;
+}
+
+uint8_t profile_save(uint8_t no, const char* name, const PersistConfig& cfg) {
+  if (no < 1 || no > PROFILE_MAX) return PROFILE_ST_RANGE;
+  scan_once();
+
+  // Mål image før der vælges sider
+  const uint16_t maxLen = PROFILE_PAGES * PROFILE_PAGE_SIZE - sizeof(ProfileHeader);
+  uint16_t len, crc;
+  eeprom_stream_begin(0, maxLen, true);
+  bool ok = config_tlv_write(cfg);
+  ok = eeprom_stream_end(len, crc) && ok;
+  if (!ok) return PROFILE_ST_FULL;
+
+  // Gammel version af samme nr beholdes til den nye er komplet, når der
+  // er plads til begge. Ellers genbruges dens sider: den ugyldiggøres
+  // først, og profilerne pakkes hvis den frie plads er delt op.
+  ProfileSlot& s = tab[no - 1];
+  uint8_t need = (uint8_t)((sizeof(ProfileHeader) + len + PROFILE_PAGE_SIZE - 1) / PROFILE_PAGE_SIZE);
+  uint8_t reusable = free_pages() + ((s.page != 0xFF) ? s.pages : 0);
+  if (need > reusable) return PROFILE_ST_FULL;
+
+  eeprom_stats_begin();
+  profile_area_format();
+  int8_t page = find_free(need);
+  if (page < 0 && s.page != 0xFF) {
+    hdr_kill(s.page);
+    s.page = 0xFF;
+    page = find_free(need);
+  }
+  if (page < 0) {
+    profile_compact();
+    page = find_free(need);
+  }
+  if (page < 0) return PROFILE_ST_FULL;
+  eeprom_stream_begin(page_addr((uint8_t)page) + sizeof(ProfileHeader),
+                      (uint16_t)need * PROFILE_PAGE_SIZE - sizeof(ProfileHeader));
+  ok = config_tlv_write(cfg);
+  ok = eeprom_stream_end(len, crc) && ok;
+  if (!ok) return PROFILE_ST_SAVEFAIL;
+
+  ProfileHeader h;
+  memset(&h, 0, sizeof(h));
+  h.magic = PROFILE_MAGIC;
+  h.no    = no;
+  h.pages = need;
+  h.seq   = nextSeq;
+  h.len   = len;
+  if (name) strncpy(h.name, name, sizeof(h.name));
+  h.crc   = hdr_crc(h, crc);
+  eeprom_write_diff(page_addr((uint8_t)page), &h, sizeof(h));
+
+  // Verificér ud fra det faktisk lagrede image
+  ProfileHeader v;
+  if (!hdr_read((uint8_t)page, v) || v.seq != h.seq) return PROFILE_ST_SAVEFAIL;
+
+  if (s.page != 0xFF) hdr_kill(s.page);
+  s.page  = (uint8_t)page;
+  s.pages = need;
+  s.seq   = h.seq;
+  nextSeq++;
+  return PROFILE_ST_OK;
+}
+
+bool profile_delete(uint8_t no) {
+  if (no < 1 || no > PROFILE_MAX) return false;
+  scan_once();
+  ProfileSlot& s = tab[no - 1];
+  if (s.page == 0xFF) return false;
+  hdr_kill(s.page);
+  s.page = 0xFF;
+  return true;
+}
+
+uint8_t profile_apply(uint8_t no, bool save) {
+  if (no < 1 || no > PROFILE_MAX) return PROFILE_ST_RANGE;
+  scan_once();
+  const ProfileSlot& s = tab[no - 1];
+  if (s.page == 0xFF) return PROFILE_ST_EMPTY;
+
+  // CRC tjekkes før globalConfig røres
+  ProfileHeader h;
+  if (!hdr_read(s.page, h)) return PROFILE_ST_INVALID;
+  if (!config_tlv_load_at(page_addr(s.page) + sizeof(h), h.len, globalConfig)) {
+    configLoad(globalConfig);       // globalConfig tilbage til boot-config
+    return PROFILE_ST_INVALID;
+  }
+
+  // Kommunikation og selve vælgeren følger ikke med profilen
+  globalConfig.slaveId    = currentSlaveID;
+  globalConfig.baud       = currentBaudrate;
+  globalConfig.serverFlag = serverRunning ? 1 : 0;
+  globalConfig.profileReg = profileReg;
+  strncpy(globalConfig.hostname, cliHostname, sizeof(globalConfig.hostname));
+  globalConfig.profileActive = no;
+
+  configApply(globalConfig);
+  if (!save) return PROFILE_ST_OK;
+
+  // Boot-config skrives trinvis fra modbusLoop (configSaveStep), så
+  // EEPROM-skrivningen ikke blokerer bussen; profile_loop() melder resultat
+  configSaveDeferred();
+  return PROFILE_ST_SAVING;
+}
+
+void profile_on_reg_write(uint16_t addr) {
+  if (profileReg == 0 || addr != profileReg + PROFILE_REG_SELECT) return;
+  if (holdingRegs[addr] == 0) return;
+  profileStatus = PROFILE_ST_PENDING;
+  publish();
+}
+
+void profile_loop() {
+  if (profileStatus == PROFILE_ST_SAVING) {
+    uint8_t st = configSaveState();
+    if (st == CONFIG_SAVE_FAIL) profileStatus = PROFILE_ST_SAVEFAIL;
+    else if (st != CONFIG_SAVE_BUSY) profileStatus = PROFILE_ST_OK;   // OK eller afløst af 'save'
+  }
+  if (profileReg == 0) return;
+  uint16_t sel = holdingRegs[profileReg + PROFILE_REG_SELECT];
+  if (sel != 0) {
+    holdingRegs[profileReg + PROFILE_REG_SELECT] = 0;
+    uint16_t no = sel & ~PROFILE_SEL_SAVE;
+    profileStatus = (no > PROFILE_MAX) ? PROFILE_ST_RANGE
+                                       : profile_apply((uint8_t)no, (sel & PROFILE_SEL_SAVE) != 0);
+  }
+  publish();
+}
+
+void profile_print() {
+  scan_once();
+  Serial.println(F("=== CONFIG PROFILES ==="));
+  bool any = false;
+  for (uint8_t i = 0; i < PROFILE_MAX; ++i) {
+    const ProfileSlot& s = tab[i];
+    if (s.page == 0xFF) continue;
+    ProfileHeader h;
+    if (!hdr_read(s.page, h)) continue;
+    any = true;
+    char name[PROFILE_NAME_LEN + 1];
+    memcpy(name, h.name, PROFILE_NAME_LEN);
+    name[PROFILE_NAME_LEN] = '\0';
+    Serial.print(F("Profile ")); Serial.print(i + 1);
+    Serial.print(F(" | ")); Serial.print(name[0] ? name : "-");
+    Serial.print(F(" | ")); Serial.print(h.len);
+    Serial.print(F(" bytes | pages ")); Serial.print(s.page);
+    Serial.print(F("..")); Serial.print(s.page + s.pages - 1);
+    if (profileActive == i + 1) Serial.print(F(" | ACTIVE"));
+    Serial.println();
+  }
+  if (!any) Serial.println(F("(none)"));
+  Serial.print(F("Area: ")); Serial.print(PROFILE_PAGES);
+  Serial.print(F(" x ")); Serial.print(PROFILE_PAGE_SIZE);
+  Serial.print(F(" bytes @")); Serial.print(PROFILE_AREA_BASE);
+  Serial.print(F(" | free pages ")); Serial.println(free_pages());
+  Serial.print(F("Active: "));
+  if (profileActive) Serial.print(profileActive); else Serial.print(F("base config"));
+  Serial.print(F(" | Regs: "));
+  if (profileReg == 0) {
+    Serial.println(F("disabled"));
+    return;
+  }
+  Serial.print(profileReg); Serial.print(F(".."));
+  Serial.print(profileReg + PROFILE_REGS - 1);
+  Serial.print(F(" | last status: ")); Serial.println(profileStatus);
+}
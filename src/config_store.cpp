@@ -1,16 +1,75 @@
 // ============================================================================
 //  Filnavn : config_store.cpp
 //  Projekt  : Modbus RTU Server / CLI
-//  Version  : v3.3.0 (Hybrid HW/SW Counter Engine)
+//  Version  : v3.9.6 (2026-10-18)
 //  Forfatter: JanG at modbus_slave@laces.dk
-//  Formål   : EEPROM persistence – schema v10 (CounterEngine v4 with hw-mode)
+//  Formål   : EEPROM persistence – schema 26 (A/B journal-slots, TLV-format)
+//  Ændringer:
+//    - v3.7.1: Schema 13 – PersistConfig er append-only (udvidelser før crc),
+//              generisk migrering fra schema 12+; samplerHz persisteres
+//    - v3.7.2: Schema 14 – counterFilterUs[4] (µs input-filter) persisteres
+//    - v3.7.3: Schema 15 – counterCompare[4] (compare-setpoints) persisteres
+//    - v3.7.4: Schema 16 – snapshotReg/snapshotPin (counter snapshot-latch)
+//    - v3.7.5: Schema 17 – counterEdgeLog[4] (edge-tidsstempel ring) persisteres
+//    - v3.7.6: Schema 18 – counterPwm[4] (pulsbredde/duty-måling) persisteres
+//    - v3.7.7: Schema 19 – counterGateWin[4] (gate-input + tidsvindue) persisteres
+//    - v3.7.8: Schema 20 – counterRateReg[4] (rate/totalizer) persisteres
+//    - v3.8.2: Direkte GPIO-drive for coil-mappede pins i configApply
+//    - v3.8.3: GPIO mirror-plan genopbygges i configApply
+//    - v3.8.4: Schema 21 – timerWave (waveform reg-blok + pin) persisteres
+//    - v3.8.5: Schema 22 – timerParamReg[4] (live timer-parametre) persisteres
+//    - v3.8.6: Schema 23 – timerSeqReg[4] (trin-program blok, mode 6) persisteres
+//    - v3.8.7: Schema 24 – timerTrigPin[4] (INT/PCINT trigger, mode 4) persisteres
+//    - v3.9.0: Differentiel save (config_eeprom.h): kun ændrede bytes skrives;
+//              antal bytes og tid rapporteres (input-reg 110)
+//    - v3.9.1: A/B journal-slots med sekvens + CRC16; load vælger nyeste
+//              gyldige slot, save skriver den inaktive (legacy-fallback)
+//    - v3.9.2: Schema 25 – counterRetain[4] (retentive counters) persisteres
+//    - v3.9.3: TLV-format i slots (config_tlv.h); schema 10/11 migrering
+//              uden kopier på stakken - felter genlæses fra EEPROM
+//    - v3.9.4: Boot-dump flyttet til configDump() ('show config dump');
+//              configApply genstarter kun UART ved ny baudrate (ingen delay)
+//    - v3.9.5: configApply() som diff mod kørende tilstand efter boot:
+//              ingen register-wipe, kun ændrede timere/counters/blokke
+//    - v3.9.6: Schema 26 – profileReg/profileActive (config-profiler);
+//              configCapture() deles af save og 'profile save'
+//    - v3.9.6: Diff-apply genopbygger counter polling-plan ved ny GPIO-
+//              mapping/filter; ROR-bit synkes også for opdaterede counters
+//    - v3.9.6: configSaveDeferred(): udskudt save der skrives trinvis fra
+//              modbusLoop (én ændret byte pr. trin), til profil-select
+//    - v3.9.6: Input-filter anvendes via counters_filter_set()
+//    - v3.9.6: Ændrede edge-log ringe slukkes før de sættes (må ikke
+//              overlappe hinanden)
+//    - v3.9.6: Diff-apply nulstiller fjernede statiske registre/coils og
+//              starter/stopper uændrede counters ved ny auto-start
+//    - v3.9.6: Rate uden ledig slot meldes på konsollen i stedet for at
+//              blive slukket stille
+//    - v3.9.6: Alle ændrede reg-blokke slukkes før de sættes (overlap-
+//              tjek i regmap_owner), ikke kun edge-log ringe
+//    - v3.9.6: configCaptureBase() (fra cli_shell) deles med FC-auto-save
+//    - v3.9.6: Rå-image migrering kun for baseline schema 10..12 (+ aktuelt
+//              schema); 13..25 migreres ikke længere (TLV dækker nyere)
 // ============================================================================
 #include "modbus_core.h"
 #include "modbus_globals.h"
 #include "modbus_timers.h"
 #include "modbus_counters.h"
+#include "modbus_counters_sampler.h"
+#include "modbus_counters_compare.h"
+#include "modbus_counters_snapshot.h"
+#include "modbus_counters_edgelog.h"
+#include "modbus_counters_pwm.h"
+#include "modbus_counters_window.h"
+#include "modbus_counters_rate.h"
+#include "modbus_counters_retain.h"
+#include "config_eeprom.h"
+#include "modbus_idle.h"
+#include "config_tlv.h"
+#include "config_profile.h"
+#include <avr/eeprom.h>
 #include <EEPROM.h>
 #include <string.h>
+#include <stddef.h>
 
 // ============================================================================
 //  Hjælpefunktioner
@@ -32,6 +91,15 @@ static bool checkCrc(const PersistConfig &cfg) {
   return (c == cfg.crc);
 }
 
+// Append-only blokken efter schema 12 (samplerHz .. crc). Alle felter er
+// 0 = slået fra, så defaults er én memset. Nye felter med anden default
+// sættes i configDefaults(); migrering af nyere schemas sker via TLV.
+static void configExtDefaults(PersistConfig &cfg) {
+  uint8_t* p = reinterpret_cast<uint8_t*>(&cfg);
+  memset(p + offsetof(PersistConfig, samplerHz), 0,
+         offsetof(PersistConfig, crc) - offsetof(PersistConfig, samplerHz));
+}
+
 static bool isSupportedBaud(unsigned long nb) __attribute__((unused));
 static bool isSupportedBaud(unsigned long nb) {
   const unsigned long rates[] = {
@@ -45,8 +113,35 @@ static bool isSupportedBaud(unsigned long nb) {
 // ============================================================================
 //  LOAD
 // ============================================================================
+// Genlæs bytes [from, to) af et rå struct-image direkte fra EEPROM
+// (migrering uden kopi af timers/counters på stakken)
+static void rawField(PersistConfig &cfg, uint16_t rawAddr, uint16_t from, uint16_t to) {
+  eeprom_read_block(reinterpret_cast<uint8_t*>(&cfg) + from,
+                    reinterpret_cast<const void*>(rawAddr + from), to - from);
+}
+
 bool configLoad(PersistConfig &cfg) {
-  EEPROM.get(0, cfg);
+  // Nyeste gyldige journal-slot: TLV-image (v3.9.3+) eller rå struct-image
+  int8_t slot = eeprom_slot_scan();
+  if (slot >= 0 && config_tlv_is((uint8_t)slot)) {
+    if (!config_tlv_load((uint8_t)slot, cfg)) {
+      Serial.println(F("! EEPROM TLV image invalid"));
+      configDefaults(cfg);
+      return false;
+    }
+    computeFillCrc(cfg);
+    return true;
+  }
+
+  // Rå struct-image: slot fra v3.9.1/v3.9.2 eller legacy på offset 0.
+  // Næste save skriver det som TLV.
+  uint16_t rawAddr = 0, len = 0;
+  if (slot < 0 || !eeprom_slot_info((uint8_t)slot, rawAddr, len)) {
+    rawAddr = 0;
+    EEPROM.get(0, cfg);
+  } else {
+    eeprom_slot_read((uint8_t)slot, &cfg, sizeof(PersistConfig), len);
+  }
 
   // Check magic and CRC
   if (cfg.magic != 0xC0DE) {
@@ -58,7 +153,7 @@ bool configLoad(PersistConfig &cfg) {
   }
 
   // Schema check BEFORE CRC (CRC layout may have changed)
-  if (cfg.schema != 10 && cfg.schema != 11 && cfg.schema != 12) {
+  if (cfg.schema < 10 || cfg.schema > CONFIG_SCHEMA) {
     Serial.print(F("! EEPROM schema unknown (got "));
     Serial.print(cfg.schema);
     Serial.println(F(")"));
@@ -66,78 +161,17 @@ bool configLoad(PersistConfig &cfg) {
     return false;  // Let main.cpp handle save
   }
 
-  // For schema 10->11 migration: GPIO arrays removed from persistence
+  // For schema 10->11 migration: GPIO arrays removed from persistence.
+  // ID/baud/server, statiske maps og timers/counters bevares; resten
+  // default'es. Felterne genlæses fra EEPROM efter configDefaults().
   if (cfg.schema == 10) {
     Serial.println(F("! EEPROM schema 10 (old) - upgrading to 11 (GPIO no longer persisted)"));
-
-    // CRITICAL: Save ALL timer and counter configs BEFORE calling configDefaults()
-    TimerConfig oldTimers[4];
-    CounterConfig oldCounters[4];
-    uint8_t oldTimerCount = cfg.timerCount;
-    uint8_t oldCounterCount = cfg.counterCount;
-
-    for (uint8_t i = 0; i < 4; i++) {
-      oldTimers[i] = cfg.timer[i];
-      oldCounters[i] = cfg.counter[i];
-    }
-
-    // Save the old settings we want to keep
-    uint8_t oldSlaveId = cfg.slaveId;
-    uint32_t oldBaud = cfg.baud;
-    uint8_t oldServerFlag = cfg.serverFlag;
-    uint8_t oldRegStaticCount = cfg.regStaticCount;
-    uint8_t oldCoilStaticCount = cfg.coilStaticCount;
-
-    uint16_t oldRegAddr[MAX_STATIC_REGS];
-    uint16_t oldRegVal[MAX_STATIC_REGS];
-    for (uint8_t i = 0; i < oldRegStaticCount && i < MAX_STATIC_REGS; i++) {
-      oldRegAddr[i] = cfg.regStaticAddr[i];
-      oldRegVal[i] = cfg.regStaticVal[i];
-    }
-
-    uint16_t oldCoilIdx[MAX_STATIC_COILS];
-    uint8_t oldCoilVal[MAX_STATIC_COILS];
-    for (uint8_t i = 0; i < oldCoilStaticCount && i < MAX_STATIC_COILS; i++) {
-      oldCoilIdx[i] = cfg.coilStaticIdx[i];
-      oldCoilVal[i] = cfg.coilStaticVal[i];
-    }
-
-    // Now reset to defaults (this will overwrite everything)
     configDefaults(cfg);
-
-    // Restore old settings
-    cfg.slaveId = oldSlaveId;
-    cfg.baud = oldBaud;
-    cfg.serverFlag = oldServerFlag;
-    cfg.timerCount = oldTimerCount;
-    cfg.counterCount = oldCounterCount;
-
-    cfg.regStaticCount = oldRegStaticCount;
-    for (uint8_t i = 0; i < oldRegStaticCount && i < MAX_STATIC_REGS; i++) {
-      cfg.regStaticAddr[i] = oldRegAddr[i];
-      cfg.regStaticVal[i] = oldRegVal[i];
-    }
-
-    cfg.coilStaticCount = oldCoilStaticCount;
-    for (uint8_t i = 0; i < oldCoilStaticCount && i < MAX_STATIC_COILS; i++) {
-      cfg.coilStaticIdx[i] = oldCoilIdx[i];
-      cfg.coilStaticVal[i] = oldCoilVal[i];
-    }
-
-    // Restore timer and counter configs
-    for (uint8_t i = 0; i < oldTimerCount && i < 4; i++) {
-      cfg.timer[i] = oldTimers[i];
-    }
-    for (uint8_t i = 0; i < oldCounterCount && i < 4; i++) {
-      cfg.counter[i] = oldCounters[i];
-    }
-
-    // Recompute CRC after migration restore
+    rawField(cfg, rawAddr, offsetof(PersistConfig, slaveId), offsetof(PersistConfig, hostname));
+    rawField(cfg, rawAddr, offsetof(PersistConfig, timerCount), offsetof(PersistConfig, counterResetOnReadEnable));
     computeFillCrc(cfg);
 
-    // CRITICAL: Return false so main.cpp saves the migrated config back with schema=11
-    // But cfg now contains the restored timer/counter data, not defaults!
-    // main.cpp will call configSave() which updates schema=11 and re-saves
+    // Return false so main.cpp saves the migrated config
     return false;
   }
 
@@ -145,40 +179,54 @@ bool configLoad(PersistConfig &cfg) {
   if (cfg.schema == 11) {
     Serial.println(F("! EEPROM schema 11 (old) - upgrading to 12 (GPIO persistence restored)"));
 
-    // Save timer/counter configs before migration
-    TimerConfig oldTimers[4];
-    CounterConfig oldCounters[4];
-    uint8_t oldTimerCount = cfg.timerCount;
-    uint8_t oldCounterCount = cfg.counterCount;
-
-    for (uint8_t i = 0; i < 4; i++) {
-      oldTimers[i] = cfg.timer[i];
-      oldCounters[i] = cfg.counter[i];
-    }
-
-    // Initialize GPIO mappings (they were lost in v11)
+    // GPIO mappings (they were lost in v11) + felter efter dem
     for (uint8_t i = 0; i < NUM_GPIO; i++) {
       cfg.gpioToCoil[i]  = -1;
       cfg.gpioToInput[i] = -1;
     }
+    configExtDefaults(cfg);
+    computeFillCrc(cfg);
 
-    // Restore timer/counter configs
-    cfg.timerCount = oldTimerCount;
-    cfg.counterCount = oldCounterCount;
-    for (uint8_t i = 0; i < 4; i++) {
-      cfg.timer[i] = oldTimers[i];
-      cfg.counter[i] = oldCounters[i];
+    // Return false so main.cpp saves the migrated config
+    return false;
+  }
+
+  // Schema 12: sidste rå baseline. Imaget er et præfiks af den aktuelle
+  // struct til samplerHz, efterfulgt af sin egen crc.
+  if (cfg.schema == 12) {
+    const uint8_t* raw = reinterpret_cast<const uint8_t*>(&cfg);
+    const uint16_t len = offsetof(PersistConfig, samplerHz);
+    uint16_t stored = (uint16_t)raw[len] | ((uint16_t)raw[len + 1] << 8);
+    if (crc16_simple(raw, len) != stored) {
+      Serial.println(F("! EEPROM CRC invalid (schema 12)"));
+      configDefaults(cfg);
+      return false;
     }
 
-    // Recompute CRC after migration
+    Serial.print(F("! EEPROM schema 12 (old) - upgrading to "));
+    Serial.println(CONFIG_SCHEMA);
+
+    configExtDefaults(cfg);
+    cfg.schema = CONFIG_SCHEMA;
     computeFillCrc(cfg);
 
-    // Return false so main.cpp saves with schema=12
+    // Return false so main.cpp saves the migrated config
     return false;
   }
 
-  // Schema 12 validation
-  if (cfg.schema == 12) {
+  // Rå images med schema 13..CONFIG_SCHEMA-1 (før TLV, v3.9.2 og ældre)
+  // migreres ikke længere: baseline 10..12 ovenfor, nyere schemas via TLV.
+  // Rå struct skrives kun som fallback med det aktuelle schema.
+  if (cfg.schema < CONFIG_SCHEMA) {
+    Serial.print(F("! EEPROM raw schema "));
+    Serial.print(cfg.schema);
+    Serial.println(F(" no longer migrated - using defaults"));
+    configDefaults(cfg);
+    return false;
+  }
+
+  // Current schema validation
+  if (cfg.schema == CONFIG_SCHEMA) {
     if (!checkCrc(cfg)) {
       Serial.print(F("! EEPROM CRC invalid (expected 0x"));
       Serial.print(cfg.crc, HEX);
@@ -194,67 +242,6 @@ bool configLoad(PersistConfig &cfg) {
       return false;  // Let main.cpp handle save
     }
 
-    // DEBUG: Show EVERYTHING we're loading
-    Serial.println(F("\n=== DEBUG: configLoad() - FULL CONFIG ==="));
-    Serial.print(F("Magic: 0x")); Serial.print(cfg.magic, HEX);
-    Serial.print(F(" | Schema: ")); Serial.print(cfg.schema);
-    Serial.print(F(" | CRC: 0x")); Serial.println(cfg.crc, HEX);
-    Serial.print(F("SlaveID: ")); Serial.print(cfg.slaveId);
-    Serial.print(F(" | Baud: ")); Serial.print(cfg.baud);
-    Serial.print(F(" | Server: ")); Serial.println(cfg.serverFlag);
-    Serial.println(F("------ STATIC REGISTERS ------"));
-    Serial.print(F("Count: ")); Serial.println(cfg.regStaticCount);
-    for (uint8_t i = 0; i < cfg.regStaticCount; i++) {
-      Serial.print(F("  [") ); Serial.print(i); Serial.print(F("] Addr="));
-      Serial.print(cfg.regStaticAddr[i]); Serial.print(F(" Val="));
-      Serial.println(cfg.regStaticVal[i]);
-    }
-    Serial.println(F("------ STATIC COILS ------"));
-    Serial.print(F("Count: ")); Serial.println(cfg.coilStaticCount);
-    for (uint8_t i = 0; i < cfg.coilStaticCount; i++) {
-      Serial.print(F("  [") ); Serial.print(i); Serial.print(F("] Idx="));
-      Serial.print(cfg.coilStaticIdx[i]); Serial.print(F(" Val="));
-      Serial.println(cfg.coilStaticVal[i]);
-    }
-    Serial.println(F("------ TIMERS ------"));
-    Serial.print(F("Count: ")); Serial.println(cfg.timerCount);
-    Serial.print(F("Status Reg: ")); Serial.print(cfg.timerStatusReg);
-    Serial.print(F(" | Ctrl Reg: ")); Serial.println(cfg.timerStatusCtrlReg);
-    for (uint8_t i = 0; i < cfg.timerCount; i++) {
-      Serial.print(F("  [") ); Serial.print(i); Serial.print(F("] ID="));
-      Serial.print(cfg.timer[i].id); Serial.print(F(" Mode="));
-      Serial.print(cfg.timer[i].mode); Serial.print(F(" Enabled="));
-      Serial.println(cfg.timer[i].enabled);
-    }
-    Serial.println(F("------ COUNTERS ------"));
-    Serial.print(F("Count: ")); Serial.println(cfg.counterCount);
-    for (uint8_t i = 0; i < cfg.counterCount; i++) {
-      Serial.print(F("  [") ); Serial.print(i); Serial.print(F("] ID="));
-      Serial.print(cfg.counter[i].id); Serial.print(F(" Enabled="));
-      Serial.print(cfg.counter[i].enabled); Serial.print(F(" EdgeMode="));
-      Serial.print(cfg.counter[i].edgeMode); Serial.print(F(" Dir="));
-      Serial.print(cfg.counter[i].direction); Serial.print(F(" Input="));
-      Serial.print(cfg.counter[i].inputIndex); Serial.print(F(" Reg="));
-      Serial.println(cfg.counter[i].regIndex);
-    }
-    Serial.println(F("------ GPIO MAPPINGS ------"));
-    bool hasGpio = false;
-    for (uint8_t i = 0; i < NUM_GPIO; i++) {
-      if (cfg.gpioToCoil[i] >= 0 || cfg.gpioToInput[i] >= 0) {
-        Serial.print(F("  Pin ")); Serial.print(i);
-        if (cfg.gpioToCoil[i] >= 0) {
-          Serial.print(F(" -> coil ")); Serial.print(cfg.gpioToCoil[i]);
-        }
-        if (cfg.gpioToInput[i] >= 0) {
-          Serial.print(F(" -> input ")); Serial.print(cfg.gpioToInput[i]);
-        }
-        Serial.println();
-        hasGpio = true;
-      }
-    }
-    if (!hasGpio) Serial.println(F("  (no GPIO mappings)"));
-    Serial.println(F("==========================================\n"));
-
     return true;
   }
 
@@ -263,13 +250,80 @@ bool configLoad(PersistConfig &cfg) {
   return false;
 }
 
+// ============================================================================
+//  DUMP (CLI 'show config dump')
+// ============================================================================
+// Fuldt config-image linje for linje. Blev tidligere skrevet af configLoad()
+// og configSave() ved hver boot/save (v3.9.4: kun på forespørgsel).
+void configDump(const PersistConfig &cfg) {
+  Serial.println(F("=== CONFIG DUMP (last loaded/saved image) ==="));
+  Serial.print(F("Magic: 0x")); Serial.print(cfg.magic, HEX);
+  Serial.print(F(" | Schema: ")); Serial.print(cfg.schema);
+  Serial.print(F(" | CRC: 0x")); Serial.println(cfg.crc, HEX);
+  Serial.print(F("SlaveID: ")); Serial.print(cfg.slaveId);
+  Serial.print(F(" | Baud: ")); Serial.print(cfg.baud);
+  Serial.print(F(" | Server: ")); Serial.println(cfg.serverFlag);
+  Serial.println(F("------ STATIC REGISTERS ------"));
+  Serial.print(F("Count: ")); Serial.println(cfg.regStaticCount);
+  for (uint8_t i = 0; i < cfg.regStaticCount; i++) {
+    Serial.print(F("  [") ); Serial.print(i); Serial.print(F("] Addr="));
+    Serial.print(cfg.regStaticAddr[i]); Serial.print(F(" Val="));
+    Serial.println(cfg.regStaticVal[i]);
+  }
+  Serial.println(F("------ STATIC COILS ------"));
+  Serial.print(F("Count: ")); Serial.println(cfg.coilStaticCount);
+  for (uint8_t i = 0; i < cfg.coilStaticCount; i++) {
+    Serial.print(F("  [") ); Serial.print(i); Serial.print(F("] Idx="));
+    Serial.print(cfg.coilStaticIdx[i]); Serial.print(F(" Val="));
+    Serial.println(cfg.coilStaticVal[i]);
+  }
+  Serial.println(F("------ TIMERS ------"));
+  Serial.print(F("Count: ")); Serial.println(cfg.timerCount);
+  Serial.print(F("Status Reg: ")); Serial.print(cfg.timerStatusReg);
+  Serial.print(F(" | Ctrl Reg: ")); Serial.println(cfg.timerStatusCtrlReg);
+  for (uint8_t i = 0; i < cfg.timerCount; i++) {
+    Serial.print(F("  [") ); Serial.print(i); Serial.print(F("] ID="));
+    Serial.print(cfg.timer[i].id); Serial.print(F(" Mode="));
+    Serial.print(cfg.timer[i].mode); Serial.print(F(" Enabled="));
+    Serial.println(cfg.timer[i].enabled);
+  }
+  Serial.println(F("------ COUNTERS ------"));
+  Serial.print(F("Count: ")); Serial.println(cfg.counterCount);
+  for (uint8_t i = 0; i < cfg.counterCount; i++) {
+    Serial.print(F("  [") ); Serial.print(i); Serial.print(F("] ID="));
+    Serial.print(cfg.counter[i].id); Serial.print(F(" Enabled="));
+    Serial.print(cfg.counter[i].enabled); Serial.print(F(" EdgeMode="));
+    Serial.print(cfg.counter[i].edgeMode); Serial.print(F(" Dir="));
+    Serial.print(cfg.counter[i].direction); Serial.print(F(" Input="));
+    Serial.print(cfg.counter[i].inputIndex); Serial.print(F(" Reg="));
+    Serial.println(cfg.counter[i].regIndex);
+  }
+  Serial.println(F("------ GPIO MAPPINGS ------"));
+  bool hasGpio = false;
+  for (uint8_t i = 0; i < NUM_GPIO; i++) {
+    if (cfg.gpioToCoil[i] >= 0 || cfg.gpioToInput[i] >= 0) {
+      Serial.print(F("  Pin ")); Serial.print(i);
+      if (cfg.gpioToCoil[i] >= 0) {
+        Serial.print(F(" -> coil ")); Serial.print(cfg.gpioToCoil[i]);
+      }
+      if (cfg.gpioToInput[i] >= 0) {
+        Serial.print(F(" -> input ")); Serial.print(cfg.gpioToInput[i]);
+      }
+      Serial.println();
+      hasGpio = true;
+    }
+  }
+  if (!hasGpio) Serial.println(F("  (no GPIO mappings)"));
+  Serial.println(F("=============================================="));
+}
+
 // ============================================================================
 //  DEFAULTS
 // ============================================================================
 void configDefaults(PersistConfig &cfg) {
   memset(&cfg, 0, sizeof(cfg));
   cfg.magic      = 0xC0DE;
-  cfg.schema     = 12;  // v12: GPIO mappings restored to persistence
+  cfg.schema     = CONFIG_SCHEMA;
   cfg.slaveId    = SLAVE_ID;
   cfg.serverFlag = 1;
   cfg.baud       = BAUDRATE;
@@ -295,20 +349,97 @@ void configDefaults(PersistConfig &cfg) {
     cfg.gpioToInput[i] = -1;
   }
 
+  configExtDefaults(cfg);
   computeFillCrc(cfg);
 }
 
 // ============================================================================
 //  SAVE
 // ============================================================================
-// Use globalConfig directly to save RAM (passed by reference)
-// Only need one static temp for verification
-static PersistConfig verifyTempConfig;
+// Use globalConfig directly to save RAM (passed by reference).
+// Verifikation sker via slot-CRC direkte i EEPROM (ingen temp-kopi).
+// Rå struct-image er fallback hvis TLV-image ikke kan være i en slot
+// (fx alle GPIO-pins og statiske coils mappet), så det skal altid passe.
+static_assert(sizeof(PersistConfig) <= EEPROM_SLOT_PAYLOAD,
+              "PersistConfig passer ikke i en EEPROM journal-slot");
+
+// Kørende basis-config (system, statiske maps, timers, counters) -> cfg;
+// configCapture() tilføjer udvidelserne. Deles af CLI 'save', 'profile
+// save' og auto-save via reg 0 = 0x00FF. Kaldes med globalConfig, så
+// PersistConfig (>1 KB) aldrig ligger på stakken.
+void configCaptureBase(PersistConfig &cfg) {
+  memset(&cfg, 0, sizeof(cfg));
+  cfg.magic      = 0xC0DE;
+  cfg.schema     = 11;  // v11: GPIO mappings removed from persistence
+  cfg.reserved   = 0;
+  cfg.slaveId    = currentSlaveID;
+  cfg.serverFlag = serverRunning ? 1 : 0;
+  cfg.baud       = currentBaudrate;
+  cfg.timerStatusReg     = timerStatusRegIndex;
+  cfg.timerStatusCtrlReg = timerStatusCtrlRegIndex;
 
-bool configSave(const PersistConfig &cfgIn) {
-  // Cast away const to work with cfgIn directly (saves 1KB RAM)
-  PersistConfig &cfg = const_cast<PersistConfig&>(cfgIn);
+  // Hostname
+  strncpy(cfg.hostname, cliHostname, sizeof(cfg.hostname));
+  cfg.hostname[sizeof(cfg.hostname)-1] = '\0';
+
+  // Counter control flags (will be saved by configSave())
+  for (uint8_t i = 0; i < 4; i++) {
+    cfg.counterResetOnReadEnable[i] = counterResetOnReadEnable[i];
+    cfg.counterAutoStartEnable[i] = counterAutoStartEnable[i];
+  }
 
+  // statiske maps
+  cfg.regStaticCount  = regStaticCount;
+  for (uint8_t i = 0; i < cfg.regStaticCount && i < MAX_STATIC_REGS; i++) {
+    cfg.regStaticAddr[i] = regStaticAddr[i];
+    cfg.regStaticVal [i] = regStaticVal [i];
+  }
+  cfg.coilStaticCount = coilStaticCount;
+  for (uint8_t i = 0; i < cfg.coilStaticCount && i < MAX_STATIC_COILS; i++) {
+    cfg.coilStaticIdx[i] = coilStaticIdx[i];
+    cfg.coilStaticVal[i] = coilStaticVal[i] ? 1 : 0;
+  }
+
+  // timere: gem og tæl kun enabled
+  cfg.timerCount = 0;
+  for (uint8_t i = 0; i < 4; i++) {
+    cfg.timer[i] = timers[i];
+    if (timers[i].enabled) cfg.timerCount++;
+
+    // Nulstil runtime-felter som IKKE skal gemmes
+    cfg.timer[i].active = 0;
+    cfg.timer[i].phase = 0;
+    cfg.timer[i].phaseStartMs = 0;
+    cfg.timer[i].lastTrigLevel = 0;
+    cfg.timer[i].alarm = 0;
+    cfg.timer[i].alarmCode = 0;
+    cfg.timer[i].lastDurationMs = 0;
+  }
+
+  // Counters: gem og tæl kun enabled
+  cfg.counterCount = 0;
+  for (uint8_t i = 0; i < 4; i++) {
+    cfg.counter[i] = counters[i];
+    if (counters[i].enabled) cfg.counterCount++;
+
+    // Nulstil runtime-felter som IKKE skal gemmes
+    cfg.counter[i].counterValue = cfg.counter[i].startValue;
+    cfg.counter[i].edgeCount = 0;
+    cfg.counter[i].overflowFlag = 0;
+    cfg.counter[i].lastLevel = 0;
+    cfg.counter[i].lastEdgeMs = 0;
+    cfg.counter[i].lastCountForFreq = 0;
+    cfg.counter[i].lastFreqCalcMs = 0;
+    cfg.counter[i].currentFreqHz = 0;
+  }
+
+  // NOTE: GPIO mappings no longer saved (v3.3.1)
+  // HW counters auto-map their pins, static mappings are runtime-only
+}
+
+// Kørende udvidelses-config (alt der ikke er timers/counters/statiske
+// maps) kopieres ind i cfg, og schema + checksum sættes
+void configCapture(PersistConfig &cfg) {
   // Gem globale timer status/control registre
   cfg.timerStatusReg     = timerStatusRegIndex;
   cfg.timerStatusCtrlReg = timerStatusCtrlRegIndex;
@@ -319,6 +450,13 @@ bool configSave(const PersistConfig &cfgIn) {
   for (uint8_t i = 0; i < 4; ++i) {
     cfg.counterResetOnReadEnable[i] = counterResetOnReadEnable[i];
     cfg.counterAutoStartEnable[i] = counterAutoStartEnable[i];
+    cfg.counterFilterUs[i] = counterFilterUs[i];
+    cfg.counterCompare[i] = counterCompare[i];
+    cfg.counterEdgeLog[i] = counterEdgeLog[i];
+    cfg.counterPwm[i] = counterPwm[i];
+    cfg.counterGateWin[i] = counterGateWin[i];
+    cfg.counterRateReg[i] = counterRateReg[i];
+    cfg.counterRetain[i] = counterRetain[i];
   }
 
   // Gem GPIO mappings
@@ -327,182 +465,450 @@ bool configSave(const PersistConfig &cfgIn) {
     cfg.gpioToInput[i] = gpioToInput[i];
   }
 
-  cfg.schema = 12;  // v12: GPIO mappings restored to persistence
-  computeFillCrc(cfg);
+  // Gem counter sampler-rate (v13)
+  cfg.samplerHz = sampler_rate_hz();
 
-  // DEBUG: Show EVERYTHING we're saving
-  Serial.println(F("\n=== DEBUG: configSave() - FULL CONFIG ==="));
-  Serial.print(F("Magic: 0x")); Serial.print(cfg.magic, HEX);
-  Serial.print(F(" | Schema: ")); Serial.print(cfg.schema);
-  Serial.print(F(" | CRC: 0x")); Serial.println(cfg.crc, HEX);
-  Serial.print(F("SlaveID: ")); Serial.print(cfg.slaveId);
-  Serial.print(F(" | Baud: ")); Serial.print(cfg.baud);
-  Serial.print(F(" | Server: ")); Serial.println(cfg.serverFlag);
-  Serial.println(F("------ STATIC REGISTERS ------"));
-  Serial.print(F("Count: ")); Serial.println(cfg.regStaticCount);
-  for (uint8_t i = 0; i < cfg.regStaticCount; i++) {
-    Serial.print(F("  [") ); Serial.print(i); Serial.print(F("] Addr="));
-    Serial.print(cfg.regStaticAddr[i]); Serial.print(F(" Val="));
-    Serial.println(cfg.regStaticVal[i]);
+  // Gem snapshot-latch (v16)
+  cfg.snapshotReg = snapshotReg;
+  cfg.snapshotPin = snapshotPin;
+
+  // Gem waveform-generator (v21), live timer-parametre (v22),
+  // trin-program blokke (v23) og trigger-pins (v24)
+  cfg.timerWave = timerWave;
+  for (uint8_t i = 0; i < 4; ++i) {
+    cfg.timerParamReg[i] = timerParamReg[i];
+    cfg.timerSeqReg[i]   = timerSeqReg[i];
+    cfg.timerTrigPin[i]  = timerTrigPin[i];
   }
-  Serial.println(F("------ STATIC COILS ------"));
-  Serial.print(F("Count: ")); Serial.println(cfg.coilStaticCount);
-  for (uint8_t i = 0; i < cfg.coilStaticCount; i++) {
-    Serial.print(F("  [") ); Serial.print(i); Serial.print(F("] Idx="));
-    Serial.print(cfg.coilStaticIdx[i]); Serial.print(F(" Val="));
-    Serial.println(cfg.coilStaticVal[i]);
+
+  // Profil-vælger (v26)
+  cfg.profileReg    = profileReg;
+  cfg.profileActive = profileActive;
+
+  cfg.schema = CONFIG_SCHEMA;
+  computeFillCrc(cfg);
+}
+
+// Udskudt save: globalConfig streames i hvert trin, og højst én ændret
+// byte programmeres (eeprom_slot_step_*). Et TLV-image der ikke kan være
+// i slotten gemmes som rå PersistConfig, som ved configSave().
+static uint8_t saveState = CONFIG_SAVE_IDLE;
+static bool    saveRaw   = false;
+
+bool configSave(const PersistConfig &cfgIn) {
+  // Cast away const to work with cfgIn directly (saves 1KB RAM)
+  PersistConfig &cfg = const_cast<PersistConfig&>(cfgIn);
+  configCapture(cfg);
+
+  // En synkron save afløser en igangværende udskudt save
+  if (saveState == CONFIG_SAVE_BUSY) {
+    eeprom_slot_step_cancel();
+    saveState = CONFIG_SAVE_IDLE;
   }
-  Serial.println(F("------ TIMERS ------"));
-  Serial.print(F("Count: ")); Serial.println(cfg.timerCount);
-  Serial.print(F("Status Reg: ")); Serial.print(cfg.timerStatusReg);
-  Serial.print(F(" | Ctrl Reg: ")); Serial.println(cfg.timerStatusCtrlReg);
-  for (uint8_t i = 0; i < cfg.timerCount; i++) {
-    Serial.print(F("  [") ); Serial.print(i); Serial.print(F("] ID="));
-    Serial.print(cfg.timer[i].id); Serial.print(F(" Mode="));
-    Serial.print(cfg.timer[i].mode); Serial.print(F(" Enabled="));
-    Serial.println(cfg.timer[i].enabled);
+
+  // TLV-image streames til inaktiv journal-slot (kun ændrede bytes),
+  // header sidst, og CRC verificeres mod det lagrede image
+  eeprom_stats_begin();
+  int8_t slot = config_tlv_save(cfg);
+  if (slot == -2) {
+    Serial.println(F("% TLV image too large - saving full image"));
+    slot = eeprom_slot_write(&cfg, sizeof(PersistConfig));
   }
-  Serial.println(F("------ COUNTERS ------"));
-  Serial.print(F("Count: ")); Serial.println(cfg.counterCount);
-  for (uint8_t i = 0; i < cfg.counterCount; i++) {
-    Serial.print(F("  [") ); Serial.print(i); Serial.print(F("] ID="));
-    Serial.print(cfg.counter[i].id); Serial.print(F(" Enabled="));
-    Serial.print(cfg.counter[i].enabled); Serial.print(F(" EdgeMode="));
-    Serial.print(cfg.counter[i].edgeMode); Serial.print(F(" Dir="));
-    Serial.print(cfg.counter[i].direction); Serial.print(F(" Input="));
-    Serial.print(cfg.counter[i].inputIndex); Serial.print(F(" Reg="));
-    Serial.println(cfg.counter[i].regIndex);
+  eeprom_print_last_write();
+  inputRegs[IREG_DIAG_EEPROM_WRITTEN] = eepromLastWrite.written;
+
+  if (slot < 0) {
+    Serial.println(F("! EEPROM slot verify failed"));
+    return false;
   }
-  Serial.println(F("------ GPIO MAPPINGS ------"));
-  bool hasGpio = false;
-  for (uint8_t i = 0; i < NUM_GPIO; ++i) {
-    if (cfg.gpioToCoil[i] >= 0 || cfg.gpioToInput[i] >= 0) {
-      Serial.print(F("  Pin ")); Serial.print(i);
-      if (cfg.gpioToCoil[i] >= 0) {
-        Serial.print(F(" -> coil ")); Serial.print(cfg.gpioToCoil[i]);
-      }
-      if (cfg.gpioToInput[i] >= 0) {
-        Serial.print(F(" -> input ")); Serial.print(cfg.gpioToInput[i]);
-      }
-      Serial.println();
-      hasGpio = true;
-    }
+  Serial.print(F("EEPROM: slot "));
+  Serial.print((char)('A' + slot));
+  Serial.print(F(" seq="));
+  Serial.println(eeprom_slot_seq());
+  return true;
+}
+
+void configSaveDeferred() {
+  configCapture(globalConfig);
+  eeprom_slot_step_cancel();      // ny save starter forfra i inaktiv slot
+  eeprom_stats_begin();
+  saveRaw   = false;
+  saveState = CONFIG_SAVE_BUSY;
+}
+
+void configSaveStep() {
+  if (saveState != CONFIG_SAVE_BUSY) return;
+  if (!eeprom_slot_step_begin()) return;          // EEPROM optaget
+  if (saveRaw) eeprom_slot_append(&globalConfig, sizeof(PersistConfig));
+  else         config_tlv_write(globalConfig);
+  int8_t r = eeprom_slot_step_end();
+  if (r == EEPROM_STEP_MORE) return;
+  if (r == -2 && !saveRaw) {
+    saveRaw = true;                               // TLV for stort
+    return;
   }
-  if (!hasGpio) Serial.println(F("  (no GPIO mappings)"));
-  Serial.println(F("==========================================\n"));
+  saveState = (r >= 0) ? CONFIG_SAVE_OK : CONFIG_SAVE_FAIL;
+  inputRegs[IREG_DIAG_EEPROM_WRITTEN] = eepromLastWrite.written;
+}
 
-  EEPROM.put(0, cfg);
+uint8_t configSaveState() {
+  return saveState;
+}
 
-  EEPROM.get(0, verifyTempConfig);
-  return (verifyTempConfig.magic == cfg.magic &&
-          verifyTempConfig.schema == cfg.schema &&
-          verifyTempConfig.crc == cfg.crc);
+uint32_t config_save_next_deadline_ms() {
+  return (saveState == CONFIG_SAVE_BUSY) ? CONFIG_SAVE_STEP_MS : IDLE_NO_DEADLINE;
 }
 
 // ============================================================================
 //  APPLY
 // ============================================================================
+// Første kald (boot) anvender alt. Senere kald (load, defaults) anvendes
+// som diff mod den kørende tilstand (v3.9.5), så et opskriftsskift ikke
+// giver kommunikationsudfald eller datatab:
+//  - UART genstartes kun ved ny baudrate; nyt slave-ID kasserer kun en
+//    halvt modtaget frame
+//  - holdingRegs/coils nulstilles ikke; statiske regs/coils skrives kun
+//    når de er nye eller har fået ny værdi
+//  - GPIO-plan genopbygges kun ved ændret mapping
+//  - kun ændrede timere/counters re-initialiseres; kun scale/registre
+//    ændret -> counter opdateres uden at miste værdien
+//  - udvidelses-blokke (compare, edgelog, pwm, gate, rate, retain,
+//    snapshot, sampler, trigger, waveform) sættes kun når de er ændret
+//    eller deres counter/timer er re-initialiseret (set-funktionerne
+//    nulstiller deres reg-blokke)
 void configApply(const PersistConfig &cfg) {
-  currentSlaveID  = cfg.slaveId;
-  currentBaudrate = cfg.baud;
-  serverRunning   = (cfg.serverFlag != 0);
-
-  MODBUS_SERIAL.end();
-  delay(50);
-  MODBUS_SERIAL.begin(currentBaudrate);
-  frameGapUs = rtuGapUs();
-
-  memset(holdingRegs, 0, sizeof(holdingRegs));
-  memset(coils,       0, sizeof(coils));
-
-  // --- Initialize GPIO-mappings to -1 (unmapped) FIRST ---
-  // This ensures safe defaults if config data is corrupted
-  for (uint8_t i = 0; i < NUM_GPIO; i++) {
-    gpioToCoil[i]  = -1;
-    gpioToInput[i] = -1;
+  static bool booted = false;
+  const bool full = !booted;
+  booted = true;
+
+  serverRunning = (cfg.serverFlag != 0);
+
+  // UART genstartes kun ved ny baudrate (v3.9.4): ved boot kører porten
+  // allerede fra initModbus(), og bussen må ikke være døv unødigt
+  if (cfg.baud != currentBaudrate) {
+    currentBaudrate = cfg.baud;
+    MODBUS_SERIAL.end();
+    MODBUS_SERIAL.begin(currentBaudrate);
+    frameGapUs = rtuGapUs();
+    modbus_rx_flush();
+  } else if (cfg.slaveId != currentSlaveID) {
+    modbus_rx_flush();
   }
+  currentSlaveID = cfg.slaveId;
 
-  // --- Restore GPIO-mappings from config ---
+  // --- GPIO-mappings (ugyldig/uinitialiseret værdi -> -1 = unmapped) ---
+  bool gpioChanged = full;
   for (uint8_t i = 0; i < NUM_GPIO; i++) {
-    // Only restore if value is explicitly valid (>= 0 or == -1)
-    // If both coil and input are 0 (from uninitialized EEPROM), treat as -1
     int16_t c = cfg.gpioToCoil[i];
     int16_t d = cfg.gpioToInput[i];
 
-    // If both are 0 (uninitialized), treat as -1
-    if (c == 0 && d == 0) {
-      gpioToCoil[i]  = -1;
-      gpioToInput[i] = -1;
-    } else {
-      // Restore with validation
-      if (c >= 0 && c < (int16_t)NUM_COILS) {
-        gpioToCoil[i] = c;
-      } else if (c == -1) {
-        gpioToCoil[i] = -1;
-      }
+    // If both are 0 (uninitialized EEPROM), treat as -1
+    if (c == 0 && d == 0) c = d = -1;
+    if (c < 0 || c >= (int16_t)NUM_COILS)    c = -1;
+    if (d < 0 || d >= (int16_t)NUM_DISCRETE) d = -1;
 
-      if (d >= 0 && d < (int16_t)NUM_DISCRETE) {
-        gpioToInput[i] = d;
-      } else if (d == -1) {
-        gpioToInput[i] = -1;
-      }
+    if (gpioToCoil[i] != c || gpioToInput[i] != d) {
+      gpioToCoil[i]  = c;
+      gpioToInput[i] = d;
+      gpioChanged = true;
     }
   }
 
   // --- Gendan globale timer status/control registre ---
+  bool ctrlChanged = full || cfg.timerStatusCtrlReg != timerStatusCtrlRegIndex;
   timerStatusRegIndex     = cfg.timerStatusReg;
   timerStatusCtrlRegIndex = cfg.timerStatusCtrlReg;
 
   strncpy(cliHostname, cfg.hostname, sizeof(cliHostname));
   cliHostname[sizeof(cliHostname)-1] = '\0'; // sikker terminering
 
-  regStaticCount  = cfg.regStaticCount;
+  // --- Statiske registre/coils som load fjerner eller flytter: nulstilles,
+  // medmindre den nye liste stadig har adressen eller en counter bruger den
+  if (!full) {
+    for (uint8_t i = 0; i < regStaticCount && i < MAX_STATIC_REGS; i++) {
+      uint16_t a = regStaticAddr[i];
+      bool keep = a >= NUM_REGS || counters_uses_reg(a);
+      for (uint8_t j = 0; j < cfg.regStaticCount && j < MAX_STATIC_REGS && !keep; j++) {
+        keep = (cfg.regStaticAddr[j] == a);
+      }
+      if (!keep) holdingRegs[a] = 0;
+    }
+    for (uint8_t i = 0; i < coilStaticCount && i < MAX_STATIC_COILS; i++) {
+      uint16_t c = coilStaticIdx[i];
+      bool keep = c >= NUM_COILS || timers_hasCoil(c);
+      for (uint8_t j = 0; j < cfg.coilStaticCount && j < MAX_STATIC_COILS && !keep; j++) {
+        keep = (cfg.coilStaticIdx[j] == c);
+      }
+      if (!keep) {
+        bitWriteArray(coils, c, false);
+        gpioChanged = true;     // coil-mappet pin drives fra ny værdi
+      }
+    }
+  }
+
+  // --- Statiske registre (adresser + værdier), kun nye/ændrede skrives ---
+  uint8_t oldRegCount = regStaticCount;
+  regStaticCount = cfg.regStaticCount;
+  for (uint8_t i = 0; i < regStaticCount && i < MAX_STATIC_REGS; i++) {
+    bool same = !full && i < oldRegCount &&
+                regStaticAddr[i] == cfg.regStaticAddr[i] &&
+                regStaticVal[i]  == cfg.regStaticVal[i];
+    regStaticAddr[i] = cfg.regStaticAddr[i];
+    regStaticVal[i]  = cfg.regStaticVal[i];
+    if (!same && regStaticAddr[i] < NUM_REGS)
+      holdingRegs[regStaticAddr[i]] = regStaticVal[i];
+  }
+
+  // --- Statiske coils (indeks + værdier), kun nye/ændrede skrives ---
+  uint8_t oldCoilCount = coilStaticCount;
   coilStaticCount = cfg.coilStaticCount;
+  for (uint8_t i = 0; i < coilStaticCount && i < MAX_STATIC_COILS; i++) {
+    bool same = !full && i < oldCoilCount &&
+                coilStaticIdx[i] == cfg.coilStaticIdx[i] &&
+                coilStaticVal[i] == cfg.coilStaticVal[i];
+    coilStaticIdx[i] = cfg.coilStaticIdx[i];
+    coilStaticVal[i] = cfg.coilStaticVal[i];
+    if (!same && coilStaticIdx[i] < NUM_COILS) {
+      bitWriteArray(coils, coilStaticIdx[i], (coilStaticVal[i] != 0));
+      gpioChanged = true;       // coil-mappet pin drives fra ny værdi
+    }
+  }
 
-  // --- Gendan statiske registre (adresser + værdier) ---
-for (uint8_t i = 0; i < regStaticCount && i < MAX_STATIC_REGS; i++) {
-  regStaticAddr[i] = cfg.regStaticAddr[i];
-  regStaticVal[i]  = cfg.regStaticVal[i];
-  if (regStaticAddr[i] < NUM_REGS)
-    holdingRegs[regStaticAddr[i]] = regStaticVal[i];
-}
+  // GPIO mirror-plan + direkte drive (v3.8.3), efter statiske coils
+  if (gpioChanged) gpio_plan_rebuild();
 
-// --- Gendan statiske coils (indeks + værdier) ---
-for (uint8_t i = 0; i < coilStaticCount && i < MAX_STATIC_COILS; i++) {
-  coilStaticIdx[i] = cfg.coilStaticIdx[i];
-  coilStaticVal[i] = cfg.coilStaticVal[i];
-  if (coilStaticIdx[i] < NUM_COILS)
-    bitWriteArray(coils, coilStaticIdx[i], (coilStaticVal[i] != 0));
-}
+  // --- Timers: hvilke skal re-initialiseres ---
+  bool waveChanged = full || memcmp(&cfg.timerWave, &timerWave, sizeof(timerWave)) != 0;
+  uint8_t tReset = 0;
+  for (uint8_t i = 0; i < 4; i++) {
+    // Beholdes live-blokken, ejer master T/P (skrevet via FC06/FC16)
+    bool liveParams = cfg.timerParamReg[i] != 0 && cfg.timerParamReg[i] == timerParamReg[i];
+    if (full ||
+        !timers_config_same(i + 1, cfg.timer[i], liveParams) ||
+        cfg.timerParamReg[i] != timerParamReg[i] ||
+        cfg.timerSeqReg[i]   != timerSeqReg[i] ||
+        cfg.timerTrigPin[i]  != timerTrigPin[i] ||
+        (waveChanged && (timers[i].mode == TM_WAVE || cfg.timer[i].mode == TM_WAVE))) {
+      tReset |= (uint8_t)(1u << i);
+    }
+    timers[i].statusRoEnable = cfg.timer[i].statusRoEnable;
+  }
 
+  if (full) {
+    timers_init();
+  } else {
+    // Stop ændrede timere først, så waveform/trigger er frie til den nye config
+    for (uint8_t i = 0; i < 4; i++) {
+      if (!(tReset & (1u << i))) continue;
+      TimerConfig off = timers[i];
+      off.enabled = 0;
+      timers_config_set(i + 1, off);
+    }
+  }
+  for (uint8_t i = 0; i < 4; i++) {
+    if (tReset & (1u << i)) trig_pin_set(i, 0);   // gendannes efter counters
+  }
 
-  // --- Timers ---
-  timers_init();
-  if (timerStatusCtrlRegIndex < NUM_REGS)
+  // Reg-blokke må ikke overlappe (regmap_owner): sluk ændrede blokke først,
+  // så en blok der flytter ind hvor en anden lå, ikke afvises. De sættes
+  // igen nedenfor, fordi de nu afviger fra cfg.
+  if (!full) {
+    for (uint8_t i = 0; i < 4; ++i) {
+      if (cfg.timerParamReg[i] != timerParamReg[i]) timers_param_reg_set(i, 0);
+      if (cfg.timerSeqReg[i] != timerSeqReg[i]) seq_reg_set(i, 0);
+      if (memcmp(&cfg.counterCompare[i], &counterCompare[i], sizeof(CounterCompareConfig)) != 0) {
+        CounterCompareConfig off;
+        memset(&off, 0, sizeof(off));
+        cmp_config_set(i, off);
+      }
+      if (memcmp(&cfg.counterEdgeLog[i], &counterEdgeLog[i], sizeof(CounterEdgeLogConfig)) != 0) {
+        CounterEdgeLogConfig off;
+        memset(&off, 0, sizeof(off));
+        edgelog_config_set(i, off);
+      }
+      if (memcmp(&cfg.counterPwm[i], &counterPwm[i], sizeof(CounterPwmConfig)) != 0) {
+        CounterPwmConfig off;
+        memset(&off, 0, sizeof(off));
+        pwm_config_set(i, off);
+      }
+      if (memcmp(&cfg.counterGateWin[i], &counterGateWin[i], sizeof(CounterGateWindowConfig)) != 0) {
+        CounterGateWindowConfig off;
+        memset(&off, 0, sizeof(off));
+        gatewin_config_set(i, off);
+      }
+      if (cfg.counterRateReg[i] != counterRateReg[i]) rate_config_set(i, 0);
+    }
+    if (waveChanged) {
+      TimerWaveConfig off;
+      memset(&off, 0, sizeof(off));
+      wave_config_set(off);
+    }
+    if (cfg.snapshotReg != snapshotReg || cfg.snapshotPin != snapshotPin) snapshot_config_set(0, 0);
+    if (cfg.profileReg != profileReg) profile_config_set(0);
+  }
+  if (ctrlChanged && timerStatusCtrlRegIndex < NUM_REGS)
     holdingRegs[timerStatusCtrlRegIndex] = 0;
 
-  // Load ALL 4 timers from config (enabled flag in struct determines if active)
+  // Waveform reg-blok/pin (v21) før timere, så mode 5 kan binde sig.
+  // Ugyldig blok eller pin optaget af GPIO-mapping -> slukket
+  if (waveChanged && !wave_config_set(cfg.timerWave)) {
+    TimerWaveConfig off;
+    memset(&off, 0, sizeof(off));
+    wave_config_set(off);
+  }
+
+  // Trin-program blokke (v23) før timere, så mode 6 nulstiller kontrol-reg
+  for (uint8_t i = 0; i < 4; i++) {
+    if (!(tReset & (1u << i))) continue;
+    if (!seq_reg_set(i, cfg.timerSeqReg[i])) seq_reg_set(i, 0);
+  }
+
+  // Timers from config (enabled flag in struct determines if active)
   for (uint8_t i = 0; i < 4; i++) {
     // Use timers_config_set() to apply config (handles GPIO conflicts)
-    timers_config_set(cfg.timer[i].id, cfg.timer[i]);
+    if (tReset & (1u << i)) timers_config_set(cfg.timer[i].id, cfg.timer[i]);
+  }
+
+  // Live timer-parametre (v22) - publicerer de indlæste T/P i reg-blokken
+  for (uint8_t i = 0; i < 4; i++) {
+    if (!(tReset & (1u << i))) continue;
+    if (!timers_param_reg_set(i, cfg.timerParamReg[i])) timers_param_reg_set(i, 0);
   }
 
   // --- Counters ---
-  counters_init();
+  if (full) counters_init();
 
-  // Gendan counter reset-on-read enable flags og auto-start enable flags
+  // Gendan counter reset-on-read, auto-start og input-filter (læses live)
+  uint8_t rorChanged = 0, autoChanged = 0;
   for (uint8_t i = 0; i < 4; ++i) {
+    if (counterResetOnReadEnable[i] != cfg.counterResetOnReadEnable[i]) rorChanged |= (uint8_t)(1u << i);
+    if (counterAutoStartEnable[i] != cfg.counterAutoStartEnable[i]) autoChanged |= (uint8_t)(1u << i);
     counterResetOnReadEnable[i] = cfg.counterResetOnReadEnable[i];
     counterAutoStartEnable[i] = cfg.counterAutoStartEnable[i];
+    // Filter-ændring genopbygger polling-planen (også for uændrede counters)
+    if (counterFilterUs[i] != cfg.counterFilterUs[i]) counters_filter_set(i + 1, cfg.counterFilterUs[i]);
+  }
+
+  // Counters from config (enabled flag in struct determines if active).
+  // Diff: uændret -> intet røres, kun scale/registre -> værdi bevares
+  // cUpdated: kun scale/registre ændret (controlReg kan være flyttet)
+  uint8_t cReset = 0, cUpdated = 0;
+  for (uint8_t i = 0; i < 4; i++) {
+    if (full) {
+      counters_config_set(cfg.counter[i].id, cfg.counter[i]);
+      cReset |= (uint8_t)(1u << i);
+      continue;
+    }
+    uint8_t r = counters_config_diff_set(i + 1, cfg.counter[i]);
+    if (r == CNT_CFG_RESET)   cReset   |= (uint8_t)(1u << i);
+    if (r == CNT_CFG_UPDATED) cUpdated |= (uint8_t)(1u << i);
   }
 
-  // Load ALL 4 counters from config (enabled flag in struct determines if active)
+  // Auto-start ændret for counters der ikke blev re-initialiseret:
+  // start/stop nu (counters_config_set gør det selv ved reset)
   for (uint8_t i = 0; i < 4; i++) {
-    counters_config_set(cfg.counter[i].id, cfg.counter[i]);
+    if (full || (cReset & (1u << i)) || !(autoChanged & (1u << i))) continue;
+    if (counters[i].enabled) counters_set_running(i + 1, counterAutoStartEnable[i]);
+  }
+
+  // Polling-planen (PINx-bit pr. discrete input, filtervindue) bygges kun
+  // af counters_config_set(); uændrede counters skal se ny GPIO-mapping
+  if (!full && gpioChanged) counters_poll_plan_rebuild();
+
+  // Retentive counters (v25) - gendan værdi før compare/rate/vindue
+  // tager baseline fra counterValue
+  for (uint8_t i = 0; i < 4; ++i) {
+    if ((cReset & (1u << i)) ||
+        memcmp(&cfg.counterRetain[i], &counterRetain[i], sizeof(CounterRetainConfig)) != 0) {
+      retain_config_set(i, cfg.counterRetain[i]);
+    }
+  }
+  retain_restore();
+
+  // Udvidelses-blokke pr. counter: kun ved ændring eller re-init counter.
+  // Ugyldig blok i EEPROM -> slukket. Ændrede blokke er slukket ovenfor.
+  for (uint8_t i = 0; i < 4; ++i) {
+    bool reinit = (cReset & (1u << i)) != 0;
+
+    // Compare-setpoints (v15)
+    if (reinit || memcmp(&cfg.counterCompare[i], &counterCompare[i], sizeof(CounterCompareConfig)) != 0) {
+      if (!cmp_config_set(i, cfg.counterCompare[i])) {
+        CounterCompareConfig off;
+        memset(&off, 0, sizeof(off));
+        cmp_config_set(i, off);
+      }
+    }
+
+    // Edge-tidsstempel ringe (v17)
+    if (reinit || memcmp(&cfg.counterEdgeLog[i], &counterEdgeLog[i], sizeof(CounterEdgeLogConfig)) != 0) {
+      if (!edgelog_config_set(i, cfg.counterEdgeLog[i])) {
+        CounterEdgeLogConfig off;
+        memset(&off, 0, sizeof(off));
+        edgelog_config_set(i, off);
+      }
+    }
+
+    // Pulsbredde-måling (v18) - efter counters (kræver SW-ISR counter)
+    if (reinit || memcmp(&cfg.counterPwm[i], &counterPwm[i], sizeof(CounterPwmConfig)) != 0) {
+      if (!pwm_config_set(i, cfg.counterPwm[i])) {
+        CounterPwmConfig off;
+        memset(&off, 0, sizeof(off));
+        pwm_config_set(i, off);
+      }
+    }
+
+    // Gate / tidsvindue (v19)
+    if (reinit || memcmp(&cfg.counterGateWin[i], &counterGateWin[i], sizeof(CounterGateWindowConfig)) != 0) {
+      if (!gatewin_config_set(i, cfg.counterGateWin[i])) {
+        CounterGateWindowConfig off;
+        memset(&off, 0, sizeof(off));
+        gatewin_config_set(i, off);
+      }
+    }
+
+    // Rate/totalizer (v20) - ingen slot -> slukket med advarsel
+    if (reinit || cfg.counterRateReg[i] != counterRateReg[i]) {
+      if (!rate_config_set(i, cfg.counterRateReg[i])) {
+        if (!rate_slot_available(i)) {
+          Serial.print(F("! Counter ")); Serial.print(i + 1);
+          Serial.println(F(" rate: no free slot - rate off"));
+        }
+        rate_config_set(i, 0);
+      }
+    }
+  }
+
+  // Snapshot-latch (v16) - efter counters så interrupt-pins er kendt.
+  // Konflikt med SW-ISR pin -> behold blok uden trigger-pin.
+  if (full || cfg.snapshotReg != snapshotReg || cfg.snapshotPin != snapshotPin) {
+    if (!snapshot_config_set(cfg.snapshotReg, cfg.snapshotPin)) {
+      if (!snapshot_config_set(cfg.snapshotReg, 0)) snapshot_config_set(0, 0);
+    }
+  }
+
+  // Timer trigger-pins (v24) - efter counters/snapshot, som beholder
+  // deres interrupt-pins ved konflikt (timeren falder tilbage til polling)
+  for (uint8_t i = 0; i < 4; ++i) {
+    if (!(tReset & (1u << i))) continue;
+    if (!trig_pin_set(i, cfg.timerTrigPin[i])) trig_pin_set(i, 0);
+  }
+
+  // Profil-vælger (v26) - ugyldig blok -> slukket
+  profileActive = cfg.profileActive;
+  if (full || cfg.profileReg != profileReg) {
+    if (!profile_config_set(cfg.profileReg)) profile_config_set(0);
+  }
+
+  // Counter sampler (v13) - ugyldig rate i EEPROM -> slukket
+  if (full || cfg.samplerHz != sampler_rate_hz()) {
+    if (!counters_sampler_set(cfg.samplerHz)) {
+      counters_sampler_set(0);
+    }
   }
 
   // Sync bit 3 (reset-on-read) i controlReg fra counterResetOnReadEnable array
   for (uint8_t i = 0; i < 4; ++i) {
+    if (!((cReset | cUpdated | rorChanged) & (1u << i))) continue;
     if (counters[i].enabled && counters[i].controlReg < NUM_REGS) {
       if (counterResetOnReadEnable[i]) {
         holdingRegs[counters[i].controlReg] |= 0x0008;  // set bit 3
@@ -511,7 +917,4 @@ for (uint8_t i = 0; i < coilStaticCount && i < MAX_STATIC_COILS; i++) {
       }
     }
   }
-
-  // --- GPIO mapping already restored at the beginning of configApply() ---
-  // No need to restore again here
 }
@@ -0,0 +1,473 @@
+// ============================================================================
+//  Filnavn : config_tlv.cpp
+//  Projekt  : Modbus RTU Server / CLI
+//  Version  : v3.9.6 (2026-10-18)
+//  Forfatter: JanG at modbus_slave@laces.dk
+//  Formål   : TLV config-image (se config_tlv.h). Records streames direkte
+//             mellem PersistConfig og EEPROM-slot.
+//  Ændringer:
+//    - v3.9.6: config_tlv_write()/config_tlv_load_at() deles med
+//              config-profiler; profileReg/profileActive i system-record
+//    - v3.9.6: Timer/counter-records indeholder kun konfig-felter (nye tags
+//              0x13/0x27); gamle hel-struct records (0x10/0x20) læses stadig
+// ============================================================================
+
+#include "config_tlv.h"
+#include "config_eeprom.h"
+#include <avr/eeprom.h>
+#include <string.h>
+
+// Record-structs (felter tilføjes kun sidst)
+struct TlvSystem {
+  uint8_t  slaveId;
+  uint8_t  serverFlag;
+  uint32_t baud;
+  uint16_t timerStatusReg;
+  uint16_t timerStatusCtrlReg;
+  uint16_t samplerHz;
+  uint16_t snapshotReg;
+  uint8_t  snapshotPin;
+  uint16_t profileReg;      // v3.9.6
+  uint8_t  profileActive;   // v3.9.6
+};
+
+struct TlvStaticReg  { uint16_t addr; uint16_t val; };
+struct TlvStaticCoil { uint16_t idx;  uint8_t  val; };
+struct TlvGpio       { uint8_t pin; int16_t coil; int16_t input; };
+struct TlvTimerRegs  { uint16_t paramReg; uint16_t seqReg; uint8_t trigPin; };
+
+struct TlvCounterOpt {
+  uint8_t  resetOnRead;
+  uint8_t  autoStart;
+  uint16_t filterUs;
+  uint16_t rateReg;
+};
+
+// Kun konfigurerede felter fra TimerConfig/CounterConfig; runtime-felter
+// (fase, tællerværdi, frekvens, tidsstempler) gemmes ikke
+struct TlvTimer {
+  uint8_t  id;
+  uint8_t  enabled;
+  uint8_t  mode;
+  uint8_t  subMode;
+  uint8_t  p1High;
+  uint8_t  p2High;
+  uint8_t  p3High;
+  uint32_t T1;
+  uint32_t T2;
+  uint32_t T3;
+  uint16_t coil;
+  uint16_t trigIndex;
+  uint8_t  trigEdge;
+  uint8_t  statusRoEnable;
+};
+
+struct TlvCounter {
+  uint8_t  id;
+  uint8_t  enabled;
+  uint8_t  hwMode;
+  uint8_t  edgeMode;
+  uint8_t  direction;
+  uint8_t  bitWidth;
+  uint16_t prescaler;
+  uint16_t inputIndex;
+  uint8_t  interruptPin;
+  uint16_t regIndex;
+  uint16_t rawReg;
+  uint16_t freqReg;
+  uint16_t controlReg;
+  uint16_t overflowReg;
+  uint32_t startValue;
+  float    scale;
+  uint8_t  debounceEnable;
+  uint16_t debounceTimeMs;
+  uint16_t controlFlags;
+};
+
+static void sys_from_cfg(TlvSystem& sys, const PersistConfig& cfg) {
+  sys.slaveId            = cfg.slaveId;
+  sys.serverFlag         = cfg.serverFlag;
+  sys.baud               = cfg.baud;
+  sys.timerStatusReg     = cfg.timerStatusReg;
+  sys.timerStatusCtrlReg = cfg.timerStatusCtrlReg;
+  sys.samplerHz          = cfg.samplerHz;
+  sys.snapshotReg        = cfg.snapshotReg;
+  sys.snapshotPin        = cfg.snapshotPin;
+  sys.profileReg         = cfg.profileReg;
+  sys.profileActive      = cfg.profileActive;
+}
+
+static void timer_to_tlv(TlvTimer& r, const TimerConfig& t) {
+  r.id             = t.id;
+  r.enabled        = t.enabled;
+  r.mode           = t.mode;
+  r.subMode        = t.subMode;
+  r.p1High         = t.p1High;
+  r.p2High         = t.p2High;
+  r.p3High         = t.p3High;
+  r.T1             = t.T1;
+  r.T2             = t.T2;
+  r.T3             = t.T3;
+  r.coil           = t.coil;
+  r.trigIndex      = t.trigIndex;
+  r.trigEdge       = t.trigEdge;
+  r.statusRoEnable = t.statusRoEnable;
+}
+
+// Runtime-felter nulstilles
+static void timer_from_tlv(TimerConfig& t, const TlvTimer& r) {
+  memset(&t, 0, sizeof(t));
+  t.id             = r.id;
+  t.enabled        = r.enabled;
+  t.mode           = r.mode;
+  t.subMode        = r.subMode;
+  t.p1High         = r.p1High;
+  t.p2High         = r.p2High;
+  t.p3High         = r.p3High;
+  t.T1             = r.T1;
+  t.T2             = r.T2;
+  t.T3             = r.T3;
+  t.coil           = r.coil;
+  t.trigIndex      = r.trigIndex;
+  t.trigEdge       = r.trigEdge;
+  t.statusRoEnable = r.statusRoEnable;
+}
+
+static void counter_to_tlv(TlvCounter& r, const CounterConfig& c) {
+  r.id             = c.id;
+  r.enabled        = c.enabled;
+  r.hwMode         = c.hwMode;
+  r.edgeMode       = c.edgeMode;
+  r.direction      = c.direction;
+  r.bitWidth       = c.bitWidth;
+  r.prescaler      = c.prescaler;
+  r.inputIndex     = c.inputIndex;
+  r.interruptPin   = c.interruptPin;
+  r.regIndex       = c.regIndex;
+  r.rawReg         = c.rawReg;
+  r.freqReg        = c.freqReg;
+  r.controlReg     = c.controlReg;
+  r.overflowReg    = c.overflowReg;
+  r.startValue     = c.startValue;
+  r.scale          = c.scale;
+  r.debounceEnable = c.debounceEnable;
+  r.debounceTimeMs = c.debounceTimeMs;
+  r.controlFlags   = c.controlFlags;
+}
+
+// Runtime-felter nulstilles
+static void counter_from_tlv(CounterConfig& c, const TlvCounter& r) {
+  memset(&c, 0, sizeof(c));
+  c.id             = r.id;
+  c.enabled        = r.enabled;
+  c.hwMode         = r.hwMode;
+  c.edgeMode       = r.edgeMode;
+  c.direction      = r.direction;
+  c.bitWidth       = r.bitWidth;
+  c.prescaler      = r.prescaler;
+  c.inputIndex     = r.inputIndex;
+  c.interruptPin   = r.interruptPin;
+  c.regIndex       = r.regIndex;
+  c.rawReg         = r.rawReg;
+  c.freqReg        = r.freqReg;
+  c.controlReg     = r.controlReg;
+  c.overflowReg    = r.overflowReg;
+  c.startValue     = r.startValue;
+  c.scale          = r.scale;
+  c.debounceEnable = r.debounceEnable;
+  c.debounceTimeMs = r.debounceTimeMs;
+  c.controlFlags   = r.controlFlags;
+}
+
+static_assert(sizeof(TimerConfig) < 255 && sizeof(CounterConfig) < 255,
+              "TLV record længde er 8-bit");
+
+// ============================================================================
+// Skrivning
+// ============================================================================
+static bool tlv_put(uint8_t tag, const void* a, uint8_t la,
+                    const void* b = nullptr, uint8_t lb = 0) {
+  uint8_t hdr[2] = {tag, (uint8_t)(la + lb)};
+  if (!eeprom_stream_append(hdr, sizeof(hdr))) return false;
+  if (!eeprom_stream_append(a, la)) return false;
+  return lb == 0 || eeprom_stream_append(b, lb);
+}
+
+// Indekseret record: idx + struct
+static bool tlv_put_idx(uint8_t tag, uint8_t idx, const void* v, uint8_t len) {
+  return tlv_put(tag, &idx, 1, v, len);
+}
+
+static bool is_zero(const void* p, uint8_t len) {
+  const uint8_t* b = static_cast<const uint8_t*>(p);
+  for (uint8_t i = 0; i < len; ++i) {
+    if (b[i]) return false;
+  }
+  return true;
+}
+
+bool config_tlv_write(const PersistConfig& cfg) {
+  uint16_t magic = CONFIG_TLV_MAGIC;
+  uint8_t schema = CONFIG_SCHEMA;
+  bool ok = eeprom_stream_append(&magic, sizeof(magic)) &&
+            eeprom_stream_append(&schema, sizeof(schema));
+
+  TlvSystem sys;
+  sys_from_cfg(sys, cfg);
+  ok = ok && tlv_put(TLV_SYSTEM, &sys, sizeof(sys));
+
+  uint8_t hlen = (uint8_t)strnlen(cfg.hostname, sizeof(cfg.hostname));
+  if (hlen) ok = ok && tlv_put(TLV_HOSTNAME, cfg.hostname, hlen);
+
+  for (uint8_t i = 0; ok && i < cfg.regStaticCount && i < MAX_STATIC_REGS; ++i) {
+    TlvStaticReg r = {cfg.regStaticAddr[i], cfg.regStaticVal[i]};
+    ok = tlv_put(TLV_STATIC_REG, &r, sizeof(r));
+  }
+  for (uint8_t i = 0; ok && i < cfg.coilStaticCount && i < MAX_STATIC_COILS; ++i) {
+    TlvStaticCoil c = {cfg.coilStaticIdx[i], cfg.coilStaticVal[i]};
+    ok = tlv_put(TLV_STATIC_COIL, &c, sizeof(c));
+  }
+  for (uint8_t p = 0; ok && p < NUM_GPIO; ++p) {
+    if (cfg.gpioToCoil[p] < 0 && cfg.gpioToInput[p] < 0) continue;
+    TlvGpio g = {p, cfg.gpioToCoil[p], cfg.gpioToInput[p]};
+    ok = tlv_put(TLV_GPIO, &g, sizeof(g));
+  }
+
+  // Timere
+  for (uint8_t i = 0; ok && i < 4; ++i) {
+    if (cfg.timer[i].enabled) {
+      TlvTimer t;
+      timer_to_tlv(t, cfg.timer[i]);
+      ok = tlv_put_idx(TLV_TIMER, i, &t, sizeof(t));
+    }
+    TlvTimerRegs tr = {cfg.timerParamReg[i], cfg.timerSeqReg[i], cfg.timerTrigPin[i]};
+    if (ok && !is_zero(&tr, sizeof(tr))) {
+      ok = tlv_put_idx(TLV_TIMER_REGS, i, &tr, sizeof(tr));
+    }
+  }
+  if (ok && !is_zero(&cfg.timerWave, sizeof(cfg.timerWave))) {
+    ok = tlv_put(TLV_WAVE, &cfg.timerWave, sizeof(cfg.timerWave));
+  }
+
+  // Counters + udvidelser
+  for (uint8_t i = 0; ok && i < 4; ++i) {
+    if (cfg.counter[i].enabled) {
+      TlvCounter c;
+      counter_to_tlv(c, cfg.counter[i]);
+      ok = tlv_put_idx(TLV_COUNTER, i, &c, sizeof(c));
+    }
+    TlvCounterOpt o = {cfg.counterResetOnReadEnable[i], cfg.counterAutoStartEnable[i],
+                       cfg.counterFilterUs[i], cfg.counterRateReg[i]};
+    if (ok && !is_zero(&o, sizeof(o))) {
+      ok = tlv_put_idx(TLV_COUNTER_OPT, i, &o, sizeof(o));
+    }
+    if (ok && cfg.counterCompare[i].reg != 0) {
+      ok = tlv_put_idx(TLV_COMPARE, i, &cfg.counterCompare[i], sizeof(CounterCompareConfig));
+    }
+    if (ok && cfg.counterEdgeLog[i].reg != 0) {
+      ok = tlv_put_idx(TLV_EDGELOG, i, &cfg.counterEdgeLog[i], sizeof(CounterEdgeLogConfig));
+    }
+    if (ok && cfg.counterPwm[i].reg != 0) {
+      ok = tlv_put_idx(TLV_PWM, i, &cfg.counterPwm[i], sizeof(CounterPwmConfig));
+    }
+    if (ok && !is_zero(&cfg.counterGateWin[i], sizeof(CounterGateWindowConfig))) {
+      ok = tlv_put_idx(TLV_GATEWIN, i, &cfg.counterGateWin[i], sizeof(CounterGateWindowConfig));
+    }
+    if (ok && !is_zero(&cfg.counterRetain[i], sizeof(CounterRetainConfig))) {
+      ok = tlv_put_idx(TLV_RETAIN, i, &cfg.counterRetain[i], sizeof(CounterRetainConfig));
+    }
+  }
+
+  return ok;
+}
+
+int8_t config_tlv_save(const PersistConfig& cfg) {
+  eeprom_slot_begin();
+  if (!config_tlv_write(cfg)) {
+    eeprom_slot_commit();           // afviser (overflow) - aktiv slot urørt
+    return -2;
+  }
+  return eeprom_slot_commit();
+}
+
+// ============================================================================
+// Læsning
+// ============================================================================
+// Læs min(len, size) bytes fra EEPROM; resten af dst beholder sin default
+static void tlv_read(void* dst, uint16_t size, uint16_t src, uint8_t len) {
+  uint16_t n = (len < size) ? len : size;
+  eeprom_read_block(dst, reinterpret_cast<const void*>(src), n);
+}
+
+static void tlv_apply(PersistConfig& cfg, uint8_t tag, uint16_t src, uint8_t len) {
+  // Indekserede records: value[0] = idx (0..3)
+  uint8_t idx = 0;
+  if (tag >= TLV_TIMER_V1 && tag != TLV_WAVE) {
+    if (len < 1) return;
+    idx = eeprom_read_byte(reinterpret_cast<const uint8_t*>(src));
+    if (idx >= 4) return;
+    src++;
+    len--;
+  }
+
+  switch (tag) {
+    case TLV_SYSTEM: {
+      TlvSystem sys;
+      sys_from_cfg(sys, cfg);       // kortere record -> resten uændret
+      tlv_read(&sys, sizeof(sys), src, len);
+      cfg.slaveId            = sys.slaveId;
+      cfg.serverFlag         = sys.serverFlag;
+      cfg.baud               = sys.baud;
+      cfg.timerStatusReg     = sys.timerStatusReg;
+      cfg.timerStatusCtrlReg = sys.timerStatusCtrlReg;
+      cfg.samplerHz          = sys.samplerHz;
+      cfg.snapshotReg        = sys.snapshotReg;
+      cfg.snapshotPin        = sys.snapshotPin;
+      cfg.profileReg         = sys.profileReg;
+      cfg.profileActive      = sys.profileActive;
+      break;
+    }
+    case TLV_HOSTNAME:
+      memset(cfg.hostname, 0, sizeof(cfg.hostname));
+      tlv_read(cfg.hostname, sizeof(cfg.hostname) - 1, src, len);
+      break;
+    case TLV_STATIC_REG:
+      if (cfg.regStaticCount < MAX_STATIC_REGS) {
+        TlvStaticReg r = {0, 0};
+        tlv_read(&r, sizeof(r), src, len);
+        cfg.regStaticAddr[cfg.regStaticCount] = r.addr;
+        cfg.regStaticVal[cfg.regStaticCount]  = r.val;
+        cfg.regStaticCount++;
+      }
+      break;
+    case TLV_STATIC_COIL:
+      if (cfg.coilStaticCount < MAX_STATIC_COILS) {
+        TlvStaticCoil c = {0, 0};
+        tlv_read(&c, sizeof(c), src, len);
+        cfg.coilStaticIdx[cfg.coilStaticCount] = c.idx;
+        cfg.coilStaticVal[cfg.coilStaticCount] = c.val ? 1 : 0;
+        cfg.coilStaticCount++;
+      }
+      break;
+    case TLV_GPIO: {
+      TlvGpio g = {0xFF, -1, -1};
+      tlv_read(&g, sizeof(g), src, len);
+      if (g.pin < NUM_GPIO) {
+        cfg.gpioToCoil[g.pin]  = g.coil;
+        cfg.gpioToInput[g.pin] = g.input;
+      }
+      break;
+    }
+    case TLV_TIMER: {
+      TlvTimer r;
+      timer_to_tlv(r, cfg.timer[idx]);    // kortere record -> resten uændret
+      tlv_read(&r, sizeof(r), src, len);
+      timer_from_tlv(cfg.timer[idx], r);
+      if (cfg.timer[idx].enabled) cfg.timerCount++;
+      break;
+    }
+    case TLV_TIMER_V1: {
+      // Hel TimerConfig (før v3.9.6): kun konfig-felterne bruges
+      TimerConfig t = cfg.timer[idx];
+      tlv_read(&t, sizeof(t), src, len);
+      TlvTimer r;
+      timer_to_tlv(r, t);
+      timer_from_tlv(cfg.timer[idx], r);
+      if (cfg.timer[idx].enabled) cfg.timerCount++;
+      break;
+    }
+    case TLV_TIMER_REGS: {
+      TlvTimerRegs tr = {0, 0, 0};
+      tlv_read(&tr, sizeof(tr), src, len);
+      cfg.timerParamReg[idx] = tr.paramReg;
+      cfg.timerSeqReg[idx]   = tr.seqReg;
+      cfg.timerTrigPin[idx]  = tr.trigPin;
+      break;
+    }
+    case TLV_WAVE:
+      tlv_read(&cfg.timerWave, sizeof(cfg.timerWave), src, len);
+      break;
+    case TLV_COUNTER: {
+      TlvCounter r;
+      counter_to_tlv(r, cfg.counter[idx]);
+      tlv_read(&r, sizeof(r), src, len);
+      counter_from_tlv(cfg.counter[idx], r);
+      if (cfg.counter[idx].enabled) cfg.counterCount++;
+      break;
+    }
+    case TLV_COUNTER_V1: {
+      // Hel CounterConfig (før v3.9.6): kun konfig-felterne bruges
+      CounterConfig c = cfg.counter[idx];
+      tlv_read(&c, sizeof(c), src, len);
+      TlvCounter r;
+      counter_to_tlv(r, c);
+      counter_from_tlv(cfg.counter[idx], r);
+      if (cfg.counter[idx].enabled) cfg.counterCount++;
+      break;
+    }
+    case TLV_COUNTER_OPT: {
+      TlvCounterOpt o = {0, 0, 0, 0};
+      tlv_read(&o, sizeof(o), src, len);
+      cfg.counterResetOnReadEnable[idx] = o.resetOnRead;
+      cfg.counterAutoStartEnable[idx]   = o.autoStart;
+      cfg.counterFilterUs[idx]          = o.filterUs;
+      cfg.counterRateReg[idx]           = o.rateReg;
+      break;
+    }
+    case TLV_COMPARE:
+      tlv_read(&cfg.counterCompare[idx], sizeof(CounterCompareConfig), src, len);
+      break;
+    case TLV_EDGELOG:
+      tlv_read(&cfg.counterEdgeLog[idx], sizeof(CounterEdgeLogConfig), src, len);
+      break;
+    case TLV_PWM:
+      tlv_read(&cfg.counterPwm[idx], sizeof(CounterPwmConfig), src, len);
+      break;
+    case TLV_GATEWIN:
+      tlv_read(&cfg.counterGateWin[idx], sizeof(CounterGateWindowConfig), src, len);
+      break;
+    case TLV_RETAIN:
+      tlv_read(&cfg.counterRetain[idx], sizeof(CounterRetainConfig), src, len);
+      break;
+    default:
+      break;                        // ukendt tag (nyere firmware) - spring over
+  }
+}
+
+static bool tlv_image(uint8_t slot, uint16_t& addr, uint16_t& len) {
+  if (!eeprom_slot_info(slot, addr, len) || len < 3) return false;
+  uint16_t magic;
+  eeprom_read_block(&magic, reinterpret_cast<const void*>(addr), sizeof(magic));
+  return magic == CONFIG_TLV_MAGIC;
+}
+
+bool config_tlv_is(uint8_t slot) {
+  uint16_t addr, len;
+  return tlv_image(slot, addr, len);
+}
+
+bool config_tlv_load(uint8_t slot, PersistConfig& cfg) {
+  uint16_t addr, len;
+  if (!tlv_image(slot, addr, len)) return false;
+  return config_tlv_load_at(addr, len, cfg);
+}
+
+bool config_tlv_load_at(uint16_t addr, uint16_t len, PersistConfig& cfg) {
+  uint16_t magic;
+  if (len < 3) return false;
+  eeprom_read_block(&magic, reinterpret_cast<const void*>(addr), sizeof(magic));
+  if (magic != CONFIG_TLV_MAGIC) return false;
+
+  configDefaults(cfg);
+  uint16_t pos = 3;                 // magic + skriverens schema
+  while (pos + 2 <= len) {
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(addr + pos);
+    uint8_t tag = eeprom_read_byte(p);
+    uint8_t rlen = eeprom_read_byte(p + 1);
+    pos += 2;
+    if (pos + rlen > len) return false;   // afkortet record
+    tlv_apply(cfg, tag, addr + pos, rlen);
+    pos += rlen;
+  }
+  return pos == len;
+}
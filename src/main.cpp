@@ -7,18 +7,27 @@
 #include <Arduino.h>
 #include "modbus_core.h"
 #include "version.h"
+#include "modbus_idle.h"
 #include <avr/wdt.h>
 
 // Global config (avoid stack overflow - struct is >1KB)
 PersistConfig globalConfig;
 
+// Kort banner efter Modbus er klar; TX-bufferen er 64 bytes, så alt ud
+// over det blokerer setup() (~87 us/tegn ved 115200). Fuld config-dump
+// fås med 'show config dump'.
 static void print_banner() {
-  Serial.println(F("=== MODBUS RTU SLAVE ==="));
-  Serial.print(F("Version: ")); Serial.println(F(VERSION_STRING_NY));
-  Serial.print(F("Build: "));   Serial.println(F(VERSION_BUILD));
-  Serial.println(F("==============================================="));
+  Serial.print(F("=== MODBUS RTU SLAVE ")); Serial.print(F(VERSION_STRING_NY));
+  Serial.print(F(" | ID ")); Serial.print(currentSlaveID);
+  Serial.print(F(" | ")); Serial.print(currentBaudrate);
+  Serial.println(serverRunning ? F(" | RUNNING") : F(" | STOPPED"));
+  Serial.println(F("% Type CLI to enter (115200, NL/CR)"));
 }
 
+// Boot-sti (v3.9.4): ingen delay, intet config-dump, UART startes én gang.
+// Modbus lytter når setup() returnerer; tiden publiceres i input-reg 99
+// (klar) og 111 (første accepterede frame), målt fra sketch-start
+// (millis) - bootloader-tid før sketchen er ikke medregnet.
 void setup() {
   // Disable watchdog immediately (prevent boot loop on EEPROM issues)
   wdt_disable();
@@ -26,14 +35,11 @@ void setup() {
   // CRITICAL: Disable Timer5 interrupt before any other init (v3.6.1+)
   // This prevents ISR corruption of Serial/timing during boot
   // NOTE: Timer5 is the ONLY timer used for HW counters on Arduino Mega
-  // Timer1, Timer3, Timer4 are not routed to headers and not implemented
+  // Timer1 = waveform (timer mode 5, pin 12/13); Timer4 = timebase (modbus_timebase)
   TIMSK5 = 0x00;  // Timer5 external clock mode (for HW counter via pin 47)
 
   pinMode(LED_BUILTIN, OUTPUT);
   Serial.begin(115200);
-  delay(500);
-
-  print_banner();
 
   // Load persisted config (or defaults) and apply before initModbus()
   // Use global to avoid stack overflow (struct is >1KB)
@@ -44,29 +50,20 @@ void setup() {
     // configLoad() already set globalConfig to defaults if invalid
     if (!configSave(globalConfig)) {
       Serial.println(F("! Warning: Could not save config to EEPROM"));
-    } else {
-      Serial.println(F("✓ Config saved"));
     }
-  } else {
-    Serial.println(F("✓ Config loaded from EEPROM"));
   }
 
   initModbus();
-
   configApply(globalConfig);
-  Serial.println(F("% Modbus core initialized"));
-  Serial.print(F("% ID: "));   Serial.print(currentSlaveID);
-  Serial.print(F("  Baud: ")); Serial.println(currentBaudrate);
-  Serial.print(F("% Server: ")); Serial.println(serverRunning ? F("RUNNING") : F("STOPPED"));
-  Serial.println();
-
-  Serial.println(F("% Enter CLI by typing: CLI"));
-  Serial.println(F("% Line ending: NL or CR or Both, 115200 baud"));
-  Serial.println(F("==============================================="));
 
   // Enable interrupts globally (Arduino disables them during setup)
   // This is required for HW counter ISRs to work
   sei();
+
+  print_banner();
+
+  unsigned long readyMs = millis();
+  inputRegs[IREG_DIAG_BOOT_READY_MS] = (readyMs > 0xFFFFUL) ? 0xFFFF : (uint16_t)readyMs;
 }
 
 void loop() {
@@ -77,9 +74,9 @@ void loop() {
     cli_try_enter();
   }
 
-  // Heartbeat (1 Hz)
+  // Heartbeat (1 Hz) - ikke når pin 13 er waveform-output (v3.8.4)
   static unsigned long last = 0;
-  if (millis() - last > 1000) {
+  if (millis() - last > 1000 && !wave_uses_pin(LED_BUILTIN)) {
     last = millis();
     digitalWrite(LED_BUILTIN, !digitalRead(LED_BUILTIN));
   }
@@ -97,4 +94,12 @@ void loop() {
     inputRegs[2] = (uint16_t)(rand() % 1000);
     demoT = millis();
   }
+
+  // Idle sleep til tidligste deadline eller aktivitet (v3.8.1)
+  unsigned long now = millis();
+  unsigned long hbAge = now - last, demoAge = now - demoT;
+  uint32_t mainDue = (hbAge > 1000) ? 0 : 1001UL - hbAge;
+  uint32_t demoDue = (demoAge > 1000) ? 0 : 1001UL - demoAge;
+  if (demoDue < mainDue) mainDue = demoDue;
+  idle_loop(mainDue);
 }
@@ -13,7 +13,35 @@
 //             - Soft-control via controlReg (bit0=reset,1=start,2=stop)
 //             - Skaleret udlæsning til holdingRegs med float scale
 //             - Debounce pr. kanal (SW mode)
+//             - Port-vis batch-sampling af SW polling-tællere (PINx)
 //  Ændringer:
+//    - v3.9.6: counters_regs_owner() til reg-blok overlap (modbus_regmap)
+//    - v3.9.6: Diff-apply nulstiller registre en counter flytter/slukker;
+//              counters_set_running() og counters_uses_reg()
+//    - v3.9.6: lastEdgeMs sættes ved hver accepteret edge; counterFilterUs
+//              skrives kun via counters_filter_set()
+//    - v3.9.6: counters_uses_pin() (SW-ISR, polling-input og T5-pin 47)
+//    - v3.9.6: counterWrapSeq[] tælles op ved overflow/underflow
+//    - v3.9.6: counters_next_deadline_ms() samler deadlines fra frekvens-,
+//              tids- og rate-vinduer, sampler, pulsbredde og retain
+//    - v3.9.5: counters_config_diff_set() (diff-apply); fælles
+//              counter_cfg_sanitize() for set og diff
+//    - v3.9.2: Retentive counters (retain_init i counters_init, retain_loop)
+//    - v3.8.3: GPIO mirror-plan genopbygges i counters_config_set()
+//    - v3.8.1: counters_next_deadline_ms() (idle sleep)
+//    - v3.7.8: Rate-buckets + lifetime totalizer (rate_loop), overlever reset
+//    - v3.7.7: Gate-input i polling-vej; tidsvindue-publicering (window_loop)
+//    - v3.7.6: Pulsbredde/duty-måling for SW-ISR counters (pwm_loop)
+//    - v3.7.5: Edge-tidsstempel ring (edgelog) for polling-kanaler + head-publicering
+//    - v3.7.4: Snapshot-latch publiceres fra counters_loop() (snapshot_loop)
+//    - v3.7.3: Compare-setpoints evalueres i tællevejen (cmp_on_count) og
+//              udskudte handlinger/latch i cmp_loop()
+//    - v3.7.2: Debounce erstattet af fælles µs input-filter (InputFilter,
+//              Timer4-tidsbase) i polling-, sampler- og SW-ISR-vejen
+//    - v3.7.1: Port-mappede polling-kanaler samples af fast-rate timer-ISR
+//              (modbus_counters_sampler) og drænes fra accumulators
+//    - v3.7.0: SW polling læser hele porte (PINx) én gang pr. pass og
+//              beregner edges for alle kanaler samlet med bitmasker
 //    - v3.3.0: Hybrid HW/SW counter engine
 //              HW mode: interrupt-driven, deterministic frequency
 //              SW mode: legacy polling-based
@@ -23,6 +51,16 @@
 #include "modbus_counters.h"
 #include "modbus_counters_hw.h"
 #include "modbus_counters_sw_int.h"
+#include "modbus_counters_sampler.h"
+#include "modbus_timebase.h"
+#include "modbus_counters_compare.h"
+#include "modbus_counters_snapshot.h"
+#include "modbus_counters_edgelog.h"
+#include "modbus_counters_pwm.h"
+#include "modbus_counters_window.h"
+#include "modbus_counters_rate.h"
+#include "modbus_counters_retain.h"
+#include "modbus_idle.h"
 #include "modbus_core.h"
 #include <string.h>
 #include <math.h>
@@ -36,6 +74,10 @@ CounterConfig counters[4];
 // ============================================================================
 uint8_t counterResetOnReadEnable[4] = {0, 0, 0, 0};  // counter 1..4 (index 0..3)
 uint8_t counterAutoStartEnable[4]   = {0, 0, 0, 0};  // auto-start ved load/reboot
+uint16_t counterFilterUs[4]         = {0, 0, 0, 0};  // input-filter i µs (v3.7.2)
+volatile uint8_t counterWrapSeq[4]  = {0, 0, 0, 0};  // omløb (v3.9.6)
+
+InputFilter counterFilter[4];
 
 // ============================================================================
 //  Interne helpers
@@ -205,6 +247,73 @@ void store_value_to_regs(uint8_t idx) {
 }
 
 
+// Start/stop counter id (1..4). SW-ISR counters (re)attacher/detacher
+// interrupt-pin'en. Bruges af controlReg bit1/bit2 og af configApply når
+// auto-start ændres.
+void counters_set_running(uint8_t id, uint8_t run) {
+  if (id < 1 || id > 4) return;
+  CounterConfig& c = counters[id - 1];
+  c.running = run ? 1 : 0;
+  if (c.hwMode == 0 && c.interruptPin > 0) {
+    if (run) sw_counter_attach_interrupt(id, c.interruptPin);
+    else     sw_counter_detach_interrupt(id);
+  }
+}
+
+// Holding-regs som en enabled counter publicerer (værdi, rå, frekvens,
+// control, overflow) - samme regler som store_value_to_regs(). Returnerer
+// antal adresser i out (max 11).
+static uint8_t counter_reg_list(const CounterConfig& c, uint16_t* out) {
+  uint8_t n = 0;
+  if (!c.enabled) return 0;
+  uint8_t bw = sanitizeBitWidth(c.bitWidth);
+  uint8_t words = (bw == 64) ? 4 : (bw == 32 ? 2 : 1);
+  if ((uint32_t)c.regIndex + words <= NUM_REGS) {
+    for (uint8_t w = 0; w < words; ++w) out[n++] = c.regIndex + w;
+  }
+  uint16_t rawBase = 0;
+  if (c.rawReg > 0 && c.rawReg < NUM_REGS) rawBase = c.rawReg;
+  else if (c.regIndex > 0) rawBase = c.regIndex + 4;
+  if (rawBase > 0 && (uint32_t)rawBase + words <= NUM_REGS) {
+    for (uint8_t w = 0; w < words; ++w) out[n++] = rawBase + w;
+  }
+  if (c.freqReg > 0 && c.freqReg < NUM_REGS) out[n++] = c.freqReg;
+  if (c.controlReg < NUM_REGS) out[n++] = c.controlReg;
+  if (c.overflowReg < NUM_REGS) out[n++] = c.overflowReg;
+  return n;
+}
+
+// Nulstil registre som old publicerede men now ikke bruger (flyttet eller
+// slukket). Statiske registre ejes af den statiske liste og røres ikke.
+static void counter_regs_release(const CounterConfig& old, const CounterConfig& now) {
+  uint16_t a[11], b[11];
+  uint8_t na = counter_reg_list(old, a);
+  uint8_t nb = counter_reg_list(now, b);
+  for (uint8_t i = 0; i < na; ++i) {
+    bool keep = false;
+    for (uint8_t j = 0; j < nb && !keep; ++j) keep = (a[i] == b[j]);
+    for (uint8_t j = 0; j < regStaticCount && j < MAX_STATIC_REGS && !keep; ++j) {
+      keep = (a[i] == regStaticAddr[j]);
+    }
+    if (!keep) holdingRegs[a[i]] = 0;
+  }
+}
+
+bool counters_uses_reg(uint16_t addr) {
+  return counters_regs_owner(addr, 1) != 0;
+}
+
+uint8_t counters_regs_owner(uint16_t start, uint16_t len) {
+  uint16_t r[11];
+  for (uint8_t i = 0; i < 4; ++i) {
+    uint8_t n = counter_reg_list(counters[i], r);
+    for (uint8_t j = 0; j < n; ++j) {
+      if (r[j] >= start && (uint32_t)r[j] < (uint32_t)start + len) return (uint8_t)(i + 1);
+    }
+  }
+  return 0;
+}
+
 // Håndter controlReg-kommandoer (bit0=reset, bit1=start, bit2=stop)
 static void handle_control(CounterConfig& c) {
   if (c.controlReg >= NUM_REGS) return;
@@ -216,6 +325,7 @@ static void handle_control(CounterConfig& c) {
 
   // bit0: reset
   if (val & 0x0001) {
+    uint64_t before = c.counterValue;
     uint64_t sv = c.startValue;
     sv = maskToBitWidth(sv, bw);
     c.counterValue = sv;
@@ -239,45 +349,22 @@ static void handle_control(CounterConfig& c) {
 
     if (c.overflowReg < NUM_REGS) holdingRegs[c.overflowReg] = 0;
 
+    // Tidsvindue: nyt nulpunkt efter reset. Totalizer tæller videre.
+    window_rebase((uint8_t)(&c - counters));
+    rate_on_reset((uint8_t)(&c - counters), before);
+
     newVal &= ~0x0001;
   }
 
   // bit1: start
   if (val & 0x0002) {
-    c.running = 1;
-    // Attach interrupt if in SW mode with interrupt pin configured
-    if (c.hwMode == 0 && c.interruptPin > 0) {
-      // Find counter ID from address of config struct
-      uint8_t cid = 0;
-      for (uint8_t i = 0; i < 4; i++) {
-        if (&counters[i] == &c) {
-          cid = i + 1;
-          break;
-        }
-      }
-      if (cid > 0) {
-        sw_counter_attach_interrupt(cid, c.interruptPin);
-      }
-    }
+    counters_set_running((uint8_t)(&c - counters) + 1, 1);
     newVal &= ~0x0002;
   }
 
   // bit2: stop
   if (val & 0x0004) {
-    c.running = 0;
-    // Detach interrupt if in SW mode with interrupt pin configured
-    if (c.hwMode == 0 && c.interruptPin > 0) {
-      uint8_t cid = 0;
-      for (uint8_t i = 0; i < 4; i++) {
-        if (&counters[i] == &c) {
-          cid = i + 1;
-          break;
-        }
-      }
-      if (cid > 0) {
-        sw_counter_detach_interrupt(cid);
-      }
-    }
+    counters_set_running((uint8_t)(&c - counters) + 1, 0);
     newVal &= ~0x0004;
   }
 
@@ -297,11 +384,304 @@ static void handle_control(CounterConfig& c) {
   }
 }
 
+// Ét tællerskridt (op/ned) med overflow/underflow -> auto-reset til startValue
+static void count_step(CounterConfig& c) {
+  uint8_t bw = sanitizeBitWidth(c.bitWidth);
+  uint64_t maxVal = (bw == 64) ? 0xFFFFFFFFFFFFFFFFULL : ((1ULL << bw) - 1);
+  bool overflow = false;
+
+  uint8_t dir = sanitizeDirection(c.direction);
+  if (dir == CNT_DIR_DOWN) {
+    if (c.counterValue == 0) {
+      overflow = true;
+    } else {
+      c.counterValue--;
+    }
+  } else {
+    if (c.counterValue >= maxVal) {
+      overflow = true;
+    } else {
+      c.counterValue++;
+    }
+  }
+
+  if (overflow) {
+    c.overflowFlag = 1;
+    counterWrapSeq[&c - counters]++;
+    if (c.overflowReg < NUM_REGS) {
+      holdingRegs[c.overflowReg] = 1;
+    }
+    // Auto-reset to startValue (masked to bitWidth)
+    uint64_t sv = c.startValue;
+    sv = maskToBitWidth(sv, bw);
+    c.counterValue = sv;
+
+    // Reset frequency tracking on overflow
+    c.lastFreqCalcMs = 0;
+    c.lastCountForFreq = 0;
+    c.currentFreqHz = 0;
+    if (c.freqReg > 0 && c.freqReg < NUM_REGS) {
+      holdingRegs[c.freqReg] = 0;
+    }
+  }
+}
+
+// Frekvensberegning (1000-2000 ms vindue, nulstilles efter 5 s uden opdatering)
+static void counter_update_frequency(CounterConfig& c) {
+  if (c.freqReg > 0 && c.freqReg < NUM_REGS) {
+    unsigned long nowMs = millis();
+
+    // Initialize first time
+    if (c.lastFreqCalcMs == 0) {
+      c.lastFreqCalcMs = nowMs;
+      c.lastCountForFreq = c.counterValue;
+      c.currentFreqHz = 0;
+      holdingRegs[c.freqReg] = 0;
+    }
+
+    // Calculate frequency every second (1000-2000 ms window for stability)
+    unsigned long deltaTimeMs = nowMs - c.lastFreqCalcMs;
+    if (deltaTimeMs >= 1000 && deltaTimeMs <= 2000) {
+      uint64_t deltaCount = 0;
+      bool validDelta = true;
+
+      // Handle both UP and DOWN direction counting
+      if (c.direction == CNT_DIR_DOWN) {
+        // DOWN direction: count decreases (or wraps at underflow)
+        if (c.counterValue <= c.lastCountForFreq) {
+          // Normal down-counting: value decreased
+          deltaCount = c.lastCountForFreq - c.counterValue;
+        } else {
+          // Underflow wrap-around: value went from low to high (wrapped)
+          uint8_t bw = sanitizeBitWidth(c.bitWidth);
+          uint64_t maxVal = (bw == 64) ? 0xFFFFFFFFFFFFFFFFULL : ((1ULL << bw) - 1);
+          deltaCount = c.lastCountForFreq + (maxVal - c.counterValue) + 1;
+          // Sanity check: if deltaCount is unreasonably large, skip calculation
+          if (deltaCount > maxVal / 2) {
+            validDelta = false;
+          }
+        }
+      } else {
+        // UP direction (default): count increases (or wraps at overflow)
+        if (c.counterValue >= c.lastCountForFreq) {
+          // Normal up-counting: value increased
+          deltaCount = c.counterValue - c.lastCountForFreq;
+        } else {
+          // Overflow wrap-around: value went from high to low (wrapped)
+          uint8_t bw = sanitizeBitWidth(c.bitWidth);
+          uint64_t maxVal = (bw == 64) ? 0xFFFFFFFFFFFFFFFFULL : ((1ULL << bw) - 1);
+          deltaCount = (maxVal - c.lastCountForFreq) + c.counterValue + 1;
+          // Sanity check: if deltaCount is unreasonably large, skip calculation
+          if (deltaCount > maxVal / 2) {
+            validDelta = false;
+          }
+        }
+      }
+
+      // Calculate only if deltaCount is reasonable (max 100kHz @ 1sec sample)
+      if (validDelta && deltaCount <= 100000UL) {
+        // Calculate Hz: pulses per second
+        // Use 32-bit for intermediate result to avoid overflow
+        uint32_t freqCalc = (uint32_t)((deltaCount * 1000UL) / deltaTimeMs);
+
+        // Clamp to reasonable range (0-20000 Hz)
+        if (freqCalc > 20000UL) freqCalc = 20000UL;
+
+        c.currentFreqHz = (uint16_t)freqCalc;
+      } else {
+        // Invalid delta - keep last valid value
+        // (avoid writing garbage data)
+      }
+
+      // Write to freqReg (atomic write for Modbus consistency)
+      holdingRegs[c.freqReg] = c.currentFreqHz;
+
+      // Update tracking
+      c.lastCountForFreq = c.counterValue;
+      c.lastFreqCalcMs = nowMs;
+    } else if (deltaTimeMs > 5000) {
+      // If more than 5 seconds since last update, reset tracking
+      // (avoid accumulation of errors on long pauses)
+      c.lastFreqCalcMs = nowMs;
+      c.lastCountForFreq = c.counterValue;
+      c.currentFreqHz = 0;
+      holdingRegs[c.freqReg] = 0;
+    }
+  }
+}
+
+// n tællerskridt på én gang (drænet fra sampler-accumulator).
+// Hurtig vej uden overflow; ellers skridt for skridt så overflow-semantikken
+// (auto-reset til startValue) er identisk med enkelt-edge tælling.
+static void count_steps(CounterConfig& c, uint16_t n) {
+  if (n == 0) return;
+  uint8_t bw = sanitizeBitWidth(c.bitWidth);
+  uint64_t maxVal = (bw == 64) ? 0xFFFFFFFFFFFFFFFFULL : ((1ULL << bw) - 1);
+
+  if (sanitizeDirection(c.direction) == CNT_DIR_DOWN) {
+    if (c.counterValue >= n) { c.counterValue -= n; return; }
+  } else {
+    if (c.counterValue <= maxVal && maxVal - c.counterValue >= n) { c.counterValue += n; return; }
+  }
+  while (n--) count_step(c);
+}
+
+// ============================================================================
+//  SW polling: port-vis batch-sampling (v3.7.0)
+// ============================================================================
+// Polling-tællere læser deres input direkte fra PINx-registret for den GPIO
+// pin der er mappet til inputIndex (gpioToInput), i stedet for at vente på
+// GPIO-spejlingen i modbusLoop(). Hver port læses én gang pr. pass, og edges
+// for alle kanaler beregnes samlet:
+//   changed = nu ^ sidst
+//   rising  = changed &  nu  & riseMask
+//   falling = changed & ~nu  & fallMask
+// Tællere uden GPIO-mapping falder tilbage til discreteInputs (di_read).
+// Planen genopbygges når counter-config eller GPIO-mapping ændres.
+
+static CounterPollPlan pollPlan;
+static uint8_t pollLevels   = 0;           // sidste samplede niveauer (bit i = counter i+1)
+static unsigned long cntLoopMs = 0;         // seneste counters_loop() (idle)
+static uint8_t pollIsrMask  = 0;           // kanaler der samples af timer-ISR (sampler)
+static uint8_t pollFiltMask = 0;           // kanaler med aktivt input-filter (window > 0)
+
+// Læs alle porte i planen én gang og saml niveauer som bitmaske (bit i = counter i+1)
+static uint8_t poll_sample_levels() {
+  uint8_t portVal[4];
+  for (uint8_t p = 0; p < pollPlan.portCount; ++p) {
+    portVal[p] = *pollPlan.portReg[p];
+  }
+
+  uint8_t levels = 0;
+  for (uint8_t i = 0; i < 4; ++i) {
+    uint8_t bit = (uint8_t)(1u << i);
+    if (!(pollPlan.mask & bit)) continue;
+    if (pollPlan.chanPort[i] != POLL_NO_PORT) {
+      if (portVal[pollPlan.chanPort[i]] & pollPlan.chanMask[i]) levels |= bit;
+    } else if (di_read(counters[i].inputIndex)) {
+      levels |= bit;
+    }
+  }
+  return levels;
+}
+
+void counters_poll_plan_rebuild() {
+  CounterPollPlan& pl = pollPlan;
+  pl.portCount = 0;
+  pl.mask = 0;
+  pl.riseMask = 0;
+  pl.fallMask = 0;
+  uint8_t portMapped = 0;
+
+  for (uint8_t i = 0; i < 4; ++i) {
+    pl.chanPort[i] = POLL_NO_PORT;
+    pl.chanMask[i] = 0;
+
+    const CounterConfig& c = counters[i];
+    if (!c.enabled || c.hwMode != 0 || c.interruptPin > 0) continue;
+
+    uint8_t bit = (uint8_t)(1u << i);
+    pl.mask |= bit;
+    uint8_t edge = sanitizeEdge(c.edgeMode);
+    if (edge == CNT_EDGE_RISING  || edge == CNT_EDGE_BOTH) pl.riseMask |= bit;
+    if (edge == CNT_EDGE_FALLING || edge == CNT_EDGE_BOTH) pl.fallMask |= bit;
+
+    int8_t pin = gpio_find_input_pin(c.inputIndex);
+    if (pin < 0) continue;  // Ikke GPIO-mappet -> di_read fallback
+    uint8_t port = digitalPinToPort(pin);
+    if (port == NOT_A_PIN) continue;
+
+    volatile uint8_t* reg = portInputRegister(port);
+    uint8_t slot = 0;
+    while (slot < pl.portCount && pl.portReg[slot] != reg) slot++;
+    if (slot == pl.portCount) {
+      pl.portReg[pl.portCount++] = reg;
+    }
+    pl.chanPort[i] = slot;
+    pl.chanMask[i] = digitalPinToBitMask(pin);
+    portMapped |= bit;
+  }
+
+  // Port-mappede kanaler overdrages til sampler-ISR når den kører (v3.7.1)
+  pollIsrMask = sampler_rate_hz() ? portMapped : 0;
+
+  // Sync niveauer og filtre så en rebuild ikke giver falske edges.
+  // Filtre nulstilles med interrupts slået fra (deles med sampler-/SW-ISR).
+  pollLevels = poll_sample_levels();
+  pollFiltMask = 0;
+  for (uint8_t i = 0; i < 4; ++i) {
+    uint8_t bit = (uint8_t)(1u << i);
+    uint32_t win = counters_filter_window_ticks(i);
+    if (pl.mask & bit) {
+      counters[i].lastLevel = (pollLevels & bit) ? 1 : 0;
+      if (win > 0) pollFiltMask |= bit;
+      uint8_t s = SREG;
+      cli();
+      infilt_reset(counterFilter[i], counters[i].lastLevel, win);
+      SREG = s;
+    } else {
+      sw_counter_filter_reset(i + 1, win);
+    }
+  }
+
+  sampler_load_plan(pl, pollIsrMask, pollFiltMask & pollIsrMask);
+}
+
+// Sample alle polling-kanaler og returnér bitmaske over kanaler med en gyldig edge.
+// Kanaler med input-filter føres gennem counterFilter (Timer4-tidsstempel).
+static uint8_t poll_sample_edges() {
+  uint8_t now = poll_sample_levels();
+  uint8_t filt = pollFiltMask & (uint8_t)~pollIsrMask;
+  if (filt) {
+    uint32_t t = timebase_ticks();
+    for (uint8_t i = 0; i < 4; ++i) {
+      uint8_t bit = (uint8_t)(1u << i);
+      if (!(filt & bit)) continue;
+      if (infilt_level(counterFilter[i], (now & bit) ? 1 : 0, t)) now |= bit;
+      else now &= (uint8_t)~bit;
+    }
+  }
+  uint8_t changed = now ^ pollLevels;
+  pollLevels = now;
+  return (uint8_t)((changed & now & pollPlan.riseMask) | (changed & (uint8_t)~now & pollPlan.fallMask));
+}
+
+// Effektivt filtervindue i ticks (v3.7.2). counterFilterUs har forrang;
+// ellers bruges debounce-ms som filtervindue (stabil i mindst N ms).
+uint32_t counters_filter_window_ticks(uint8_t idx) {
+  if (idx >= 4) return 0;
+  if (counterFilterUs[idx] > 0) return TIMEBASE_US_TO_TICKS(counterFilterUs[idx]);
+  const CounterConfig& c = counters[idx];
+  if (c.debounceEnable && c.debounceTimeMs > 0) {
+    return TIMEBASE_US_TO_TICKS((uint32_t)c.debounceTimeMs * 1000UL);
+  }
+  return 0;
+}
+
+bool counters_filter_set(uint8_t id, uint16_t us) {
+  if (id < 1 || id > 4) return false;
+  counterFilterUs[id - 1] = us;
+  counters_poll_plan_rebuild();
+  return true;
+}
+
+// Sampler-rate (v3.7.1): 0 = fra, ellers SAMPLER_MIN_HZ..SAMPLER_MAX_HZ
+bool counters_sampler_set(uint16_t rateHz) {
+  if (rateHz != 0 && (rateHz < SAMPLER_MIN_HZ || rateHz > SAMPLER_MAX_HZ)) return false;
+  if (rateHz == 0) sampler_stop();
+  else sampler_start(rateHz);
+  counters_poll_plan_rebuild();
+  return true;
+}
+
 // ============================================================================
 //  Init / loop
 // ============================================================================
 
 void counters_init() {
+  // Retentive værdier: scan EEPROM-ring (boot) / husk kørende (v3.9.2)
+  retain_init();
+
   // Initialize HW counter extension registers to 0 FIRST
   // Timer5 only (other timers not accessible on Arduino Mega)
   hwCounter5Extend = 0;
@@ -345,9 +725,23 @@ void counters_init() {
     c.lastFreqCalcMs   = 0;
     c.currentFreqHz    = 0;
   }
+
+  counters_poll_plan_rebuild();
 }
 
 void counters_loop() {
+  cntLoopMs = millis();
+
+  // Batch-sample alle SW polling-kanaler (én læsning pr. port).
+  // Kanaler der samples af sampler-ISR'en tælles via accumulator i stedet.
+  uint8_t polledEdges = pollPlan.mask ? poll_sample_edges() : 0;
+  polledEdges &= (uint8_t)~pollIsrMask;
+
+  // Publicér sampler-garanti (missed-edge bound) som diagnostik
+  inputRegs[IREG_DIAG_SAMPLER_HZ]    = sampler_rate_hz();
+  inputRegs[IREG_DIAG_SAMPLER_MAXHZ] = sampler_max_input_hz();
+  inputRegs[IREG_DIAG_SAMPLER_LOST]  = sampler_lost_edges();
+
   for (uint8_t idx = 0; idx < 4; ++idx) {
     CounterConfig& c = counters[idx];
 
@@ -386,6 +780,7 @@ void counters_loop() {
 
       // Read HW counter value (direct pulse count from hardware)
       uint32_t hwValue = hw_counter_get_value(hw_id);
+      uint64_t prevValue = c.counterValue;
 
       // IMPORTANT: Hardware now ALWAYS uses external clock mode (counts ALL pulses).
       // Prescaler is implemented in SOFTWARE by dividing for raw register.
@@ -397,6 +792,7 @@ void counters_loop() {
       //   - value register = hwValue × scale (scaled output)
       //   - frequency = actual Hz (no prescaler compensation needed)
       c.counterValue = (uint64_t)hwValue;
+      cmp_on_count(idx, prevValue, c.counterValue);
 
       // Update frequency measurement using dedicated function
       // This handles first-time initialization correctly
@@ -423,6 +819,9 @@ void counters_loop() {
     // ISRs will handle edge detection and counting
     if (c.interruptPin > 0) {
       // Interrupt-driven mode: counter updates via ISR
+      // Bekræft evt. ventende filter-niveau (sidste edge før input blev stabilt)
+      sw_counter_filter_poll(c.id);
+
       // Just reflect outputs to Modbus registers
       if (c.overflowReg < NUM_REGS) {
         holdingRegs[c.overflowReg] = c.overflowFlag ? 1 : 0;
@@ -430,7 +829,8 @@ void counters_loop() {
       store_value_to_regs(idx);
 
       // Frequency calculation for SW interrupt mode (similar to polling)
-      if (c.freqReg > 0 && c.freqReg < NUM_REGS && c.running) {
+      // PWM-måling skriver freq-reg fra den målte periode (pwm_loop)
+      if (c.freqReg > 0 && c.freqReg < NUM_REGS && c.running && !pwm_enabled(idx)) {
         unsigned long nowMs = millis();
 
         // Initialize first time
@@ -497,10 +897,13 @@ void counters_loop() {
       continue;
     }
 
+    // SW polling: niveau og edge kommer fra batch-samplingen ovenfor
+    uint8_t bit = (uint8_t)(1u << idx);
+    c.lastLevel = (pollLevels & bit) ? 1 : 0;
+
     // If not running -> track lastLevel, but don't count
-    bool lvl = di_read(c.inputIndex);
     if (!c.running) {
-      c.lastLevel = lvl ? 1 : 0;
+      if (pollIsrMask & bit) sampler_drain(idx);  // kassér ISR-edges mens stoppet
       // Reflect overflow flag only if set, keep until reset-bit clears it
       if (c.overflowReg < NUM_REGS) {
         if (c.overflowFlag)
@@ -510,33 +913,26 @@ void counters_loop() {
       continue;
     }
 
-    // Edge-detection
-    bool fire = false;
-    uint8_t edge = sanitizeEdge(c.edgeMode);
-    uint8_t last = c.lastLevel;
-    uint8_t now  = lvl ? 1 : 0;
-
-    if      (edge == CNT_EDGE_RISING  && last == 0 && now == 1) fire = true;
-    else if (edge == CNT_EDGE_FALLING && last == 1 && now == 0) fire = true;
-    else if (edge == CNT_EDGE_BOTH    && last != now)           fire = true;
-
-    c.lastLevel = now;
-
-    // Debounce: if enabled, filter edges that come too fast
-    if (fire && c.debounceEnable && c.debounceTimeMs > 0) {
-      unsigned long nowMs = millis();
-      unsigned long dt = nowMs - c.lastEdgeMs;
-      if (dt < c.debounceTimeMs) {
-        // Ignore this edge as "noise"
-        fire = false;
-      } else {
-        c.lastEdgeMs = nowMs;
+    // Sampler-ISR kanal: dræn accumulator (edge-detektering + input-filter
+    // er allerede sket i ISR'en ved fast rate)
+    if (pollIsrMask & bit) {
+      uint64_t prevValue = c.counterValue;
+      uint16_t steps = sampler_drain(idx);
+      if (steps) c.lastEdgeMs = millis();
+      count_steps(c, steps);
+      cmp_on_count(idx, prevValue, c.counterValue);
+      if (c.overflowReg < NUM_REGS) {
+        holdingRegs[c.overflowReg] = c.overflowFlag ? 1 : 0;
       }
-    } else if (fire && (!c.debounceEnable || c.debounceTimeMs == 0)) {
-      // Without debounce: just update lastEdgeMs for reference
-      c.lastEdgeMs = millis();
+      store_value_to_regs(idx);
+      counter_update_frequency(c);
+      continue;
     }
 
+    // Edge-detection (beregnet samlet for alle kanaler i poll_sample_edges,
+    // efter input-filter når filtervindue er sat). Lukket gate -> ingen tælling.
+    bool fire = (polledEdges & bit) != 0 && gate_open(idx);
+
     if (!fire) {
       if (c.overflowReg < NUM_REGS) {
         holdingRegs[c.overflowReg] = c.overflowFlag ? 1 : 0;
@@ -549,44 +945,12 @@ void counters_loop() {
     // SW mode now counts ALL edges, just like HW mode
     // Prescaler division happens only at output (raw register)
 
-    // Count step
-    uint8_t bw = sanitizeBitWidth(c.bitWidth);
-    uint64_t maxVal = (bw == 64) ? 0xFFFFFFFFFFFFFFFFULL : ((1ULL << bw) - 1);
-    bool overflow = false;
-
-    uint8_t dir = sanitizeDirection(c.direction);
-    if (dir == CNT_DIR_DOWN) {
-      if (c.counterValue == 0) {
-        overflow = true;
-      } else {
-        c.counterValue--;
-      }
-    } else {
-      if (c.counterValue >= maxVal) {
-        overflow = true;
-      } else {
-        c.counterValue++;
-      }
-    }
-
-    if (overflow) {
-      c.overflowFlag = 1;
-      if (c.overflowReg < NUM_REGS) {
-        holdingRegs[c.overflowReg] = 1;
-      }
-      // Auto-reset to startValue (masked to bitWidth)
-      uint64_t sv = c.startValue;
-      sv = maskToBitWidth(sv, bw);
-      c.counterValue = sv;
-
-      // Reset frequency tracking on overflow
-      c.lastFreqCalcMs = 0;
-      c.lastCountForFreq = 0;
-      c.currentFreqHz = 0;
-      if (c.freqReg > 0 && c.freqReg < NUM_REGS) {
-        holdingRegs[c.freqReg] = 0;
-      }
-    }
+    // Count step + compare-setpoints (reagerer i samme pass)
+    uint64_t prevValue = c.counterValue;
+    c.lastEdgeMs = millis();
+    count_step(c);
+    cmp_on_count(idx, prevValue, c.counterValue);
+    edgelog_stamp(idx);
 
     // Reflect overflow flag and scaled value
     if (c.overflowReg < NUM_REGS) {
@@ -596,93 +960,136 @@ void counters_loop() {
     store_value_to_regs(idx);
 
     // Frequency calculation (every second) - SW mode only
-    if (c.freqReg > 0 && c.freqReg < NUM_REGS) {
-      unsigned long nowMs = millis();
-
-      // Initialize first time
-      if (c.lastFreqCalcMs == 0) {
-        c.lastFreqCalcMs = nowMs;
-        c.lastCountForFreq = c.counterValue;
-        c.currentFreqHz = 0;
-        holdingRegs[c.freqReg] = 0;
-      }
+    counter_update_frequency(c);
+  }
 
-      // Calculate frequency every second (1000-2000 ms window for stability)
-      unsigned long deltaTimeMs = nowMs - c.lastFreqCalcMs;
-      if (deltaTimeMs >= 1000 && deltaTimeMs <= 2000) {
-        uint64_t deltaCount = 0;
-        bool validDelta = true;
-
-        // Handle both UP and DOWN direction counting
-        if (c.direction == CNT_DIR_DOWN) {
-          // DOWN direction: count decreases (or wraps at underflow)
-          if (c.counterValue <= c.lastCountForFreq) {
-            // Normal down-counting: value decreased
-            deltaCount = c.lastCountForFreq - c.counterValue;
-          } else {
-            // Underflow wrap-around: value went from low to high (wrapped)
-            uint8_t bw = sanitizeBitWidth(c.bitWidth);
-            uint64_t maxVal = (bw == 64) ? 0xFFFFFFFFFFFFFFFFULL : ((1ULL << bw) - 1);
-            deltaCount = c.lastCountForFreq + (maxVal - c.counterValue) + 1;
-            // Sanity check: if deltaCount is unreasonably large, skip calculation
-            if (deltaCount > maxVal / 2) {
-              validDelta = false;
-            }
-          }
-        } else {
-          // UP direction (default): count increases (or wraps at overflow)
-          if (c.counterValue >= c.lastCountForFreq) {
-            // Normal up-counting: value increased
-            deltaCount = c.counterValue - c.lastCountForFreq;
-          } else {
-            // Overflow wrap-around: value went from high to low (wrapped)
-            uint8_t bw = sanitizeBitWidth(c.bitWidth);
-            uint64_t maxVal = (bw == 64) ? 0xFFFFFFFFFFFFFFFFULL : ((1ULL << bw) - 1);
-            deltaCount = (maxVal - c.lastCountForFreq) + c.counterValue + 1;
-            // Sanity check: if deltaCount is unreasonably large, skip calculation
-            if (deltaCount > maxVal / 2) {
-              validDelta = false;
-            }
-          }
-        }
+  // Compare-setpoints: udskudte coil-/timer-handlinger + latch-registre
+  cmp_loop();
 
-        // Calculate only if deltaCount is reasonable (max 100kHz @ 1sec sample)
-        if (validDelta && deltaCount <= 100000UL) {
-          // Calculate Hz: pulses per second
-          // Use 32-bit for intermediate result to avoid overflow
-          uint32_t freqCalc = (uint32_t)((deltaCount * 1000UL) / deltaTimeMs);
+  // Snapshot-latch: publicér ventende snapshot (INT-pin/control-bit)
+  snapshot_loop();
 
-          // Clamp to reasonable range (0-20000 Hz)
-          if (freqCalc > 20000UL) freqCalc = 20000UL;
+  // Edge-tidsstempel ringe: publicér head-registre
+  edgelog_loop();
 
-          c.currentFreqHz = (uint16_t)freqCalc;
-        } else {
-          // Invalid delta - keep last valid value
-          // (avoid writing garbage data)
-        }
+  // Pulsbredde/duty: publicér gennemsnit + stale-status
+  pwm_loop();
 
-        // Write to freqReg (atomic write for Modbus consistency)
-        holdingRegs[c.freqReg] = c.currentFreqHz;
-
-        // Update tracking
-        c.lastCountForFreq = c.counterValue;
-        c.lastFreqCalcMs = nowMs;
-      } else if (deltaTimeMs > 5000) {
-        // If more than 5 seconds since last update, reset tracking
-        // (avoid accumulation of errors on long pauses)
-        c.lastFreqCalcMs = nowMs;
-        c.lastCountForFreq = c.counterValue;
-        c.currentFreqHz = 0;
-        holdingRegs[c.freqReg] = 0;
-      }
-    }
-  }
+  // Tidsvinduer: publicér afsluttede vinduer (resultat + sekvens)
+  window_loop();
+
+  // Rate (60 s / 3600 s) + lifetime totalizer
+  rate_loop();
+
+  // Retentive counters: checkpoint til EEPROM-ring
+  retain_loop();
 }
 
 // ============================================================================
 //  Public helpers
 // ============================================================================
 
+// Næste deadline for CounterEngine (v3.8.1). Kanaler der ikke samples af
+// sampler-ISR'en skal polles i hvert pass. Øvrige tællere tæller i HW/ISR;
+// loop skal kun køre når et vindue slutter, en accumulator skal drænes,
+// eller compare skal evalueres for en tæller der tælles i loop (HW/sampler).
+// Registerværdier publiceres desuden i hvert pass med Modbus/CLI-aktivitet.
+uint32_t counters_next_deadline_ms() {
+  if (pollPlan.mask & (uint8_t)~pollIsrMask) return 0;
+
+  unsigned long nowMs = millis();
+  uint32_t due = IDLE_NO_DEADLINE;
+  uint32_t d;
+  for (uint8_t idx = 0; idx < 4; ++idx) {
+    const CounterConfig& c = counters[idx];
+    if (!c.enabled || !c.running) continue;
+    uint8_t bit = (uint8_t)(1u << idx);
+    bool loopCounted = (c.hwMode == 5) || (pollIsrMask & bit);
+
+    if (loopCounted && cmp_active(idx)) {
+      d = idle_due_in(cntLoopMs, 1, nowMs);
+      if (d < due) due = d;
+    }
+    if (pollIsrMask & bit) {
+      d = idle_due_in(cntLoopMs, sampler_drain_period_ms(), nowMs);
+      if (d < due) due = d;
+    }
+    if (c.hwMode == 0 && c.interruptPin > 0 && sw_counter_filter_pending(c.id)) {
+      d = idle_due_in(cntLoopMs, 1, nowMs);
+      if (d < due) due = d;
+    }
+    if (c.freqReg > 0 && c.freqReg < NUM_REGS && !pwm_enabled(idx)) {
+      if (c.hwMode == 5)             d = hw_counter_freq_next_ms();
+      else if (c.lastFreqCalcMs == 0) d = 0;
+      else                           d = idle_due_in(c.lastFreqCalcMs, 1000, nowMs);
+      if (d < due) due = d;
+    }
+  }
+
+  d = cmp_next_deadline_ms();       if (d < due) due = d;
+  d = snapshot_next_deadline_ms();  if (d < due) due = d;
+  d = window_next_deadline_ms();    if (d < due) due = d;
+  d = pwm_next_deadline_ms();       if (d < due) due = d;
+  d = rate_next_deadline_ms();      if (d < due) due = d;
+  d = retain_next_deadline_ms();    if (d < due) due = d;
+  return due;
+}
+
+// Rå værdi for counter idx med interrupts slået fra (snapshot/tidsvindue).
+// HW: læs Timer5 direkte (hw_counter_get_value() kalder sei()).
+// Sampler-kanaler: medregn edges der endnu ikke er drænet.
+uint32_t counters_raw_value_isr(uint8_t idx) {
+  const CounterConfig& c = counters[idx];
+  if (!c.enabled) return (uint32_t)c.counterValue;
+
+  if (c.hwMode == 5) {
+    uint16_t lo = TCNT5;
+    uint32_t hi = hwCounter5Extend;
+    if ((TIFR5 & _BV(TOV5)) && lo < 0x8000) hi++;
+    return (hi << 16) | lo;
+  }
+
+  uint32_t v = (uint32_t)c.counterValue;
+  uint16_t pend = sampler_peek_isr(idx);
+  if (c.direction == CNT_DIR_DOWN) v -= pend;
+  else v += pend;
+  return v;
+}
+
+// Fælles validering af konfigurations-felter (counters_config_set og
+// diff-sammenligningen i counters_config_diff_set)
+static void counter_cfg_sanitize(CounterConfig& c) {
+  c.enabled   = (c.enabled ? 1 : 0);
+  c.edgeMode  = sanitizeEdge(c.edgeMode);
+  c.direction = sanitizeDirection(c.direction);
+  c.bitWidth  = sanitizeBitWidth(c.bitWidth);
+
+  // Validate prescaler based on mode (HW vs SW)
+  // HW mode (hwMode=5) only supports: 1 (external), 8, 64, 256, 1024
+  // SW/SW-ISR modes now use: 1, 4, 16, 64, 256, 1024 (unified with HW)
+  if (c.hwMode == 5) {
+    // HW mode Timer5 - only specific prescaler values
+    c.prescaler = sanitizeHWPrescaler(c.prescaler);
+  } else if (c.hwMode == 0) {
+    // SW/SW-ISR mode - unified prescaler values (1, 4, 16, 64, 256, 1024)
+    c.prescaler = sanitizePrescaler_SW(c.prescaler);
+  } else {
+    // Unknown mode - default to 1
+    c.prescaler = 1;
+  }
+
+  if (c.inputIndex >= NUM_DISCRETE) c.inputIndex = 0;
+
+  if (isnan(c.scale) || c.scale <= 0.0f || c.scale > 100000.0f) c.scale = 1.0f;
+
+  // Debounce: tillad toggle ON/OFF uden at miste tid
+  if (c.debounceEnable) {
+    c.debounceEnable = 1;
+    if (c.debounceTimeMs < 1)  c.debounceTimeMs = 10;    // default minimum
+    if (c.debounceTimeMs > 60000) c.debounceTimeMs = 60000;
+  }
+}
+
 bool counters_config_set(uint8_t id, const CounterConfig& src) {
   if (id < 1 || id > 4) return false;
   uint8_t idx = id - 1;
@@ -717,42 +1124,9 @@ bool counters_config_set(uint8_t id, const CounterConfig& src) {
 
   CounterConfig c = src;
 
-  c.controlReg    = src.controlReg;
-  c.id        = id;
-  c.enabled   = (c.enabled ? 1 : 0);
-  c.edgeMode  = sanitizeEdge(c.edgeMode);
-  c.direction = sanitizeDirection(c.direction);
-  c.bitWidth  = sanitizeBitWidth(c.bitWidth);
-
-  // Validate prescaler based on mode (HW vs SW)
-  // HW mode (hwMode=5) only supports: 1 (external), 8, 64, 256, 1024
-  // SW/SW-ISR modes now use: 1, 4, 16, 64, 256, 1024 (unified with HW)
-  if (c.hwMode == 5) {
-    // HW mode Timer5 - only specific prescaler values
-    c.prescaler = sanitizeHWPrescaler(c.prescaler);
-  } else if (c.hwMode == 0) {
-    // SW/SW-ISR mode - unified prescaler values (1, 4, 16, 64, 256, 1024)
-    c.prescaler = sanitizePrescaler_SW(c.prescaler);
-  } else {
-    // Unknown mode - default to 1
-    c.prescaler = 1;
-  }
-
-  if (c.inputIndex >= NUM_DISCRETE) c.inputIndex = 0;
-
-  if (isnan(c.scale) || c.scale <= 0.0f || c.scale > 100000.0f) c.scale = 1.0f;
-
-
-  // --- Debounce-sanitizing (fix toggle ON/OFF issue) ---
-  // --- Debounce handling: tillad toggle uden at miste tid ---
-if (c.debounceEnable) {
-  if (c.debounceTimeMs < 1)  c.debounceTimeMs = 10;    // default minimum
-  if (c.debounceTimeMs > 60000) c.debounceTimeMs = 60000;
-} else {
-  // OFF: behold debounceTimeMs, men sæt enable=0
-  c.debounceEnable = 0;
-}
-c.lastEdgeMs = 0;
+  c.id = id;
+  counter_cfg_sanitize(c);
+  c.lastEdgeMs = 0;
 
   // Auto-start counters baseret på counterAutoStartEnable array
   c.running       = (c.enabled && counterAutoStartEnable[idx]) ? 1 : 0;
@@ -764,9 +1138,6 @@ c.lastEdgeMs = 0;
   sv = maskToBitWidth(sv, c.bitWidth);
   c.counterValue = sv;
 
-  // Sync lastLevel til aktuel input
-  c.lastLevel = di_read(c.inputIndex) ? 1 : 0;
-
   counters[idx] = c;
 
   // Initialize HW timer if in HW mode
@@ -847,7 +1218,11 @@ c.lastEdgeMs = 0;
   if (c.hwMode == 0) {
     if (c.enabled && c.interruptPin > 0) {
       // Attach interrupt for enabled SW-mode counter with interrupt pin configured
-      sw_counter_attach_interrupt(id, c.interruptPin);
+      if (!sw_counter_attach_interrupt(id, c.interruptPin)) {
+        Serial.print(F("WARNING: Counter "));
+        Serial.print(id);
+        Serial.println(F(" interrupt-pin not attached (invalid or already in use)"));
+      }
     } else {
       // Detach interrupt if: counter disabled, HW mode changed, or polling mode set
       sw_counter_detach_interrupt(id);
@@ -857,6 +1232,12 @@ c.lastEdgeMs = 0;
     sw_counter_detach_interrupt(id);
   }
 
+  // Genopbyg port-plan for SW polling (synker også lastLevel til aktuel input)
+  counters_poll_plan_rebuild();
+  gpio_plan_rebuild();          // HW-/SW-ISR pins kan have ændret gpioToInput
+  window_rebase(idx);
+  rate_rebase(idx);
+
   // Nulstil overflowReg & skriv initial værdi
   if (c.overflowReg < NUM_REGS) {
     holdingRegs[c.overflowReg] = 0;
@@ -866,6 +1247,68 @@ c.lastEdgeMs = 0;
   return true;
 }
 
+// Diff-apply (v3.9.5): kun det der afviger fra den kørende counter røres
+uint8_t counters_config_diff_set(uint8_t id, const CounterConfig& src) {
+  if (id < 1 || id > 4) return CNT_CFG_SAME;
+  uint8_t idx = id - 1;
+  CounterConfig& cur = counters[idx];
+
+  CounterConfig c = src;
+  c.id = id;
+  counter_cfg_sanitize(c);
+
+  // Tælle-opsætning: ændring kræver re-init (værdi = start-value)
+  if (c.enabled        != cur.enabled        || c.hwMode       != cur.hwMode ||
+      c.edgeMode       != cur.edgeMode       || c.direction    != cur.direction ||
+      c.bitWidth       != cur.bitWidth       || c.prescaler    != cur.prescaler ||
+      c.inputIndex     != cur.inputIndex     || c.interruptPin != cur.interruptPin ||
+      c.startValue     != cur.startValue     ||
+      c.debounceEnable != cur.debounceEnable || c.debounceTimeMs != cur.debounceTimeMs) {
+    CounterConfig old = cur;
+    retain_hold(idx);           // retentiv counter beholder kørende værdi
+    counters_config_set(id, src);
+    counter_regs_release(old, counters[idx]);
+    return CNT_CFG_RESET;
+  }
+
+  // Skalering og register-adresser: opdateres uden at nulstille værdien
+  if (c.scale      == cur.scale      && c.regIndex    == cur.regIndex &&
+      c.rawReg     == cur.rawReg     && c.freqReg     == cur.freqReg &&
+      c.controlReg == cur.controlReg && c.overflowReg == cur.overflowReg &&
+      c.controlFlags == cur.controlFlags) {
+    return CNT_CFG_SAME;
+  }
+  CounterConfig old = cur;
+  uint8_t s = SREG;
+  cli();
+  cur.scale        = c.scale;
+  cur.regIndex     = c.regIndex;
+  cur.rawReg       = c.rawReg;
+  cur.freqReg      = c.freqReg;
+  cur.controlReg   = c.controlReg;
+  cur.overflowReg  = c.overflowReg;
+  cur.controlFlags = c.controlFlags;
+  SREG = s;
+  counter_regs_release(old, cur);   // flyttede registre nulstilles
+  store_value_to_regs(idx);
+  return CNT_CFG_UPDATED;
+}
+
+bool counters_uses_pin(uint8_t pin) {
+  if (pin == 0) return false;
+  for (uint8_t i = 0; i < 4; ++i) {
+    const CounterConfig& c = counters[i];
+    if (!c.enabled) continue;
+    if (c.hwMode == 5) {
+      if (pin == 47) return true;                 // Timer5 T5 (PL2)
+    } else if (c.hwMode == 0) {
+      if (c.interruptPin == pin) return true;     // SW-ISR
+      if (c.interruptPin == 0 && gpio_find_input_pin(c.inputIndex) == (int8_t)pin) return true;
+    }
+  }
+  return false;
+}
+
 bool counters_get(uint8_t id, CounterConfig& out) {
   if (id < 1 || id > 4) return false;
   out = counters[id - 1];
@@ -876,6 +1319,7 @@ void counters_reset(uint8_t id) {
   if (id < 1 || id > 4) return;
   uint8_t idx = id - 1;
   CounterConfig& c = counters[idx];
+  uint64_t before = c.counterValue;
 
   uint8_t bw = sanitizeBitWidth(c.bitWidth);
   uint64_t sv = c.startValue;
@@ -907,6 +1351,8 @@ void counters_reset(uint8_t id) {
     holdingRegs[c.overflowReg] = 0;
   }
   store_value_to_regs(idx);
+  window_rebase(idx);
+  rate_on_reset(idx, before);
 }
 
 void counters_clear_all() {
@@ -0,0 +1,255 @@
+// ============================================================================
+//  Filnavn : modbus_counters_compare.cpp
+//  Projekt  : Modbus RTU Server / CLI
+//  Version  : v3.8.2 (2026-10-18)
+//  Forfatter: JanG at modbus_slave@laces.dk
+//  Formål   : Compare-setpoints for CounterEngine (se modbus_counters_compare.h).
+//             Evalueres i tællevejen, så reaktionstiden for GPIO-handlinger
+//             er µs (SW-ISR) eller ét loop-pass (polling/sampler/HW).
+//  Ændringer:
+//    - v3.9.6: Fyrede setpoints poster arbejde til idle (idle_isr_post)
+//    - v3.9.6: Ved omløb fyrer kun setpoints inden for tælleområdet fra
+//              startValue (maskeret til bitWidth)
+//    - v3.9.6: Reg-blok må ikke overlappe andre features (regmap_owner)
+//    - v3.9.6: GPIO-mål afvises hvis pin'en ejes af seriel/RS485, counter-
+//              input, gate, snapshot, timer-trigger eller waveform-udgang;
+//              cmp_uses_pin() til de andre funktioners tjek
+//    - v3.9.6: Omløb genkendes fra counterWrapSeq; et fald uden omløb
+//              (reset/preset/CLI-set) gen-armerer uden at fyre
+//    - v3.9.6: cmp_next_deadline_ms()/cmp_active() til idle-scheduleren
+//    - v3.9.6: Afviser compare på 64-bit counters (setpoints er 32 bit)
+//    - v3.8.2: Coil set/clear skrives i tællevejen via gpio_coil_write(),
+//              så en GPIO-mappet coil-pin følger med det samme
+// ============================================================================
+
+#include "modbus_counters_compare.h"
+#include "modbus_counters.h"
+#include "modbus_timers.h"
+#include "modbus_timers_wave.h"
+#include "modbus_timers_trig.h"
+#include "modbus_counters_window.h"
+#include "modbus_counters_snapshot.h"
+#include "modbus_idle.h"
+#include "modbus_regmap.h"
+
+CounterCompareConfig counterCompare[4];
+
+// ============================================================================
+// Runtime state (læses af SW-ISR; ændres kun med interrupts slået fra)
+// ============================================================================
+static uint32_t cmpSp[4][CMP_SETPOINTS];            // setpoint-cache fra holding-regs
+static uint8_t  cmpActive[4];                       // bit s = setpoint s har handling
+static volatile uint8_t* cmpPortOut[4][CMP_SETPOINTS]; // PORTx for GPIO-handlinger
+static uint8_t  cmpPinMask[4][CMP_SETPOINTS];
+static volatile uint8_t cmpPending[4];              // fyrede setpoints der venter på loop
+static uint8_t  cmpWrapSeen[4];                     // counterWrapSeq ved seneste cmp_on_count
+
+// ============================================================================
+// Helpers
+// ============================================================================
+// wrapped = counterWrapSeq ændret siden sidst (overflow/underflow ->
+// startValue sv undervejs). Efter omløb tælles kun fra sv, så setpoints
+// under sv (op) eller over sv (ned) passeres aldrig. En bevægelse mod
+// tælleretningen uden omløb er reset/preset/CLI-set: ingen krydsning,
+// setpointet er blot gen-armeret.
+static inline bool cmp_crossed(uint32_t sp, uint64_t prev, uint64_t now, bool down,
+                               bool wrapped, uint64_t sv) {
+  if (!down) {
+    if (wrapped) return sp > prev || (sp >= sv && sp <= now);
+    return now > prev && prev < sp && now >= sp;
+  }
+  if (wrapped) return sp < prev || (sp <= sv && sp >= now);
+  return now < prev && prev > sp && now <= sp;
+}
+
+// GPIO-mål: pin der ikke ejes af seriel/RS485, counter-input, gate,
+// snapshot-trigger, timer-trigger eller waveform-udgang (tvinges til OUTPUT)
+static bool cmp_pin_free(uint16_t target) {
+  if (target >= NUM_GPIO || digitalPinToPort(target) == NOT_A_PIN) return false;
+  uint8_t pin = (uint8_t)target;
+  if (gpio_pin_reserved(pin)) return false;
+  if (counters_uses_pin(pin) || gatewin_uses_pin(pin)) return false;
+  if (pin == snapshotPin) return false;
+  return !trig_uses_pin(pin) && !wave_uses_pin(pin);
+}
+
+static bool cmp_target_valid(uint8_t action, uint16_t target) {
+  switch (action) {
+    case CMP_ACT_NONE:       return true;
+    case CMP_ACT_COIL_SET:
+    case CMP_ACT_COIL_CLEAR: return target < NUM_COILS;
+    case CMP_ACT_GPIO_HIGH:
+    case CMP_ACT_GPIO_LOW:   return cmp_pin_free(target);
+    case CMP_ACT_TIMER:      return target >= 1 && target <= 4;
+    default:                 return false;
+  }
+}
+
+// Læs setpoints fra holding-regs ind i cachen (atomisk ift. SW-ISR)
+static void cmp_refresh_setpoints(uint8_t idx) {
+  const CounterCompareConfig& cc = counterCompare[idx];
+  if (cc.reg == 0) return;
+  uint32_t sp[CMP_SETPOINTS];
+  for (uint8_t s = 0; s < CMP_SETPOINTS; ++s) {
+    sp[s] = (uint32_t)holdingRegs[cc.reg + 2 * s] |
+            ((uint32_t)holdingRegs[cc.reg + 2 * s + 1] << 16);
+  }
+  uint8_t sreg = SREG;
+  cli();
+  for (uint8_t s = 0; s < CMP_SETPOINTS; ++s) cmpSp[idx][s] = sp[s];
+  SREG = sreg;
+}
+
+// ============================================================================
+// API
+// ============================================================================
+bool cmp_config_set(uint8_t idx, const CounterCompareConfig& cfg) {
+  if (idx >= 4) return false;
+  if (cfg.reg != 0 && (uint32_t)cfg.reg + CMP_BLOCK_REGS > NUM_REGS) return false;
+  if (cfg.reg != 0 && regmap_owner(cfg.reg, CMP_BLOCK_REGS, REGMAP_ID(REGMAP_COMPARE, idx))) return false;
+  // Setpoints er 32 bit - en 64-bit counter kan ikke sammenlignes korrekt
+  if (cfg.reg != 0 && counters[idx].bitWidth == 64) return false;
+  for (uint8_t s = 0; s < CMP_SETPOINTS; ++s) {
+    if (!cmp_target_valid(cfg.action[s], cfg.target[s])) return false;
+  }
+
+  uint8_t sreg = SREG;
+  cli();
+  counterCompare[idx] = cfg;
+  cmpActive[idx] = 0;               // aktiveres igen i cmp_rebuild()
+  cmpPending[idx] = 0;
+  cmpWrapSeen[idx] = counterWrapSeq[idx];
+  SREG = sreg;
+
+  if (cfg.reg != 0) holdingRegs[cfg.reg + CMP_SETPOINTS * 2] = 0;  // ryd latch
+  cmp_rebuild();
+  return true;
+}
+
+void cmp_rebuild() {
+  for (uint8_t i = 0; i < 4; ++i) {
+    const CounterCompareConfig& cc = counterCompare[i];
+    uint8_t active = 0;
+    volatile uint8_t* port[CMP_SETPOINTS];
+    uint8_t mask[CMP_SETPOINTS];
+
+    for (uint8_t s = 0; s < CMP_SETPOINTS; ++s) {
+      port[s] = 0;
+      mask[s] = 0;
+      if (cc.reg == 0 || !cmp_target_valid(cc.action[s], cc.target[s])) continue;
+      if (cc.action[s] == CMP_ACT_NONE) continue;
+
+      if (cc.action[s] == CMP_ACT_GPIO_HIGH || cc.action[s] == CMP_ACT_GPIO_LOW) {
+        uint8_t pin = (uint8_t)cc.target[s];
+        gpio_handle_dynamic_conflict(pin);   // compare ejer pin'en (DYNAMIC)
+        pinMode(pin, OUTPUT);
+        port[s] = portOutputRegister(digitalPinToPort(pin));
+        mask[s] = digitalPinToBitMask(pin);
+      }
+      active |= (uint8_t)(1u << s);
+    }
+
+    uint8_t sreg = SREG;
+    cli();
+    for (uint8_t s = 0; s < CMP_SETPOINTS; ++s) {
+      cmpPortOut[i][s] = port[s];
+      cmpPinMask[i][s] = mask[s];
+    }
+    cmpActive[i] = active;
+    SREG = sreg;
+
+    cmp_refresh_setpoints(i);
+  }
+}
+
+void cmp_on_count(uint8_t idx, uint64_t prev, uint64_t now) {
+  if (idx >= 4) return;
+  // Omløb siden sidst (følges også når intet setpoint er aktivt, så et
+  // gammelt omløb ikke tolkes ind i en senere reset)
+  uint8_t w = counterWrapSeq[idx];
+  bool wrapped = w != cmpWrapSeen[idx];
+  cmpWrapSeen[idx] = w;
+  if (!cmpActive[idx] || prev == now) return;
+  if (counters[idx].bitWidth == 64) return;   // counter ændret til 64 bit efter config
+  bool down = counters[idx].direction == CNT_DIR_DOWN;
+  uint64_t sv = wrapped ? maskToBitWidth(counters[idx].startValue,
+                                         sanitizeBitWidth(counters[idx].bitWidth)) : 0;
+
+  for (uint8_t s = 0; s < CMP_SETPOINTS; ++s) {
+    uint8_t bit = (uint8_t)(1u << s);
+    if (!(cmpActive[idx] & bit)) continue;
+    if (!cmp_crossed(cmpSp[idx][s], prev, now, down, wrapped, sv)) continue;
+
+    // GPIO straks (µs-reaktion også fra ISR). SREG-beskyttet RMW på PORTx.
+    volatile uint8_t* port = cmpPortOut[idx][s];
+    uint8_t action = counterCompare[idx].action[s];
+    uint8_t sreg = SREG;
+    cli();
+    if (port) {
+      if (action == CMP_ACT_GPIO_HIGH) *port |= cmpPinMask[idx][s];
+      else *port &= (uint8_t)~cmpPinMask[idx][s];
+    }
+    // Coil (+ evt. mappet pin) ligeledes straks
+    if (action == CMP_ACT_COIL_SET || action == CMP_ACT_COIL_CLEAR) {
+      gpio_coil_write(counterCompare[idx].target[s], action == CMP_ACT_COIL_SET);
+    }
+    cmpPending[idx] |= bit;
+    idle_isr_post();
+    SREG = sreg;
+  }
+}
+
+void cmp_loop() {
+  for (uint8_t i = 0; i < 4; ++i) {
+    const CounterCompareConfig& cc = counterCompare[i];
+    if (cc.reg == 0 || !cmpActive[i]) continue;
+
+    uint8_t sreg = SREG;
+    cli();
+    uint8_t fired = cmpPending[i];
+    cmpPending[i] = 0;
+    SREG = sreg;
+
+    if (fired) {
+      for (uint8_t s = 0; s < CMP_SETPOINTS; ++s) {
+        if (!(fired & (1u << s))) continue;
+        uint16_t target = cc.target[s];
+        switch (cc.action[s]) {
+          case CMP_ACT_TIMER:
+            // Samme vej som en Modbus coil-skrivning til timerens coil
+            timers_onCoilWrite(timers[target - 1].coil, 1);
+            break;
+          default: break;
+        }
+      }
+      // Latch: sticky indtil master skriver 0
+      holdingRegs[cc.reg + CMP_SETPOINTS * 2] |= fired;
+    }
+
+    // Setpoints kan ændres af master når som helst
+    cmp_refresh_setpoints(i);
+  }
+}
+
+uint32_t cmp_next_deadline_ms() {
+  for (uint8_t i = 0; i < 4; ++i) {
+    if (cmpPending[i]) return 0;
+  }
+  return IDLE_NO_DEADLINE;
+}
+
+bool cmp_uses_pin(uint8_t pin) {
+  for (uint8_t i = 0; i < 4; ++i) {
+    const CounterCompareConfig& cc = counterCompare[i];
+    if (cc.reg == 0) continue;
+    for (uint8_t s = 0; s < CMP_SETPOINTS; ++s) {
+      if ((cc.action[s] == CMP_ACT_GPIO_HIGH || cc.action[s] == CMP_ACT_GPIO_LOW) &&
+          cc.target[s] == pin) return true;
+    }
+  }
+  return false;
+}
+
+bool cmp_active(uint8_t idx) {
+  return idx < 4 && counterCompare[idx].reg != 0 && cmpActive[idx] != 0;
+}
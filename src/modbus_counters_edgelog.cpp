@@ -0,0 +1,197 @@
+// ============================================================================
+//  Filnavn : modbus_counters_edgelog.cpp
+//  Projekt  : Modbus RTU Server / CLI
+//  Version  : v3.7.5 (2026-10-18)
+//  Forfatter: JanG at modbus_slave@laces.dk
+//  Formål   : Edge-tidsstempel ring (se modbus_counters_edgelog.h).
+//             ISR-vejen skriver kun slot + intern head i privat RAM; head-
+//             registret publiceres fra loop, og slots kopieres til holding-
+//             regs når en FC03 læser blokken.
+//  Ændringer:
+//    - v3.9.6: Ring-RAM fra en pulje på EDGELOG_POOL tidsstempler, fordelt
+//              efter depth på counters med edge-log; FC03-kopien tager ét
+//              slot pr. kritisk sektion og gentager slots der blev skrevet
+//              undervejs (head før/efter)
+//    - v3.9.6: Overlap tjekkes mod alle reg-blokke (regmap_owner), ikke
+//              kun andre ringe
+//    - v3.9.6: Ringen ligger i privat RAM (elogRam) og kopieres til
+//              holding-regs ved FC03 (edgelog_publish); FC06/FC16 til
+//              blokken afvises. Erstatter sekvenstælleren (edgelog_seq)
+// ============================================================================
+
+#include "modbus_counters_edgelog.h"
+#include "modbus_counters.h"
+#include "modbus_timebase.h"
+#include "modbus_regmap.h"
+
+CounterEdgeLogConfig counterEdgeLog[4];
+
+// ============================================================================
+// Runtime state (ændres kun med interrupts slået fra)
+// ============================================================================
+// Ring-RAM: ringene ligger i counter-rækkefølge i puljen, hver med depth
+// tidsstempler (sum af depth <= EDGELOG_POOL). Counters uden edge-log
+// bruger intet af den.
+static uint32_t  elogRam[EDGELOG_POOL];
+static uint32_t* elogSlots[4] = {0, 0, 0, 0};   // ringens start i elogRam (0 = fra)
+static uint8_t   elogDepth[4];
+static uint8_t   elogPos[4];                    // næste slot
+static volatile uint16_t elogHead[4];           // antal loggede edges
+
+// Ny depth for ring idx: efterfølgende ringe rykkes (med indhold), så
+// puljen forbliver samlet. Kaldes med interrupts slået fra.
+static void elog_relayout(uint8_t idx, uint8_t depth) {
+  uint8_t off = 0;
+  for (uint8_t i = 0; i < idx; ++i) off += elogDepth[i];
+  int8_t delta = (int8_t)(depth - elogDepth[idx]);
+
+  // Ryk bagvedliggende ringe; mod højre bagfra, mod venstre forfra
+  for (uint8_t n = 0; n < 3; ++n) {
+    uint8_t i = (delta > 0) ? (uint8_t)(3 - n) : (uint8_t)(idx + 1 + n);
+    if (i <= idx || i > 3 || !elogSlots[i]) continue;
+    uint32_t* to = elogSlots[i] + delta;
+    memmove(to, elogSlots[i], elogDepth[i] * sizeof(uint32_t));
+    elogSlots[i] = to;
+  }
+
+  elogDepth[idx] = depth;
+  elogSlots[idx] = depth ? &elogRam[off] : 0;
+  if (depth) memset(elogSlots[idx], 0, depth * sizeof(uint32_t));
+}
+
+// ============================================================================
+// API
+// ============================================================================
+bool edgelog_config_set(uint8_t idx, const CounterEdgeLogConfig& cfg) {
+  if (idx >= 4) return false;
+  if (cfg.reg != 0) {
+    if (cfg.depth < 1 || cfg.depth > EDGELOG_MAX_DEPTH) return false;
+    if ((uint32_t)cfg.reg + EDGELOG_BLOCK_REGS(cfg.depth) > NUM_REGS) return false;
+    if (regmap_owner(cfg.reg, EDGELOG_BLOCK_REGS(cfg.depth), REGMAP_ID(REGMAP_EDGELOG, idx))) return false;
+    // Plads i puljen ved siden af de andre ringe
+    uint16_t used = cfg.depth;
+    for (uint8_t i = 0; i < 4; ++i) {
+      if (i != idx) used += elogDepth[i];
+    }
+    if (used > EDGELOG_POOL) return false;
+  }
+
+  uint8_t sreg = SREG;
+  cli();
+  counterEdgeLog[idx] = cfg;
+  if (cfg.reg == 0) counterEdgeLog[idx].depth = 0;
+  elog_relayout(idx, counterEdgeLog[idx].depth);
+  elogPos[idx]   = 0;
+  elogHead[idx]  = 0;
+  SREG = sreg;
+
+  if (cfg.reg != 0) {
+    memset(&holdingRegs[cfg.reg], 0, EDGELOG_BLOCK_REGS(cfg.depth) * sizeof(uint16_t));
+  }
+  counters_poll_plan_rebuild();   // sampler-ISR skal kende kanaler med edge-log
+  return true;
+}
+
+void edgelog_stamp_isr(uint8_t idx, uint32_t us) {
+  uint32_t* slots = elogSlots[idx];
+  if (!slots) return;
+  uint8_t pos = elogPos[idx];
+  slots[pos] = us;
+  if (++pos >= elogDepth[idx]) pos = 0;
+  elogPos[idx] = pos;
+  elogHead[idx]++;
+}
+
+void edgelog_stamp(uint8_t idx) {
+  if (idx >= 4 || !elogSlots[idx]) return;
+  uint8_t sreg = SREG;
+  cli();
+  edgelog_stamp_isr(idx, timebase_us_isr());
+  SREG = sreg;
+}
+
+void edgelog_loop() {
+  for (uint8_t i = 0; i < 4; ++i) {
+    uint16_t reg = counterEdgeLog[i].reg;
+    if (reg == 0) continue;
+    uint8_t sreg = SREG;
+    cli();
+    uint16_t h = elogHead[i];
+    SREG = sreg;
+    holdingRegs[reg] = h;
+  }
+}
+
+bool edgelog_overlaps(uint16_t start, uint16_t count) {
+  for (uint8_t i = 0; i < 4; ++i) {
+    if (!elogSlots[i]) continue;
+    uint16_t first = counterEdgeLog[i].reg;
+    uint16_t last  = first + 2 * (uint16_t)elogDepth[i];
+    if (start <= last && (uint32_t)start + count > first) return true;
+  }
+  return false;
+}
+
+// Kopiér slot k (hvis i [k0, k1)) til registrene - ét slot pr. kritisk
+// sektion, så sampler-ISR'en (op til 20 kHz) ikke mister samples
+static void elog_copy_slot(uint8_t i, uint16_t base, uint8_t k, uint8_t k0, uint8_t k1) {
+  if (k < k0 || k >= k1) return;
+  uint8_t sreg = SREG;
+  cli();
+  uint32_t us = elogSlots[i][k];
+  SREG = sreg;
+  holdingRegs[base + 1 + 2 * k] = (uint16_t)us;
+  holdingRegs[base + 2 + 2 * k] = (uint16_t)(us >> 16);
+}
+
+void edgelog_publish(uint16_t start, uint16_t count) {
+  uint32_t end = (uint32_t)start + count;      // eksklusiv
+  for (uint8_t i = 0; i < 4; ++i) {
+    if (!elogSlots[i]) continue;
+    uint16_t base = counterEdgeLog[i].reg;
+    uint8_t depth = elogDepth[i];
+    if (start > base + 2 * (uint16_t)depth || end <= base) continue;
+    // Kun slots i læseområdet
+    uint8_t k0 = (start > base + 1) ? (uint8_t)((start - base - 1) / 2) : 0;
+    uint8_t k1 = depth;
+    if (end < (uint32_t)base + 1 + 2 * k1) k1 = (uint8_t)((end - base) / 2);
+
+    uint8_t sreg = SREG;
+    cli();
+    uint16_t h = elogHead[i];
+    SREG = sreg;
+    for (uint8_t k = k0; k < k1; ++k) elog_copy_slot(i, base, k, k0, k1);
+
+    // Edges under kopien: kopiér de slots de skrev igen, til head står
+    // stille (edges h+1..h1 ligger i de n slots før elogPos)
+    for (uint8_t tries = 0; tries < 4; ++tries) {
+      sreg = SREG;
+      cli();
+      uint16_t h1  = elogHead[i];
+      uint8_t  pos = elogPos[i];
+      SREG = sreg;
+      uint16_t n = (uint16_t)(h1 - h);
+      if (n == 0) break;
+      if (n > depth) n = depth;
+      for (uint16_t e = 0; e < n; ++e) {
+        pos = (pos == 0) ? (uint8_t)(depth - 1) : (uint8_t)(pos - 1);
+        elog_copy_slot(i, base, pos, k0, k1);
+      }
+      h = h1;
+    }
+    holdingRegs[base] = h;
+  }
+}
+
+bool edgelog_enabled(uint8_t idx) {
+  return idx < 4 && elogSlots[idx] != 0;
+}
+
+uint16_t edgelog_head(uint8_t idx) {
+  if (idx >= 4) return 0;
+  uint8_t sreg = SREG;
+  cli();
+  uint16_t h = elogHead[idx];
+  SREG = sreg;
+  return h;
+}
@@ -7,6 +7,9 @@
 //             ISR for Timer5 overflow events (external clock mode on Pin 2).
 //             Supports deterministic, interrupt-driven pulse counting.
 //             Unified prescaler strategy: ALL pulses counted, prescaler in software.
+//  Ændringer:
+//    - v3.9.6: Frekvens-state i file-scope; hw_counter_freq_next_ms() til
+//              idle-scheduleren
 // ============================================================================
 
 #include "modbus_counters_hw.h"
@@ -22,6 +25,11 @@ volatile uint32_t hwCounter5Extend = 0;
 // Overflow tracking for frequency measurement
 volatile uint16_t hwOverflowCount = 0;
 
+// Frequency tracking for Timer5 (hw_counter_update_frequency)
+static uint32_t hwFreqLastValue = 0;
+static unsigned long hwFreqLastMs = 0;
+static bool hwFreqInit = false;
+
 // ============================================================================
 // ISR - Timer5 Overflow (Pin 2 / PE4 / T5, external clock mode)
 // ============================================================================
@@ -164,7 +172,7 @@ void hw_counter_reset_frequency(uint8_t counter_id) {
   if (counter_id < 1 || counter_id > 4) return;
 
   // We need to mark this counter as needing reinitialization
-  // This is handled by the initialized flag in hw_counter_update_frequency
+  // This is handled by hwFreqInit in hw_counter_update_frequency
   // Since we can't access static variables from another function, we rely on
   // the fact that after reset, hwOverflowCount is 0, and the first frequency
   // update will detect this anomaly and reinitialize automatically
@@ -194,33 +202,28 @@ void hw_counter_update_frequency(uint16_t freq_reg, uint8_t counter_id) {
   // Validate parameters
   if (freq_reg >= NUM_REGS || counter_id != 4) return;
 
-  // Static tracking variables for Timer5 frequency measurement
-  static uint32_t lastCounterValue = 0;
-  static unsigned long lastFreqUpdateMs = 0;
-  static bool initialized = false;
-
   unsigned long nowMs = millis();
 
   // Get current counter value (combines hwCounter5Extend + TCNT5)
   uint32_t currentCounterValue = hw_counter_get_value(counter_id);
 
   // Initialize on first call
-  if (!initialized) {
-    lastCounterValue = currentCounterValue;
-    lastFreqUpdateMs = nowMs;
-    initialized = true;
+  if (!hwFreqInit) {
+    hwFreqLastValue = currentCounterValue;
+    hwFreqLastMs = nowMs;
+    hwFreqInit = true;
     holdingRegs[freq_reg] = 0;
     return;
   }
 
-  unsigned long timeDeltaMs = nowMs - lastFreqUpdateMs;
+  unsigned long timeDeltaMs = nowMs - hwFreqLastMs;
 
   // Detect counter reset: counter value decreased (went backwards)
   // This happens when hw_counter_reset() is called
-  if (currentCounterValue < lastCounterValue) {
+  if (currentCounterValue < hwFreqLastValue) {
     // Counter was reset - reinitialize tracking
-    lastCounterValue = currentCounterValue;
-    lastFreqUpdateMs = nowMs;
+    hwFreqLastValue = currentCounterValue;
+    hwFreqLastMs = nowMs;
     holdingRegs[freq_reg] = 0;
     return;
   }
@@ -231,14 +234,14 @@ void hw_counter_update_frequency(uint16_t freq_reg, uint8_t counter_id) {
     // NOTE: Hardware always counts ALL pulses (external clock mode).
     // Prescaler is handled in software (see modbus_counters.cpp).
     // So pulseDelta represents actual pulse count without prescaler compensation.
-    uint32_t pulseDelta = currentCounterValue - lastCounterValue;
+    uint32_t pulseDelta = currentCounterValue - hwFreqLastValue;
 
     // Sanity check: if pulseDelta is unreasonably large, skip measurement
     // (e.g., pulseDelta > 100000 @ 1sec = >100kHz, but design max is 20kHz)
     if (pulseDelta > 100000UL) {
       // Skip this measurement as anomalous
-      lastCounterValue = currentCounterValue;
-      lastFreqUpdateMs = nowMs;
+      hwFreqLastValue = currentCounterValue;
+      hwFreqLastMs = nowMs;
       return;
     }
 
@@ -253,14 +256,20 @@ void hw_counter_update_frequency(uint16_t freq_reg, uint8_t counter_id) {
     holdingRegs[freq_reg] = (uint16_t)freqHz;
 
     // Update tracking for next measurement
-    lastCounterValue = currentCounterValue;
-    lastFreqUpdateMs = nowMs;
+    hwFreqLastValue = currentCounterValue;
+    hwFreqLastMs = nowMs;
   }
   // If time delta is > 5000ms, reset tracking to avoid stale measurements
   else if (timeDeltaMs > 5000) {
-    lastCounterValue = currentCounterValue;
-    lastFreqUpdateMs = nowMs;
+    hwFreqLastValue = currentCounterValue;
+    hwFreqLastMs = nowMs;
     holdingRegs[freq_reg] = 0;  // Reset frequency to 0 (timeout)
   }
 }
 
+uint32_t hw_counter_freq_next_ms() {
+  if (!hwFreqInit) return 0;
+  unsigned long age = millis() - hwFreqLastMs;
+  return (age >= 1000) ? 0 : (uint32_t)(1000 - age);
+}
+
@@ -0,0 +1,205 @@
+// ============================================================================
+//  Filnavn : modbus_counters_pwm.cpp
+//  Projekt  : Modbus RTU Server / CLI
+//  Version  : v3.7.6 (2026-10-18)
+//  Forfatter: JanG at modbus_slave@laces.dk
+//  Formål   : Pulsbredde/duty-cycle måling (se modbus_counters_pwm.h).
+//             ISR-delen er O(1) med 32-bit summer i Timer4 ticks; division
+//             og registerskrivning sker i loop.
+//  Ændringer:
+//    - v3.9.6: Flanke poster arbejde til idle (idle_isr_post)
+//    - v3.9.6: Reg-blok må ikke overlappe andre features (regmap_owner)
+//    - v3.9.6: pwm_next_deadline_ms() til idle-scheduleren
+// ============================================================================
+
+#include "modbus_counters_pwm.h"
+#include "modbus_counters.h"
+#include "modbus_timebase.h"
+#include "modbus_idle.h"
+#include "modbus_regmap.h"
+
+CounterPwmConfig counterPwm[4];
+
+// ============================================================================
+// Runtime state (ISR-del ændres kun med interrupts slået fra)
+// ============================================================================
+struct PwmState {
+  uint32_t lastRise;     // ticks ved sidste stigende flanke
+  uint32_t lastFall;     // ticks ved sidste faldende flanke
+  uint32_t sumHigh;      // summeret høj-tid (ticks) i aktuel måling
+  uint32_t sumPeriod;    // summeret periode (ticks) i aktuel måling
+  uint8_t  n;            // cyklusser i aktuel måling
+  uint8_t  phase;        // 0 = venter på rise, 1 = rise set, 2 = rise+fall set
+  uint8_t  edgeSeen;     // flanke siden sidste pwm_loop()
+  // Færdig måling til loop
+  uint32_t resHigh;
+  uint32_t resPeriod;
+  uint8_t  resN;
+};
+
+static PwmState pwmSt[4];
+static uint8_t  pwmActive = 0;            // bit i = counter i+1 måler PWM
+static unsigned long pwmLastEdgeMs[4];    // loop-tid for sidste flanke
+static unsigned long pwmLoopMs = 0;       // seneste pwm_loop()
+
+static void pwm_reset_state(uint8_t idx) {
+  uint8_t sreg = SREG;
+  cli();
+  memset(&pwmSt[idx], 0, sizeof(PwmState));
+  SREG = sreg;
+  pwmLastEdgeMs[idx] = millis();
+}
+
+static void pwm_write32(uint16_t reg, uint32_t v) {
+  holdingRegs[reg]     = (uint16_t)(v & 0xFFFF);
+  holdingRegs[reg + 1] = (uint16_t)(v >> 16);
+}
+
+// ============================================================================
+// API
+// ============================================================================
+bool pwm_config_set(uint8_t idx, const CounterPwmConfig& cfg) {
+  if (idx >= 4) return false;
+  if (cfg.reg != 0) {
+    if ((uint32_t)cfg.reg + PWM_BLOCK_REGS > NUM_REGS) return false;
+    if (regmap_owner(cfg.reg, PWM_BLOCK_REGS, REGMAP_ID(REGMAP_PWM, idx))) return false;
+    if (cfg.avgCycles < 1 || cfg.avgCycles > PWM_MAX_AVG) return false;
+    if (cfg.timeoutMs == 0) return false;
+    const CounterConfig& c = counters[idx];
+    if (c.hwMode != 0 || c.interruptPin == 0) return false;   // kun SW-ISR
+  }
+
+  uint8_t bit = (uint8_t)(1u << idx);
+  uint8_t sreg = SREG;
+  cli();
+  counterPwm[idx] = cfg;
+  if (cfg.reg != 0) pwmActive |= bit;
+  else pwmActive &= (uint8_t)~bit;
+  SREG = sreg;
+
+  pwm_reset_state(idx);
+  if (cfg.reg != 0) {
+    memset(&holdingRegs[cfg.reg], 0, PWM_BLOCK_REGS * sizeof(uint16_t));
+  }
+  return true;
+}
+
+bool pwm_enabled(uint8_t idx) {
+  return idx < 4 && (pwmActive & (1u << idx));
+}
+
+void pwm_on_level_isr(uint8_t idx, uint8_t level, uint32_t ticks) {
+  if (!(pwmActive & (1u << idx))) return;
+  PwmState& s = pwmSt[idx];
+  s.edgeSeen = 1;
+  idle_isr_post();                // deadline: timeout -> PWM_PUBLISH_MS
+
+  if (!level) {
+    // Faldende flanke: høj-tid er kendt når næste rise kommer
+    s.lastFall = ticks;
+    if (s.phase == 1) s.phase = 2;
+    return;
+  }
+
+  // Stigende flanke: afslut cyklus rise -> fall -> rise
+  if (s.phase == 2) {
+    s.sumHigh   += s.lastFall - s.lastRise;
+    s.sumPeriod += ticks - s.lastRise;
+    if (++s.n >= counterPwm[idx].avgCycles) {
+      s.resHigh   = s.sumHigh;
+      s.resPeriod = s.sumPeriod;
+      s.resN      = s.n;
+      s.sumHigh = 0;
+      s.sumPeriod = 0;
+      s.n = 0;
+    }
+  }
+  s.lastRise = ticks;
+  s.phase = 1;
+}
+
+void pwm_loop() {
+  if (!pwmActive) return;
+  unsigned long nowMs = millis();
+  pwmLoopMs = nowMs;
+
+  for (uint8_t i = 0; i < 4; ++i) {
+    if (!(pwmActive & (1u << i))) continue;
+    const CounterPwmConfig& pc = counterPwm[i];
+    PwmState& s = pwmSt[i];
+    const CounterConfig& c = counters[i];
+
+    uint8_t sreg = SREG;
+    cli();
+    uint32_t high = s.resHigh;
+    uint32_t period = s.resPeriod;
+    uint8_t n = s.resN;
+    uint8_t seen = s.edgeSeen;
+    s.resN = 0;
+    s.edgeSeen = 0;
+    SREG = sreg;
+
+    if (seen) pwmLastEdgeMs[i] = nowMs;
+
+    if (n > 0 && period > 0) {
+      // Gennemsnit i µs (ticks / (2 * n)), duty i 0,01 %
+      uint32_t div = (uint32_t)n * TIMEBASE_TICKS_PER_US;
+      uint32_t highUs = (high + div / 2) / div;
+      uint32_t periodUs = (period + div / 2) / div;
+      uint16_t duty = (uint16_t)(((uint64_t)high * 10000UL + period / 2) / period);
+
+      pwm_write32(pc.reg, highUs);
+      pwm_write32(pc.reg + 2, periodUs - (highUs < periodUs ? highUs : periodUs));
+      pwm_write32(pc.reg + 4, periodUs);
+      holdingRegs[pc.reg + 6] = duty;
+      holdingRegs[pc.reg + 7] = PWM_ST_VALID;
+
+      // freq-reg fra målt periode (Hz, afrundet, mættet til 16 bit)
+      if (c.freqReg > 0 && c.freqReg < NUM_REGS) {
+        uint32_t hz = ((uint32_t)n * TIMEBASE_TICKS_PER_US * 1000000UL + period / 2) / period;
+        holdingRegs[c.freqReg] = (hz > 0xFFFFUL) ? 0xFFFF : (uint16_t)hz;
+      }
+      continue;
+    }
+
+    // Stale: ingen flanke i timeout -> fast niveau
+    if ((nowMs - pwmLastEdgeMs[i]) > pc.timeoutMs &&
+        !(holdingRegs[pc.reg + 7] & PWM_ST_STALE)) {
+      uint8_t level = digitalRead(c.interruptPin) ? 1 : 0;
+      sreg = SREG;
+      cli();
+      s.phase = 0;
+      s.n = 0;
+      s.sumHigh = 0;
+      s.sumPeriod = 0;
+      SREG = sreg;
+
+      pwm_write32(pc.reg, 0);
+      pwm_write32(pc.reg + 2, 0);
+      pwm_write32(pc.reg + 4, 0);
+      holdingRegs[pc.reg + 6] = level ? 10000 : 0;
+      holdingRegs[pc.reg + 7] = (uint16_t)((holdingRegs[pc.reg + 7] & PWM_ST_VALID) |
+                                           PWM_ST_STALE | (level ? PWM_ST_LEVEL : 0));
+      if (c.freqReg > 0 && c.freqReg < NUM_REGS) holdingRegs[c.freqReg] = 0;
+    }
+  }
+}
+
+uint32_t pwm_next_deadline_ms() {
+  if (!pwmActive) return IDLE_NO_DEADLINE;
+  unsigned long nowMs = millis();
+  uint32_t due = IDLE_NO_DEADLINE;
+  for (uint8_t i = 0; i < 4; ++i) {
+    if (!(pwmActive & (1u << i))) continue;
+    uint32_t d;
+    if (pwmSt[i].resN || pwmSt[i].edgeSeen) {
+      d = idle_due_in(pwmLoopMs, PWM_PUBLISH_MS, nowMs);      // 8-bit, atomisk
+    } else if (holdingRegs[counterPwm[i].reg + 7] & PWM_ST_STALE) {
+      continue;                                               // allerede stale
+    } else {
+      d = idle_due_in(pwmLastEdgeMs[i], (uint32_t)counterPwm[i].timeoutMs + 1, nowMs);
+    }
+    if (d < due) due = d;
+  }
+  return due;
+}
@@ -0,0 +1,240 @@
+// ============================================================================
+//  Filnavn : modbus_counters_rate.cpp
+//  Projekt  : Modbus RTU Server / CLI
+//  Version  : v3.7.8 (2026-10-18)
+//  Forfatter: JanG at modbus_slave@laces.dk
+//  Formål   : Rate (60 s / 3600 s) og lifetime totalizer pr. counter
+//             (se modbus_counters_rate.h). Kører kun i loop-kontekst.
+//  Ændringer:
+//    - v3.9.6: Reg-blok må ikke overlappe andre features (regmap_owner)
+//    - v3.9.6: rate_slot_available(); fuld pulje afvises med egen besked
+//    - v3.9.6: rate_next_deadline_ms() til idle-scheduleren
+//    - v3.9.6: Totalizer bevares når rate slås fra og til igen
+//    - v3.9.6: Fald i værdien tælles kun som omløb efter et overflow/
+//              underflow (counterWrapSeq); ellers ny baseline. 64-bit værdi
+// ============================================================================
+
+#include "modbus_counters_rate.h"
+#include "modbus_counters.h"
+#include "modbus_idle.h"
+#include "modbus_regmap.h"
+
+uint16_t counterRateReg[4] = {0, 0, 0, 0};
+
+// ============================================================================
+// Bucket-state pr. slot
+// ============================================================================
+struct RateSlot {
+  uint16_t sec[RATE_SEC_BUCKETS];   // pulser pr. sekund (mættet til 65535)
+  uint32_t blk[RATE_BLK_BUCKETS];   // pulser pr. 5-min blok
+  uint32_t sum60;                   // sum af sec[]
+  uint32_t sumBlk;                  // sum af blk[]
+  uint32_t curSec;                  // pulser i igangværende sekund
+  uint32_t curBlk;                  // pulser i igangværende blok (afsluttede sekunder)
+  uint16_t secInBlk;                // afsluttede sekunder i igangværende blok
+  uint8_t  secPos;
+  uint8_t  blkPos;                  // ældste blok (næste der overskrives)
+  uint64_t lastRaw;                 // rå værdi ved sidste opdatering
+  uint8_t  lastWrap;                // counterWrapSeq ved sidste opdatering
+  uint64_t total;                   // lifetime totalizer
+};
+
+static RateSlot rateSlot[RATE_SLOTS];
+static int8_t   rateSlotOf[4] = {-1, -1, -1, -1};
+static unsigned long rateNextSecMs = 0;
+
+// Totalizer for counters uden slot (rate slået fra) - tages med igen når
+// rate slås til
+static uint64_t rateTotalKeep[4] = {0, 0, 0, 0};
+
+// Antal edges fra 'last' til 'now' i tælleretningen. 'wraps' = antal
+// overflow/underflow med auto-reset til startValue undervejs
+// (counterWrapSeq). En bevægelse mod tælleretningen uden omløb er en
+// værdi-skrivning, startValue-reload eller reset: ingen edges, ny baseline.
+// HW-mode (Timer5) tæller op og løber naturligt rundt ved 2^32.
+static uint32_t rate_delta(const CounterConfig& c, uint64_t last, uint64_t now, uint8_t wraps) {
+  uint64_t d;
+  if (c.hwMode == 5) {
+    d = (uint32_t)((uint32_t)now - (uint32_t)last);
+  } else if (wraps == 0) {
+    if (c.direction == CNT_DIR_DOWN) d = (now <= last) ? last - now : 0;
+    else                             d = (now >= last) ? now - last : 0;
+  } else {
+    uint8_t bw = sanitizeBitWidth(c.bitWidth);
+    uint64_t maxVal = (bw == 64) ? 0xFFFFFFFFFFFFFFFFULL : ((1ULL << bw) - 1);
+    uint64_t sv = maskToBitWidth(c.startValue, bw);
+    if (c.direction == CNT_DIR_DOWN) {
+      // last -> 0 -> underflow -> startValue -> (hele omløb) -> now
+      d = last + 1 + (sv - now) + (uint64_t)(wraps - 1) * (sv + 1);
+    } else {
+      // last -> max -> overflow -> startValue -> (hele omløb) -> now
+      d = (maxVal - last) + 1 + (now - sv) + (uint64_t)(wraps - 1) * (maxVal - sv + 1);
+    }
+  }
+  return (d > 0xFFFFFFFFULL) ? 0xFFFFFFFFUL : (uint32_t)d;
+}
+
+static void rate_publish(uint8_t idx, const RateSlot& r) {
+  uint16_t reg = counterRateReg[idx];
+
+  // Ældste blok vægtes med den andel der stadig er inden for 3600 s
+  uint32_t oldest = r.blk[r.blkPos];
+  uint32_t hour = r.sumBlk - oldest + r.curBlk +
+                  (uint32_t)(((uint64_t)oldest * (RATE_BLK_SECONDS - r.secInBlk)) / RATE_BLK_SECONDS);
+
+  holdingRegs[reg]     = (uint16_t)(r.sum60 & 0xFFFF);
+  holdingRegs[reg + 1] = (uint16_t)(r.sum60 >> 16);
+  holdingRegs[reg + 2] = (uint16_t)(hour & 0xFFFF);
+  holdingRegs[reg + 3] = (uint16_t)(hour >> 16);
+  for (uint8_t w = 0; w < 4; ++w) {
+    holdingRegs[reg + 4 + w] = (uint16_t)(r.total >> (16 * w));
+  }
+}
+
+// Afslut ét sekund: skub curSec ind i ringene
+static void rate_roll_second(RateSlot& r) {
+  uint16_t s = (r.curSec > 0xFFFFUL) ? 0xFFFF : (uint16_t)r.curSec;
+  r.sum60 -= r.sec[r.secPos];
+  r.sec[r.secPos] = s;
+  r.sum60 += s;
+  if (++r.secPos >= RATE_SEC_BUCKETS) r.secPos = 0;
+
+  r.curBlk += r.curSec;
+  r.curSec = 0;
+  if (++r.secInBlk >= RATE_BLK_SECONDS) {
+    r.sumBlk -= r.blk[r.blkPos];
+    r.blk[r.blkPos] = r.curBlk;
+    r.sumBlk += r.curBlk;
+    if (++r.blkPos >= RATE_BLK_BUCKETS) r.blkPos = 0;
+    r.curBlk = 0;
+    r.secInBlk = 0;
+  }
+}
+
+// Første slot uden counter, -1 hvis puljen er fuld
+static int8_t rate_free_slot() {
+  for (uint8_t s = 0; s < RATE_SLOTS; ++s) {
+    bool used = false;
+    for (uint8_t i = 0; i < 4; ++i) if (rateSlotOf[i] == (int8_t)s) used = true;
+    if (!used) return (int8_t)s;
+  }
+  return -1;
+}
+
+// ============================================================================
+// API
+// ============================================================================
+bool rate_slot_available(uint8_t idx) {
+  if (idx >= 4) return false;
+  return rateSlotOf[idx] >= 0 || rate_free_slot() >= 0;
+}
+
+bool rate_config_set(uint8_t idx, uint16_t reg) {
+  if (idx >= 4) return false;
+  if (reg != 0 && (uint32_t)reg + RATE_BLOCK_REGS > NUM_REGS) return false;
+  if (reg != 0 && regmap_owner(reg, RATE_BLOCK_REGS, REGMAP_ID(REGMAP_RATE, idx))) return false;
+
+  if (reg == 0) {
+    if (rateSlotOf[idx] >= 0) rateTotalKeep[idx] = rateSlot[rateSlotOf[idx]].total;
+    rateSlotOf[idx] = -1;
+    counterRateReg[idx] = 0;
+    return true;
+  }
+
+  if (rateSlotOf[idx] < 0) {
+    int8_t free = rate_free_slot();
+    if (free < 0) return false;
+    memset(&rateSlot[free], 0, sizeof(RateSlot));
+    rateSlot[free].total = rateTotalKeep[idx];
+    rateSlotOf[idx] = free;
+    rate_rebase(idx);
+  }
+
+  counterRateReg[idx] = reg;
+  if (rateNextSecMs == 0) rateNextSecMs = millis() + 1000UL;
+  rate_publish(idx, rateSlot[rateSlotOf[idx]]);
+  return true;
+}
+
+void rate_rebase(uint8_t idx) {
+  if (idx >= 4 || rateSlotOf[idx] < 0) return;
+  RateSlot& r = rateSlot[rateSlotOf[idx]];
+  r.lastRaw  = counters[idx].counterValue;
+  r.lastWrap = counterWrapSeq[idx];
+}
+
+void rate_on_reset(uint8_t idx, uint64_t before) {
+  if (idx >= 4 || rateSlotOf[idx] < 0) return;
+  RateSlot& r = rateSlot[rateSlotOf[idx]];
+  uint8_t w = counterWrapSeq[idx];
+  uint32_t d = rate_delta(counters[idx], r.lastRaw, before, (uint8_t)(w - r.lastWrap));
+  r.curSec += d;
+  r.total += d;
+  r.lastRaw  = counters[idx].counterValue;
+  r.lastWrap = w;
+}
+
+void rate_total_reset(uint8_t idx) {
+  if (idx >= 4) return;
+  rateTotalKeep[idx] = 0;
+  if (rateSlotOf[idx] < 0) return;
+  rateSlot[rateSlotOf[idx]].total = 0;
+  rate_publish(idx, rateSlot[rateSlotOf[idx]]);
+}
+
+uint64_t rate_total(uint8_t idx) {
+  if (idx >= 4) return 0;
+  if (rateSlotOf[idx] < 0) return rateTotalKeep[idx];
+  return rateSlot[rateSlotOf[idx]].total;
+}
+
+// Edges mellem to rate_loop() lægges til det sekund de behandles i, så
+// loop skal kun køre ved sekundgrænsen (counterWrapSeq fanger omløb)
+uint32_t rate_next_deadline_ms() {
+  bool any = false;
+  for (uint8_t i = 0; i < 4; ++i) {
+    if (rateSlotOf[i] >= 0) any = true;
+  }
+  if (!any) return IDLE_NO_DEADLINE;
+  long in = (long)(rateNextSecMs - millis());
+  return (in <= 0) ? 0 : (uint32_t)in;
+}
+
+void rate_loop() {
+  bool any = false;
+  for (uint8_t i = 0; i < 4; ++i) {
+    if (rateSlotOf[i] < 0) continue;
+    any = true;
+    RateSlot& r = rateSlot[rateSlotOf[i]];
+    uint8_t sreg = SREG;
+    cli();                               // SW-ISR tæller: værdi + omløb samlet
+    uint8_t  w   = counterWrapSeq[i];
+    uint64_t now = counters[i].counterValue;
+    SREG = sreg;
+    if (now != r.lastRaw || w != r.lastWrap) {
+      uint32_t d = rate_delta(counters[i], r.lastRaw, now, (uint8_t)(w - r.lastWrap));
+      r.lastRaw  = now;
+      r.lastWrap = w;
+      r.curSec += d;
+      r.total += d;
+    }
+  }
+  if (!any) return;
+
+  // Sekundgrænse: rul alle slots (indhent evt. flere sekunder efter lang blokering)
+  unsigned long nowMs = millis();
+  if ((long)(nowMs - rateNextSecMs) < 0) return;
+  uint8_t rolls = 0;
+  while ((long)(nowMs - rateNextSecMs) >= 0 && rolls < RATE_SEC_BUCKETS) {
+    for (uint8_t i = 0; i < 4; ++i) {
+      if (rateSlotOf[i] >= 0) rate_roll_second(rateSlot[rateSlotOf[i]]);
+    }
+    rateNextSecMs += 1000UL;
+    rolls++;
+  }
+  if ((long)(nowMs - rateNextSecMs) >= 0) rateNextSecMs = nowMs + 1000UL;
+
+  for (uint8_t i = 0; i < 4; ++i) {
+    if (rateSlotOf[i] >= 0) rate_publish(i, rateSlot[rateSlotOf[i]]);
+  }
+}
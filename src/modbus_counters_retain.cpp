@@ -0,0 +1,378 @@
+// ============================================================================
+//  Filnavn : modbus_counters_retain.cpp
+//  Projekt  : Modbus RTU Server / CLI
+//  Version  : v3.9.6 (2026-10-18)
+//  Forfatter: JanG at modbus_slave@laces.dk
+//  Formål   : Retentive counters - checkpoint-ring i EEPROM
+//             (se modbus_counters_retain.h). Kører kun i loop-kontekst.
+//  Ændringer:
+//    - v3.9.6: retain_next_deadline_ms() til idle-scheduleren
+//    - v3.9.6: 96 records; gammel øverste halvdel migreres ind i ringen
+//              ved første boot, hvorefter profil-området formateres
+//    - v3.9.6: gap 36 s (værste slid med fastholdte records); interval-s
+//              under gap hæves til gap
+// ============================================================================
+
+#include "modbus_counters_retain.h"
+#include "modbus_counters.h"
+#include "modbus_counters_hw.h"
+#include "modbus_counters_window.h"
+#include "modbus_counters_rate.h"
+#include "config_profile.h"
+#include "modbus_idle.h"
+#include <avr/eeprom.h>
+#include <util/crc16.h>
+#include <stddef.h>
+
+CounterRetainConfig counterRetain[4] = {{0, 0}, {0, 0}, {0, 0}, {0, 0}};
+
+struct RetainRecord {
+  uint8_t  id;          // counter 1..4 (0 / 0xFF = tom)
+  uint16_t seq;         // fælles sekvens for ringen
+  uint32_t value;       // rå tællerværdi (32 bit)
+  uint8_t  crc;         // crc8 over ovenstående - skrives sidst
+};
+
+// Nyeste record pr. counter (efter scan / egne skrivninger)
+static bool          recHave[4]  = {false, false, false, false};
+static uint16_t      recSeq[4];
+static uint8_t       recSlot[4];
+static uint32_t      recValue[4];
+static unsigned long recMs[4]    = {0, 0, 0, 0};
+
+static bool     ringScanned = false;
+static uint8_t  ringHead = 0;       // næste slot der skrives
+static uint16_t ringSeq  = 0;       // sekvens for næste record
+
+// Værdier der gendannes af retain_restore()
+static uint32_t restoreValue[4];
+static uint8_t  restoreMask = 0;
+
+// Igangværende record (skrives én byte pr. loop-pass)
+static RetainRecord wr;
+static uint8_t  wrPos  = RETAIN_REC_SIZE;   // RETAIN_REC_SIZE = ingen skrivning
+static uint8_t  wrSlot = 0;
+static uint8_t  wrIdx  = 0;
+static unsigned long lastWriteMs = 0;
+static bool     wroteAny = false;
+static uint8_t  rrNext = 0;                 // round-robin start
+static unsigned long chkMs = 0;             // seneste interval/delta-tjek
+
+// ============================================================================
+// Hjælpere
+// ============================================================================
+static uint8_t* rec_addr(uint8_t slot) {
+  return reinterpret_cast<uint8_t*>(RETAIN_RING_BASE + (uint16_t)slot * RETAIN_REC_SIZE);
+}
+
+static uint8_t rec_crc(const RetainRecord& r) {
+  const uint8_t* p = reinterpret_cast<const uint8_t*>(&r);
+  uint8_t crc = 0;
+  for (uint8_t i = 0; i < offsetof(RetainRecord, crc); ++i) crc = _crc8_ccitt_update(crc, p[i]);
+  return crc;
+}
+
+static bool rec_read(uint8_t slot, RetainRecord& r) {
+  eeprom_read_block(&r, rec_addr(slot), sizeof(r));
+  if (r.id < 1 || r.id > 4) return false;
+  return rec_crc(r) == r.crc;
+}
+
+// Wrap-sikker: a er nyere end b
+static inline bool seq_newer(uint16_t a, uint16_t b) {
+  return (int16_t)(a - b) > 0;
+}
+
+// Rå værdi (lav 32 bit) - SW-ISR counters ændres fra ISR
+static uint32_t retain_value(uint8_t idx) {
+  uint8_t s = SREG;
+  cli();
+  uint32_t v = (uint32_t)counters[idx].counterValue;
+  SREG = s;
+  return v;
+}
+
+// Slot med nyeste record for en retentiv counter må ikke overskrives
+static bool slot_pinned(uint8_t slot) {
+  for (uint8_t j = 0; j < 4; ++j) {
+    if (recHave[j] && recSlot[j] == slot && retain_enabled(j)) return true;
+  }
+  return false;
+}
+
+// Første slot fra ringHead der ikke holder nyeste record for en counter.
+// Ved boot er retentiv-config endnu ikke sat, så alle nyeste records tæller.
+static uint8_t ring_free_slot() {
+  uint8_t slot = ringHead;
+  for (uint8_t n = 0; n < RETAIN_RING_RECS; ++n) {
+    bool held = false;
+    for (uint8_t j = 0; j < 4; ++j) {
+      if (recHave[j] && recSlot[j] == slot) held = true;
+    }
+    if (!held) break;
+    slot = (uint8_t)((slot + 1) % RETAIN_RING_RECS);
+  }
+  return slot;
+}
+
+// Skriv record straks (blokerende, kun ved boot-migrering). crc er sidste
+// byte og skrives sidst.
+static void rec_write_now(uint8_t idx, uint32_t value) {
+  uint8_t slot = ring_free_slot();
+  RetainRecord r;
+  r.id    = idx + 1;
+  r.seq   = ringSeq++;
+  r.value = value;
+  r.crc   = rec_crc(r);
+  eeprom_write_diff(RETAIN_RING_BASE + (uint16_t)slot * RETAIN_REC_SIZE, &r, sizeof(r));
+  recHave[idx]  = true;
+  recSeq[idx]   = r.seq;
+  recSlot[idx]  = slot;
+  recValue[idx] = value;
+  ringHead = (uint8_t)((slot + 1) % RETAIN_RING_RECS);
+}
+
+static void retain_scan() {
+  bool any = false, anyRing = false;
+  uint16_t newest = 0, newestRing = 0;
+  uint8_t newestSlot = 0;
+
+  // Indtil profil-området er formateret kan den gamle øverste halvdel
+  // (ring før v3.9.6) rumme nyere records end ringen
+  bool     legacy = !profile_area_formatted();
+  bool     legHave[4] = {false, false, false, false};
+  uint16_t legSeq[4];
+  uint32_t legValue[4];
+  uint8_t  scanRecs = legacy ? RETAIN_LEGACY_RECS : RETAIN_RING_RECS;
+
+  for (uint8_t s = 0; s < scanRecs; ++s) {
+    RetainRecord r;
+    if (!rec_read(s, r)) continue;
+    if (!any || seq_newer(r.seq, newest)) {
+      newest = r.seq;
+      any = true;
+    }
+    uint8_t i = r.id - 1;
+    if (s >= RETAIN_RING_RECS) {
+      if (!legHave[i] || seq_newer(r.seq, legSeq[i])) {
+        legHave[i]  = true;
+        legSeq[i]   = r.seq;
+        legValue[i] = r.value;
+      }
+      continue;
+    }
+    if (!anyRing || seq_newer(r.seq, newestRing)) {
+      newestRing = r.seq;
+      newestSlot = s;
+      anyRing = true;
+    }
+    if (!recHave[i] || seq_newer(r.seq, recSeq[i])) {
+      recHave[i]  = true;
+      recSeq[i]   = r.seq;
+      recSlot[i]  = s;
+      recValue[i] = r.value;
+    }
+  }
+
+  if (any) ringSeq = (uint16_t)(newest + 1);
+  if (anyRing) ringHead = (uint8_t)((newestSlot + 1) % RETAIN_RING_RECS);
+
+  if (legacy) {
+    // Engangs-migrering: nyeste legacy-værdi flyttes ind i ringen (nyere
+    // seq end alle legacy-records), derefter formateres profil-området, så
+    // den gamle halvdel aldrig læses igen. Strømsvigt midt i: næste boot
+    // gentager, og de migrerede records vinder på seq.
+    for (uint8_t i = 0; i < 4; ++i) {
+      if (legHave[i] && (!recHave[i] || seq_newer(legSeq[i], recSeq[i]))) {
+        rec_write_now(i, legValue[i]);
+      }
+    }
+    profile_area_format();
+  }
+
+  restoreMask = 0;
+  for (uint8_t i = 0; i < 4; ++i) {
+    if (!recHave[i]) continue;
+    restoreValue[i] = recValue[i];
+    restoreMask |= (uint8_t)(1u << i);
+  }
+}
+
+// Programmér højst én ændret byte pr. kald; crc-byten er sidst
+static void retain_write_step() {
+  const uint8_t* src = reinterpret_cast<const uint8_t*>(&wr);
+  uint8_t* dst = rec_addr(wrSlot);
+  while (wrPos < RETAIN_REC_SIZE) {
+    if (!eeprom_is_ready()) return;
+    uint8_t p = wrPos++;
+    if (eeprom_read_byte(dst + p) != src[p]) {
+      eeprom_write_byte(dst + p, src[p]);
+      if (wrPos < RETAIN_REC_SIZE) return;
+    }
+  }
+  recHave[wrIdx]  = true;
+  recSeq[wrIdx]   = wr.seq;
+  recSlot[wrIdx]  = wrSlot;
+  recValue[wrIdx] = wr.value;
+  recMs[wrIdx]    = millis();
+}
+
+static void retain_begin(uint8_t idx, unsigned long now) {
+  uint8_t slot = ringHead;
+  for (uint8_t n = 0; n < RETAIN_RING_RECS && slot_pinned(slot); ++n) {
+    slot = (uint8_t)((slot + 1) % RETAIN_RING_RECS);
+  }
+  for (uint8_t j = 0; j < 4; ++j) {
+    if (recHave[j] && recSlot[j] == slot) recHave[j] = false;   // overskrives
+  }
+
+  wr.id    = idx + 1;
+  wr.seq   = ringSeq;
+  wr.value = retain_value(idx);
+  wr.crc   = rec_crc(wr);
+  wrSlot = slot;
+  wrIdx  = idx;
+  wrPos  = 0;
+
+  ringHead = (uint8_t)((slot + 1) % RETAIN_RING_RECS);
+  ringSeq++;
+  lastWriteMs = now;
+  wroteAny = true;
+  retain_write_step();
+}
+
+static bool retain_due(uint8_t idx, unsigned long now) {
+  if (!retain_enabled(idx) || !counters[idx].enabled) return false;
+  if (!recHave[idx]) return true;
+  if ((uint16_t)(ringSeq - recSeq[idx]) >= RETAIN_SEQ_REFRESH) return true;
+
+  uint32_t v = retain_value(idx);
+  uint32_t last = recValue[idx];
+  if (v == last) return false;
+
+  const CounterRetainConfig& rc = counterRetain[idx];
+  if (rc.intervalS != 0 && now - recMs[idx] >= (unsigned long)rc.intervalS * 1000UL) return true;
+  if (rc.delta != 0) {
+    uint32_t d = (v > last) ? v - last : last - v;
+    if (d >= rc.delta) return true;
+  }
+  return false;
+}
+
+// ============================================================================
+// API
+// ============================================================================
+bool retain_enabled(uint8_t idx) {
+  if (idx >= 4) return false;
+  return counterRetain[idx].intervalS != 0 || counterRetain[idx].delta != 0;
+}
+
+bool retain_config_set(uint8_t idx, const CounterRetainConfig& cfg) {
+  if (idx >= 4) return false;
+  bool was = retain_enabled(idx);
+  counterRetain[idx] = cfg;
+  // Ældre config (gap 17 s) kan have et kortere interval end ringen tillader
+  if (cfg.intervalS && cfg.intervalS < RETAIN_MIN_GAP_S)
+    counterRetain[idx].intervalS = RETAIN_MIN_GAP_S;
+  if (!was && retain_enabled(idx)) recMs[idx] = millis();
+  return true;
+}
+
+void retain_init() {
+  if (!ringScanned) {
+    retain_scan();
+    ringScanned = true;
+    return;
+  }
+  // Genanvendt config (load): behold kørende værdier
+  restoreMask = 0;
+  for (uint8_t i = 0; i < 4; ++i) retain_hold(i);
+}
+
+void retain_hold(uint8_t idx) {
+  if (!retain_enabled(idx) || !counters[idx].enabled) return;
+  restoreValue[idx] = retain_value(idx);
+  restoreMask |= (uint8_t)(1u << idx);
+}
+
+void retain_restore() {
+  for (uint8_t i = 0; i < 4; ++i) {
+    if (!(restoreMask & (1u << i))) continue;
+    CounterConfig& c = counters[i];
+    if (!retain_enabled(i) || !c.enabled) continue;
+
+    uint64_t v = maskToBitWidth(restoreValue[i], c.bitWidth);
+    if (c.hwMode == 5) hw_counter_reset_to_value(4, (uint32_t)v);
+    uint8_t s = SREG;
+    cli();
+    c.counterValue = v;
+    SREG = s;
+    c.lastFreqCalcMs = 0;         // frekvens startes forfra fra ny værdi
+
+    window_rebase(i);
+    rate_rebase(i);
+    store_value_to_regs(i);
+    recMs[i] = millis();
+  }
+  restoreMask = 0;
+}
+
+void retain_loop() {
+  if (wrPos < RETAIN_REC_SIZE) {
+    retain_write_step();
+    return;
+  }
+  unsigned long now = millis();
+  if (wroteAny && now - lastWriteMs < RETAIN_MIN_GAP_MS) return;
+  chkMs = now;
+
+  for (uint8_t k = 0; k < 4; ++k) {
+    uint8_t i = (uint8_t)((rrNext + k) & 3);
+    if (!retain_due(i, now)) continue;
+    rrNext = (uint8_t)((i + 1) & 3);
+    retain_begin(i, now);
+    return;
+  }
+}
+
+uint32_t retain_next_deadline_ms() {
+  if (wrPos < RETAIN_REC_SIZE) return RETAIN_STEP_MS;
+  bool any = false;
+  for (uint8_t i = 0; i < 4; ++i) {
+    if (retain_enabled(i) && counters[i].enabled) any = true;
+  }
+  if (!any) return IDLE_NO_DEADLINE;
+  unsigned long now = millis();
+  if (wroteAny && now - lastWriteMs < RETAIN_MIN_GAP_MS) {
+    return idle_due_in(lastWriteMs, RETAIN_MIN_GAP_MS, now);
+  }
+  return idle_due_in(chkMs, RETAIN_CHECK_MS, now);
+}
+
+void retain_print_status() {
+  Serial.println(F("=== COUNTER RETAIN ==="));
+  bool any = false;
+  unsigned long now = millis();
+  for (uint8_t i = 0; i < 4; ++i) {
+    if (!retain_enabled(i)) continue;
+    any = true;
+    Serial.print(F("Counter ")); Serial.print(i + 1);
+    if (recHave[i]) {
+      Serial.print(F(" | saved ")); Serial.print(recValue[i]);
+      Serial.print(F(" | age ")); Serial.print((now - recMs[i]) / 1000UL);
+      Serial.print(F(" s | seq ")); Serial.print(recSeq[i]);
+    } else {
+      Serial.print(F(" | no checkpoint yet"));
+    }
+    Serial.println();
+  }
+  if (!any) {
+    Serial.println(F("(none)"));
+    return;
+  }
+  Serial.print(F("Ring: ")); Serial.print(RETAIN_RING_RECS);
+  Serial.print(F(" x ")); Serial.print(RETAIN_REC_SIZE);
+  Serial.print(F(" bytes @")); Serial.print(RETAIN_RING_BASE);
+  Serial.print(F(" | head ")); Serial.print(ringHead);
+  Serial.print(F(" | next seq ")); Serial.println(ringSeq);
+}
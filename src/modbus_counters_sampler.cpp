@@ -0,0 +1,210 @@
+// ============================================================================
+//  Filnavn : modbus_counters_sampler.cpp
+//  Projekt  : Modbus RTU Server / CLI
+//  Version  : v3.7.7 (2026-10-18)
+//  Forfatter: JanG at modbus_slave@laces.dk
+//  Formål   : Fast-rate sampler for SW polling-tællere.
+//             Timer2 i CTC mode (OCR2A) giver et compare-match interrupt ved
+//             1..20 kHz. ISR'en læser portene fra CounterPollPlan, beregner
+//             edges med bitmasker, anvender input-filter (µs, Timer4) og tæller
+//             op i 16-bit accumulators. counters_loop() dræner dem atomisk.
+//  Timer-valg:
+//    - Timer0 = millis(), Timer5 = HW counter (T5/pin 47)
+//    - Timer2 er 8-bit og har ingen OC-pins i brug på boardet (kun tone())
+//      -> prescaler 32 (500 kHz) for rater >= 2 kHz, ellers 64 (250 kHz)
+//  Ændringer:
+//    - v3.9.6: Kritiske sektioner gemmer/gendanner SREG i stedet for sei()
+//    - v3.9.6: sampler_drain_period_ms() (dræn-deadline for idle)
+//    - v3.7.7: Gate-input tjekkes i ISR (gate_closed_mask)
+//    - v3.7.5: Edge-tidsstempler logges i ISR ved sample-tidspunktet
+//    - v3.7.4: sampler_peek_isr() til snapshot-latch
+//    - v3.7.2: Holdoff-debounce i samples erstattet af fælles InputFilter
+// ============================================================================
+
+#include "modbus_counters_sampler.h"
+#include "modbus_timebase.h"
+#include "modbus_counters_edgelog.h"
+#include "modbus_counters_window.h"
+#include "modbus_idle.h"
+
+// ============================================================================
+// Sampler state
+// ============================================================================
+// Plan + filtermaske ændres kun med interrupts slået fra (sampler_load_plan)
+static CounterPollPlan smpPlan;
+static uint8_t  smpMask     = 0;      // kanaler der samples (bit i = counter i+1)
+static uint8_t  smpFiltMask = 0;      // kanaler med input-filter (counterFilter[i])
+static uint8_t  smpLevels   = 0;      // sidste samplede (filtrerede) niveauer
+static uint8_t  smpLogMask  = 0;      // kanaler med edge-tidsstempel ring
+static uint8_t  smpGateMask = 0;      // kanaler med gate-input
+static volatile uint16_t smpAcc[4];   // akkumulerede edges pr. kanal
+static volatile uint16_t smpLost = 0; // edges tabt pga. fuld accumulator
+static uint16_t smpRateHz = 0;        // faktisk rate (0 = stoppet)
+
+// Læs alle porte i planen og saml niveauer for de samplede kanaler
+static inline uint8_t smp_read_levels() {
+  uint8_t portVal[4];
+  for (uint8_t p = 0; p < smpPlan.portCount; ++p) {
+    portVal[p] = *smpPlan.portReg[p];
+  }
+  uint8_t levels = 0;
+  for (uint8_t i = 0; i < 4; ++i) {
+    uint8_t bit = (uint8_t)(1u << i);
+    if ((smpMask & bit) && (portVal[smpPlan.chanPort[i]] & smpPlan.chanMask[i])) {
+      levels |= bit;
+    }
+  }
+  return levels;
+}
+
+// ============================================================================
+// ISR - Timer2 Compare Match A (fast sample-rate)
+// ============================================================================
+// CRITICAL: ISRs must NEVER call micros() or millis() (se modbus_counters_hw.cpp)
+ISR(TIMER2_COMPA_vect) {
+  uint8_t now = smp_read_levels();
+
+  // Input-filter kun for kanaler hvor rå niveau eller kandidat afviger
+  // (stille inputs koster ingen 32-bit aritmetik)
+  if (smpFiltMask) {
+    uint32_t t = timebase_ticks_isr();
+    for (uint8_t i = 0; i < 4; ++i) {
+      uint8_t bit = (uint8_t)(1u << i);
+      if (!(smpFiltMask & bit)) continue;
+      InputFilter& f = counterFilter[i];
+      uint8_t raw = (now & bit) ? 1 : 0;
+      uint8_t lvl = f.stable;
+      if (raw != f.cand || f.cand != f.stable) lvl = infilt_level(f, raw, t);
+      if (lvl) now |= bit;
+      else now &= (uint8_t)~bit;
+    }
+  }
+
+  uint8_t changed = now ^ smpLevels;
+  smpLevels = now;
+
+  uint8_t fired = (uint8_t)((changed & now & smpPlan.riseMask) |
+                            (changed & (uint8_t)~now & smpPlan.fallMask));
+  if (!fired) return;
+  if (smpGateMask) fired &= (uint8_t)~gate_closed_mask();   // gated kanaler
+  if (!fired) return;
+
+  // Edge-tidsstempler (kun hvis en fyret kanal har edge-log og kører)
+  uint8_t stamp = (uint8_t)(fired & smpLogMask);
+  uint32_t us = stamp ? timebase_us_isr() : 0;
+
+  for (uint8_t i = 0; i < 4; ++i) {
+    if (!(fired & (1u << i))) continue;
+    if (smpAcc[i] != 0xFFFF) smpAcc[i]++;
+    else if (smpLost != 0xFFFF) smpLost++;
+    if ((stamp & (1u << i)) && counters[i].running) edgelog_stamp_isr(i, us);
+  }
+}
+
+// ============================================================================
+// API
+// ============================================================================
+void sampler_start(uint16_t rateHz) {
+  if (rateHz < SAMPLER_MIN_HZ) rateHz = SAMPLER_MIN_HZ;
+  if (rateHz > SAMPLER_MAX_HZ) rateHz = SAMPLER_MAX_HZ;
+
+  // Prescaler 32 -> 500 kHz tick (OCR2A <= 255 kræver rate >= 1954 Hz)
+  // Prescaler 64 -> 250 kHz tick for lavere rater
+  uint32_t tickHz;
+  uint8_t  csBits;
+  if (rateHz >= 2000) {
+    tickHz = 500000UL;
+    csBits = _BV(CS21) | _BV(CS20);
+  } else {
+    tickHz = 250000UL;
+    csBits = _BV(CS22);
+  }
+  uint16_t top = (uint16_t)((tickHz + rateHz / 2) / rateHz);
+  if (top < 2) top = 2;
+  if (top > 256) top = 256;
+
+  uint8_t s = SREG;
+  cli();
+  TIMSK2 = 0;
+  TCCR2A = _BV(WGM21);           // CTC, TOP = OCR2A
+  TCCR2B = 0;
+  TCNT2  = 0;
+  OCR2A  = (uint8_t)(top - 1);
+  for (uint8_t i = 0; i < 4; ++i) smpAcc[i] = 0;
+  smpLost = 0;
+  TIFR2  = _BV(OCF2A);           // clear pending compare-flag
+  TCCR2B = csBits;
+  TIMSK2 = _BV(OCIE2A);
+  SREG = s;
+
+  smpRateHz = (uint16_t)(tickHz / top);
+}
+
+void sampler_stop() {
+  uint8_t s = SREG;
+  cli();
+  TIMSK2 = 0;
+  TCCR2B = 0;
+  smpMask = 0;
+  for (uint8_t i = 0; i < 4; ++i) smpAcc[i] = 0;
+  SREG = s;
+  smpRateHz = 0;
+}
+
+uint16_t sampler_rate_hz() {
+  return smpRateHz;
+}
+
+void sampler_load_plan(const CounterPollPlan& plan, uint8_t chanMask, uint8_t filtMask) {
+  uint8_t s = SREG;
+  cli();
+  smpPlan = plan;
+  smpMask = chanMask;
+  smpFiltMask = filtMask & chanMask;
+  smpLogMask = 0;
+  smpGateMask = 0;
+  for (uint8_t i = 0; i < 4; ++i) {
+    if (!(chanMask & (1u << i))) continue;
+    if (edgelog_enabled(i)) smpLogMask |= (uint8_t)(1u << i);
+    if (counterGateWin[i].gatePin != 0) smpGateMask |= (uint8_t)(1u << i);
+  }
+  // Sync så ny plan ikke giver falske edges (filtre er nulstillet af kalderen)
+  smpLevels = smp_read_levels();
+  for (uint8_t i = 0; i < 4; ++i) {
+    if (!(chanMask & (1u << i))) smpAcc[i] = 0;
+  }
+  SREG = s;
+}
+
+uint16_t sampler_drain(uint8_t idx) {
+  if (idx >= 4) return 0;
+  uint8_t s = SREG;
+  cli();
+  uint16_t n = smpAcc[idx];
+  smpAcc[idx] = 0;
+  SREG = s;
+  return n;
+}
+
+uint16_t sampler_peek_isr(uint8_t idx) {
+  if (idx >= 4) return 0;
+  return smpAcc[idx];
+}
+
+uint16_t sampler_lost_edges() {
+  uint8_t s = SREG;
+  cli();
+  uint16_t n = smpLost;
+  SREG = s;
+  return n;
+}
+
+uint16_t sampler_max_input_hz() {
+  return smpRateHz / 2;
+}
+
+uint32_t sampler_drain_period_ms() {
+  uint16_t hz = sampler_max_input_hz();
+  if (hz == 0) return IDLE_NO_DEADLINE;
+  return 0xFFFFUL * 1000UL / hz / 2;
+}
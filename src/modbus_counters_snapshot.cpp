@@ -0,0 +1,150 @@
+// ============================================================================
+//  Filnavn : modbus_counters_snapshot.cpp
+//  Projekt  : Modbus RTU Server / CLI
+//  Version  : v3.7.4 (2026-10-18)
+//  Forfatter: JanG at modbus_slave@laces.dk
+//  Formål   : Synkron snapshot-latch af counters (se modbus_counters_snapshot.h).
+//             Capture sker med interrupts slået fra i én omgang; registrene
+//             skrives fra loop, så en FC03-læsning aldrig ser et halvt snapshot.
+//  Ændringer:
+//    - v3.9.6: Latch poster arbejde til idle (idle_isr_post)
+//    - v3.9.6: Reg-blok må ikke overlappe andre features (regmap_owner)
+//    - v3.9.6: Afvis 18/19 (MODBUS_SERIAL), gate-pin og compare-mål
+//    - v3.9.6: Afkortede 64-bit værdier markeres med SNAP_ST_TRUNC(i)
+//    - v3.9.6: snapshot_next_deadline_ms() til idle-scheduleren
+//    - v3.8.7: Afvis pin der bruges som timer trigger-pin
+//    - v3.7.7: Rå værdi læses via counters_raw_value_isr() (deles med tidsvindue)
+// ============================================================================
+
+#include "modbus_counters_snapshot.h"
+#include "modbus_counters.h"
+#include "modbus_counters_sw_int.h"
+#include "modbus_timebase.h"
+#include "modbus_timers_trig.h"
+#include "modbus_counters_window.h"
+#include "modbus_counters_compare.h"
+#include "modbus_idle.h"
+#include "modbus_regmap.h"
+
+uint16_t snapshotReg = 0;
+uint8_t  snapshotPin = 0;
+
+// ============================================================================
+// Capture-buffer (skrives kun med interrupts slået fra)
+// ============================================================================
+static uint32_t snapTsUs;
+static uint32_t snapValue[4];
+static uint16_t snapFreq[4];
+static uint16_t snapTrunc;           // SNAP_ST_TRUNC-bits for snapshottet
+static uint16_t snapSeq = 0;
+static volatile uint8_t snapPending = 0;
+
+static void snap_capture_isr() {
+  snapTsUs = timebase_us_isr();
+  snapTrunc = 0;
+  for (uint8_t i = 0; i < 4; ++i) {
+    const CounterConfig& c = counters[i];
+    snapValue[i] = counters_raw_value_isr(i);
+    snapFreq[i]  = c.currentFreqHz;
+    // Blokken har 32 bit pr. kanal: markér når en 64-bit værdi ikke passer
+    if (c.hwMode != 5 && c.bitWidth == 64 && (uint32_t)(c.counterValue >> 32) != 0) {
+      snapTrunc |= SNAP_ST_TRUNC(i);
+    }
+  }
+  snapSeq++;
+  snapPending = 1;
+  idle_isr_post();
+}
+
+// INT-pin trigger (stigende flanke)
+static void snap_pin_isr() {
+  snap_capture_isr();
+}
+
+// ============================================================================
+// API
+// ============================================================================
+bool snapshot_config_set(uint16_t reg, uint8_t pin) {
+  if (reg != 0 && (uint32_t)reg + SNAP_BLOCK_REGS > NUM_REGS) return false;
+  if (reg != 0 && regmap_owner(reg, SNAP_BLOCK_REGS, REGMAP_ID(REGMAP_SNAPSHOT, 0))) return false;
+  if (pin != 0) {
+    if (!sw_counter_is_valid_interrupt_pin(pin)) return false;
+    if (gpio_pin_reserved(pin)) return false;   // 18/19 = Serial1 (Modbus)
+    if (trig_uses_pin(pin)) return false;        // timer trigger-pin
+    if (counters_uses_pin(pin) || gatewin_uses_pin(pin) || cmp_uses_pin(pin)) return false;
+  }
+
+  // Frigiv gammel trigger-pin
+  if (snapshotPin != 0 && snapshotPin != pin) {
+    detachInterrupt(digitalPinToInterrupt(snapshotPin));
+  }
+
+  snapshotReg = reg;
+  snapshotPin = (reg != 0) ? pin : 0;
+
+  if (snapshotPin != 0) {
+    pinMode(snapshotPin, INPUT);
+    attachInterrupt(digitalPinToInterrupt(snapshotPin), snap_pin_isr, RISING);
+  }
+  if (snapshotReg != 0) holdingRegs[snapshotReg] = 0;
+  return true;
+}
+
+void snapshot_capture() {
+  uint8_t s = SREG;
+  cli();
+  snap_capture_isr();
+  SREG = s;
+}
+
+void snapshot_on_reg_write(uint16_t addr) {
+  if (snapshotReg == 0 || addr != snapshotReg) return;
+  if (holdingRegs[snapshotReg] & SNAP_CTRL_LATCH) {
+    snapshot_capture();
+    snapshot_loop();      // publicér straks så svaret følger et komplet snapshot
+  }
+}
+
+void snapshot_loop() {
+  if (snapshotReg == 0) return;
+
+  // Control-bit sat uden om FC-handlerne (fx CLI write reg)
+  if ((holdingRegs[snapshotReg] & SNAP_CTRL_LATCH) && !snapPending) {
+    snapshot_capture();
+  }
+  if (!snapPending) return;
+
+  uint16_t hdr[SNAP_HDR_REGS];
+  uint16_t ch[4 * SNAP_CH_REGS];
+  uint8_t s = SREG;
+  cli();
+  uint16_t trunc = snapTrunc;
+  hdr[1] = snapSeq;
+  hdr[2] = (uint16_t)(snapTsUs & 0xFFFF);
+  hdr[3] = (uint16_t)(snapTsUs >> 16);
+  for (uint8_t i = 0; i < 4; ++i) {
+    ch[i * SNAP_CH_REGS + 0] = (uint16_t)(snapValue[i] & 0xFFFF);
+    ch[i * SNAP_CH_REGS + 1] = (uint16_t)(snapValue[i] >> 16);
+    ch[i * SNAP_CH_REGS + 2] = snapFreq[i];
+  }
+  snapPending = 0;
+  SREG = s;
+
+  hdr[0] = (uint16_t)((holdingRegs[snapshotReg] & ~(SNAP_CTRL_LATCH | SNAP_ST_TRUNC_ALL)) | trunc);
+  for (uint8_t r = 0; r < SNAP_HDR_REGS; ++r) holdingRegs[snapshotReg + r] = hdr[r];
+  for (uint8_t r = 0; r < 4 * SNAP_CH_REGS; ++r) {
+    holdingRegs[snapshotReg + SNAP_HDR_REGS + r] = ch[r];
+  }
+}
+
+uint32_t snapshot_next_deadline_ms() {
+  return snapPending ? 0 : IDLE_NO_DEADLINE;
+}
+
+uint16_t snapshot_seq() {
+  uint8_t s = SREG;
+  cli();
+  uint16_t n = snapSeq;
+  SREG = s;
+  return n;
+}
@@ -1,18 +1,42 @@
 // ============================================================================
 //  Filnavn : modbus_counters_sw_int.cpp
 //  Projekt  : Modbus RTU Server / CLI
-//  Version  : v3.3.0 (2025-11-13)
+//  Version  : v3.9.6 (2026-10-18)
 //  Forfatter: JanG at modbus_slave@laces.dk
 //  Formål   : External interrupt handling for SW-mode counters.
 //             Provides 6 ISRs for INT0-INT5 (pins 2,3,18,19,20,21).
 //             Prevents CLI operations from blocking edge detection.
+//  Ændringer:
+//    - v3.7.2: Debounce med millis() i ISR erstattet af µs input-filter
+//              (InputFilter + Timer4-tidsbase). Pin læses via PINx-register.
+//    - v3.7.3: Compare-setpoints evalueres direkte i ISR (cmp_on_count)
+//    - v3.7.4: Afvis interrupt-pin der bruges som snapshot-trigger
+//    - v3.7.5: Edge-tidsstempel logges i ISR (edgelog_stamp_isr)
+//    - v3.7.6: Niveauskift sendes til pulsbredde-måling (pwm_on_level_isr)
+//    - v3.7.7: Gate-input tjekkes i ISR før tælling
+//    - v3.8.7: Afvis interrupt-pin der bruges som timer trigger-pin
+//    - v3.9.6: Pulsbredde stemples med rå skift-tidspunkt fra filteret
+//    - v3.9.6: Overflow tælles i counterWrapSeq[] (rate)
+//    - v3.9.6: sw_counter_filter_pending() til idle-scheduleren
+//    - v3.9.6: lastEdgeMs sættes ved hver accepteret edge
+//    - v3.9.6: Ventende filterkandidat poster arbejde til idle
 // ============================================================================
 
 #include "modbus_counters_sw_int.h"
 #include "modbus_counters.h"
 #include "modbus_core.h"
+#include "modbus_idle.h"
+#include "modbus_timebase.h"
+#include "modbus_counters_compare.h"
+#include "modbus_counters_snapshot.h"
+#include "modbus_counters_edgelog.h"
+#include "modbus_counters_pwm.h"
+#include "modbus_counters_window.h"
+#include "modbus_timers_trig.h"
 #include <string.h>
 
+extern volatile unsigned long timer0_millis;   // Arduino core (wiring.c)
+
 // ============================================================================
 // Interrupt Pin Mapping
 // ============================================================================
@@ -23,9 +47,13 @@ static uint8_t counterToInterruptPin[4] = {0, 0, 0, 0};  // 0 = not attached
 // 0 = not used, 1-4 = counter ID
 static uint8_t interruptToCounter[6] = {0, 0, 0, 0, 0, 0};
 
-// Previous pin states for edge detection (per counter)
+// Previous (filtered) pin states for edge detection (per counter)
 static uint8_t counterLastState[4] = {0, 0, 0, 0};
 
+// Precomputed PINx register + bitmask per counter (ISR læser uden digitalRead)
+static volatile uint8_t* counterPinReg[4] = {0, 0, 0, 0};
+static uint8_t counterPinMask[4] = {0, 0, 0, 0};
+
 
 // ============================================================================
 // Valid Interrupt Pin Mapping for SW-ISR Mode
@@ -65,21 +93,10 @@ int8_t sw_counter_pin_to_interrupt(uint8_t pin) {
 // Interrupt Handler Core Logic
 // ============================================================================
 
-void sw_counter_interrupt_handler(uint8_t counter_id) {
-  if (counter_id < 1 || counter_id > 4) return;
-
-  uint8_t idx = counter_id - 1;
+// Edge-detektering på filtreret niveau + tællerskridt.
+// Kaldes fra ISR eller fra loop med interrupts slået fra.
+static void sw_counter_apply_level(uint8_t idx, uint8_t now) {
   CounterConfig& c = counters[idx];
-
-  if (!c.enabled || c.hwMode != 0) return;  // Only SW mode
-  if (!c.running) return;                    // Counter must be running to count
-
-  // Read current pin state directly from the hardware pin associated with this interrupt
-  // (ignore GPIO mapping and inputIndex - ISR mode reads directly from the interrupt pin)
-  uint8_t pin = counterToInterruptPin[idx];
-  if (pin == 0) return;  // Not attached
-
-  uint8_t now = digitalRead(pin) ? 1 : 0;  // Read directly from hardware pin
   uint8_t last = counterLastState[idx];
 
   bool fire = false;
@@ -91,19 +108,16 @@ void sw_counter_interrupt_handler(uint8_t counter_id) {
 
   counterLastState[idx] = now;
 
+  // Pulsbredde-måling ser alle niveauskift uanset tælle-edge (v3.7.6).
+  // Tidsstempel = rå skift, ikke filter-bekræftelsen (v3.9.6)
+  if (last != now) pwm_on_level_isr(idx, now, counterFilter[idx].stableSince);
+
   if (!fire) return;
+  if (!gate_open(idx)) return;   // gate lukket: edge tælles ikke (v3.7.7)
 
-  // Debounce check (if enabled)
-  unsigned long nowMs = millis();
-  if (c.debounceEnable && c.debounceTimeMs > 0) {
-    unsigned long dt = nowMs - c.lastEdgeMs;
-    if (dt < c.debounceTimeMs) {
-      return;  // Ignore this edge as "noise"
-    }
-    c.lastEdgeMs = nowMs;
-  } else if (fire) {
-    c.lastEdgeMs = millis();
-  }
+  // Accepteret edge: millis-tælleren læses direkte, interrupts er slået fra
+  c.lastEdgeMs = timer0_millis;
+  uint64_t prevValue = c.counterValue;
 
   // REMOVED: SW-ISR mode prescaler via edgeCount (now handled in store_value_to_regs)
   // SW-ISR mode now counts ALL edges, just like HW mode and SW mode (v3.6.0)
@@ -136,6 +150,7 @@ void sw_counter_interrupt_handler(uint8_t counter_id) {
 
   if (overflow) {
     c.overflowFlag = 1;
+    counterWrapSeq[idx]++;
     if (c.overflowReg < 160) {
       holdingRegs[c.overflowReg] = 1;
     }
@@ -154,6 +169,76 @@ void sw_counter_interrupt_handler(uint8_t counter_id) {
       holdingRegs[c.freqReg] = 0;
     }
   }
+
+  // Compare-setpoints direkte fra ISR (GPIO-handling sker straks)
+  cmp_on_count(idx, prevValue, c.counterValue);
+
+  // Edge-tidsstempel i ring (v3.7.5)
+  edgelog_stamp_isr(idx, timebase_us_isr());
+}
+
+void sw_counter_interrupt_handler(uint8_t counter_id) {
+  // Tidsstempel først, så input-skiftet stemples før resten af handleren
+  uint32_t t = timebase_ticks_isr();
+  if (counter_id < 1 || counter_id > 4) return;
+
+  uint8_t idx = counter_id - 1;
+  CounterConfig& c = counters[idx];
+
+  if (!c.enabled || c.hwMode != 0) return;  // Only SW mode
+  if (!c.running) return;                    // Counter must be running to count
+
+  // Read current pin state directly from the hardware pin associated with this interrupt
+  // (ignore GPIO mapping and inputIndex - ISR mode reads directly from the interrupt pin)
+  if (counterToInterruptPin[idx] == 0) return;  // Not attached
+  uint8_t raw = (*counterPinReg[idx] & counterPinMask[idx]) ? 1 : 0;
+
+  // Input-filter (v3.7.2): Timer4-tidsstempel, ingen millis() i ISR
+  InputFilter& f = counterFilter[idx];
+  uint8_t now = infilt_level(f, raw, t);
+  if (f.cand != f.stable) idle_isr_post();   // kandidat venter (filter_poll)
+  sw_counter_apply_level(idx, now);
+}
+
+void sw_counter_filter_poll(uint8_t counter_id) {
+  if (counter_id < 1 || counter_id > 4) return;
+  uint8_t idx = counter_id - 1;
+  if (counterToInterruptPin[idx] == 0) return;
+  InputFilter& f = counterFilter[idx];
+  if (f.windowTicks == 0) return;
+
+  const CounterConfig& c = counters[idx];
+  if (!c.enabled || c.hwMode != 0 || !c.running) return;
+
+  uint8_t s = SREG;
+  cli();
+  if (f.cand != f.stable) {
+    // Ingen ny edge siden kandidaten: bekræft den når vinduet er udløbet
+    sw_counter_apply_level(idx, infilt_level(f, f.cand, timebase_ticks_isr()));
+  }
+  SREG = s;
+}
+
+bool sw_counter_filter_pending(uint8_t counter_id) {
+  if (counter_id < 1 || counter_id > 4) return false;
+  uint8_t idx = counter_id - 1;
+  if (counterToInterruptPin[idx] == 0) return false;
+  const InputFilter& f = counterFilter[idx];
+  return f.windowTicks != 0 && f.cand != f.stable;   // 8-bit felter
+}
+
+void sw_counter_filter_reset(uint8_t counter_id, uint32_t windowTicks) {
+  if (counter_id < 1 || counter_id > 4) return;
+  uint8_t idx = counter_id - 1;
+  uint8_t s = SREG;
+  cli();
+  uint8_t level = counterLastState[idx];
+  if (counterToInterruptPin[idx] > 0) {
+    level = (*counterPinReg[idx] & counterPinMask[idx]) ? 1 : 0;
+    counterLastState[idx] = level;
+  }
+  infilt_reset(counterFilter[idx], level, windowTicks);
+  SREG = s;
 }
 
 // ============================================================================
@@ -207,6 +292,12 @@ bool sw_counter_attach_interrupt(uint8_t counter_id, uint8_t pin) {
   if (!sw_counter_is_valid_interrupt_pin(pin)) {
     return false;
   }
+  if (pin == snapshotPin) {
+    return false;  // Reserved as snapshot latch trigger
+  }
+  if (trig_uses_pin(pin)) {
+    return false;  // Reserved as timer trigger input
+  }
 
   int8_t intNum = sw_counter_pin_to_interrupt(pin);
   if (intNum < 0 || intNum > 5) {
@@ -244,8 +335,12 @@ bool sw_counter_attach_interrupt(uint8_t counter_id, uint8_t pin) {
   // Arduino Mega 2560 REQUIRES pin to be INPUT for external interrupts to trigger
   pinMode(pin, INPUT);
 
-  // Initialize counterLastState from the hardware pin (ISR mode ignores GPIO mapping)
-  counterLastState[idx] = digitalRead(pin) ? 1 : 0;
+  // Precompute PINx register + mask so the ISR avoids digitalRead()
+  counterPinReg[idx]  = portInputRegister(digitalPinToPort(pin));
+  counterPinMask[idx] = digitalPinToBitMask(pin);
+
+  // Initialize counterLastState + input-filter from the hardware pin (ISR mode ignores GPIO mapping)
+  sw_counter_filter_reset(counter_id, counters_filter_window_ticks(idx));
   interruptToCounter[intNum] = counter_id;
 
   // Attach the interrupt
@@ -0,0 +1,245 @@
+// ============================================================================
+//  Filnavn : modbus_counters_window.cpp
+//  Projekt  : Modbus RTU Server / CLI
+//  Version  : v3.7.7 (2026-10-18)
+//  Forfatter: JanG at modbus_slave@laces.dk
+//  Formål   : Gate-input og tidsvindue-tælling (se modbus_counters_window.h).
+//             TIMER4_COMPB_vect lukker vinduer: rå værdi latches med
+//             counters_raw_value_isr() og næste grænse armeres i OCR4B.
+//  Ændringer:
+//    - v3.9.6: Vinduesslut i ISR poster arbejde til idle (idle_isr_post)
+//    - v3.9.6: Vindue-blok må ikke overlappe andre features (regmap_owner)
+//    - v3.9.6: gatewin_config_set afviser gate-pin ejet af seriel/counter/
+//              trigger/compare/snapshot/waveform og gate på hw-mode counter
+//    - v3.9.6: gatewin_uses_pin() til pin-ejerskab
+//    - v3.9.6: window_next_deadline_ms() til idle-scheduleren
+//    - v3.9.6: Genlæser TCNT4 efter armering af OCR4B; vinduesværdi
+//              maskeres til counterens bitWidth
+// ============================================================================
+
+#include "modbus_counters_window.h"
+#include "modbus_counters.h"
+#include "modbus_counters_compare.h"
+#include "modbus_counters_snapshot.h"
+#include "modbus_timers_trig.h"
+#include "modbus_timers_wave.h"
+#include "modbus_timebase.h"
+#include "modbus_idle.h"
+#include "modbus_regmap.h"
+
+CounterGateWindowConfig counterGateWin[4];
+
+// ============================================================================
+// Gate state (ændres kun med interrupts slået fra)
+// ============================================================================
+static volatile uint8_t* gatePinReg[4] = {0, 0, 0, 0};
+static uint8_t gatePinMask[4];
+static uint8_t gateActiveHigh[4];
+static uint8_t gateMask = 0;               // bit i = counter i+1 har gate
+
+// ============================================================================
+// Window state
+// ============================================================================
+static uint8_t  winMask = 0;               // bit i = counter i+1 har vindue
+static uint32_t winLenTicks[4];
+static uint32_t winEndTicks[4];            // næste vinduesgrænse (ticks)
+static uint32_t winStartValue[4];          // rå værdi ved vinduesstart
+static uint32_t winResult[4];              // latched resultat (ISR -> loop)
+static uint16_t winSeq[4];
+static volatile uint8_t winPending = 0;    // bit i = nyt resultat klar
+
+static inline uint32_t win_delta(uint8_t idx, uint32_t now) {
+  return (counters[idx].direction == CNT_DIR_DOWN) ? (winStartValue[idx] - now)
+                                                   : (now - winStartValue[idx]);
+}
+
+// Luk alle forfaldne vinduer og armér OCR4B til nærmeste næste grænse.
+// Kræver interrupts slået fra.
+static void win_service_isr() {
+  for (;;) {
+    uint32_t now = timebase_ticks_isr();
+    uint32_t next = 0;
+    int32_t  nextIn = 0x7FFFFFFF;
+
+    for (uint8_t i = 0; i < 4; ++i) {
+      if (!(winMask & (1u << i))) continue;
+      if ((int32_t)(now - winEndTicks[i]) >= 0) {
+        uint32_t v = counters_raw_value_isr(i);
+        winResult[i] = win_delta(i, v);
+        winStartValue[i] = v;
+        winSeq[i]++;
+        winPending |= (uint8_t)(1u << i);
+        idle_isr_post();
+        winEndTicks[i] += winLenTicks[i];
+      }
+      int32_t in = (int32_t)(winEndTicks[i] - now);
+      if (in < nextIn) { nextIn = in; next = winEndTicks[i]; }
+    }
+
+    if (!winMask) return;
+    // Grænse inden for få ticks: behandl straks i stedet for at vente på wrap
+    if (nextIn > 8) {
+      timebase_compb_arm_isr(next);
+      // Genlæs TCNT4: passerede grænsen mens OCR4B blev skrevet, kommer
+      // compare-match først et 16-bit omløb senere - behandl den her
+      if ((int32_t)(next - timebase_ticks_isr()) > 2) return;
+    }
+  }
+}
+
+// ============================================================================
+// ISR - Timer4 Compare Match B (vinduesgrænse)
+// ============================================================================
+// OCR4B matcher lave 16 bit; ved vinduer > 32,768 ms kommer tidlige match,
+// som win_service_isr() blot genarmerer.
+ISR(TIMER4_COMPB_vect) {
+  win_service_isr();
+}
+
+// ============================================================================
+// API
+// ============================================================================
+bool gatewin_uses_pin(uint8_t pin) {
+  if (pin == 0) return false;
+  for (uint8_t i = 0; i < 4; ++i) {
+    if (counterGateWin[i].gatePin == pin) return true;
+  }
+  return false;
+}
+
+// Gate-pin: gyldig GPIO der ikke ejes af seriel/RS485, counter-input,
+// timer-trigger, compare-mål, snapshot-trigger eller waveform-udgang.
+// Flere counters må dele samme gate-pin.
+static bool gate_pin_free(uint8_t pin) {
+  if (pin >= NUM_GPIO || digitalPinToPort(pin) == NOT_A_PIN) return false;
+  if (gpio_pin_reserved(pin) || counters_uses_pin(pin)) return false;
+  if (trig_uses_pin(pin) || cmp_uses_pin(pin)) return false;
+  return pin != snapshotPin && !wave_uses_pin(pin);
+}
+
+bool gatewin_config_set(uint8_t idx, const CounterGateWindowConfig& cfg) {
+  if (idx >= 4) return false;
+  if (cfg.gatePin != 0) {
+    if (!gate_pin_free(cfg.gatePin)) return false;
+    if (counters[idx].hwMode != 0) return false;   // Timer5 tæller uden CPU
+  }
+  if (cfg.windowReg != 0) {
+    if ((uint32_t)cfg.windowReg + WIN_BLOCK_REGS > NUM_REGS) return false;
+    if (regmap_owner(cfg.windowReg, WIN_BLOCK_REGS, REGMAP_ID(REGMAP_WINDOW, idx))) return false;
+    if (cfg.windowMs < 1 || cfg.windowMs > WIN_MAX_MS) return false;
+  }
+
+  volatile uint8_t* preg = 0;
+  uint8_t pmask = 0;
+  if (cfg.gatePin != 0) {
+    gpio_handle_dynamic_conflict(cfg.gatePin);   // gate ejer pin'en (DYNAMIC)
+    pinMode(cfg.gatePin, INPUT);
+    preg  = portInputRegister(digitalPinToPort(cfg.gatePin));
+    pmask = digitalPinToBitMask(cfg.gatePin);
+  }
+
+  uint8_t bit = (uint8_t)(1u << idx);
+  uint8_t sreg = SREG;
+  cli();
+  counterGateWin[idx] = cfg;
+  if (cfg.windowReg == 0) counterGateWin[idx].windowMs = 0;
+
+  gatePinReg[idx]     = preg;
+  gatePinMask[idx]    = pmask;
+  gateActiveHigh[idx] = cfg.gateLevel ? 1 : 0;
+  if (preg) gateMask |= bit;
+  else gateMask &= (uint8_t)~bit;
+
+  winPending &= (uint8_t)~bit;
+  winSeq[idx] = 0;
+  if (cfg.windowReg != 0) {
+    winLenTicks[idx]   = (uint32_t)cfg.windowMs * 1000UL * TIMEBASE_TICKS_PER_US;
+    winEndTicks[idx]   = timebase_ticks_isr() + winLenTicks[idx];
+    winStartValue[idx] = counters_raw_value_isr(idx);
+    winMask |= bit;
+  } else {
+    winMask &= (uint8_t)~bit;
+  }
+  if (winMask) win_service_isr();
+  SREG = sreg;
+
+  if (!winMask) timebase_compb_disable();
+  if (cfg.windowReg != 0) {
+    memset(&holdingRegs[cfg.windowReg], 0, WIN_BLOCK_REGS * sizeof(uint16_t));
+  }
+  counters_poll_plan_rebuild();   // sampler-ISR skal kende gated kanaler
+  return true;
+}
+
+bool gate_open(uint8_t idx) {
+  volatile uint8_t* r = gatePinReg[idx];
+  if (!r) return true;
+  return ((*r & gatePinMask[idx]) ? 1 : 0) == gateActiveHigh[idx];
+}
+
+uint8_t gate_closed_mask() {
+  if (!gateMask) return 0;
+  uint8_t closed = 0;
+  for (uint8_t i = 0; i < 4; ++i) {
+    if ((gateMask & (1u << i)) && !gate_open(i)) closed |= (uint8_t)(1u << i);
+  }
+  return closed;
+}
+
+void window_rebase(uint8_t idx) {
+  if (idx >= 4 || !(winMask & (1u << idx))) return;
+  uint8_t sreg = SREG;
+  cli();
+  winStartValue[idx] = counters_raw_value_isr(idx);
+  SREG = sreg;
+}
+
+void window_loop() {
+  if (!winPending) return;
+  for (uint8_t i = 0; i < 4; ++i) {
+    uint8_t bit = (uint8_t)(1u << i);
+    uint8_t sreg = SREG;
+    cli();
+    bool ready = (winPending & bit) != 0;
+    uint32_t res = winResult[i];
+    uint16_t seq = winSeq[i];
+    winPending &= (uint8_t)~bit;
+    SREG = sreg;
+    if (!ready) continue;
+
+    uint16_t reg = counterGateWin[i].windowReg;
+    if (reg == 0) continue;
+    // Differensen regnes i 32 bit; maskér så et omløb af en smallere
+    // counter (8/16 bit) giver det rigtige antal
+    res = (uint32_t)maskToBitWidth(res, counters[i].bitWidth);
+    holdingRegs[reg]     = (uint16_t)(res & 0xFFFF);
+    holdingRegs[reg + 1] = (uint16_t)(res >> 16);
+    holdingRegs[reg + 2] = seq;
+  }
+}
+
+uint32_t window_next_deadline_ms() {
+  if (winPending) return 0;
+  if (!winMask) return IDLE_NO_DEADLINE;
+  int32_t nextIn = 0x7FFFFFFF;
+  uint8_t sreg = SREG;
+  cli();
+  uint32_t now = timebase_ticks_isr();
+  for (uint8_t i = 0; i < 4; ++i) {
+    if (!(winMask & (1u << i))) continue;
+    int32_t in = (int32_t)(winEndTicks[i] - now);
+    if (in < nextIn) nextIn = in;
+  }
+  SREG = sreg;
+  if (nextIn <= 0) return 0;
+  return (uint32_t)nextIn / (1000UL * TIMEBASE_TICKS_PER_US) + 1;
+}
+
+uint16_t window_seq(uint8_t idx) {
+  if (idx >= 4) return 0;
+  uint8_t sreg = SREG;
+  cli();
+  uint16_t s = winSeq[idx];
+  SREG = sreg;
+  return s;
+}
@@ -5,6 +5,24 @@
 //  Forfatter: JanG at modbus_slave@laces.dk
 //  Formål   : Modbus function-code-håndtering med CLEAN init
 //  Ændringer:
+//    - v3.9.6: Auto-save (reg 0 = 0x00FF) fanger i globalConfig via
+//              configCaptureBase() i stedet for en PersistConfig på stakken
+//    - v3.9.6: FC-print pr. frame kun med MODBUS_DEBUG_FC (som CLI_DEBUG_ECHO)
+//    - v3.9.6: Udskudt save (configSaveStep) køres trinvis fra modbusLoop
+//    - v3.9.6: modbusLoop() kører kun forfaldne motorer (idle_engines_due)
+//    - v3.9.6: FC03 kopierer edge-log ringe fra RAM (edgelog_publish);
+//              FC06/FC16 til en edge-log blok afvises
+//    - v3.9.6: FC06/FC16 til N/trin i et kørende trin-program afvises
+//    - v3.9.6: Broadcast kun for skrive-FC (05/06/0F/10)
+//    - v3.9.6: FC03 reset-on-read kalder window_rebase()/rate_on_reset()
+//    - v3.9.6: Profil-select (config_profile.h) udføres efter frame-svaret
+//    - v3.9.5: modbus_rx_flush() til hot reconfig af baud/slave-ID
+//    - v3.9.4: Boot-tid til første accepterede frame i input-reg 111;
+//              initModbus() skriver ikke længere til konsollen
+//    - v3.8.3: GPIO-spejling via gpio_mirror() (per-port plan)
+//    - v3.8.1: RX-tilstand i file-scope; modbus_next_deadline_ms() til idle sleep
+//    - v3.7.4: Broadcast (slave-ID 0) accepteres uden svar; snapshot-latch
+//              trigges fra FC06/FC16 skrivning til snapshot control-reg
 //    - v3.1.3-patch1: Fjernet demo-init i initModbus(); kalder nu modbus_init_globals()
 //                      for CLEAN build uden testdata.
 // ============================================================================
@@ -12,6 +30,16 @@
 #include "modbus_timers.h"
 #include "modbus_counters.h"
 #include "modbus_counters_hw.h"
+#include "modbus_timebase.h"
+#include "modbus_counters_snapshot.h"
+#include "modbus_counters_window.h"
+#include "modbus_counters_rate.h"
+#include "modbus_counters_edgelog.h"
+#include "modbus_timers_seq.h"
+#include "modbus_idle.h"
+#include "config_profile.h"
+
+static const bool MODBUS_DEBUG_FC = false; // set true for FC-print pr. frame
 
 // ---------------------------------------------------------------------------
 // READ HANDLERS
@@ -42,6 +70,8 @@ static void fc_read_hregs(uint8_t rxSlave,uint8_t* f){
   if((uint32_t)s+q>NUM_REGS){ sendException(rxSlave,FC_READ_HOLDING_REGS,EX_ILLEGAL_DATA_ADDRESS);return; }
   uint8_t resp[MAX_RESP]; resp[0]=rxSlave; resp[1]=FC_READ_HOLDING_REGS; resp[2]=q*2;
   uint16_t idx=3;
+  // Edge-log ringe ligger i RAM: kopiér de læste slots ind før svaret
+  edgelog_publish(s, q);
   for(uint16_t i=0;i<q;i++){
     uint16_t v=holdingRegs[s+i];
     resp[idx++]=v>>8;
@@ -63,6 +93,7 @@ static void fc_read_hregs(uint8_t rxSlave,uint8_t* f){
     if (!((s + q - 1) < regStart || s > regEnd)) {
       uint8_t bw = sanitizeBitWidth(c.bitWidth);
       uint64_t sv = maskToBitWidth(c.startValue, bw);
+      uint64_t before = c.counterValue;
       c.counterValue = sv;
       c.edgeCount = 0;
       c.overflowFlag = 0;
@@ -80,6 +111,11 @@ static void fc_read_hregs(uint8_t rxSlave,uint8_t* f){
 
       // Skriv reset værdi til holdingRegs EFTER response er sendt
       store_value_to_regs(ci);
+
+      // Tidsvindue + rate: nyt nulpunkt, edges frem til reset medregnes
+      // (ellers ses faldet som et wrap i rate_loop())
+      window_rebase(ci);
+      rate_on_reset(ci, before);
     }
   }
 
@@ -130,51 +166,16 @@ static void fc_write_single_coil(uint8_t rxSlave,uint8_t* f){
 static void fc_write_single_reg(uint8_t rxSlave,uint8_t* f){
   uint16_t a=(f[2]<<8)|f[3],v=(f[4]<<8)|f[5];
   if(a>=NUM_REGS){sendException(rxSlave,FC_WRITE_SINGLE_REG,EX_ILLEGAL_DATA_ADDRESS);return;}
+  if(edgelog_overlaps(a,1)){sendException(rxSlave,FC_WRITE_SINGLE_REG,EX_ILLEGAL_DATA_ADDRESS);return;}
+  if(seq_write_locked(a,1)){sendException(rxSlave,FC_WRITE_SINGLE_REG,EX_ILLEGAL_DATA_ADDRESS);return;}
   holdingRegs[a]=v;
 
   // --- Specialkommando: write reg 0 = 0x00FF -> save EEPROM config ---
   if (a == 0 && v == 0x00FF) {
-    PersistConfig cfg;
-    memset(&cfg, 0, sizeof(cfg));
-
-    // Byg aktuel config (samme som CLI SAVE)
-    cfg.magic      = 0xC0DE;
-    cfg.schema     = 11;  // v11: GPIO mappings removed from persistence
-    cfg.slaveId    = currentSlaveID;
-    cfg.serverFlag = serverRunning ? 1 : 0;
-    cfg.baud       = currentBaudrate;
-
-    // Statiske registre
-    cfg.regStaticCount = regStaticCount;
-    for (uint8_t i = 0; i < regStaticCount && i < MAX_STATIC_REGS; i++) {
-      cfg.regStaticAddr[i] = regStaticAddr[i];
-      cfg.regStaticVal[i]  = regStaticVal[i];
-    }
-
-    // Coils
-    cfg.coilStaticCount = coilStaticCount;
-    for (uint8_t i = 0; i < coilStaticCount && i < MAX_STATIC_COILS; i++) {
-      cfg.coilStaticIdx[i] = coilStaticIdx[i];
-      cfg.coilStaticVal[i] = coilStaticVal[i];
-    }
-
-    // Timere - tæl enabled
-    cfg.timerCount = 0;
-    for (uint8_t i = 0; i < 4; i++) {
-      cfg.timer[i] = timers[i];
-      if (timers[i].enabled) cfg.timerCount++;
-    }
-
-    // Counters - tæl enabled
-    cfg.counterCount = 0;
-    for (uint8_t i = 0; i < 4; i++) {
-      cfg.counter[i] = counters[i];
-      if (counters[i].enabled) cfg.counterCount++;
-    }
-
-    // NOTE: GPIO mappings no longer saved (v3.3.1)
-
-    if (configSave(cfg)) {
+    // Som CLI 'save': fang i globalConfig, ingen PersistConfig (>1 KB) på
+    // stakken i FC-handleren
+    configCaptureBase(globalConfig);
+    if (configSave(globalConfig)) {
       Serial.println(F("AUTO-SAVE: Konfiguration gemt til EEPROM (via reg0=0xFF)"));
     } else {
       Serial.println(F("AUTO-SAVE FEJL: configSave() returnerede false"));
@@ -197,6 +198,10 @@ static void fc_write_single_reg(uint8_t rxSlave,uint8_t* f){
     }
   }
 
+  // --- Snapshot-latch / profil-select (også via broadcast) ---
+  snapshot_on_reg_write(a);
+  profile_on_reg_write(a);
+
   uint8_t resp[6]={rxSlave,FC_WRITE_SINGLE_REG,f[2],f[3],f[4],f[5]};
   sendResponse(resp,6,rxSlave);
 }
@@ -221,6 +226,8 @@ static void fc_write_multiple_regs(uint8_t rxSlave,uint8_t* f){
   uint16_t s=(f[2]<<8)|f[3],q=(f[4]<<8)|f[5];uint8_t bc=f[6];
   if(q<1||q>123||bc!=q*2){sendException(rxSlave,FC_WRITE_MULTIPLE_REGS,EX_ILLEGAL_DATA_VALUE);return;}
   if((uint32_t)s+q>NUM_REGS){sendException(rxSlave,FC_WRITE_MULTIPLE_REGS,EX_ILLEGAL_DATA_ADDRESS);return;}
+  if(edgelog_overlaps(s,q)){sendException(rxSlave,FC_WRITE_MULTIPLE_REGS,EX_ILLEGAL_DATA_ADDRESS);return;}
+  if(seq_write_locked(s,q)){sendException(rxSlave,FC_WRITE_MULTIPLE_REGS,EX_ILLEGAL_DATA_ADDRESS);return;}
   uint8_t idx=7;
   for(uint16_t i=0;i<q;i++){
     uint16_t v=(f[idx]<<8)|f[idx+1];
@@ -234,47 +241,9 @@ static void fc_write_multiple_regs(uint8_t rxSlave,uint8_t* f){
     uint16_t addr = s + i;
     uint16_t val  = holdingRegs[addr];
     if (addr == 0 && val == 0x00FF) {
-      PersistConfig cfg;
-      memset(&cfg, 0, sizeof(cfg));
-
-      // Byg aktuel konfiguration (samme som CLI SAVE)
-      cfg.magic      = 0xC0DE;
-      cfg.schema     = 11;  // v11: GPIO mappings removed from persistence
-      cfg.slaveId    = currentSlaveID;
-      cfg.serverFlag = serverRunning ? 1 : 0;
-      cfg.baud       = currentBaudrate;
-
-      // Statiske holding-registre
-      cfg.regStaticCount = regStaticCount;
-      for (uint8_t j = 0; j < regStaticCount && j < MAX_STATIC_REGS; j++) {
-        cfg.regStaticAddr[j] = regStaticAddr[j];
-        cfg.regStaticVal[j]  = regStaticVal[j];
-      }
-
-      // Coils
-      cfg.coilStaticCount = coilStaticCount;
-      for (uint8_t j = 0; j < coilStaticCount && j < MAX_STATIC_COILS; j++) {
-        cfg.coilStaticIdx[j] = coilStaticIdx[j];
-        cfg.coilStaticVal[j] = coilStaticVal[j];
-      }
-
-      // Timere - tæl enabled
-      cfg.timerCount = 0;
-      for (uint8_t j = 0; j < 4; j++) {
-        cfg.timer[j] = timers[j];
-        if (timers[j].enabled) cfg.timerCount++;
-      }
-
-      // Counters - tæl enabled
-      cfg.counterCount = 0;
-      for (uint8_t j = 0; j < 4; j++) {
-        cfg.counter[j] = counters[j];
-        if (counters[j].enabled) cfg.counterCount++;
-      }
-
-      // NOTE: GPIO mappings no longer saved (v3.3.1)
-
-      if (configSave(cfg))
+      // Som FC06: fang i globalConfig, ikke på stakken
+      configCaptureBase(globalConfig);
+      if (configSave(globalConfig))
         Serial.println(F("AUTO-SAVE: Konfiguration gemt til EEPROM (via FC16 reg0=0xFF)"));
       else
         Serial.println(F("AUTO-SAVE FEJL: configSave() returnerede false"));
@@ -294,6 +263,12 @@ static void fc_write_multiple_regs(uint8_t rxSlave,uint8_t* f){
     }
   }
 
+  // --- Snapshot-latch / profil-select (også via broadcast) ---
+  for (uint16_t i = 0; i < q; ++i) {
+    snapshot_on_reg_write(s + i);
+    profile_on_reg_write(s + i);
+  }
+
   sendResponse(resp,6,rxSlave);
 }
 
@@ -313,12 +288,25 @@ void processModbusFrame(uint8_t *frame, uint8_t len) {
 
   uint8_t rxSlave = frame[0];
   uint8_t fc      = frame[1];
-  if (!listenToAll && rxSlave != currentSlaveID) {
+  // Slave-ID 0 = broadcast: kun skrivninger (FC05/06/0F/10) behandles, og
+  // de besvares ikke (sendResponse). Læsning via broadcast ignoreres.
+  if (!listenToAll && rxSlave != currentSlaveID && rxSlave != 0) {
     Serial.println("IGNORED: Wrong slave ID"); wrongSlaveID++; return;
   }
+  if (rxSlave == 0 && fc != FC_WRITE_SINGLE_COIL && fc != FC_WRITE_SINGLE_REG &&
+      fc != FC_WRITE_MULTIPLE_COILS && fc != FC_WRITE_MULTIPLE_REGS) {
+    Serial.println("IGNORED: Broadcast read"); return;
+  }
 
   validFrames++;
-  Serial.print("FC: 0x"); if(fc<0x10) Serial.print("0"); Serial.print(fc, HEX); Serial.println();
+  // Boot-instrumentering (v3.9.4): første accepterede frame efter reset
+  if (inputRegs[IREG_DIAG_BOOT_FIRST_MS] == 0) {
+    unsigned long ms = millis();
+    inputRegs[IREG_DIAG_BOOT_FIRST_MS] = (ms == 0) ? 1 : (ms > 0xFFFFUL ? 0xFFFF : (uint16_t)ms);
+  }
+  if (MODBUS_DEBUG_FC) {
+    Serial.print(F("FC: 0x")); if(fc<0x10) Serial.print('0'); Serial.println(fc, HEX);
+  }
 
   switch (fc) {
     case FC_READ_COILS:            fc_read_coils(rxSlave, frame); break;
@@ -341,10 +329,10 @@ void initModbus() {
   pinMode(RS485_DIR_PIN, OUTPUT);
   rs485_rx_enable();
   MODBUS_SERIAL.begin(currentBaudrate);
-  frameGapUs = rtuGapUs();
-  Serial.print(F("RTU gap(us): ")); Serial.println(frameGapUs);
+  frameGapUs = rtuGapUs();   // intet konsol-output her (hurtig boot, v3.9.4)
 
-  // Init delsystemer
+  // Init delsystemer (tidsbase først - bruges af counter input-filter)
+  timebase_init();
   timers_init();
   counters_init();
 
@@ -353,27 +341,41 @@ void initModbus() {
   // This avoids double-loading and prevents stack overflow from local PersistConfig
 }
 
+// RX-tilstand (file-scope så idle-scheduleren kan se en igangværende frame)
+static uint8_t  rxBuf[RXBUF_SIZE];
+static uint8_t  rxLen = 0;
+static bool     frameComplete = false;
+static unsigned long lastUs = 0;
+
+// Næste deadline for Modbus RX (v3.8.1): en igangværende frame skal have
+// sin inter-frame gap målt i loop, ellers vækker RX-interruptet CPU'en.
+uint32_t modbus_next_deadline_ms() {
+  if (MODBUS_SERIAL.available()) return 0;
+  if (rxLen > 0 && !frameComplete) return 0;
+  return IDLE_NO_DEADLINE;
+}
+
+// Kassér halvt modtaget frame (ny baud/slave-ID ved hot reconfig, v3.9.5)
+void modbus_rx_flush() {
+  while (MODBUS_SERIAL.available()) MODBUS_SERIAL.read();
+  rxLen = 0;
+  frameComplete = false;
+}
+
 void modbusLoop() {
-  static uint8_t  rxBuf[RXBUF_SIZE];
-  static uint8_t  rxLen = 0;
-  static bool     frameComplete = false;
-  static unsigned long lastUs = 0;
   unsigned long nowUs = micros();
 
+  // Kun motorer hvis deadline er nået (v3.9.6); under RX/CLI-aktivitet
+  // er alle forfaldne
+  uint8_t due = idle_engines_due();
+
   if (!serverRunning) {
     while (MODBUS_SERIAL.available()) MODBUS_SERIAL.read();
-    for (uint8_t p = 0; p < NUM_GPIO; ++p) {
-      if (gpioToCoil[p] >= 0) {
-        bool coilState = bitReadArray(coils, gpioToCoil[p]);
-        digitalWrite(p, coilState ? HIGH : LOW);
-      }
-      if (gpioToInput[p] >= 0) {
-        bool pinState = digitalRead(p);
-        bitWriteArray(discreteInputs, gpioToInput[p], pinState);
-      }
-    }
-    timers_loop();
-    counters_loop();
+    if (due & IDLE_ENG_GPIO)     gpio_mirror();
+    if (due & IDLE_ENG_TIMERS)   timers_loop();
+    if (due & IDLE_ENG_COUNTERS) counters_loop();
+    profile_loop();
+    configSaveStep();
     return;
   }
 
@@ -391,17 +393,15 @@ void modbusLoop() {
     rxLen = 0;
   }
 
-  for (uint8_t p = 0; p < NUM_GPIO; ++p) {
-    if (gpioToCoil[p] >= 0) {
-      bool coilState = bitReadArray(coils, gpioToCoil[p]);
-      digitalWrite(p, coilState ? HIGH : LOW);
-    }
-    if (gpioToInput[p] >= 0) {
-      bool pinState = digitalRead(p);
-      bitWriteArray(discreteInputs, gpioToInput[p], pinState);
-    }
-  }
+  // GPIO-spejling via forudberegnet per-port plan (v3.8.3)
+  if (due & IDLE_ENG_GPIO) gpio_mirror();
+
+  if (due & IDLE_ENG_TIMERS)   timers_loop();
+  if (due & IDLE_ENG_COUNTERS) counters_loop();
+
+  // Profil-select (v3.9.6) - efter frame-behandling, så svaret er sendt
+  profile_loop();
 
-  timers_loop();
-  counters_loop();
+  // Udskudt save: ét EEPROM-trin pr. pass
+  configSaveStep();
 }
@@ -1,13 +1,22 @@
 // ============================================================================
 //  Filnavn : modbus_globals.cpp
 //  Projekt  : Modbus RTU Server / CLI
-//  Version  : v3.1.3-patch1 (2025-11-03)
+//  Version  : v3.8.3 (2026-10-18)
 //  Forfatter: JanG at modbus_slave@laces.dk
 //  Formål   : Globale Modbus-buffere, status- og statistikvariabler,
 //             samt initialisering (CLEAN BUILD – ingen demo-data).
+//  Ændringer:
+//    - v3.9.6: gpio_pin_reserved() - seriel- og RS485-pins
+//    - v3.9.6: gpio_next_deadline_ms() - mirror køres kun når forfalden
+//    - v3.9.6: gpio_mirror() læser coils og skriver port i én kritisk sektion
+//    - v3.8.3: Per-port GPIO mirror-plan (gpio_plan_rebuild/gpio_mirror)
+//              erstatter digitalRead/digitalWrite-løkkerne i modbusLoop()
+//    - v3.8.2: Direkte GPIO-drive (gpio_coil_write)
 // ============================================================================
 
 #include "modbus_globals.h"
+#include "modbus_core.h"
+#include "modbus_idle.h"
 
 // ---------------------------------------------------------------------------
 //  Globale Modbus-buffere
@@ -98,6 +107,12 @@ void modbus_init_globals() {
 // ============================================================================
 // GPIO-konflikt-håndtering
 // ============================================================================
+bool gpio_pin_reserved(uint8_t pin) {
+  return pin == 0 || pin == 1 ||        // Serial (CLI)
+         pin == 18 || pin == 19 ||      // Serial1 = MODBUS_SERIAL
+         pin == RS485_DIR_PIN;
+}
+
 // Når en timer/counter tager DYNAMIC kontrol over en GPIO pin, skal
 // eventuel STATIC mapping fjernes og bruger skal advares
 void gpio_handle_dynamic_conflict(uint8_t pin) {
@@ -130,6 +145,181 @@ void gpio_handle_dynamic_conflict(uint8_t pin) {
 
   // Besked hvis der var en konflikt
   if (hadConflict) {
+    gpio_plan_rebuild();
     Serial.println(F("% Du skal opdatere din config-fil!"));
   }
 }
+
+// ============================================================================
+// Reverse-opslag: discrete input -> GPIO pin
+// ============================================================================
+int8_t gpio_find_input_pin(uint16_t inputIndex) {
+  for (uint8_t p = 0; p < NUM_GPIO; ++p) {
+    if (gpioToInput[p] == (int16_t)inputIndex) return (int8_t)p;
+  }
+  return -1;
+}
+
+// ============================================================================
+// GPIO mirror-plan + direkte drive (v3.8.2 / v3.8.3)
+// ============================================================================
+// gpioToCoil/gpioToInput kompileres til en plan pr. port. Et mirror-pass er
+// derefter én PORTx-skrivning og én PINx-læsning pr. port med masker. Er en
+// ports pins mappet 1:1 til et byte-aligned coil-/input-område (bit k ->
+// index base+k), flyttes hele bytes uden bit-for-bit opslag.
+static_assert(NUM_COILS <= 256 && NUM_DISCRETE <= 256, "GpioPinPlan bruger 8-bit index");
+
+#define GPIO_PLAN_PORTS  10          // Mega pin 0..53 fordeler sig på 9 porte
+#define GPIO_NO_BYTE     0xFF
+
+struct GpioPortPlan {
+  volatile uint8_t* reg;   // PORTx (output) / PINx (input)
+  uint8_t mask;            // mappede bits i porten
+  uint8_t first;           // første entry i gpPins
+  uint8_t count;
+  uint8_t byteIdx;         // 1:1 byte i coils/discreteInputs, ellers GPIO_NO_BYTE
+};
+
+struct GpioPinPlan {
+  uint8_t idx;             // coil- / input-index
+  uint8_t bit;             // bitmaske i porten
+};
+
+// Planen læses fra ISR (gpio_coil_write) og byttes med interrupts slået fra
+static GpioPortPlan gpOut[GPIO_PLAN_PORTS];
+static GpioPortPlan gpIn [GPIO_PLAN_PORTS];
+static GpioPinPlan  gpPins[NUM_GPIO];
+static uint8_t gpOutCount = 0;
+static uint8_t gpInCount  = 0;
+static unsigned long gpLastMs = 0;       // seneste mirror-pass (millis)
+
+// Saml alle pins i 'port' der er mappet i 'map' til én port-plan
+static void plan_add_port(const int16_t* map, int16_t limit, uint8_t port, bool output,
+                          GpioPortPlan* tab, uint8_t& nTab,
+                          GpioPinPlan* pins, uint8_t& nPins) {
+  if (nTab >= GPIO_PLAN_PORTS) return;
+  GpioPortPlan pp;
+  pp.mask  = 0;
+  pp.first = nPins;
+  pp.count = 0;
+  int16_t base = -1;
+  bool aligned = true;
+
+  for (uint8_t p = 0; p < NUM_GPIO; ++p) {
+    int16_t idx = map[p];
+    if (idx < 0 || idx >= limit) continue;
+    if (digitalPinToPort(p) != port) continue;
+
+    uint8_t bit = digitalPinToBitMask(p);
+    uint8_t pos = 0;
+    while (!(bit & (1u << pos))) pos++;
+    int16_t b = idx - pos;
+    if (b < 0 || (b & 7) || (base >= 0 && b != base)) aligned = false;
+    else base = b;
+
+    pins[nPins].idx = (uint8_t)idx;
+    pins[nPins].bit = bit;
+    nPins++;
+    pp.mask |= bit;
+    pp.count++;
+
+    if (output) {
+      digitalWrite(p, bitReadArray(coils, (uint16_t)idx) ? HIGH : LOW);
+      pinMode(p, OUTPUT);
+    }
+  }
+  if (pp.count == 0) return;
+
+  pp.reg = output ? portOutputRegister(port) : portInputRegister(port);
+  pp.byteIdx = (aligned && base >= 0) ? (uint8_t)(base / 8) : GPIO_NO_BYTE;
+  tab[nTab++] = pp;
+}
+
+void gpio_plan_rebuild() {
+  GpioPortPlan out[GPIO_PLAN_PORTS];
+  GpioPortPlan in [GPIO_PLAN_PORTS];
+  GpioPinPlan  pins[NUM_GPIO];
+  uint8_t nOut = 0, nIn = 0, nPins = 0;
+
+  // Arduino port-numre (PA=1 .. PL=12); NOT_A_PORT = 0
+  for (uint8_t port = 1; port <= 12; ++port) {
+    plan_add_port(gpioToCoil, NUM_COILS, port, true, out, nOut, pins, nPins);
+  }
+  for (uint8_t port = 1; port <= 12; ++port) {
+    plan_add_port(gpioToInput, NUM_DISCRETE, port, false, in, nIn, pins, nPins);
+  }
+
+  uint8_t s = SREG;
+  cli();
+  for (uint8_t i = 0; i < nOut; ++i)  gpOut[i]  = out[i];
+  for (uint8_t i = 0; i < nIn; ++i)   gpIn[i]   = in[i];
+  for (uint8_t i = 0; i < nPins; ++i) gpPins[i] = pins[i];
+  gpOutCount = nOut;
+  gpInCount  = nIn;
+  SREG = s;
+}
+
+void gpio_mirror() {
+  gpLastMs = millis();
+
+  // Coils -> PORTx. val beregnes i samme kritiske sektion som porten
+  // skrives, ellers kan en ISR (gpio_coil_write) der sætter coil + pin
+  // imellem blive overskrevet med den gamle coil-værdi.
+  for (uint8_t i = 0; i < gpOutCount; ++i) {
+    const GpioPortPlan& pp = gpOut[i];
+    uint8_t val;
+    uint8_t s = SREG;
+    cli();
+    if (pp.byteIdx != GPIO_NO_BYTE) {
+      val = coils[pp.byteIdx] & pp.mask;
+    } else {
+      val = 0;
+      for (uint8_t k = pp.first; k < pp.first + pp.count; ++k) {
+        if (bitReadArray(coils, gpPins[k].idx)) val |= gpPins[k].bit;
+      }
+    }
+    *pp.reg = (uint8_t)((*pp.reg & (uint8_t)~pp.mask) | val);
+    SREG = s;
+  }
+
+  // PINx -> discreteInputs
+  for (uint8_t i = 0; i < gpInCount; ++i) {
+    const GpioPortPlan& pp = gpIn[i];
+    uint8_t v = *pp.reg;
+    if (pp.byteIdx != GPIO_NO_BYTE) {
+      uint8_t s = SREG;
+      cli();
+      uint8_t& d = discreteInputs[pp.byteIdx];
+      d = (uint8_t)((d & (uint8_t)~pp.mask) | (v & pp.mask));
+      SREG = s;
+    } else {
+      for (uint8_t k = pp.first; k < pp.first + pp.count; ++k) {
+        bitWriteArray(discreteInputs, gpPins[k].idx, (v & gpPins[k].bit) != 0);
+      }
+    }
+  }
+}
+
+uint32_t gpio_next_deadline_ms() {
+  if (gpInCount == 0) return IDLE_NO_DEADLINE;
+  return idle_due_in(gpLastMs, 1, millis());
+}
+
+bool gpio_coil_write(uint16_t coilIdx, bool value) {
+  if (coilIdx >= NUM_COILS) return false;
+  bool driven = false;
+  uint8_t s = SREG;
+  cli();
+  bitWriteArray(coils, coilIdx, value);
+  for (uint8_t i = 0; i < gpOutCount; ++i) {
+    const GpioPortPlan& pp = gpOut[i];
+    for (uint8_t k = pp.first; k < pp.first + pp.count; ++k) {
+      if (gpPins[k].idx != coilIdx) continue;
+      if (value) *pp.reg |= gpPins[k].bit;
+      else       *pp.reg &= (uint8_t)~gpPins[k].bit;
+      driven = true;
+    }
+  }
+  SREG = s;
+  return driven;
+}
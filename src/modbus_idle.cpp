@@ -0,0 +1,167 @@
+// ============================================================================
+//  Filnavn : modbus_idle.cpp
+//  Projekt  : Modbus RTU Server / CLI
+//  Version  : v3.8.1 (2026-10-18)
+//  Forfatter: JanG at modbus_slave@laces.dk
+//  Formål   : Next-deadline scheduling og AVR idle sleep (se modbus_idle.h).
+//             Søvntid måles med Timer4-tidsbasen og publiceres pr. sekund
+//             som promille af tiden (input-reg 104) sammen med loop-pass/s.
+//  Ændringer:
+//    - v3.9.6: Deadline caches under søvn; Timer0/Timer2-vækninger
+//              koster kun en millis()-sammenligning
+//    - v3.9.6: Søvn over flere Timer0-ticks til tidligste deadline;
+//              forfaldne motorer pr. pass (idle_engines_due)
+// ============================================================================
+
+#include "modbus_idle.h"
+#include "modbus_core.h"
+#include "modbus_timebase.h"
+#include <avr/sleep.h>
+
+bool idleSleepEnabled = true;
+volatile uint8_t idleIsrWork = 0;
+
+// Motorer der skal køre i næste pass (alle efter boot)
+static uint8_t idlDue = IDLE_ENG_ALL;
+
+// Statistik for indeværende 1 s vindue
+static unsigned long idlWinStartMs = 0;
+static uint32_t idlSleepTicks = 0;        // ticks tilbragt i søvn (inkl. vækkende ISR)
+static uint16_t idlPasses     = 0;        // loop-pass i vinduet
+static uint16_t idlSleeps     = 0;        // vækninger fra søvn i vinduet
+static uint16_t idlRuns[3]    = {0, 0, 0};  // kørsler pr. motor (GPIO, timere, tællere)
+
+// Resultat for seneste afsluttede vindue
+static uint16_t idlLastPermille = 0;
+static uint16_t idlLastPasses   = 0;
+static uint16_t idlLastSleeps   = 0;
+static uint16_t idlLastRuns[3]  = {0, 0, 0};
+static uint32_t idlLastDue      = IDLE_NO_DEADLINE;
+
+// Bytes fra CLI/USB eller en Modbus-frame i gang: master/CLI kan læse og
+// skrive alle registre, så alle motorer skal køre
+static bool idle_activity() {
+  if (Serial.available()) return true;
+  return serverRunning && modbus_next_deadline_ms() == 0;
+}
+
+uint32_t idle_next_deadline_ms(uint32_t mainDueMs) {
+  if (idle_activity()) return 0;
+
+  uint32_t due = mainDueMs;
+  uint32_t d = gpio_next_deadline_ms();
+  if (d < due) due = d;
+  d = timers_next_deadline_ms();
+  if (d < due) due = d;
+  d = counters_next_deadline_ms();
+  if (d < due) due = d;
+  d = config_save_next_deadline_ms();
+  if (d < due) due = d;
+  return due;
+}
+
+// Forfaldne motorer (deadline 0). Timere læser discrete inputs (mode 4,
+// trin-program), så GPIO mirror køres før dem.
+static uint8_t idle_compute_due() {
+  if (idle_activity()) return IDLE_ENG_ALL;
+  uint8_t m = 0;
+  if (gpio_next_deadline_ms() == 0)     m |= IDLE_ENG_GPIO;
+  if (timers_next_deadline_ms() == 0)   m |= IDLE_ENG_TIMERS | IDLE_ENG_GPIO;
+  if (counters_next_deadline_ms() == 0) m |= IDLE_ENG_COUNTERS;
+  return m;
+}
+
+uint8_t idle_engines_due() {
+  uint8_t m = idlDue;
+  for (uint8_t i = 0; i < 3; ++i) {
+    if ((m & (1u << i)) && idlRuns[i] != 0xFFFF) idlRuns[i]++;
+  }
+  return m;
+}
+
+void idle_loop(uint32_t mainDueMs) {
+  if (idlPasses != 0xFFFF) idlPasses++;
+
+  // Nulstilles før scannet: arbejde postet under/efter scannet ses i søvnen
+  idleIsrWork = 0;
+  uint32_t due = idle_next_deadline_ms(mainDueMs);
+  idlLastDue = due;
+
+  if (idleSleepEnabled && due > 0) {
+    unsigned long startMs = millis();
+    uint32_t t0 = timebase_ticks();
+    set_sleep_mode(SLEEP_MODE_IDLE);
+    // due = cachet deadline i ms efter startMs
+    for (;;) {
+      cli();
+      // Genkontrollér med interrupts slået fra: en byte der lige er
+      // ankommet må ikke vente på næste interrupt
+      if (Serial.available() || MODBUS_SERIAL.available()) {
+        sei();
+        break;
+      }
+      if (!idleIsrWork) {
+        sleep_enable();
+        sei();            // instruktionen efter sei udføres før interrupts
+        sleep_cpu();
+        sleep_disable();
+        if (idlSleeps != 0xFFFF) idlSleeps++;
+      }
+      sei();
+
+      // Timer0/Timer2-vækning: intet nyt før den cachede deadline
+      uint32_t el = millis() - startMs;
+      if (!idleIsrWork && el < due) continue;
+
+      // Motor-ISR-arbejde eller deadline nået: fuldt scan, intet loop-pass
+      idleIsrWork = 0;
+      uint32_t mainLeft = (mainDueMs > el) ? mainDueMs - el : 0;
+      uint32_t d = idle_next_deadline_ms(mainLeft);
+      if (d == 0) break;
+      due = (d > IDLE_NO_DEADLINE - el) ? IDLE_NO_DEADLINE : el + d;
+    }
+    idlSleepTicks += timebase_ticks() - t0;
+  }
+
+  idlDue = idle_compute_due();
+
+  unsigned long now = millis();
+  unsigned long winMs = now - idlWinStartMs;
+  if (winMs >= 1000) {
+    // 1 promille af vinduet = winMs * 1000 µs / 1000 = winMs µs
+    uint32_t pm = idlSleepTicks / (winMs * TIMEBASE_TICKS_PER_US);
+    idlLastPermille = (pm > 1000) ? 1000 : (uint16_t)pm;
+    idlLastPasses   = idlPasses;
+    idlLastSleeps   = idlSleeps;
+    for (uint8_t i = 0; i < 3; ++i) {
+      idlLastRuns[i] = idlRuns[i];
+      idlRuns[i] = 0;
+    }
+    idlSleepTicks = 0;
+    idlPasses     = 0;
+    idlSleeps     = 0;
+    idlWinStartMs = now;
+
+    inputRegs[IREG_DIAG_IDLE_PERMILLE]  = idlLastPermille;
+    inputRegs[IREG_DIAG_LOOP_PASSES]    = idlLastPasses;
+  }
+}
+
+void idle_print_status() {
+  Serial.println(F("=== IDLE SLEEP ==="));
+  Serial.print(F("Sleep: "));
+  Serial.println(idleSleepEnabled ? F("ON (SLEEP_MODE_IDLE)") : F("OFF"));
+  Serial.print(F("Idle (last 1 s): "));
+  Serial.print(idlLastPermille / 10); Serial.print(F("."));
+  Serial.print(idlLastPermille % 10); Serial.println(F(" %"));
+  Serial.print(F("Loop passes/s: ")); Serial.println(idlLastPasses);
+  Serial.print(F("Wakeups/s: "));     Serial.println(idlLastSleeps);
+  Serial.print(F("Engine runs/s: gpio ")); Serial.print(idlLastRuns[0]);
+  Serial.print(F(" | timers ")); Serial.print(idlLastRuns[1]);
+  Serial.print(F(" | counters ")); Serial.println(idlLastRuns[2]);
+  Serial.print(F("Next deadline: "));
+  if (idlLastDue == IDLE_NO_DEADLINE) Serial.println(F("none"));
+  else if (idlLastDue == 0)           Serial.println(F("now (busy/polling)"));
+  else { Serial.print(idlLastDue); Serial.println(F(" ms")); }
+  Serial.println(F("=================="));
+}
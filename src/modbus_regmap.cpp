@@ -0,0 +1,76 @@
+// ============================================================================
+//  Filnavn : modbus_regmap.cpp
+//  Projekt  : Modbus RTU Server / CLI
+//  Version  : v3.9.6 (2026-10-18)
+//  Forfatter: JanG at modbus_slave@laces.dk
+//  Formål   : Overlap-tjek mellem holding-reg blokke (se modbus_regmap.h).
+//             Læser kun de persisterede base-regs; ingen egen tilstand.
+// ============================================================================
+
+#include "modbus_regmap.h"
+#include "modbus_counters.h"
+#include "modbus_counters_compare.h"
+#include "modbus_counters_edgelog.h"
+#include "modbus_counters_pwm.h"
+#include "modbus_counters_window.h"
+#include "modbus_counters_rate.h"
+#include "modbus_counters_snapshot.h"
+#include "modbus_timers.h"
+#include "modbus_timers_seq.h"
+#include "modbus_timers_wave.h"
+#include "config_profile.h"
+
+// Base-reg og længde for blok (kind, i). 0 = blokken er slået fra.
+// Globale blokke findes kun som idx 0 (status/control-reg: idx 0 og 1).
+static uint16_t regmap_block(uint8_t kind, uint8_t i, uint16_t& len) {
+  switch (kind) {
+    case REGMAP_COMPARE:
+      len = CMP_BLOCK_REGS;   return counterCompare[i].reg;
+    case REGMAP_EDGELOG:
+      len = EDGELOG_BLOCK_REGS(counterEdgeLog[i].depth);
+      return counterEdgeLog[i].reg;
+    case REGMAP_PWM:
+      len = PWM_BLOCK_REGS;   return counterPwm[i].reg;
+    case REGMAP_WINDOW:
+      len = WIN_BLOCK_REGS;   return counterGateWin[i].windowReg;
+    case REGMAP_RATE:
+      len = RATE_BLOCK_REGS;  return counterRateReg[i];
+    case REGMAP_TPARAM:
+      len = TIMER_PARAM_REGS; return timerParamReg[i];
+    case REGMAP_SEQ:
+      len = SEQ_BLOCK_REGS;   return timerSeqReg[i];
+    case REGMAP_SNAPSHOT:
+      len = SNAP_BLOCK_REGS;  return (i == 0) ? snapshotReg : 0;
+    case REGMAP_WAVE:
+      len = WAVE_BLOCK_REGS;  return (i == 0) ? timerWave.reg : 0;
+    case REGMAP_PROFILE:
+      len = PROFILE_REGS;     return (i == 0) ? profileReg : 0;
+    case REGMAP_TSTATUS:
+      len = 1;
+      if (i == 0) return timerStatusRegIndex;
+      if (i == 1) return timerStatusCtrlRegIndex;
+      return 0;
+  }
+  len = 0;
+  return 0;
+}
+
+uint8_t regmap_owner(uint16_t start, uint16_t len, uint8_t self) {
+  uint32_t end = (uint32_t)start + len;
+
+  // Counterens egne registre (kun enabled counters)
+  uint8_t id = counters_regs_owner(start, len);
+  if (id != 0) return REGMAP_ID(REGMAP_COUNTER, id - 1);
+
+  for (uint8_t kind = REGMAP_COMPARE; kind <= REGMAP_TSTATUS; ++kind) {
+    for (uint8_t i = 0; i < 4; ++i) {
+      uint8_t owner = REGMAP_ID(kind, i);
+      if (owner == self) continue;
+      uint16_t n;
+      uint16_t base = regmap_block(kind, i, n);
+      if (base == 0 || base >= NUM_REGS) continue;
+      if (start < (uint32_t)base + n && end > base) return owner;
+    }
+  }
+  return REGMAP_NONE;
+}
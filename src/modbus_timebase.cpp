@@ -0,0 +1,111 @@
+// ============================================================================
+//  Filnavn : modbus_timebase.cpp
+//  Projekt  : Modbus RTU Server / CLI
+//  Version  : v3.8.0 (2026-10-18)
+//  Forfatter: JanG at modbus_slave@laces.dk
+//  Formål   : Timer4 free-running tidsbase med 32-bit udvidelse.
+//             Bruges til µs-tidsstempler i ISR'er (input-filter m.fl.).
+//  Ændringer:
+//    - v3.8.0: Compare-kanal A (OCR4A) til TimerEngine-scheduler
+//    - v3.7.7: Compare-kanal B (OCR4B) til tidsvindue-tælling
+//    - v3.7.4: 32-bit overflow-tæller; timebase_us()/timebase_us_isr() til
+//              fulde µs-tidsstempler (snapshot-latch)
+// ============================================================================
+
+#include "modbus_timebase.h"
+
+// Antal Timer4 overflows (tælles op i overflow-ISR). 32 bit så µs-tiden
+// kan dannes som fuld 32-bit værdi (wrap efter ca. 71 min).
+static volatile uint32_t tbOverflows = 0;
+
+// ============================================================================
+// ISR - Timer4 Overflow (hver 32,768 ms)
+// ============================================================================
+ISR(TIMER4_OVF_vect) {
+  tbOverflows++;
+}
+
+// ============================================================================
+// API
+// ============================================================================
+void timebase_init() {
+  uint8_t s = SREG;
+  cli();
+  TIMSK4 = 0;
+  TCCR4A = 0;                    // Normal mode (ingen OC-pins, ingen PWM)
+  TCCR4B = 0;
+  TCCR4C = 0;
+  TCNT4  = 0;
+  tbOverflows = 0;
+  TIFR4  = 0xFF;                 // ryd alle ventende flag
+  TCCR4B = _BV(CS41);            // prescaler 8 -> 2 MHz
+  TIMSK4 = _BV(TOIE4);
+  SREG = s;
+}
+
+// Læs (overflows, TCNT4) konsistent. Kræver at interrupts er slået fra.
+static inline uint32_t tb_read(uint16_t& lo) {
+  lo = TCNT4;
+  uint32_t hi = tbOverflows;
+  // Overflow sket men endnu ikke behandlet af ISR: lo er allerede wrappet
+  if ((TIFR4 & _BV(TOV4)) && lo < 0x8000) hi++;
+  return hi;
+}
+
+uint32_t timebase_ticks_isr() {
+  uint16_t lo;
+  uint32_t hi = tb_read(lo);
+  return (hi << 16) | lo;
+}
+
+uint32_t timebase_us_isr() {
+  uint16_t lo;
+  uint32_t hi = tb_read(lo);
+  return (hi << 15) | (lo >> 1);     // 2 ticks pr. µs
+}
+
+uint32_t timebase_us() {
+  uint8_t s = SREG;
+  cli();
+  uint32_t t = timebase_us_isr();
+  SREG = s;
+  return t;
+}
+
+uint32_t timebase_ticks() {
+  uint8_t s = SREG;
+  cli();
+  uint32_t t = timebase_ticks_isr();
+  SREG = s;
+  return t;
+}
+
+// Compare-kanal B: OCR4B matcher kun de lave 16 bit, så et mål længere end
+// 32,768 ms fremme giver et (eller flere) tidlige interrupts. Brugeren af
+// TIMER4_COMPB_vect tjekker selv fuld 32-bit tid og genarmerer.
+void timebase_compb_arm_isr(uint32_t atTicks) {
+  OCR4B = (uint16_t)atTicks;
+  TIMSK4 |= _BV(OCIE4B);
+}
+
+void timebase_compb_disable() {
+  uint8_t s = SREG;
+  cli();
+  TIMSK4 &= (uint8_t)~_BV(OCIE4B);
+  TIFR4 = _BV(OCF4B);
+  SREG = s;
+}
+
+// Compare-kanal A: som kanal B (tidlige interrupts ved mål > 32,768 ms)
+void timebase_compa_arm_isr(uint32_t atTicks) {
+  OCR4A = (uint16_t)atTicks;
+  TIMSK4 |= _BV(OCIE4A);
+}
+
+void timebase_compa_disable() {
+  uint8_t s = SREG;
+  cli();
+  TIMSK4 &= (uint8_t)~_BV(OCIE4A);
+  TIFR4 = _BV(OCF4A);
+  SREG = s;
+}
@@ -1,11 +1,45 @@
 // ============================================================================
 //  Filnavn : modbus_timers.cpp
 //  Projekt  : Modbus RTU Server / CLI
-//  Version  : v3.0.7-patch4 (2025-11-03)
+//  Version  : v3.8.0 (2026-10-18)
 //  Forfatter: JanG at modbus_slave@laces.dk
 //  Formål   : Timerengine for 4 uafhængige timere med coil-styring,
 //             alarm- og timeout-overvågning samt CLI statusprint.
+//  Scheduler (v3.8.0):
+//    - Faseskift sker i TIMER4_COMPA_vect (Timer4 OCR4A, 0,5 µs tick).
+//      Næste deadline på tværs af alle timere programmeres i OCR4A, og
+//      ISR'en skifter fase og skriver coil-bit'en. Deadlines regnes fra
+//      forrige deadline (ikke fra ISR-tidspunktet), så der ikke er drift.
+//    - Faser længere end TMR_CHUNK_MS deles i bidder, så 32-bit tick-
+//      forskelle altid er entydige.
+//    - loop() står kun for trigger-edges (mode 4), start via coil-write,
+//      alarm/timeout og publicering af lateness-diagnostik.
 //  Ændringer:
+//    - v3.9.6: Faseskift/trigger i ISR poster arbejde til idle (idle_isr_post)
+//    - v3.9.6: Parameter-blok må ikke overlappe andre features (regmap_owner)
+//    - v3.9.6: timers_next_deadline_ms() medtager alarm-timeout og ventende
+//              ISR-hændelser; loop køres kun når forfalden
+//    - v3.9.6: Mode 6 input-trin valideres ved indgang; ugyldigt input-index
+//              eller venteform stopper programmet med alarm (kode 3);
+//              fasen nulstilles
+//    - v3.9.6: GPIO-mapping til timerens coil fjernes ikke længere
+//    - v3.9.6: tmr_service_isr() genlæser TCNT4 efter armering af OCR4A
+//    - v3.9.5: timers_config_same() (diff-apply ved load/profil)
+//    - v3.8.8: Lateness-statistik pr. timer (min/max/mean + log2-histogram)
+//              i input-reg 112..159; timers_stats_reset()
+//    - v3.8.7: Mode 4 kan startes fra INT/PCINT edge-ISR (modbus_timers_trig.h)
+//              med fasestart = ISR-tidsstempel; trigger->output latency
+//    - v3.8.6: Mode 6 trin-program (modbus_timers_seq.h): tidstrin i ISR,
+//              input-trin polles i loop; kontrol/aktuelt-trin registre
+//    - v3.8.5: T1..T3 og P1..P3 kan bindes til holding-regs (timerParamReg);
+//              nye værdier bruges fra næste faseskift uden genstart
+//    - v3.8.4: Mode 5 hardware waveform (Timer1); færdig -> timer-status bit
+//    - v3.8.3: GPIO mirror-plan genopbygges ved konflikt-håndtering
+//    - v3.8.2: Coil skrives med gpio_coil_write() (mappet pin drives straks
+//              fra ISR); output-latency deadline -> pin måles
+//    - v3.8.1: timers_next_deadline_ms() til idle sleep
+//    - v3.8.0: Compare-match scheduler (ISR) erstatter millis()-polling;
+//              lateness måles i ISR og publiceres i input-registre
 //    - v3.0.7-patch4: Tilføjet alarm/timeout-detektion, statusprint og clear_alarms()
 //    - v3.0.7-patch2: Tilføjet timers_hasCoil() til exclusive coil control
 //    - v3.0.7       : Grundversion af timer-engine v2
@@ -13,6 +47,12 @@
 
 #include "modbus_timers.h"
 #include "modbus_core.h"
+#include "modbus_timebase.h"
+#include "modbus_idle.h"
+#include "modbus_timers_wave.h"
+#include "modbus_timers_seq.h"
+#include "modbus_timers_trig.h"
+#include "modbus_regmap.h"
 #include <string.h>
 
 static inline void timers_flag_active(uint8_t idx) {
@@ -30,6 +70,52 @@ TimerConfig timers[4];  // global timer-array
 uint16_t timerStatusRegIndex      = 0;   // default = 0 = deaktiveret
 uint16_t timerStatusCtrlRegIndex  = 0;
 
+// Live-parametre pr. timer (v3.8.5): base holding-reg, 0 = fra
+uint16_t timerParamReg[4] = {0, 0, 0, 0};
+
+// ============================================================================
+// Scheduler state (ændres i ISR eller med interrupts slået fra)
+// ============================================================================
+#define TMR_TICKS_PER_MS   (1000UL * TIMEBASE_TICKS_PER_US)
+#define TMR_CHUNK_MS       500000UL   // max fase-bid (1e9 ticks < 2^31)
+#define TMR_REARM_TICKS    8          // deadline tættere på -> håndter straks
+#define TMR_ARM_MARGIN     2          // min. ticks tilbage efter armering af OCR4A
+
+static volatile uint8_t tmrArmed = 0;     // bit i = timer i har en deadline
+static volatile uint8_t tmrEvt   = 0;     // bit i = fase skiftet (til loop)
+static uint32_t tmrDeadline[4];           // næste deadline (ticks)
+static uint32_t tmrRemainMs[4];           // rest af fasen efter deadline
+
+// Trin-program (mode 6): fasen = aktuelt trin
+static volatile uint8_t seqWait = 0;      // bit i = venter på input (loop poller)
+static uint8_t  seqNext[4];               // næste trin efter det aktuelle
+static uint16_t seqWaitIdx[4];            // input der ventes på
+static uint8_t  seqWaitLvl[4];            // niveau der ventes på
+static uint16_t seqLastCtrl[4];           // sidst sete kontrol-reg
+
+// Lateness-diagnostik (ticks, mættet i 16 bit)
+static volatile uint16_t tmrLateLast  = 0;
+static volatile uint16_t tmrLateMax   = 0;
+static volatile uint16_t tmrIsrMax    = 0;
+static volatile uint32_t tmrEvents    = 0;
+static volatile uint16_t tmrOutLast   = 0;   // deadline -> pin skrevet
+static volatile uint16_t tmrOutMax    = 0;
+static volatile uint16_t tmrTrigLast  = 0;   // edge-ISR -> første fase skrevet
+static volatile uint16_t tmrTrigMax   = 0;
+static volatile uint8_t  tmrTrigFired = 0;   // bit i = startet fra edge-ISR
+
+// Lateness pr. timer for faseskift ved deadline (ticks; kun ISR/cli)
+struct TmrStat {
+  uint32_t n;                          // faseskift
+  uint32_t sumN;                       // faseskift i sum (halveres med sum)
+  uint32_t sum;                        // sum af lateness
+  uint16_t min;
+  uint16_t max;
+  uint16_t hist[TIMER_STATS_BINS];     // mættet i 16 bit
+};
+static TmrStat tmrStat[4];
+static unsigned long tmrStatPubMs = 0;
+
 // ------------------------------------------------------
 // Internal helpers
 // ------------------------------------------------------
@@ -38,116 +124,395 @@ static inline bool di_read(uint16_t idx) {
   return bitReadArray(discreteInputs, idx);
 }
 
-static void set_coil_level(uint16_t coilIdx, bool high) {
-  if (coilIdx >= NUM_COILS) return;
-  bitWriteArray(coils, coilIdx, high);
+// Coil + evt. GPIO-mappet pin (direkte PORTx-skrivning). true = pin drevet.
+static bool set_coil_level(uint16_t coilIdx, bool high) {
+  if (coilIdx >= NUM_COILS) return false;
+  return gpio_coil_write(coilIdx, high);
 }
 
-// ------------------------------------------------------
-// Timer logic
-// ------------------------------------------------------
-static void loop_one_shot(TimerConfig& t, unsigned long now) {
-  switch (t.phase) {
-    case 0:
-      set_coil_level(t.coil, t.p1High);
-      if (t.T1 == 0 || now - t.phaseStartMs >= t.T1) {
-        t.phase++;
-        t.phaseStartMs = now;
-      }
-      break;
+static inline uint16_t tmr_sat16(uint32_t v) {
+  return (v > 0xFFFFu) ? 0xFFFFu : (uint16_t)v;
+}
 
-    case 1:
-      set_coil_level(t.coil, t.p2High);
-      if (t.T2 == 0 || now - t.phaseStartMs >= t.T2) {
-        t.phase++;
-        t.phaseStartMs = now;
-      }
-      break;
+// Effektiv mode (mode 4 kører sin subMode)
+static inline uint8_t tmr_mode(const TimerConfig& t) {
+  return (t.mode == TM_TRIGGER) ? t.subMode : t.mode;
+}
+
+// Niveau og varighed for en fase. false = sekvensen er slut.
+//   One-shot : 0=P1(T1) 1=P2(T2) 2=P3(T3)
+//   Mono     : 1=P2(T1), derefter tilbage til P1
+//   Astable  : 0=P1(T1) 1=P2(T2), gentages
+static bool tmr_phase_def(const TimerConfig& t, uint8_t m, uint8_t ph,
+                          uint8_t& level, uint32_t& ms) {
+  switch (m) {
+    case TM_ONE_SHOT:
+      if (ph == 0) { level = t.p1High; ms = t.T1; return true; }
+      if (ph == 1) { level = t.p2High; ms = t.T2; return true; }
+      if (ph == 2) { level = t.p3High; ms = t.T3; return true; }
+      return false;
+    case TM_MONO:
+      if (ph == 1) { level = t.p2High; ms = t.T1; return true; }
+      return false;
+    case TM_ASTABLE:
+      level = ph ? t.p2High : t.p1High;
+      ms    = ph ? t.T2 : t.T1;
+      // T1=T2=0 ville give en ISR-storm -> 1 ms pr. fase
+      if (t.T1 == 0 && t.T2 == 0) ms = 1;
+      return true;
+  }
+  return false;
+}
 
-    case 2:
-      set_coil_level(t.coil, t.p3High);
-      if (t.T3 == 0 || now - t.phaseStartMs >= t.T3) {
-        t.phase++;
+static inline uint8_t tmr_next_phase(uint8_t m, uint8_t ph) {
+  return (m == TM_ASTABLE) ? (uint8_t)(ph ^ 1) : (uint8_t)(ph + 1);
+}
+
+// Planlæg (næste bid af) fasen fra tidspunkt 'from'
+static void tmr_schedule_isr(uint8_t i, uint32_t from) {
+  uint32_t ms = tmrRemainMs[i];
+  if (ms > TMR_CHUNK_MS) ms = TMR_CHUNK_MS;
+  tmrRemainMs[i] -= ms;
+  tmrDeadline[i] = from + ms * TMR_TICKS_PER_MS;
+  tmrArmed |= (uint8_t)(1u << i);
+}
+
+// Skriv output for en fase der starter ved 'at'. Er coil'en GPIO-mappet,
+// måles end-to-end latency: deadline (eller start) -> PORTx skrevet.
+static void tmr_drive_isr(uint16_t coil, bool level, uint32_t at) {
+  if (!set_coil_level(coil, level)) return;
+  uint16_t lat = tmr_sat16(timebase_ticks_isr() - at);
+  tmrOutLast = lat;
+  if (lat > tmrOutMax) tmrOutMax = lat;
+}
+
+// Trin-program: udfør trin t.phase ved 'at'. Trin uden ventetid (0 ms,
+// opfyldt input-betingelse) følges straks; et program der kun består af
+// sådanne trin får 1 ms pr. runde, så ISR'en ikke hænger.
+static void tmr_seq_enter_isr(uint8_t i, uint32_t at) {
+  TimerConfig& t = timers[i];
+  uint8_t bit = (uint8_t)(1u << i);
+  seqWait &= (uint8_t)~bit;
+
+  for (uint8_t guard = 0; guard < SEQ_MAX_STEPS; ++guard) {
+    SeqStep st;
+    if (!seq_step_get(i, t.phase, st)) break;
+    for (uint8_t k = 0; k < SEQ_COILS; ++k) {
+      if (st.mask & (1u << k)) tmr_drive_isr(t.coil + k, (st.levels >> k) & 1, at);
+    }
+    seqNext[i] = st.next;
+    if (st.wait == SEQ_WAIT_END) break;
+    if (st.wait == SEQ_WAIT_TIME) {
+      if (st.arg != 0) {
+        tmrRemainMs[i] = st.arg;
+        tmr_schedule_isr(i, at);
+        return;
       }
-      break;
+    } else if (st.wait > SEQ_WAIT_LOW || st.arg >= NUM_DISCRETE) {
+      // Ugyldigt trin (master-skrevet input-index/venteform): stop med alarm
+      tmrArmed &= (uint8_t)~bit;
+      t.phase     = 0;
+      t.active    = 0;
+      t.alarm     = 1;
+      t.alarmCode = 3;   // ugyldigt trin
+      return;
+    } else if (di_read(st.arg) != (st.wait == SEQ_WAIT_HIGH)) {
+      seqWaitIdx[i] = st.arg;
+      seqWaitLvl[i] = (st.wait == SEQ_WAIT_HIGH) ? 1 : 0;
+      tmrArmed &= (uint8_t)~bit;
+      seqWait  |= bit;
+      return;
+    }
+    t.phase = st.next;
+    if (guard == SEQ_MAX_STEPS - 1) {
+      tmrRemainMs[i] = 1;
+      tmr_schedule_isr(i, at);
+      return;
+    }
+  }
+
+  // Program slut
+  tmrArmed &= (uint8_t)~bit;
+  t.phase  = 0;
+  t.active = 0;
+}
+
+// Gå ind i t.phase ved tidspunkt 'at': skriv coil og planlæg deadline.
+// Faser med varighed 0 springes over (coil skrives, næste fase følger).
+static void tmr_enter_isr(uint8_t i, uint32_t at) {
+  TimerConfig& t = timers[i];
+  uint8_t m = tmr_mode(t);
+  uint8_t bit = (uint8_t)(1u << i);
+  tmrEvt |= bit;
+  idle_isr_post();
+  if (m == TM_SEQUENCE) {
+    tmr_seq_enter_isr(i, at);
+    return;
+  }
 
-    default:
+  for (uint8_t guard = 0; guard < 4; ++guard) {
+    uint8_t  level;
+    uint32_t ms;
+    if (!tmr_phase_def(t, m, t.phase, level, ms)) {
+      // Sekvens slut: mono vender tilbage til hvileniveau P1
+      tmrArmed &= (uint8_t)~bit;
+      if (m == TM_MONO) {
+        tmr_drive_isr(t.coil, t.p1High, at);
+        t.lastDurationMs = t.T1;
+        t.phase = 0;
+      } else {
+        t.lastDurationMs = t.T3;
+      }
       t.active = 0;
-      t.lastDurationMs = now - t.phaseStartMs;
-      break;
+      return;
+    }
+    tmr_drive_isr(t.coil, level, at);
+    if (ms != 0) {
+      tmrRemainMs[i] = ms;
+      tmr_schedule_isr(i, at);
+      return;
+    }
+    t.phase = tmr_next_phase(m, t.phase);
   }
+  tmrArmed &= (uint8_t)~bit;   // kan ikke nås (astable har min. 1 ms)
 }
 
-static void loop_monostable(TimerConfig& t, unsigned long now) {
-  if (!t.active) {
-    set_coil_level(t.coil, t.p1High);
+// Deadline nået: næste bid af fasen eller næste fase
+static void tmr_expire_isr(uint8_t i) {
+  if (tmrRemainMs[i] != 0) {
+    tmr_schedule_isr(i, tmrDeadline[i]);
     return;
   }
+  TimerConfig& t = timers[i];
+  uint8_t m = tmr_mode(t);
+  t.phase = (m == TM_SEQUENCE) ? seqNext[i] : tmr_next_phase(m, t.phase);
+  tmr_enter_isr(i, tmrDeadline[i]);
+}
 
-  if (t.phase == 0) {
-    t.phase = 1;
-    t.phaseStartMs = now;
-    set_coil_level(t.coil, t.p2High);
-  } else if (t.phase == 1 && now - t.phaseStartMs >= t.T1) {
-    set_coil_level(t.coil, t.p1High);
-    t.active = 0;
-    t.phase = 0;
-    t.lastDurationMs = now - t.phaseStartMs;
+// Registrér lateness (ticks) for et faseskift. Bin b dækker [2^b, 2^(b+1)) µs,
+// bin 0 også 0 µs og sidste bin alt derover.
+static void tmr_stat_isr(uint8_t i, uint16_t late) {
+  TmrStat& st = tmrStat[i];
+  if (st.n == 0 || late < st.min) st.min = late;
+  if (late > st.max) st.max = late;
+  st.n++;
+  if (st.sum > 0xFFFF0000UL) {         // bevar middelværdien ved overløb
+    st.sum  >>= 1;
+    st.sumN >>= 1;
   }
+  st.sum += late;
+  st.sumN++;
+  uint16_t us = late / TIMEBASE_TICKS_PER_US;
+  uint8_t b = 0;
+  while (us > 1 && b < TIMER_STATS_BINS - 1) { us >>= 1; b++; }
+  if (st.hist[b] != 0xFFFF) st.hist[b]++;
 }
 
-static void loop_astable(TimerConfig& t, unsigned long now) {
-  if (!t.active) return;
+// Håndter alle forfaldne deadlines og armér OCR4A til den nærmeste
+static void tmr_service_isr() {
+  uint32_t entry = timebase_ticks_isr();
+  for (;;) {
+    uint32_t now = timebase_ticks_isr();
+    for (uint8_t i = 0; i < 4; ++i) {
+      if (!(tmrArmed & (1u << i))) continue;
+      int32_t d = (int32_t)(tmrDeadline[i] - now);
+      if (d > 0) continue;
+      uint16_t late = tmr_sat16((uint32_t)(-d));
+      tmrLateLast = late;
+      if (late > tmrLateMax) tmrLateMax = late;
+      tmrEvents++;
+      if (tmrRemainMs[i] == 0) tmr_stat_isr(i, late);   // ikke bid-grænser
+      tmr_expire_isr(i);
+    }
 
-  if (t.phase == 0) {
-    set_coil_level(t.coil, t.p1High);
-    if (t.T1 == 0 || now - t.phaseStartMs >= t.T1) {
-      t.phase = 1;
-      t.phaseStartMs = now;
+    // Nærmeste deadline målt fra en frisk tid (expire kan tage tid)
+    now = timebase_ticks_isr();
+    uint8_t  armed   = tmrArmed;
+    bool     any     = false;
+    int32_t  nearest = 0;
+    uint8_t  next    = 0;
+    for (uint8_t i = 0; i < 4; ++i) {
+      if (!(armed & (1u << i))) continue;
+      int32_t d = (int32_t)(tmrDeadline[i] - now);
+      if (!any || d < nearest) { nearest = d; next = i; any = true; }
+    }
+    if (!any) {
+      TIMSK4 &= (uint8_t)~_BV(OCIE4A);
+      break;
     }
-  } else {
-    set_coil_level(t.coil, t.p2High);
-    if (t.T2 == 0 || now - t.phaseStartMs >= t.T2) {
-      t.phase = 0;
-      t.phaseStartMs = now;
+    if (nearest > TMR_REARM_TICKS) {
+      timebase_compa_arm_isr(tmrDeadline[next]);
+      // Genlæs TCNT4: nåede deadline at passere (eller komme for tæt på)
+      // mens OCR4A blev skrevet, kommer compare-match først et 16-bit
+      // omløb senere (32,8 ms) - så håndteres den her i stedet.
+      if ((int32_t)(tmrDeadline[next] - timebase_ticks_isr()) > TMR_ARM_MARGIN) break;
     }
   }
+  uint16_t spent = tmr_sat16(timebase_ticks_isr() - entry);
+  if (spent > tmrIsrMax) tmrIsrMax = spent;
 }
 
-static void loop_trigger_mode(TimerConfig& t, unsigned long now) {
-  uint8_t lvl = di_read(t.trigIndex) ? 1 : 0;
-  bool fire = false;
+// ============================================================================
+// ISR - Timer4 Compare Match A (TimerEngine deadlines)
+// ============================================================================
+// OCR4A matcher kun de lave 16 bit; tidlige interrupts for fjerne deadlines
+// finder intet forfaldent og genarmerer blot.
+ISR(TIMER4_COMPA_vect) {
+  tmr_service_isr();
+}
 
-  if      (t.trigEdge == TRIG_RISING  && t.lastTrigLevel == 0 && lvl == 1) fire = true;
-  else if (t.trigEdge == TRIG_FALLING && t.lastTrigLevel == 1 && lvl == 0) fire = true;
-  else if (t.trigEdge == TRIG_BOTH    && t.lastTrigLevel != lvl)           fire = true;
+// Start sekvens for timer i (loop-kontekst)
+static void tmr_start(uint8_t i) {
+  TimerConfig& t = timers[i];
+  uint8_t s = SREG;
+  cli();
+  t.phase = (tmr_mode(t) == TM_MONO) ? 1 : 0;
+  tmr_enter_isr(i, timebase_ticks_isr());
+  tmr_service_isr();   // armér OCR4A (eller slå fra hvis intet venter)
+  SREG = s;
+}
 
-  t.lastTrigLevel = lvl;
+// Stop scheduler for timer i (loop-kontekst)
+static void tmr_stop(uint8_t i) {
+  uint8_t s = SREG;
+  cli();
+  tmrArmed &= (uint8_t)~(1u << i);
+  tmrEvt   &= (uint8_t)~(1u << i);
+  seqWait  &= (uint8_t)~(1u << i);
+  SREG = s;
+}
 
-  if (fire) {
-    t.active       = 1;
-    t.phase        = 0;
-    t.phaseStartMs = now;
-    t.alarm        = 0;
-    t.alarmCode    = 0;
+// Mode 4 startet fra edge-ISR (modbus_timers_trig.cpp). 'at' er tidsstemplet
+// ved ISR-indgang, så faserne regnes fra flanken og ikke fra loop.
+// Status-bit sættes i timers_loop() (holding-regs skrives ikke fra ISR).
+void timers_trigger_isr(uint8_t i, uint32_t at) {
+  TimerConfig& t = timers[i];
+  if (!t.enabled || t.mode != TM_TRIGGER) return;
+  t.active    = 1;
+  t.alarm     = 0;
+  t.alarmCode = 0;
+  t.phase = (tmr_mode(t) == TM_MONO) ? 1 : 0;
+  tmr_enter_isr(i, at);
+  tmr_service_isr();
+  tmrTrigFired |= (uint8_t)(1u << i);
+  uint16_t lat = tmr_sat16(timebase_ticks_isr() - at);
+  tmrTrigLast = lat;
+  if (lat > tmrTrigMax) tmrTrigMax = lat;
+}
 
-    // Sæt global timer-statusbit for denne timer
-    uint8_t idx = (t.id > 0 && t.id <= 4) ? (t.id - 1) : 0;
-    timers_flag_active(idx);
+// Start sekvens udløst af trigger/coil-write: sæt flag og status
+static void tmr_fire(uint8_t i, unsigned long nowMs) {
+  TimerConfig& t = timers[i];
+  t.active       = 1;
+  t.phaseStartMs = nowMs;
+  t.alarm        = 0;
+  t.alarmCode    = 0;
+  timers_flag_active(i);
+  if (t.mode == TM_SEQUENCE) {
+    uint16_t* r = seq_regs(i);
+    if (r) r[0] = 1;
+    seqLastCtrl[i] = 1;
   }
+  tmr_start(i);
+}
 
-  switch (t.subMode) {
-    case TM_ONE_SHOT: loop_one_shot(t, now);    break;
-    case TM_MONO:     loop_monostable(t, now);  break;
-    case TM_ASTABLE:  loop_astable(t, now);     break;
+// Trin-program i loop: kontrol-reg, input-trin og aktuelt-trin reg
+static void tmr_seq_loop(uint8_t i, unsigned long nowMs) {
+  TimerConfig& t = timers[i];
+  uint16_t* r = seq_regs(i);
+  if (!r) return;
+  uint8_t bit = (uint8_t)(1u << i);
+
+  // Slut i ISR -> kontrol-reg tilbage til 0
+  if (!t.active && seqLastCtrl[i] != 0) {
+    r[0] = 0;
+    seqLastCtrl[i] = 0;
   }
+
+  uint16_t ctrl = r[0];
+  if (ctrl != seqLastCtrl[i]) {
+    seqLastCtrl[i] = ctrl;
+    if (ctrl != 0) {
+      tmr_fire(i, nowMs);
+    } else {
+      tmr_stop(i);
+      t.active = 0;
+      t.phase  = 0;
+    }
+  }
+
+  // Input-trin: betingelse opfyldt -> næste trin startes herfra
+  if (seqWait & bit) {
+    if (di_read(seqWaitIdx[i]) == (seqWaitLvl[i] != 0)) {
+      uint8_t s = SREG;
+      cli();
+      if (seqWait & bit) {
+        t.phase = seqNext[i];
+        tmr_enter_isr(i, timebase_ticks_isr());
+        tmr_service_isr();
+      }
+      SREG = s;
+    }
+  }
+
+  r[1] = t.active ? t.phase : SEQ_STEP_IDLE;
 }
 
+// ------------------------------------------------------
+// Live-parametre i holding-regs (v3.8.5)
+// ------------------------------------------------------
+// Publicér aktuelle perioder/niveauer i reg-blokken
+static void tmr_params_push(uint8_t i) {
+  uint16_t reg = timerParamReg[i];
+  if (reg == 0) return;
+  const TimerConfig& t = timers[i];
+  uint16_t* r = &holdingRegs[reg];
+  r[0] = (uint16_t)(t.T1 & 0xFFFF); r[1] = (uint16_t)(t.T1 >> 16);
+  r[2] = (uint16_t)(t.T2 & 0xFFFF); r[3] = (uint16_t)(t.T2 >> 16);
+  r[4] = (uint16_t)(t.T3 & 0xFFFF); r[5] = (uint16_t)(t.T3 >> 16);
+  r[6] = (uint16_t)((t.p1High ? 1 : 0) | (t.p2High ? 2 : 0) | (t.p3High ? 4 : 0));
+}
+
+// Hent ændrede værdier fra reg-blokken. Igangværende fase beholder sin
+// deadline; ISR'en læser T/P først når næste fase startes.
+static void tmr_params_pull(uint8_t i) {
+  uint16_t reg = timerParamReg[i];
+  if (reg == 0) return;
+  TimerConfig& t = timers[i];
+  const uint16_t* r = &holdingRegs[reg];
+  uint32_t T1 = (uint32_t)r[0] | ((uint32_t)r[1] << 16);
+  uint32_t T2 = (uint32_t)r[2] | ((uint32_t)r[3] << 16);
+  uint32_t T3 = (uint32_t)r[4] | ((uint32_t)r[5] << 16);
+  uint8_t p1 = (r[6] & 1) ? 1 : 0;
+  uint8_t p2 = (r[6] & 2) ? 1 : 0;
+  uint8_t p3 = (r[6] & 4) ? 1 : 0;
+  if (T1 == t.T1 && T2 == t.T2 && T3 == t.T3 &&
+      p1 == t.p1High && p2 == t.p2High && p3 == t.p3High) return;
+
+  bool restLevel = (p1 != t.p1High);
+  uint8_t s = SREG;
+  cli();
+  t.T1 = T1; t.T2 = T2; t.T3 = T3;
+  t.p1High = p1; t.p2High = p2; t.p3High = p3;
+  SREG = s;
+
+  // Mono i hvile holder P1 -> nyt hvileniveau gælder straks
+  if (restLevel && !t.active && tmr_mode(t) == TM_MONO) set_coil_level(t.coil, p1);
+}
 
 // ------------------------------------------------------
 // Public API
 // ------------------------------------------------------
 void timers_init() {
+  uint8_t s = SREG;
+  cli();
+  tmrArmed = 0;
+  tmrEvt   = 0;
+  SREG = s;
+  timebase_compa_disable();
+  wave_unbind();
+  for (uint8_t i = 0; i < 4; i++) trig_unbind(i);
+
   for (uint8_t i = 0; i < 4; i++) {
     memset(&timers[i], 0, sizeof(TimerConfig));
     timers[i].id       = i + 1;
@@ -161,30 +526,95 @@ void timers_init() {
   }
 }
 
+// Alarm-timeout: 5x "normal" cyklustid (fallback 1 s hvis alt er 0)
+static unsigned long tmr_timeout_ms(const TimerConfig& t) {
+  unsigned long total = t.T1 + t.T2 + t.T3;
+  if (total == 0) total = 1000;
+  return total * 5UL;
+}
+
 void timers_loop() {
   unsigned long now = millis();
 
+  // Faseskift fra ISR -> ms-tid til timeout-overvågning
+  uint8_t s = SREG;
+  cli();
+  uint8_t evt = tmrEvt;
+  tmrEvt = 0;
+  uint8_t fired = tmrTrigFired;
+  tmrTrigFired = 0;
+  SREG = s;
+
+  // Waveform (mode 5): enkelt-puls/pulstog færdig -> status-bit
+  if (wave_loop()) timers_flag_active((uint8_t)wave_timer());
+
   for (uint8_t i = 0; i < 4; i++) {
     TimerConfig& t = timers[i];
     if (!t.enabled) continue;
+    if (t.mode == TM_WAVE) {           // ingen faser/timeout; Timer1 styrer pin
+      t.active = wave_running() ? 1 : 0;
+      continue;
+    }
+    if (evt & (1u << i)) t.phaseStartMs = now;
+    if (t.mode == TM_SEQUENCE) {       // ingen timeout: trin kan vente på input
+      tmr_seq_loop(i, now);
+      continue;
+    }
+    tmr_params_pull(i);
+
+    // Trigger startet fra edge-ISR: niveau spejles til discrete input
+    if (t.mode == TM_TRIGGER && trig_bound(i)) {
+      if (fired & (1u << i)) timers_flag_active(i);
+      uint8_t lvl = trig_level(i) ? 1 : 0;
+      if (t.trigIndex < NUM_DISCRETE) bitWriteArray(discreteInputs, t.trigIndex, lvl);
+      t.lastTrigLevel = lvl;
+    }
+    // Trigger-edge (mode 4) på diskret input
+    else if (t.mode == TM_TRIGGER) {
+      uint8_t lvl = di_read(t.trigIndex) ? 1 : 0;
+      bool fire = false;
+
+      if      (t.trigEdge == TRIG_RISING  && t.lastTrigLevel == 0 && lvl == 1) fire = true;
+      else if (t.trigEdge == TRIG_FALLING && t.lastTrigLevel == 1 && lvl == 0) fire = true;
+      else if (t.trigEdge == TRIG_BOTH    && t.lastTrigLevel != lvl)           fire = true;
 
-    // Kerne-timerlogik
-    switch (t.mode) {
-      case TM_ONE_SHOT: loop_one_shot(t, now);    break;
-      case TM_MONO:     loop_monostable(t, now);  break;
-      case TM_ASTABLE:  loop_astable(t, now);     break;
-      case TM_TRIGGER:  loop_trigger_mode(t, now);break;
+      t.lastTrigLevel = lvl;
+      if (fire) tmr_fire(i, now);
     }
 
     // --- Alarm / timeout overvågning ---
-    unsigned long total = t.T1 + t.T2 + t.T3;
-    if (total == 0) total = 1000;        // fallback hvis alt er 0
-    unsigned long timeout = total * 5UL; // 5x "normal" cyklustid
-
-    if (t.active && (now - t.phaseStartMs > timeout)) {
+    if (t.active && (now - t.phaseStartMs > tmr_timeout_ms(t))) {
       t.alarm    = 1;
       t.alarmCode= 1;  // timeout
       t.active   = 0;  // stop for sikkerhed
+      tmr_stop(i);
+    }
+  }
+
+  // Lateness-diagnostik (FC04)
+  TimerLatenessStats st;
+  timers_lateness_get(st);
+  inputRegs[IREG_DIAG_TIMER_LATE_LAST] = st.lateLastUs;
+  inputRegs[IREG_DIAG_TIMER_LATE_MAX]  = st.lateMaxUs;
+  inputRegs[IREG_DIAG_TIMER_ISR_MAX]   = st.isrMaxUs;
+  inputRegs[IREG_DIAG_TIMER_EVENTS]    = (uint16_t)st.events;
+  inputRegs[IREG_DIAG_OUT_LAT_LAST]    = st.outLastUs;
+  inputRegs[IREG_DIAG_OUT_LAT_MAX]     = st.outMaxUs;
+  inputRegs[IREG_DIAG_TRIG_LAT_LAST]   = st.trigLastUs;
+  inputRegs[IREG_DIAG_TRIG_LAT_MAX]    = st.trigMaxUs;
+
+  // Lateness pr. timer (FC04), højst 4 gange i sekundet (32-bit division)
+  if (now - tmrStatPubMs >= TIMER_STATS_PUBLISH_MS) {
+    tmrStatPubMs = now;
+    for (uint8_t i = 0; i < 4; i++) {
+      TimerPhaseStats ps;
+      timers_stats_get(i, ps);
+      uint16_t* r = &inputRegs[IREG_TIMER_STATS_BASE + i * TIMER_STATS_REGS];
+      r[0] = (uint16_t)ps.count;
+      r[1] = ps.minUs;
+      r[2] = ps.maxUs;
+      r[3] = ps.meanUs;
+      for (uint8_t b = 0; b < TIMER_STATS_BINS; b++) r[4 + b] = ps.hist[b];
     }
   }
 }
@@ -197,40 +627,141 @@ void timers_onCoilWrite(uint16_t coilIdx, uint8_t value) {
   for (uint8_t i = 0; i < 4; i++) {
     TimerConfig& t = timers[i];
     if (!t.enabled) continue;
+    if (t.mode == TM_WAVE) continue;
     if (t.coil != coilIdx) continue;
 
-    // ASTABLE der allerede kører skal ikke retrigges
-    if (t.mode == TM_ASTABLE && t.active) continue;
+    // ASTABLE/trin-program der allerede kører skal ikke retrigges
+    if ((t.mode == TM_ASTABLE || t.mode == TM_SEQUENCE) && t.active) continue;
 
-    t.active        = 1;
-        // --- marker denne timer som aktiv i global status-reg ---
-    timers_flag_active(i);
+    tmr_fire(i, now);
+  }
+}
 
-    t.phase         = 0;
-    t.phaseStartMs  = now;
-    t.alarm         = 0;
-    t.alarmCode     = 0;
+// Næste deadline i ms (v3.8.1). Faseskift sker i OCR4A-ISR'en, som
+// vækker CPU'en; loop skal derefter have ét pass (tmrEvt) til timeout-
+// overvågning og trin-programmets kontrol-reg. Mode 4 poller sit trigger-
+// input i loop og kræver derfor hvert pass - undtagen med trigger-pin,
+// hvor edge-ISR'en selv vækker CPU'en.
+uint32_t timers_next_deadline_ms() {
+  for (uint8_t i = 0; i < 4; i++) {
+    if (timers[i].enabled && timers[i].mode == TM_TRIGGER && !trig_bound(i)) return 0;
+  }
+  if (seqWait) return 0;        // trin-program venter på input (polles)
+  if (tmrEvt || tmrTrigFired || wave_pending()) return 0;
 
-    // --- marker denne timer som aktiv ---
-    timers_flag_active(i);
+  uint32_t due = IDLE_NO_DEADLINE;
+  unsigned long nowMs = millis();
+  for (uint8_t i = 0; i < 4; i++) {
+    const TimerConfig& t = timers[i];
+    if (!t.enabled || !t.active || t.mode == TM_WAVE || t.mode == TM_SEQUENCE) continue;
+    uint32_t d = idle_due_in(t.phaseStartMs, tmr_timeout_ms(t) + 1, nowMs);
+    if (d < due) due = d;
+  }
+
+  // Fase-slut (faseskiftet selv sker i ISR'en)
+  uint8_t s = SREG;
+  cli();
+  uint32_t now = timebase_ticks_isr();
+  for (uint8_t i = 0; i < 4; i++) {
+    if (!(tmrArmed & (1u << i))) continue;
+    int32_t d = (int32_t)(tmrDeadline[i] - now);
+    uint32_t ms = (d > 0) ? (uint32_t)d / TMR_TICKS_PER_MS : 0;
+    ms += tmrRemainMs[i];
+    if (ms < due) due = ms;
+  }
+  SREG = s;
+  return due;
+}
 
-    t.phase         = 0;
-    t.phaseStartMs  = now;
-    t.alarm         = 0;
-    t.alarmCode     = 0;
+void timers_lateness_get(TimerLatenessStats& out) {
+  uint8_t s = SREG;
+  cli();
+  uint16_t last = tmrLateLast;
+  uint16_t max  = tmrLateMax;
+  uint16_t isr  = tmrIsrMax;
+  uint16_t oLast = tmrOutLast;
+  uint16_t oMax  = tmrOutMax;
+  uint16_t tLast = tmrTrigLast;
+  uint16_t tMax  = tmrTrigMax;
+  out.events    = tmrEvents;
+  SREG = s;
+  out.lateLastUs = last / TIMEBASE_TICKS_PER_US;
+  out.lateMaxUs  = max  / TIMEBASE_TICKS_PER_US;
+  out.isrMaxUs   = isr  / TIMEBASE_TICKS_PER_US;
+  out.outLastUs  = oLast / TIMEBASE_TICKS_PER_US;
+  out.outMaxUs   = oMax  / TIMEBASE_TICKS_PER_US;
+  out.trigLastUs = tLast / TIMEBASE_TICKS_PER_US;
+  out.trigMaxUs  = tMax  / TIMEBASE_TICKS_PER_US;
+}
+bool timers_stats_get(uint8_t idx, TimerPhaseStats& out) {
+  if (idx >= 4) return false;
+  uint8_t s = SREG;
+  cli();
+  const TmrStat st = tmrStat[idx];
+  SREG = s;
+  out.count  = st.n;
+  out.minUs  = st.min / TIMEBASE_TICKS_PER_US;
+  out.maxUs  = st.max / TIMEBASE_TICKS_PER_US;
+  out.meanUs = st.sumN ? (uint16_t)(st.sum / st.sumN / TIMEBASE_TICKS_PER_US) : 0;
+  memcpy(out.hist, st.hist, sizeof(out.hist));
+  return true;
+}
+
+void timers_stats_reset() {
+  uint8_t s = SREG;
+  cli();
+  memset(tmrStat, 0, sizeof(tmrStat));
+  tmrLateLast = 0;
+  tmrLateMax  = 0;
+  tmrIsrMax   = 0;
+  tmrOutLast  = 0;
+  tmrOutMax   = 0;
+  tmrTrigLast = 0;
+  tmrTrigMax  = 0;
+  SREG = s;
+  tmrStatPubMs = millis() - TIMER_STATS_PUBLISH_MS;   // publicér i næste loop
+}
+
+void timers_print_stats() {
+  Serial.println(F("=== TIMER LATENESS (deadline -> phase switch, us) ==="));
+  Serial.println(F("timer | switches   | min   | mean  | max   | <2    <4    <8    <16   <32   <64   <128  >=128"));
+  for (uint8_t i = 0; i < 4; i++) {
+    TimerPhaseStats ps;
+    timers_stats_get(i, ps);
+    char buf[120];
+    snprintf(buf, sizeof(buf), " %u     | %-10lu | %-5u | %-5u | %-5u |",
+             (unsigned)(i + 1), (unsigned long)ps.count, ps.minUs, ps.meanUs, ps.maxUs);
+    Serial.print(buf);
+    for (uint8_t b = 0; b < TIMER_STATS_BINS; b++) {
+      snprintf(buf, sizeof(buf), " %-5u", ps.hist[b]);
+      Serial.print(buf);
+    }
+    Serial.println();
   }
+  Serial.print(F("input regs ")); Serial.print(IREG_TIMER_STATS_BASE);
+  Serial.print(F("..")); Serial.print(IREG_TIMER_STATS_BASE + 4 * TIMER_STATS_REGS - 1);
+  Serial.println(F(" (per timer: switches, min, max, mean, 8 bins); 'reset timers stats' clears"));
 }
+
 // bruges af Opgave 1b: tjek om coil ejes af timer
 bool timers_hasCoil(uint16_t idx) {
   for (uint8_t i = 0; i < 4; i++) {
     if (!timers[i].enabled) continue;
+    if (timers[i].mode == TM_WAVE) continue;
+    if (timers[i].mode == TM_SEQUENCE) {
+      if (idx >= timers[i].coil && idx < timers[i].coil + SEQ_COILS) return true;
+      continue;
+    }
     if (timers[i].coil == idx) return true;
   }
   return false;
 }
 
 void timers_disable_all() {
+  wave_unbind();
   for (uint8_t i = 0; i < 4; i++) {
+    trig_unbind(i);
+    tmr_stop(i);
     timers[i].enabled = 0;
     timers[i].active  = 0;
   }
@@ -238,6 +769,12 @@ void timers_disable_all() {
 
 bool timers_config_set(uint8_t id, const TimerConfig& src) {
   if (id < 1 || id > 4) return false;
+  // Kun én timer kan eje Timer1-generatoren (mode 5)
+  if (src.enabled && src.mode == TM_WAVE &&
+      wave_timer() >= 0 && wave_timer() != (int8_t)(id - 1)) return false;
+  tmr_stop(id - 1);             // ISR må ikke læse en halvt kopieret config
+  trig_unbind(id - 1);
+  if (wave_timer() == (int8_t)(id - 1)) wave_unbind();
   timers[id-1] = src;
   TimerConfig& t = timers[id-1];
 
@@ -249,28 +786,14 @@ bool timers_config_set(uint8_t id, const TimerConfig& src) {
   t.alarm       = 0;
   t.alarmCode   = 0;
 
-  // Check for GPIO conflicts on coil (only if timer is enabled)
-  // If timer controls a coil, check if any GPIO pin is STATIC mapped to that coil
-  if (t.enabled && t.coil < NUM_COILS) {
-    for (uint8_t pin = 0; pin < NUM_GPIO; ++pin) {
-      if (gpioToCoil[pin] == (int16_t)t.coil) {
-        // Found a GPIO pin mapped to this coil
-        Serial.print(F("⚠ GPIO-KONFLIKT: pin "));
-        Serial.print(pin);
-        Serial.print(F(" var STATIC mapped til coil "));
-        Serial.print(t.coil);
-        Serial.print(F(" – fjernet da timer "));
-        Serial.print(t.id);
-        Serial.println(F(" nu har kontrol (DYNAMIC)"));
-        Serial.println(F("% Du skal opdatere din config-fil!"));
-        gpioToCoil[pin] = -1;
-      }
-    }
-  }
+  // En GPIO-pin mappet til timerens coil er ikke en konflikt: den er
+  // timerens output og drives direkte fra ISR (gpio_coil_write). Mappingen
+  // beholdes, så direkte drive overlever genstart og load (v3.9.6).
 
   // Check for GPIO conflicts on trigger input (only if timer is enabled AND mode is 4)
   // If timer uses trigger input, check if any GPIO pin is STATIC mapped to that input
   if (t.enabled && t.mode == 4 && t.trigIndex < NUM_DISCRETE) {
+    bool unmapped = false;
     for (uint8_t pin = 0; pin < NUM_GPIO; ++pin) {
       if (gpioToInput[pin] == (int16_t)t.trigIndex) {
         // Found a GPIO pin mapped to this input
@@ -283,8 +806,14 @@ bool timers_config_set(uint8_t id, const TimerConfig& src) {
         Serial.println(F(" nu har kontrol (DYNAMIC)"));
         Serial.println(F("% Du skal opdatere din config-fil!"));
         gpioToInput[pin] = -1;
+        unmapped = true;
       }
     }
+    // Polling-tællere på samme input skal ikke længere læse pin'en
+    if (unmapped) {
+      counters_poll_plan_rebuild();
+      gpio_plan_rebuild();
+    }
   }
 
   // Update timer status register if configured
@@ -292,9 +821,50 @@ bool timers_config_set(uint8_t id, const TimerConfig& src) {
     holdingRegs[timerStatusRegIndex] |= (1u << (t.id - 1));
   }
 
+  // Starttilstand: one-shot kører sin sekvens fra konfiguration,
+  // mono holder hvileniveau P1, astable venter på start
+  if (t.enabled) {
+    uint8_t m = tmr_mode(t);
+    if (m == TM_ONE_SHOT)  tmr_start(id - 1);
+    else if (m == TM_MONO) set_coil_level(t.coil, t.p1High);
+    else if (m == TM_WAVE) wave_bind(id - 1);
+  }
+  if (t.mode == TM_SEQUENCE) {  // trin-program venter på start
+    uint16_t* r = seq_regs(id - 1);
+    if (r) { r[0] = 0; r[1] = SEQ_STEP_IDLE; }
+    seqLastCtrl[id - 1] = 0;
+  }
+
+  // Ny config er gældende -> reg-blokken viser den (ellers vinder gamle regs)
+  tmr_params_push(id - 1);
+  trig_rebind(id - 1);          // edge-ISR med ny flanke (kun mode 4)
+
+  return true;
+}
+
+bool timers_param_reg_set(uint8_t idx, uint16_t reg) {
+  if (idx >= 4) return false;
+  if (reg != 0 && (uint32_t)reg + TIMER_PARAM_REGS > NUM_REGS) return false;
+  if (reg != 0 && regmap_owner(reg, TIMER_PARAM_REGS, REGMAP_ID(REGMAP_TPARAM, idx))) return false;
+  timerParamReg[idx] = reg;
+  tmr_params_push(idx);
   return true;
 }
 
+// Diff-apply (v3.9.5): true hvis src svarer til kørende timer id.
+// liveParams: T1..T3/P1..P3 ejes af master via reg-blokken og sammenlignes
+// ikke (ellers ville en load overskrive master-skrevne setpunkter).
+bool timers_config_same(uint8_t id, const TimerConfig& src, bool liveParams) {
+  if (id < 1 || id > 4) return true;
+  const TimerConfig& t = timers[id-1];
+  if ((src.enabled != 0) != (t.enabled != 0)) return false;
+  if (src.mode != t.mode || src.subMode != t.subMode) return false;
+  if (src.coil != t.coil || src.trigIndex != t.trigIndex || src.trigEdge != t.trigEdge) return false;
+  if (liveParams) return true;
+  return src.p1High == t.p1High && src.p2High == t.p2High && src.p3High == t.p3High &&
+         src.T1 == t.T1 && src.T2 == t.T2 && src.T3 == t.T3;
+}
+
 bool timers_get(uint8_t id, TimerConfig& out) {
   if (id < 1 || id > 4) return false;
   out = timers[id-1];
@@ -310,7 +880,11 @@ void timers_print_status() {
   Serial.println(F("------------------------------------------------------------------------------------------------------------------------------"));
 
   for (uint8_t i = 0; i < 4; i++) {
-    const TimerConfig& t = timers[i];
+    // Kopi med interrupts slået fra (ISR'en opdaterer fase/runtime-felter)
+    uint8_t s = SREG;
+    cli();
+    const TimerConfig t = timers[i];
+    SREG = s;
 
     // Edge som tekst
     const char* edgeStr = "-";
@@ -349,6 +923,54 @@ void timers_print_status() {
   }
 
   Serial.println(F("------------------------------------------------------------------------------------------------------------------------------"));
+
+  TimerLatenessStats st;
+  timers_lateness_get(st);
+  Serial.print(F("scheduler: Timer4 OCR4A, events="));
+  Serial.print(st.events);
+  Serial.print(F(" late last/max="));
+  Serial.print(st.lateLastUs); Serial.print(F("/"));
+  Serial.print(st.lateMaxUs);
+  Serial.print(F(" us, isr max="));
+  Serial.print(st.isrMaxUs);
+  Serial.println(F(" us"));
+  Serial.print(F("gpio output: deadline->pin last/max="));
+  Serial.print(st.outLastUs); Serial.print(F("/"));
+  Serial.print(st.outMaxUs);
+  Serial.println(F(" us"));
+  Serial.print(F("trigger isr: edge->first phase last/max="));
+  Serial.print(st.trigLastUs); Serial.print(F("/"));
+  Serial.print(st.trigMaxUs);
+  Serial.println(F(" us"));
+  for (uint8_t i = 0; i < 4; i++) {
+    if (timerTrigPin[i] == 0) continue;
+    Serial.print(F("timer ")); Serial.print(i + 1);
+    Serial.print(F(" trigger pin ")); Serial.print(timerTrigPin[i]);
+    Serial.println(trig_bound(i) ? F(" (isr)") : F(" (inactive, not mode 4)"));
+  }
+  for (uint8_t i = 0; i < 4; i++) {
+    if (timerParamReg[i] == 0) continue;
+    Serial.print(F("timer ")); Serial.print(i + 1);
+    Serial.print(F(" params: regs ")); Serial.print(timerParamReg[i]);
+    Serial.print(F("..")); Serial.print(timerParamReg[i] + TIMER_PARAM_REGS - 1);
+    Serial.println(F(" (T1..T3 LSW/MSW, P1..P3 bits)"));
+  }
+  for (uint8_t i = 0; i < 4; i++) {
+    if (timers[i].mode != TM_SEQUENCE || timerSeqReg[i] == 0) continue;
+    const uint16_t* r = seq_regs(i);
+    Serial.print(F("timer ")); Serial.print(i + 1);
+    Serial.print(F(" program: reg ")); Serial.print(timerSeqReg[i]);
+    Serial.print(F(" steps=")); Serial.print(r[2]);
+    Serial.print(F(" step="));
+    if (r[1] == SEQ_STEP_IDLE) Serial.print(F("-")); else Serial.print(r[1]);
+    if (seqWait & (1u << i)) {
+      Serial.print(F(" wait input ")); Serial.print(seqWaitIdx[i]);
+      Serial.print(seqWaitLvl[i] ? F("=1") : F("=0"));
+    }
+    Serial.print(F(" coils ")); Serial.print(timers[i].coil);
+    Serial.print(F("..")); Serial.println(timers[i].coil + SEQ_COILS - 1);
+  }
+  wave_print_status();
 }
 
 void timers_clear_alarms() {
@@ -0,0 +1,69 @@
+// ============================================================================
+//  Filnavn : modbus_timers_seq.cpp
+//  Projekt  : Modbus RTU Server / CLI
+//  Version  : v3.8.6 (2026-10-18)
+//  Forfatter: JanG at modbus_slave@laces.dk
+//  Formål   : Trin-program format for timer mode 6 (se modbus_timers_seq.h).
+//             Programmet læses direkte fra holding-registrene; der kopieres
+//             intet til RAM. Mens programmet kører, afvises master-skrivninger
+//             til N og trinene (seq_write_locked), så ISR'en ser ét program.
+//  Ændringer:
+//    - v3.9.6: Programblok må ikke overlappe andre features (regmap_owner)
+//    - v3.9.6: seq_reg_set kræver hele blokken (SEQ_BLOCK_REGS) inden for
+//              NUM_REGS; seq_write_locked() til FC06/FC16
+// ============================================================================
+
+#include "modbus_timers_seq.h"
+#include "modbus_timers.h"
+#include "modbus_regmap.h"
+
+uint16_t timerSeqReg[4] = {0, 0, 0, 0};
+
+bool seq_reg_set(uint8_t idx, uint16_t reg) {
+  if (idx >= 4) return false;
+  if (reg != 0 && (uint32_t)reg + SEQ_BLOCK_REGS > NUM_REGS) return false;
+  if (reg != 0 && regmap_owner(reg, SEQ_BLOCK_REGS, REGMAP_ID(REGMAP_SEQ, idx))) return false;
+  timerSeqReg[idx] = reg;
+  if (reg != 0) {
+    holdingRegs[reg]     = 0;
+    holdingRegs[reg + 1] = SEQ_STEP_IDLE;
+  }
+  return true;
+}
+
+bool seq_step_get(uint8_t idx, uint8_t step, SeqStep& out) {
+  uint16_t reg = timerSeqReg[idx];
+  if (reg == 0) return false;
+  uint16_t n = holdingRegs[reg + 2];
+  if (n > SEQ_MAX_STEPS) n = SEQ_MAX_STEPS;
+  if (step >= n) return false;
+  uint16_t w = reg + SEQ_HDR_REGS + (uint16_t)step * SEQ_STEP_REGS;
+
+  uint16_t w0 = holdingRegs[w];
+  uint16_t w2 = holdingRegs[w + 2];
+  out.mask   = (uint8_t)(w0 & 0xFF);
+  out.levels = (uint8_t)(w0 >> 8);
+  out.arg    = holdingRegs[w + 1];
+  out.wait   = (uint8_t)((w2 >> 8) & 0x0F);
+  uint8_t nx = (uint8_t)(w2 & 0xFF);
+  out.next   = (nx == SEQ_NEXT_SEQ) ? (uint8_t)(step + 1) : nx;
+  return true;
+}
+
+uint16_t* seq_regs(uint8_t idx) {
+  if (idx >= 4 || timerSeqReg[idx] == 0) return nullptr;
+  return &holdingRegs[timerSeqReg[idx]];
+}
+
+bool seq_write_locked(uint16_t start, uint16_t count) {
+  uint32_t end = (uint32_t)start + count;
+  for (uint8_t i = 0; i < 4; ++i) {
+    uint16_t reg = timerSeqReg[i];
+    if (reg == 0 || timers[i].mode != TM_SEQUENCE || !timers[i].active) continue;
+    // base+0 (kontrol) er altid skrivbar, så programmet kan stoppes
+    uint16_t lo = reg + 1;
+    uint16_t hi = reg + SEQ_BLOCK_REGS;
+    if (start < hi && end > lo) return true;
+  }
+  return false;
+}
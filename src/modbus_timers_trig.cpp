@@ -0,0 +1,192 @@
+// ============================================================================
+//  Filnavn : modbus_timers_trig.cpp
+//  Projekt  : Modbus RTU Server / CLI
+//  Version  : v3.8.7 (2026-10-18)
+//  Forfatter: JanG at modbus_slave@laces.dk
+//  Formål   : INT/PCINT trigger-pins for timer mode 4 (se modbus_timers_trig.h).
+//             ISR'erne tager tidsstemplet først og kalder timers_trigger_isr(),
+//             som starter sekvensen og skriver første fase med det samme.
+//  Ændringer:
+//    - v3.9.6: Afviser 18/19 (MODBUS_SERIAL); trig_pin_set tjekker også
+//              gate-pin, compare-mål og gpioToInput-mapping
+// ============================================================================
+
+#include "modbus_timers_trig.h"
+#include "modbus_timers.h"
+#include "modbus_timers_wave.h"
+#include "modbus_counters.h"
+#include "modbus_counters_sw_int.h"
+#include "modbus_counters_snapshot.h"
+#include "modbus_counters_window.h"
+#include "modbus_counters_compare.h"
+#include "modbus_timebase.h"
+
+uint8_t timerTrigPin[4] = {0, 0, 0, 0};
+
+#define TRIG_NONE  0xFF
+
+// Aktiv binding pr. timer (sat af trig_rebind, læst af ISR'erne)
+static uint8_t trigBoundPin[4] = {0, 0, 0, 0};
+static volatile uint8_t* trigPinReg[4];
+static uint8_t trigPinMask[4];
+
+// INT0..INT5 -> timer idx
+static volatile uint8_t trigIntTimer[6] = {TRIG_NONE, TRIG_NONE, TRIG_NONE,
+                                           TRIG_NONE, TRIG_NONE, TRIG_NONE};
+
+// PCINT: port 0 = PCINT0 (PINB), 1 = PCINT2 (PINK)
+static volatile uint8_t trigPcPort[4] = {TRIG_NONE, TRIG_NONE, TRIG_NONE, TRIG_NONE};
+static volatile uint8_t trigPcMask[2] = {0, 0};   // bits bundet til en timer
+static volatile uint8_t trigPcLast[2] = {0, 0};   // portniveau ved seneste ISR
+
+// ============================================================================
+// ISR'er
+// ============================================================================
+static inline void trig_int(uint8_t n) {
+  uint32_t at = timebase_ticks_isr();
+  uint8_t idx = trigIntTimer[n];
+  if (idx != TRIG_NONE) timers_trigger_isr(idx, at);
+}
+
+static void trig_int0() { trig_int(0); }
+static void trig_int1() { trig_int(1); }
+static void trig_int2() { trig_int(2); }
+static void trig_int3() { trig_int(3); }
+static void trig_int4() { trig_int(4); }
+static void trig_int5() { trig_int(5); }
+
+// Pin-skift på en PCINT-port: flanken afgøres ud fra det læste niveau
+static void trig_pcint(uint8_t port, uint8_t level, uint32_t at) {
+  uint8_t changed = (uint8_t)((level ^ trigPcLast[port]) & trigPcMask[port]);
+  trigPcLast[port] = level;
+  if (!changed) return;
+  for (uint8_t i = 0; i < 4; ++i) {
+    if (trigPcPort[i] != port || !(changed & trigPinMask[i])) continue;
+    bool high = (level & trigPinMask[i]) != 0;
+    uint8_t e = timers[i].trigEdge;
+    if ((e == TRIG_RISING && high) || (e == TRIG_FALLING && !high) || e == TRIG_BOTH) {
+      timers_trigger_isr(i, at);
+    }
+  }
+}
+
+ISR(PCINT0_vect) {
+  uint8_t level = PINB;
+  trig_pcint(0, level, timebase_ticks_isr());
+}
+
+ISR(PCINT2_vect) {
+  uint8_t level = PINK;
+  trig_pcint(1, level, timebase_ticks_isr());
+}
+
+// ============================================================================
+// Hjælpere
+// ============================================================================
+// PCINT-port for pin: 0 = PCINT0, 1 = PCINT2, TRIG_NONE = ingen
+static uint8_t trig_pc_port(uint8_t pin) {
+  if (digitalPinToPCICR(pin) == 0) return TRIG_NONE;
+  uint8_t b = digitalPinToPCICRbit(pin);
+  if (b == 0) return 0;
+  if (b == 2) return 1;
+  return TRIG_NONE;             // PCINT1 deler pins med Serial/Serial3
+}
+
+bool trig_pin_valid(uint8_t pin) {
+  if (gpio_pin_reserved(pin)) return false;   // INT2/INT3 = Serial1 (Modbus)
+  if (sw_counter_is_valid_interrupt_pin(pin)) return true;
+  return trig_pc_port(pin) != TRIG_NONE;
+}
+
+bool trig_uses_pin(uint8_t pin) {
+  if (pin == 0) return false;
+  for (uint8_t i = 0; i < 4; ++i) {
+    if (timerTrigPin[i] == pin) return true;
+  }
+  return false;
+}
+
+bool trig_bound(uint8_t idx) {
+  return idx < 4 && trigBoundPin[idx] != 0;
+}
+
+bool trig_level(uint8_t idx) {
+  if (!trig_bound(idx)) return false;
+  return (*trigPinReg[idx] & trigPinMask[idx]) != 0;
+}
+
+void trig_unbind(uint8_t idx) {
+  if (idx >= 4) return;
+  uint8_t pin = trigBoundPin[idx];
+  if (pin == 0) return;
+
+  uint8_t s = SREG;
+  cli();
+  if (sw_counter_is_valid_interrupt_pin(pin)) {
+    int8_t n = digitalPinToInterrupt(pin);
+    detachInterrupt(n);
+    trigIntTimer[n] = TRIG_NONE;
+  } else {
+    uint8_t port = trigPcPort[idx];
+    trigPcMask[port] &= (uint8_t)~trigPinMask[idx];
+    *digitalPinToPCMSK(pin) &= (uint8_t)~_BV(digitalPinToPCMSKbit(pin));
+    if (trigPcMask[port] == 0) *digitalPinToPCICR(pin) &= (uint8_t)~_BV(digitalPinToPCICRbit(pin));
+    trigPcPort[idx] = TRIG_NONE;
+  }
+  trigBoundPin[idx] = 0;
+  SREG = s;
+}
+
+void trig_rebind(uint8_t idx) {
+  if (idx >= 4) return;
+  trig_unbind(idx);
+  const TimerConfig& t = timers[idx];
+  uint8_t pin = timerTrigPin[idx];
+  if (pin == 0 || !t.enabled || t.mode != TM_TRIGGER) return;
+
+  pinMode(pin, INPUT);
+  trigPinReg[idx]  = portInputRegister(digitalPinToPort(pin));
+  trigPinMask[idx] = digitalPinToBitMask(pin);
+
+  if (sw_counter_is_valid_interrupt_pin(pin)) {
+    static void (*isrs[6])() = {trig_int0, trig_int1, trig_int2,
+                                trig_int3, trig_int4, trig_int5};
+    int8_t n = digitalPinToInterrupt(pin);
+    int mode = CHANGE;
+    if (t.trigEdge == TRIG_RISING)  mode = RISING;
+    if (t.trigEdge == TRIG_FALLING) mode = FALLING;
+    trigIntTimer[n] = idx;
+    trigBoundPin[idx] = pin;
+    attachInterrupt(n, isrs[n], mode);
+    return;
+  }
+
+  uint8_t port = trig_pc_port(pin);
+  uint8_t s = SREG;
+  cli();
+  volatile uint8_t* in = (port == 0) ? &PINB : &PINK;
+  trigPcLast[port] = (uint8_t)((trigPcLast[port] & ~trigPinMask[idx]) | (*in & trigPinMask[idx]));
+  trigPcMask[port] |= trigPinMask[idx];
+  trigPcPort[idx] = port;
+  trigBoundPin[idx] = pin;
+  *digitalPinToPCMSK(pin) |= _BV(digitalPinToPCMSKbit(pin));
+  *digitalPinToPCICR(pin) |= _BV(digitalPinToPCICRbit(pin));
+  SREG = s;
+}
+
+bool trig_pin_set(uint8_t idx, uint8_t pin) {
+  if (idx >= 4) return false;
+  if (pin != 0) {
+    if (!trig_pin_valid(pin)) return false;
+    if (pin == snapshotPin || wave_uses_pin(pin)) return false;
+    if (pin < NUM_GPIO && (gpioToCoil[pin] >= 0 || gpioToInput[pin] >= 0)) return false;
+    if (counters_uses_pin(pin) || gatewin_uses_pin(pin) || cmp_uses_pin(pin)) return false;
+    for (uint8_t i = 0; i < 4; ++i) {
+      if (i != idx && timerTrigPin[i] == pin) return false;
+    }
+  }
+  trig_unbind(idx);
+  timerTrigPin[idx] = pin;
+  trig_rebind(idx);
+  return true;
+}
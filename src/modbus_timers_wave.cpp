@@ -0,0 +1,472 @@
+// ============================================================================
+//  Filnavn : modbus_timers_wave.cpp
+//  Projekt  : Modbus RTU Server / CLI
+//  Version  : v3.8.4 (2026-10-18)
+//  Forfatter: JanG at modbus_slave@laces.dk
+//  Formål   : Hardware waveform (timer mode 5) på Timer1 OC1B/OC1C
+//             (se modbus_timers_wave.h).
+//  Metode:
+//    - PWM/pulstog: Fast PWM mode 15, inverterende output (lav fra BOTTOM,
+//      høj fra compare-match til TOP). Pulsbredde = TOP - OCR1x ticks.
+//    - Pulstog tælles i TIMER1_OVF_vect (TOV1 ved TOP = puls færdig). I den
+//      sidste periode skrives OCR1x = 0xFFFF (> TOP) i bufferen; den latches
+//      ved BOTTOM efter sidste puls, så hardware ikke starter puls N+1.
+//      Kører OVF-ISR'en før BOTTOM (TCNT1 stadig = TOP), skrives stop-
+//      værdien i stedet fra kanalens compare-ISR (OCF1B/OCF1C), som altid
+//      kommer efter BOTTOM - ingen ventetid i ISR. Efter sidste puls køres
+//      én tom periode (pin lav), og timeren standses ved dens TOV1.
+//      ISR'en skal derfor blot nå at køre inden for én periode; pulstog er
+//      begrænset til WAVE_MAX_TRAIN_HZ.
+//    - Enkelt-puls: normal mode, pin sættes med FOC1x og cleares af compare-
+//      match efter præcis n ticks; TIMER1_COMPA_vect stopper timeren.
+//  Ændringer:
+//    - v3.9.6: Sekvens-slut i ISR poster arbejde til idle (idle_isr_post)
+//    - v3.9.6: Reg-blok må ikke overlappe andre features (regmap_owner)
+//    - v3.9.6: Output-pin afvises hvis compare-mål, counter, gate eller
+//              snapshot bruger den
+//    - v3.9.6: wave_pending() til idle-scheduleren
+//    - v3.9.6: Ingen busy-wait til BOTTOM i TIMER1_OVF_vect; stop-værdi
+//              armeres fra compare-ISR; max. pulstog-frekvens håndhæves
+// ============================================================================
+
+#include "modbus_timers_wave.h"
+#include "modbus_idle.h"
+#include "modbus_timers_trig.h"
+#include "modbus_counters.h"
+#include "modbus_counters_compare.h"
+#include "modbus_counters_window.h"
+#include "modbus_counters_snapshot.h"
+#include "modbus_regmap.h"
+
+TimerWaveConfig timerWave = {0, 0, 0};
+
+// ============================================================================
+// Output-kanal (OC1B = pin 12 / PB6, OC1C = pin 13 / PB7)
+// ============================================================================
+static volatile uint16_t* wvOcr = &OCR1B;
+static uint8_t wvComShift = COM1B0;
+static uint8_t wvFoc      = FOC1B;
+static uint8_t wvOcie     = _BV(OCIE1B);   // compare-interrupt for kanalen
+static uint8_t wvOcf      = _BV(OCF1B);
+static uint8_t wvMask     = 0;        // PORTB-bit, 0 = ingen pin
+
+// Loop-state
+static int8_t   wvTimer   = -1;       // timer der ejer generatoren
+static uint8_t  wvCmd     = WAVE_CMD_STOP;
+static uint16_t wvLastCmd = 0;        // sidst sete kommando-reg
+static uint16_t wvFreq = 0, wvDuty = 0, wvCount = 0;
+static uint8_t  wvCs      = 0;        // aktiv prescaler (CS1x)
+static uint8_t  wvStatic  = 0;        // PWM duty 0/1000: pin holdes statisk
+static uint16_t wvStatus  = 0;
+
+// Delt med ISR
+static volatile uint16_t wvDoneCnt  = 0;   // færdige pulser
+static volatile uint16_t wvTarget   = 0;   // N (0 = PWM uden stop)
+static volatile uint8_t  wvArmed    = 0;   // stop-værdi skrevet i OCR-buffer
+static volatile uint8_t  wvFinished = 0;   // sekvens slut (til loop)
+static volatile uint8_t  wvTail     = 0;   // tom periode efter sidste puls
+static volatile uint16_t wvTop      = 0;   // TOP for næste periode
+static volatile uint16_t wvTopPrev  = 0;   // TOP for igangværende periode
+
+static const uint8_t wvShift[5] = {0, 3, 6, 8, 10};   // prescaler 1..1024
+
+// Mindste prescaler hvor clk (16 MHz ticks) giver <= maxTicks timer-ticks
+static bool wv_pick(uint32_t clk, uint32_t maxTicks, uint8_t& cs, uint32_t& ticks) {
+  for (uint8_t k = 0; k < 5; ++k) {
+    uint32_t n = (clk + ((1UL << wvShift[k]) >> 1)) >> wvShift[k];
+    if (n <= maxTicks) {
+      cs = k + 1;
+      ticks = n;
+      return true;
+    }
+  }
+  return false;
+}
+
+// Periode/duty -> prescaler, TOP og OCR (inverterende: høj i TOP-OCR ticks)
+static bool wv_calc(uint16_t freq, uint16_t duty, uint8_t& cs, uint16_t& top, uint16_t& ocr) {
+  if (freq == 0) return false;
+  uint32_t n;
+  if (!wv_pick((F_CPU + freq / 2) / freq, 65536UL, cs, n)) return false;
+  if (n < 3) return false;
+  top = (uint16_t)(n - 1);
+  uint32_t h = (n * (uint32_t)(duty > 1000 ? 1000 : duty) + 500) / 1000;
+  if (h < 1) h = 1;
+  if (h > (uint32_t)(top - 1)) h = top - 1;   // mindst 2 ticks lav
+  ocr = (uint16_t)(top - h);
+  return true;
+}
+
+// ============================================================================
+// Timer1 hardware
+// ============================================================================
+static inline void wv_hw_halt_isr() {
+  TIMSK1 = 0;
+  TCCR1B = 0;
+  TCCR1A = 0;                 // OC1x frakoblet -> pin følger PORTB (lav)
+  TIFR1  = _BV(TOV1) | _BV(OCF1A) | _BV(OCF1B) | _BV(OCF1C);
+}
+
+static void wv_hw_stop() {
+  uint8_t s = SREG;
+  cli();
+  wv_hw_halt_isr();
+  PORTB &= (uint8_t)~wvMask;
+  wvArmed    = 0;
+  wvFinished = 0;
+  wvTail     = 0;
+  SREG = s;
+}
+
+// Fast PWM mode 15, inverterende. n = antal pulser (0 = kontinuerlig PWM, ellers >= 2)
+static void wv_hw_train(uint8_t cs, uint16_t top, uint16_t ocr, uint16_t n) {
+  uint8_t s = SREG;
+  cli();
+  TIMSK1 = 0;
+  TCCR1B = 0;
+  // Normal mode: OC-latch -> lav og direkte skrivning af compare-registre
+  TCCR1A = (uint8_t)(2 << wvComShift);
+  TCCR1C = _BV(wvFoc);
+  TCNT1  = 0;
+  OCR1A  = top;
+  *wvOcr = ocr;
+  TCCR1A = (uint8_t)((3 << wvComShift) | _BV(WGM11) | _BV(WGM10));
+  TCCR1B = _BV(WGM13) | _BV(WGM12);
+  OCR1A  = top;               // fyld double-buffer med samme værdier
+  *wvOcr = ocr;
+  wvTop = wvTopPrev = top;
+  wvDoneCnt  = 0;
+  wvTarget   = n;
+  wvArmed    = 0;
+  wvFinished = 0;
+  wvTail     = 0;
+  TIFR1  = _BV(TOV1) | _BV(OCF1A) | _BV(OCF1B) | _BV(OCF1C);
+  TIMSK1 = n ? _BV(TOIE1) : 0;
+  TCCR1B = (uint8_t)(_BV(WGM13) | _BV(WGM12) | cs);
+  SREG = s;
+}
+
+// Enkelt-puls på n ticks (normal mode). Pin høj ved FOC, lav ved compare-
+// match; ca. 4 CPU-cykler (0,25 µs) fra FOC til timer-start.
+static void wv_hw_pulse(uint8_t cs, uint16_t n) {
+  uint8_t s = SREG;
+  cli();
+  TIMSK1 = 0;
+  TCCR1B = 0;
+  TCNT1  = 0;
+  OCR1A  = n;
+  *wvOcr = n;
+  wvTarget   = 1;
+  wvDoneCnt  = 0;
+  wvArmed    = 0;
+  wvFinished = 0;
+  wvTail     = 0;
+  TIFR1  = _BV(TOV1) | _BV(OCF1A) | _BV(OCF1B) | _BV(OCF1C);
+  TIMSK1 = _BV(OCIE1A);
+  TCCR1A = (uint8_t)(3 << wvComShift);    // set on match
+  TCCR1C = _BV(wvFoc);                    // -> pin høj nu
+  TCCR1A = (uint8_t)(2 << wvComShift);    // clear on match
+  TCCR1B = cs;
+  SREG = s;
+}
+
+// Ny periode/duty i double-buffer (latches sammen ved næste BOTTOM)
+static void wv_hw_update(uint16_t top, uint16_t ocr) {
+  uint8_t s = SREG;
+  cli();
+  wvTopPrev = wvTop;
+  wvTop  = top;
+  OCR1A  = top;
+  if (!wvArmed) *wvOcr = ocr;
+  SREG = s;
+}
+
+// ============================================================================
+// ISR'er
+// ============================================================================
+// Stop-værdi i OCR-bufferen: latches ved næste BOTTOM, så perioden der
+// kører nu er den sidste med puls
+static inline void wv_arm_stop_isr() {
+  *wvOcr  = 0xFFFF;
+  wvArmed = 1;
+  TIMSK1 &= (uint8_t)~wvOcie;
+}
+
+// TOV1 ved TOP: én puls er færdig
+ISR(TIMER1_OVF_vect) {
+  if (wvTarget == 0) return;          // kontinuerlig PWM tælles ikke
+  if (wvTail) {                       // tom periode slut (pin lav hele vejen)
+    wv_hw_halt_isr();
+    wvTail  = 0;
+    wvArmed = 0;
+    return;
+  }
+  uint16_t d = wvDoneCnt + 1;
+  wvDoneCnt = d;
+  if (wvArmed || d >= wvTarget) {
+    if (!wvArmed) {
+      // Ikke armeret i tide (N sænket sent): før BOTTOM når stop-værdien
+      // endnu at blive latched, ellers standses timeren straks
+      uint16_t t = TCNT1;
+      if (t != wvTop && t != wvTopPrev) {
+        wv_hw_halt_isr();
+        wvFinished = 1;
+        idle_isr_post();
+        return;
+      }
+      *wvOcr = 0xFFFF;
+    }
+    TIMSK1 &= (uint8_t)~wvOcie;
+    wvArmed    = 1;               // wv_hw_update må ikke overskrive stop-værdien
+    wvTail     = 1;
+    wvFinished = 1;
+    idle_isr_post();
+    return;
+  }
+  if ((uint16_t)(d + 1) >= wvTarget) {
+    // Stop-værdien må først latches ved BOTTOM efter sidste puls. Er
+    // BOTTOM allerede passeret, skrives den nu; ellers fra compare-match
+    // i sidste periode (efter BOTTOM, før næste BOTTOM)
+    uint16_t t = TCNT1;
+    if (t != wvTop && t != wvTopPrev) {
+      wv_arm_stop_isr();
+    } else {
+      TIFR1   = wvOcf;
+      TIMSK1 |= wvOcie;
+    }
+  }
+  wvTopPrev = wvTop;
+}
+
+ISR(TIMER1_COMPB_vect) {
+  wv_arm_stop_isr();
+}
+
+ISR(TIMER1_COMPC_vect) {
+  wv_arm_stop_isr();
+}
+
+// Enkelt-puls slut (pin allerede lav via compare-match)
+ISR(TIMER1_COMPA_vect) {
+  wv_hw_halt_isr();
+  wvDoneCnt  = 1;
+  wvFinished = 1;
+  idle_isr_post();
+}
+
+// ============================================================================
+// Kommandoer
+// ============================================================================
+static void wv_start(uint16_t cmd) {
+  wv_hw_stop();
+  wvCmd    = WAVE_CMD_STOP;
+  wvStatic = 0;
+  wvStatus = 0;
+  if (cmd == WAVE_CMD_STOP) return;
+
+  const uint16_t* r = &holdingRegs[timerWave.reg];
+  bool ok = false;
+
+  if (cmd == WAVE_CMD_PULSE) {
+    uint32_t us = (uint32_t)r[4] | ((uint32_t)r[5] << 16);
+    uint32_t n;
+    if (us >= 1 && us <= WAVE_MAX_PULSE_US && wv_pick(us * (F_CPU / 1000000UL), 65535UL, wvCs, n)) {
+      wv_hw_pulse(wvCs, (uint16_t)n);
+      ok = true;
+    }
+  }
+  else if (cmd == WAVE_CMD_PWM || cmd == WAVE_CMD_TRAIN) {
+    uint16_t top, ocr;
+    wvFreq  = r[1];
+    wvDuty  = r[2];
+    wvCount = r[3];
+    if (wv_calc(wvFreq, wvDuty, wvCs, top, ocr)) {
+      if (cmd == WAVE_CMD_PWM) {
+        if (wvDuty == 0 || wvDuty >= 1000) {
+          // 0 % / 100 %: timeren stoppet, pin holdes statisk
+          wvStatic = 1;
+          if (wvDuty) PORTB |= wvMask;
+        } else {
+          wv_hw_train(wvCs, top, ocr, 0);
+        }
+        ok = true;
+      } else if (wvDuty != 0 && wvCount != 0 &&
+                 (wvCount == 1 || wvFreq <= WAVE_MAX_TRAIN_HZ)) {
+        if (wvCount == 1) wv_hw_pulse(wvCs, (uint16_t)(top - ocr));
+        else              wv_hw_train(wvCs, top, ocr, wvCount);
+        ok = true;
+      }
+    }
+  }
+
+  if (ok) {
+    wvCmd    = (uint8_t)cmd;
+    wvStatus = WAVE_ST_RUNNING;
+  } else {
+    wvStatus = WAVE_ST_PARAM_ERR;
+  }
+}
+
+// Frekvens/duty/N ændret mens output kører
+static void wv_retune() {
+  const uint16_t* r = &holdingRegs[timerWave.reg];
+  uint16_t freq = r[1], duty = r[2], cnt = r[3];
+
+  if (wvCmd == WAVE_CMD_TRAIN && cnt != wvCount) {
+    wvCount = cnt;
+    uint8_t s = SREG;
+    cli();
+    wvTarget = cnt;
+    // Allerede nået: stop efter igangværende puls
+    if (!wvArmed && !wvTail && (uint16_t)(wvDoneCnt + 1) >= cnt) wv_arm_stop_isr();
+    SREG = s;
+  }
+
+  if (freq == wvFreq && duty == wvDuty) return;
+
+  uint8_t cs;
+  uint16_t top, ocr;
+  bool ok = wv_calc(freq, duty, cs, top, ocr);
+  if (wvCmd == WAVE_CMD_PWM) {
+    bool stat = (duty == 0 || duty >= 1000);
+    if (ok && (stat || wvStatic || cs != wvCs)) {
+      wv_start(WAVE_CMD_PWM);   // prescaler-skift / statisk niveau: genstart
+      return;
+    }
+  } else if (ok && (duty == 0 || cs != wvCs || freq > WAVE_MAX_TRAIN_HZ)) {
+    ok = false;                 // pulstog kan ikke skifte prescaler undervejs
+  }
+
+  wvFreq = freq;
+  wvDuty = duty;
+  if (!ok) {
+    wvStatus |= WAVE_ST_PARAM_ERR;
+    return;
+  }
+  wvStatus &= (uint16_t)~WAVE_ST_PARAM_ERR;
+  wv_hw_update(top, ocr);
+}
+
+// ============================================================================
+// API
+// ============================================================================
+bool wave_config_set(const TimerWaveConfig& cfg) {
+  if (cfg.reg != 0 && (uint32_t)cfg.reg + WAVE_BLOCK_REGS > NUM_REGS) return false;
+  if (cfg.reg != 0 && regmap_owner(cfg.reg, WAVE_BLOCK_REGS, REGMAP_ID(REGMAP_WAVE, 0))) return false;
+  if (cfg.pin != 0 && cfg.pin != 12 && cfg.pin != 13) return false;
+  if (cfg.pin != 0 && (gpioToCoil[cfg.pin] >= 0 || gpioToInput[cfg.pin] >= 0)) return false;
+  if (cfg.pin != 0 && trig_uses_pin(cfg.pin)) return false;
+  // Compare-mål, counter-input, gate eller snapshot på samme pin
+  if (cfg.pin != 0 && (cmp_uses_pin(cfg.pin) || counters_uses_pin(cfg.pin) ||
+                       gatewin_uses_pin(cfg.pin) || cfg.pin == snapshotPin)) return false;
+
+  wv_hw_stop();
+  if (timerWave.pin != 0 && timerWave.pin != cfg.pin) pinMode(timerWave.pin, INPUT);
+
+  timerWave = cfg;
+  timerWave.reserved = 0;
+  if (cfg.pin == 13) {
+    wvOcr = &OCR1C; wvComShift = COM1C0; wvFoc = FOC1C; wvMask = _BV(7);
+    wvOcie = _BV(OCIE1C); wvOcf = _BV(OCF1C);
+  } else {
+    wvOcr = &OCR1B; wvComShift = COM1B0; wvFoc = FOC1B; wvMask = (cfg.pin == 12) ? _BV(6) : 0;
+    wvOcie = _BV(OCIE1B); wvOcf = _BV(OCF1B);
+  }
+  if (cfg.pin != 0) {
+    PORTB &= (uint8_t)~wvMask;
+    pinMode(cfg.pin, OUTPUT);
+  }
+
+  wvCmd     = WAVE_CMD_STOP;
+  wvStatic  = 0;
+  wvStatus  = 0;
+  wvLastCmd = 0;              // kommando i reg anvendes ved næste loop
+  return true;
+}
+
+void wave_bind(uint8_t idx) {
+  wv_hw_stop();
+  wvTimer   = (int8_t)idx;
+  wvCmd     = WAVE_CMD_STOP;
+  wvStatic  = 0;
+  wvStatus  = 0;
+  wvLastCmd = 0;
+}
+
+void wave_unbind() {
+  wv_hw_stop();
+  wvTimer  = -1;
+  wvCmd    = WAVE_CMD_STOP;
+  wvStatic = 0;
+  wvStatus = 0;
+}
+
+int8_t wave_timer() {
+  return wvTimer;
+}
+
+bool wave_uses_pin(uint8_t pin) {
+  return pin != 0 && timerWave.pin == pin;
+}
+
+bool wave_running() {
+  return wvCmd != WAVE_CMD_STOP;
+}
+
+bool wave_pending() {
+  return wvFinished != 0;
+}
+
+bool wave_loop() {
+  if (wvTimer < 0 || timerWave.reg == 0 || wvMask == 0) return false;
+  uint16_t* r = &holdingRegs[timerWave.reg];
+  bool completed = false;
+
+  uint8_t s = SREG;
+  cli();
+  uint8_t fin = wvFinished;
+  wvFinished = 0;
+  uint16_t done = wvDoneCnt;
+  uint16_t target = wvTarget;
+  SREG = s;
+
+  if (fin && wvCmd != WAVE_CMD_STOP) {
+    wvCmd     = WAVE_CMD_STOP;
+    wvStatus  = (uint16_t)((wvStatus & WAVE_ST_PARAM_ERR) | WAVE_ST_DONE);
+    r[0]      = WAVE_CMD_STOP;
+    wvLastCmd = WAVE_CMD_STOP;
+    completed = true;
+  }
+
+  uint16_t cmd = r[0];
+  if (cmd != wvLastCmd) {
+    wvLastCmd = cmd;
+    wv_start(cmd);
+  } else if (wvCmd == WAVE_CMD_PWM || wvCmd == WAVE_CMD_TRAIN) {
+    wv_retune();
+  }
+
+  uint16_t remain = 0;
+  if (wvCmd == WAVE_CMD_TRAIN || wvCmd == WAVE_CMD_PULSE) {
+    remain = (target > done) ? (uint16_t)(target - done) : 0;
+  }
+  r[6] = remain;
+  r[7] = wvStatus;
+  return completed;
+}
+
+void wave_print_status() {
+  if (wvTimer < 0) return;
+  Serial.print(F("waveform: timer ")); Serial.print(wvTimer + 1);
+  Serial.print(F(" Timer1 pin ")); Serial.print(timerWave.pin);
+  Serial.print(timerWave.pin == 13 ? F(" (OC1C)") : F(" (OC1B)"));
+  Serial.print(F(" reg ")); Serial.print(timerWave.reg);
+  Serial.print(F("..")); Serial.print(timerWave.reg + WAVE_BLOCK_REGS - 1);
+  Serial.print(F(" cmd=")); Serial.print(wvCmd);
+  if (wvCmd == WAVE_CMD_PWM || wvCmd == WAVE_CMD_TRAIN) {
+    Serial.print(F(" ")); Serial.print(wvFreq);
+    Serial.print(F(" Hz duty ")); Serial.print(wvDuty);
+    Serial.print(F(" permille"));
+  }
+  Serial.print(F(" status=0x")); Serial.println(wvStatus, HEX);
+}
@@ -1,6 +1,7 @@
 #include "modbus_core.h"
 
 void sendResponse(uint8_t *r,uint8_t len,uint8_t sid){
+  if(sid==0) return;   // broadcast besvares aldrig
   if(monitorMode){
     Serial.println("--- MONITOR: TX suppressed ---");
     Serial.print("HEX: "); printHex(r,len); return;
@@ -1,9 +1,11 @@
 // ============================================================================
 //  Filnavn : modbus_utils.cpp
 //  Projekt  : Modbus RTU Server / CLI
-//  Version  : v3.1.3-patch1 (2025-11-03)
+//  Version  : v3.8.0 (2026-10-18)
 //  Forfatter: JanG at modbus_slave@laces.dk
 //  Formål   : Diverse hjælpefunktioner – CRC, bitfelter, RTU-gap m.m.
+//  Ændringer:
+//    - v3.8.0: bitWriteArray() er atomisk (coils skrives også fra ISR)
 // ============================================================================
 
 #include "modbus_globals.h"
@@ -34,11 +36,16 @@ bool bitReadArray(const uint8_t *arr, uint16_t bitIndex) {
   return (arr[byteIndex] >> bitPos) & 0x01;
 }
 
+// Read-modify-write sker med interrupts slået fra: TimerEngine-ISR'en
+// skriver coil-bits, og en afbrudt RMW i loop ville overskrive dem.
 void bitWriteArray(uint8_t *arr, uint16_t bitIndex, bool value) {
   uint16_t byteIndex = bitIndex / 8;
   uint8_t  bitPos    = bitIndex % 8;
+  uint8_t s = SREG;
+  cli();
   if (value) arr[byteIndex] |= (1 << bitPos);
   else       arr[byteIndex] &= ~(1 << bitPos);
+  SREG = s;
 }
 
 void packBits(const uint8_t *src, uint16_t start, uint16_t qty, uint8_t *dst) {
@@ -7,6 +7,10 @@ void printStatistics() {
   Serial.print("CRC Err: "); Serial.println(crcErrors);
   Serial.print("Wrong ID: "); Serial.println(wrongSlaveID);
   Serial.print("TX: "); Serial.println(responsesSent);
+  Serial.print("Boot ready (ms): "); Serial.println(inputRegs[IREG_DIAG_BOOT_READY_MS]);
+  Serial.print("First frame (ms): ");
+  if (inputRegs[IREG_DIAG_BOOT_FIRST_MS]) Serial.println(inputRegs[IREG_DIAG_BOOT_FIRST_MS]);
+  else Serial.println("-");
   Serial.println("=============");
 }
 